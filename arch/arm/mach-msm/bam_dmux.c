@@ -27,6 +27,8 @@
 #include <linux/clk.h>
 #include <linux/wakelock.h>
 #include <linux/kfifo.h>
+#include <linux/hrtimer.h>
+#include <linux/interrupt.h>
 
 #include <mach/sps.h>
 #include <mach/bam_dmux.h>
@@ -54,10 +56,27 @@
 #define LOW_WATERMARK		2
 #define HIGH_WATERMARK		4
 
+#define UL_AGGR_MAX_SIZE	4096
+#define UL_AGGR_MAX_USECS	10000
+
 static int msm_bam_dmux_debug_enable;
 module_param_named(debug_enable, msm_bam_dmux_debug_enable,
 		   int, S_IRUGO | S_IWUSR | S_IWGRP);
 
+/*
+ * Uplink aggregation: pack several mux frames into one BAM descriptor,
+ * sent once aggr_size bytes are reached or aggr_time_us after the first
+ * frame, whichever comes first.  An aggregate counts once against the
+ * tx watermarks of each channel it carries.  Downlink buffers are then
+ * also parsed for more than one frame.  Both ends must support it, so
+ * 0 (off) is the default.
+ */
+static uint ul_aggr_size;
+module_param_named(aggr_size, ul_aggr_size, uint, S_IRUGO | S_IWUSR | S_IWGRP);
+static uint ul_aggr_time_us = 1000;
+module_param_named(aggr_time_us, ul_aggr_time_us,
+		   uint, S_IRUGO | S_IWUSR | S_IWGRP);
+
 #if defined(DEBUG)
 static uint32_t bam_dmux_read_cnt;
 static uint32_t bam_dmux_write_cnt;
@@ -65,6 +84,9 @@ static uint32_t bam_dmux_write_cpy_cnt;
 static uint32_t bam_dmux_write_cpy_bytes;
 static uint32_t bam_dmux_tx_sps_failure_cnt;
 static uint32_t bam_dmux_tx_stall_cnt;
+static uint32_t bam_dmux_ul_aggr_desc_cnt;
+static uint32_t bam_dmux_ul_aggr_pkt_cnt;
+static uint32_t bam_dmux_dl_deaggr_pkt_cnt;
 
 #define DBG(x...) do {		                 \
 		if (msm_bam_dmux_debug_enable)  \
@@ -102,6 +124,15 @@ static uint32_t bam_dmux_tx_stall_cnt;
 	bam_dmux_tx_stall_cnt++; \
 } while (0)
 
+#define DBG_INC_UL_AGGR_CNT(x) do {		\
+		bam_dmux_ul_aggr_desc_cnt++;	\
+		bam_dmux_ul_aggr_pkt_cnt += (x);	\
+} while (0)
+
+#define DBG_INC_DL_DEAGGR_CNT() do {	\
+	bam_dmux_dl_deaggr_pkt_cnt++; \
+} while (0)
+
 #else
 #define DBG(x...) do { } while (0)
 #define DBG_INC_READ_CNT(x...) do { } while (0)
@@ -109,6 +140,8 @@ static uint32_t bam_dmux_tx_stall_cnt;
 #define DBG_INC_WRITE_CPY(x...) do { } while (0)
 #define DBG_INC_TX_SPS_FAILURE_CNT() do { } while (0)
 #define DBG_INC_TX_STALL_CNT() do { } while (0)
+#define DBG_INC_UL_AGGR_CNT(x) do { } while (0)
+#define DBG_INC_DL_DEAGGR_CNT() do { } while (0)
 #endif
 
 struct bam_ch_info {
@@ -126,6 +159,9 @@ struct tx_pkt_info {
 	struct sk_buff *skb;
 	dma_addr_t dma_address;
 	char is_cmd;
+	char is_aggr;	/* skb holds copies of the frames in aggr_pkts */
+	struct sk_buff_head aggr_pkts;
+	uint32_t aggr_chs;	/* channels counted once for this aggregate */
 	uint32_t len;
 	struct work_struct work;
 	struct list_head list_node;
@@ -136,6 +172,7 @@ struct tx_pkt_info {
 struct rx_pkt_info {
 	struct sk_buff *skb;
 	dma_addr_t dma_address;
+	uint32_t len;	/* bytes actually received */
 	struct work_struct work;
 	struct list_head list_node;
 };
@@ -169,6 +206,11 @@ static int bam_rx_pool_len;
 static LIST_HEAD(bam_tx_pool);
 static DEFINE_SPINLOCK(bam_tx_pool_spinlock);
 
+/* uplink frame being aggregated, protected by ul_aggr_lock */
+static struct tx_pkt_info *ul_aggr_pkt;
+static DEFINE_SPINLOCK(ul_aggr_lock);
+static struct hrtimer ul_aggr_timer;
+
 struct bam_mux_hdr {
 	uint16_t magic_num;
 	uint8_t reserved;
@@ -182,8 +224,12 @@ static void notify_all(int event, unsigned long data);
 static void bam_mux_write_done(struct work_struct *work);
 static void handle_bam_mux_cmd(struct work_struct *work);
 static void rx_timer_work_func(struct work_struct *work);
+static void ul_aggr_flush_func(unsigned long data);
+static void ul_aggr_wakeup_func(struct work_struct *work);
 
 static DECLARE_WORK(rx_timer_work, rx_timer_work_func);
+static DECLARE_TASKLET(ul_aggr_flush_tasklet, ul_aggr_flush_func, 0);
+static DECLARE_WORK(ul_aggr_wakeup_work, ul_aggr_wakeup_func);
 
 static struct workqueue_struct *bam_mux_rx_workqueue;
 static struct workqueue_struct *bam_mux_tx_workqueue;
@@ -385,6 +431,7 @@ static void queue_rx(void)
 		}
 
 		INIT_WORK(&info->work, handle_bam_mux_cmd);
+		info->len = BUFFER_SIZE;
 
 		info->skb = __dev_alloc_skb(BUFFER_SIZE, GFP_KERNEL);
 		if (info->skb == NULL) {
@@ -468,6 +515,43 @@ static void bam_mux_process_data(struct sk_buff *rx_skb)
 	queue_rx();
 }
 
+/*
+ * Copy out any data frames following the first one in an aggregated
+ * downlink buffer.  They are delivered after the first frame so the
+ * order on the wire is kept.
+ */
+static void bam_mux_deaggregate(struct sk_buff *rx_skb, uint32_t rx_len,
+				struct sk_buff_head *frames)
+{
+	struct bam_mux_hdr *hdr = (struct bam_mux_hdr *)rx_skb->data;
+	uint32_t offset;
+	uint32_t frame_len;
+	struct sk_buff *skb;
+
+	rx_len = min_t(uint32_t, rx_len, BUFFER_SIZE);
+	offset = sizeof(struct bam_mux_hdr) + hdr->pkt_len + hdr->pad_len;
+	while (offset + sizeof(struct bam_mux_hdr) <= rx_len) {
+		hdr = (struct bam_mux_hdr *)(rx_skb->data + offset);
+		frame_len = sizeof(struct bam_mux_hdr) + hdr->pkt_len;
+		if (hdr->magic_num != BAM_MUX_HDR_MAGIC_NO ||
+		    hdr->cmd != BAM_MUX_HDR_CMD_DATA ||
+		    hdr->ch_id >= BAM_DMUX_NUM_CHANNELS ||
+		    offset + frame_len + hdr->pad_len > rx_len)
+			break;
+
+		skb = __dev_alloc_skb(frame_len, GFP_KERNEL);
+		if (!skb) {
+			DMUX_LOG_KERR("%s: unable to alloc skb\n", __func__);
+			break;
+		}
+		memcpy(skb_put(skb, frame_len), hdr, frame_len);
+		__skb_queue_tail(frames, skb);
+		DBG_INC_READ_CNT(hdr->pkt_len);
+		DBG_INC_DL_DEAGGR_CNT();
+		offset += frame_len + hdr->pad_len;
+	}
+}
+
 static inline void handle_bam_mux_cmd_open(struct bam_mux_hdr *rx_hdr)
 {
 	unsigned long flags;
@@ -490,9 +574,12 @@ static void handle_bam_mux_cmd(struct work_struct *work)
 	struct bam_mux_hdr *rx_hdr;
 	struct rx_pkt_info *info;
 	struct sk_buff *rx_skb;
+	struct sk_buff_head frames;
+	uint32_t rx_len;
 
 	info = container_of(work, struct rx_pkt_info, work);
 	rx_skb = info->skb;
+	rx_len = info->len;
 	dma_unmap_single(NULL, info->dma_address, BUFFER_SIZE, DMA_FROM_DEVICE);
 	kfree(info);
 
@@ -527,7 +614,12 @@ static void handle_bam_mux_cmd(struct work_struct *work)
 	switch (rx_hdr->cmd) {
 	case BAM_MUX_HDR_CMD_DATA:
 		DBG_INC_READ_CNT(rx_hdr->pkt_len);
+		__skb_queue_head_init(&frames);
+		if (ul_aggr_size)
+			bam_mux_deaggregate(rx_skb, rx_len, &frames);
 		bam_mux_process_data(rx_skb);
+		while ((rx_skb = __skb_dequeue(&frames)))
+			bam_mux_process_data(rx_skb);
 		break;
 	case BAM_MUX_HDR_CMD_OPEN:
 		bam_dmux_log("%s: opening cid %d PC enabled\n", __func__,
@@ -600,6 +692,7 @@ static int bam_mux_write_cmd(void *data, uint32_t len)
 	pkt->len = len;
 	pkt->dma_address = dma_address;
 	pkt->is_cmd = 1;
+	pkt->is_aggr = 0;
 	set_tx_timestamp(pkt);
 	INIT_WORK(&pkt->work, bam_mux_write_done);
 	spin_lock_irqsave(&bam_tx_pool_spinlock, flags);
@@ -624,13 +717,58 @@ static int bam_mux_write_cmd(void *data, uint32_t len)
 	return rc;
 }
 
+/*
+ * An aggregate counts as one tx packet for each channel it carries, so
+ * the watermarks bound aggregates in flight rather than frames.
+ */
+static void bam_mux_aggr_put_chs(struct tx_pkt_info *pkt)
+{
+	unsigned long flags;
+	int i;
+
+	for (i = 0; i < BAM_DMUX_NUM_CHANNELS; i++) {
+		if (!(pkt->aggr_chs & (1 << i)))
+			continue;
+		spin_lock_irqsave(&bam_ch[i].lock, flags);
+		bam_ch[i].num_tx_pkts--;
+		spin_unlock_irqrestore(&bam_ch[i].lock, flags);
+	}
+	pkt->aggr_chs = 0;
+}
+
+static void bam_mux_notify_write_done(struct sk_buff *skb)
+{
+	struct bam_mux_hdr *hdr;
+	unsigned long event_data;
+
+	hdr = (struct bam_mux_hdr *)skb->data;
+	DBG_INC_WRITE_CNT(skb->data_len);
+	event_data = (unsigned long)(skb);
+	if (bam_ch[hdr->ch_id].notify)
+		bam_ch[hdr->ch_id].notify(
+			bam_ch[hdr->ch_id].priv, BAM_DMUX_WRITE_DONE,
+							event_data);
+	else
+		dev_kfree_skb_any(skb);
+}
+
+static void bam_mux_write_done_skb(struct sk_buff *skb)
+{
+	struct bam_mux_hdr *hdr;
+	unsigned long flags;
+
+	hdr = (struct bam_mux_hdr *)skb->data;
+	spin_lock_irqsave(&bam_ch[hdr->ch_id].lock, flags);
+	bam_ch[hdr->ch_id].num_tx_pkts--;
+	spin_unlock_irqrestore(&bam_ch[hdr->ch_id].lock, flags);
+	bam_mux_notify_write_done(skb);
+}
+
 static void bam_mux_write_done(struct work_struct *work)
 {
 	struct sk_buff *skb;
-	struct bam_mux_hdr *hdr;
 	struct tx_pkt_info *info;
 	struct tx_pkt_info *info_expected;
-	unsigned long event_data;
 	unsigned long flags;
 
 	if (in_global_reset)
@@ -667,20 +805,180 @@ static void bam_mux_write_done(struct work_struct *work)
 		kfree(info);
 		return;
 	}
+	if (info->is_aggr) {
+		bam_mux_aggr_put_chs(info);
+		while ((skb = __skb_dequeue(&info->aggr_pkts)))
+			bam_mux_notify_write_done(skb);
+		dev_kfree_skb_any(info->skb);
+		kfree(info);
+		return;
+	}
 	skb = info->skb;
 	kfree(info);
+	bam_mux_write_done_skb(skb);
+}
+
+/* Free an aggregate that will never reach the hardware. */
+static void bam_mux_aggr_free(struct tx_pkt_info *pkt)
+{
+	bam_mux_aggr_put_chs(pkt);
+	__skb_queue_purge(&pkt->aggr_pkts);
+	dev_kfree_skb_any(pkt->skb);
+	kfree(pkt);
+}
+
+/*
+ * Hand the frame being aggregated to the BAM.
+ * Must be called with ul_wakeup_lock read-locked and the UL powered up.
+ */
+static void bam_mux_aggr_flush(void)
+{
+	struct tx_pkt_info *pkt;
+	unsigned long flags;
+	dma_addr_t dma_address;
+	int rc;
+
+	/*
+	 * Cancel under the lock so a timer armed for the next aggregate
+	 * is never cancelled here.  A callback already running can only
+	 * flush early.
+	 */
+	spin_lock_irqsave(&ul_aggr_lock, flags);
+	pkt = ul_aggr_pkt;
+	if (pkt)
+		hrtimer_try_to_cancel(&ul_aggr_timer);
+	ul_aggr_pkt = NULL;
+	spin_unlock_irqrestore(&ul_aggr_lock, flags);
+	if (!pkt)
+		return;
+
+	if (in_global_reset) {
+		bam_mux_aggr_free(pkt);
+		return;
+	}
+
+	dma_address = dma_map_single(NULL, pkt->skb->data, pkt->skb->len,
+					DMA_TO_DEVICE);
+	if (!dma_address) {
+		pr_err("%s: dma_map_single() failed\n", __func__);
+		bam_mux_aggr_free(pkt);
+		return;
+	}
+	pkt->dma_address = dma_address;
+	set_tx_timestamp(pkt);
+	DBG("%s: %d frames, %d bytes\n", __func__,
+	    skb_queue_len(&pkt->aggr_pkts), pkt->skb->len);
+	DBG_INC_UL_AGGR_CNT(skb_queue_len(&pkt->aggr_pkts));
+	spin_lock_irqsave(&bam_tx_pool_spinlock, flags);
+	list_add_tail(&pkt->list_node, &bam_tx_pool);
+	rc = sps_transfer_one(bam_tx_pipe, dma_address, pkt->skb->len,
+				pkt, SPS_IOVEC_FLAG_INT | SPS_IOVEC_FLAG_EOT);
+	if (rc) {
+		DMUX_LOG_KERR("%s sps_transfer_one failed rc=%d\n",
+			__func__, rc);
+		list_del(&pkt->list_node);
+		DBG_INC_TX_SPS_FAILURE_CNT();
+		spin_unlock_irqrestore(&bam_tx_pool_spinlock, flags);
+		dma_unmap_single(NULL, pkt->dma_address,
+					pkt->skb->len, DMA_TO_DEVICE);
+		bam_mux_aggr_free(pkt);
+	} else {
+		spin_unlock_irqrestore(&bam_tx_pool_spinlock, flags);
+	}
+	ul_packet_written = 1;
+}
+
+/*
+ * Copy a fully framed skb into the pending aggregate, starting a new
+ * one if needed.  The skb itself is completed once the aggregate is.
+ * Must be called with ul_wakeup_lock read-locked and the UL powered up.
+ */
+static int bam_mux_aggr_queue(struct sk_buff *skb)
+{
+	struct bam_mux_hdr *hdr;
+	struct tx_pkt_info *pkt;
+	unsigned long flags;
+	uint32_t size = min_t(uint32_t, ul_aggr_size, UL_AGGR_MAX_SIZE);
+	uint32_t usecs = min_t(uint32_t, ul_aggr_time_us, UL_AGGR_MAX_USECS);
+	int full;
+
+	spin_lock_irqsave(&ul_aggr_lock, flags);
+	while (ul_aggr_pkt && skb_tailroom(ul_aggr_pkt->skb) < skb->len) {
+		spin_unlock_irqrestore(&ul_aggr_lock, flags);
+		bam_mux_aggr_flush();
+		spin_lock_irqsave(&ul_aggr_lock, flags);
+	}
+
+	if (!ul_aggr_pkt) {
+		pkt = kmalloc(sizeof(struct tx_pkt_info), GFP_ATOMIC);
+		if (pkt == NULL) {
+			spin_unlock_irqrestore(&ul_aggr_lock, flags);
+			return -ENOMEM;
+		}
+		pkt->skb = __dev_alloc_skb(size, GFP_ATOMIC);
+		if (pkt->skb == NULL) {
+			spin_unlock_irqrestore(&ul_aggr_lock, flags);
+			kfree(pkt);
+			return -ENOMEM;
+		}
+		pkt->is_cmd = 0;
+		pkt->is_aggr = 1;
+		pkt->aggr_chs = 0;
+		__skb_queue_head_init(&pkt->aggr_pkts);
+		INIT_WORK(&pkt->work, bam_mux_write_done);
+		ul_aggr_pkt = pkt;
+		hrtimer_start(&ul_aggr_timer, ns_to_ktime(usecs * NSEC_PER_USEC),
+				HRTIMER_MODE_REL);
+	}
+
 	hdr = (struct bam_mux_hdr *)skb->data;
-	DBG_INC_WRITE_CNT(skb->data_len);
-	event_data = (unsigned long)(skb);
-	spin_lock_irqsave(&bam_ch[hdr->ch_id].lock, flags);
-	bam_ch[hdr->ch_id].num_tx_pkts--;
-	spin_unlock_irqrestore(&bam_ch[hdr->ch_id].lock, flags);
-	if (bam_ch[hdr->ch_id].notify)
-		bam_ch[hdr->ch_id].notify(
-			bam_ch[hdr->ch_id].priv, BAM_DMUX_WRITE_DONE,
-							event_data);
+	if (!(ul_aggr_pkt->aggr_chs & (1 << hdr->ch_id))) {
+		ul_aggr_pkt->aggr_chs |= 1 << hdr->ch_id;
+		spin_lock(&bam_ch[hdr->ch_id].lock);
+		bam_ch[hdr->ch_id].num_tx_pkts++;
+		spin_unlock(&bam_ch[hdr->ch_id].lock);
+	}
+	memcpy(skb_put(ul_aggr_pkt->skb, skb->len), skb->data, skb->len);
+	__skb_queue_tail(&ul_aggr_pkt->aggr_pkts, skb);
+	DBG_INC_WRITE_CPY(skb->len);
+	full = skb_tailroom(ul_aggr_pkt->skb) <
+		sizeof(struct bam_mux_hdr) + sizeof(uint32_t);
+	spin_unlock_irqrestore(&ul_aggr_lock, flags);
+
+	if (full)
+		bam_mux_aggr_flush();
+	return 0;
+}
+
+static enum hrtimer_restart ul_aggr_timer_func(struct hrtimer *timer)
+{
+	tasklet_hi_schedule(&ul_aggr_flush_tasklet);
+	return HRTIMER_NORESTART;
+}
+
+static void ul_aggr_flush_func(unsigned long data)
+{
+	read_lock(&ul_wakeup_lock);
+	if (bam_is_connected)
+		bam_mux_aggr_flush();
 	else
-		dev_kfree_skb_any(skb);
+		queue_work(bam_mux_tx_workqueue, &ul_aggr_wakeup_work);
+	read_unlock(&ul_wakeup_lock);
+}
+
+static void ul_aggr_wakeup_func(struct work_struct *work)
+{
+	read_lock(&ul_wakeup_lock);
+	if (!bam_is_connected) {
+		read_unlock(&ul_wakeup_lock);
+		ul_wakeup();
+		if (unlikely(in_global_reset == 1))
+			return;
+		read_lock(&ul_wakeup_lock);
+		notify_all(BAM_DMUX_UL_CONNECTED, (unsigned long)(NULL));
+	}
+	bam_mux_aggr_flush();
+	read_unlock(&ul_wakeup_lock);
 }
 
 int msm_bam_dmux_write(uint32_t id, struct sk_buff *skb)
@@ -758,6 +1056,17 @@ int msm_bam_dmux_write(uint32_t id, struct sk_buff *skb)
 	    __func__, skb->data, skb->tail, skb->len,
 	    hdr->pkt_len, hdr->pad_len);
 
+	if (ul_aggr_size && skb->len <= min_t(uint32_t, ul_aggr_size,
+					       UL_AGGR_MAX_SIZE)) {
+		if (!bam_mux_aggr_queue(skb)) {
+			ul_packet_written = 1;
+			read_unlock(&ul_wakeup_lock);
+			return 0;
+		}
+	}
+	/* keep frames in order behind anything still being aggregated */
+	bam_mux_aggr_flush();
+
 	pkt = kmalloc(sizeof(struct tx_pkt_info), GFP_ATOMIC);
 	if (pkt == NULL) {
 		pr_err("%s: mem alloc for tx_pkt_info failed\n", __func__);
@@ -773,6 +1082,7 @@ int msm_bam_dmux_write(uint32_t id, struct sk_buff *skb)
 	pkt->skb = skb;
 	pkt->dma_address = dma_address;
 	pkt->is_cmd = 0;
+	pkt->is_aggr = 0;
 	set_tx_timestamp(pkt);
 	INIT_WORK(&pkt->work, bam_mux_write_done);
 	spin_lock_irqsave(&bam_tx_pool_spinlock, flags);
@@ -1036,6 +1346,7 @@ static void rx_switch_to_interrupt_mode(void)
 			DMUX_LOG_KERR("%s: iovec %p != dma %p\n",
 				__func__,
 				(void *)info->dma_address, (void *)iov.addr);
+		info->len = iov.size;
 		handle_bam_mux_cmd(&info->work);
 	}
 	return;
@@ -1077,6 +1388,7 @@ static void rx_timer_work_func(struct work_struct *work)
 			--bam_rx_pool_len;
 			list_del(&info->list_node);
 			mutex_unlock(&bam_rx_pool_mutexlock);
+			info->len = iov.size;
 			handle_bam_mux_cmd(&info->work);
 		}
 
@@ -1201,12 +1513,18 @@ static int debug_stats(char *buf, int max)
 			"skb copy bytes:  %u\n"
 			"sps tx failures: %u\n"
 			"sps tx stalls:   %u\n"
-			"rx queue len:    %d\n",
+			"rx queue len:    %d\n"
+			"ul aggr descs:   %u\n"
+			"ul aggr pkts:    %u\n"
+			"dl deaggr pkts:  %u\n",
 			bam_dmux_write_cpy_cnt,
 			bam_dmux_write_cpy_bytes,
 			bam_dmux_tx_sps_failure_cnt,
 			bam_dmux_tx_stall_cnt,
-			bam_rx_pool_len
+			bam_rx_pool_len,
+			bam_dmux_ul_aggr_desc_cnt,
+			bam_dmux_ul_aggr_pkt_cnt,
+			bam_dmux_dl_deaggr_pkt_cnt
 			);
 
 	return i;
@@ -1776,13 +2094,30 @@ static int restart_notifier_cb(struct notifier_block *this,
 	}
 
 	/* Cleanup pending UL data */
+	hrtimer_cancel(&ul_aggr_timer);
+	spin_lock_irqsave(&ul_aggr_lock, flags);
+	info = ul_aggr_pkt;
+	ul_aggr_pkt = NULL;
+	spin_unlock_irqrestore(&ul_aggr_lock, flags);
+	if (info) {
+		/* the channel counts were reset above */
+		info->aggr_chs = 0;
+		bam_mux_aggr_free(info);
+	}
+
 	spin_lock_irqsave(&bam_tx_pool_spinlock, flags);
 	while (!list_empty(&bam_tx_pool)) {
 		node = bam_tx_pool.next;
 		list_del(node);
 		info = container_of(node, struct tx_pkt_info,
 							list_node);
-		if (!info->is_cmd) {
+		if (info->is_aggr) {
+			dma_unmap_single(NULL, info->dma_address,
+						info->skb->len,
+						DMA_TO_DEVICE);
+			__skb_queue_purge(&info->aggr_pkts);
+			dev_kfree_skb_any(info->skb);
+		} else if (!info->is_cmd) {
 			dma_unmap_single(NULL, info->dma_address,
 						info->skb->len,
 						DMA_TO_DEVICE);
@@ -2198,6 +2533,9 @@ static int __init bam_dmux_init(void)
 		bam_dmux_state_logging_disabled = 1;
 	}
 
+	hrtimer_init(&ul_aggr_timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	ul_aggr_timer.function = ul_aggr_timer_func;
+
 	subsys_notif_register_notifier("modem", &restart_notifier);
 	return platform_driver_register(&bam_dmux_driver);
 }
@@ -157,6 +157,27 @@ int smd_read_avail(smd_channel_t *ch);
 */
 int smd_cur_packet_size(smd_channel_t *ch);
 
+/* Zero-copy access to the FIFO.
+**
+** smd_read_buffer() returns the number of contiguous bytes readable at
+** *ptr (limited to the current packet on packet channels) and
+** smd_read_done() consumes len of them.  smd_write_buffer() returns the
+** contiguous free space at *ptr and smd_write_done() commits len bytes
+** written there; on packet channels it is only valid inside a
+** smd_write_start() transaction.
+**
+** smd_read_nokick() copies up to len bytes out through the same calls.
+**
+** None of these interrupt the remote processor.  Call smd_kick() once
+** after a batch of reads and/or writes.
+*/
+int smd_read_buffer(smd_channel_t *ch, void **ptr);
+int smd_read_done(smd_channel_t *ch, int len);
+int smd_read_nokick(smd_channel_t *ch, void *data, int len);
+int smd_write_buffer(smd_channel_t *ch, void **ptr);
+int smd_write_done(smd_channel_t *ch, int len);
+void smd_kick(smd_channel_t *ch);
+
 
 #if 0
 /* these are interruptable waits which will block you until the specified
@@ -290,6 +311,35 @@ static inline int smd_cur_packet_size(smd_channel_t *ch)
 	return -ENODEV;
 }
 
+static inline int smd_read_buffer(smd_channel_t *ch, void **ptr)
+{
+	return -ENODEV;
+}
+
+static inline int smd_read_done(smd_channel_t *ch, int len)
+{
+	return -ENODEV;
+}
+
+static inline int smd_read_nokick(smd_channel_t *ch, void *data, int len)
+{
+	return -ENODEV;
+}
+
+static inline int smd_write_buffer(smd_channel_t *ch, void **ptr)
+{
+	return -ENODEV;
+}
+
+static inline int smd_write_done(smd_channel_t *ch, int len)
+{
+	return -ENODEV;
+}
+
+static inline void smd_kick(smd_channel_t *ch)
+{
+}
+
 static inline int smd_tiocmget(smd_channel_t *ch)
 {
 	return -ENODEV;
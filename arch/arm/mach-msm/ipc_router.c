@@ -27,6 +27,8 @@
 #include <linux/platform_device.h>
 #include <linux/uaccess.h>
 #include <linux/debugfs.h>
+#include <linux/mempool.h>
+#include <linux/rcupdate.h>
 
 #include <asm/uaccess.h>
 #include <asm/byteorder.h>
@@ -122,6 +124,8 @@ struct msm_ipc_router_remote_port {
 	wait_queue_head_t quota_wait;
 	uint32_t tx_quota_cnt;
 	struct mutex quota_lock;
+	atomic_t ref;
+	struct rcu_head rcu;
 };
 
 struct msm_ipc_router_xprt_info {
@@ -156,6 +160,14 @@ static struct list_head routing_table[RT_HASH_SIZE];
 static DEFINE_MUTEX(routing_table_lock);
 static int routing_table_inited;
 
+/*
+ * rr_packet descriptors are taken from a preallocated pool so that the
+ * receive path does not have to go to the allocator for every message.
+ */
+#define IPC_ROUTER_PKT_POOL_SIZE 32
+static struct kmem_cache *rr_packet_cache;
+static mempool_t *rr_packet_pool;
+
 static LIST_HEAD(msm_ipc_board_dev_list);
 static DEFINE_MUTEX(msm_ipc_board_dev_list_lock);
 
@@ -226,7 +238,10 @@ static struct msm_ipc_routing_table_entry *alloc_routing_table_entry(
 	return rt_entry;
 }
 
-/*Please take routing_table_lock before calling this function*/
+/*
+ * Please take routing_table_lock before calling this function.
+ * Entries are never removed, so readers only need rcu_read_lock().
+ */
 static int add_routing_table_entry(
 	struct msm_ipc_routing_table_entry *rt_entry)
 {
@@ -236,18 +251,18 @@ static int add_routing_table_entry(
 		return -EINVAL;
 
 	key = (rt_entry->node_id % RT_HASH_SIZE);
-	list_add_tail(&rt_entry->list, &routing_table[key]);
+	list_add_tail_rcu(&rt_entry->list, &routing_table[key]);
 	return 0;
 }
 
-/*Please take routing_table_lock before calling this function*/
+/*Please take routing_table_lock or rcu_read_lock before calling this function*/
 static struct msm_ipc_routing_table_entry *lookup_routing_table(
 	uint32_t node_id)
 {
 	uint32_t key = (node_id % RT_HASH_SIZE);
 	struct msm_ipc_routing_table_entry *rt_entry;
 
-	list_for_each_entry(rt_entry, &routing_table[key], list) {
+	list_for_each_entry_rcu(rt_entry, &routing_table[key], list) {
 		if (rt_entry->node_id == node_id)
 			return rt_entry;
 	}
@@ -284,13 +299,23 @@ struct rr_packet *rr_read(struct msm_ipc_router_xprt_info *xprt_info)
 	return temp_pkt;
 }
 
+struct rr_packet *alloc_pkt(void)
+{
+	struct rr_packet *pkt;
+
+	pkt = mempool_alloc(rr_packet_pool, GFP_KERNEL);
+	if (pkt)
+		memset(pkt, 0, sizeof(struct rr_packet));
+	return pkt;
+}
+
 struct rr_packet *clone_pkt(struct rr_packet *pkt)
 {
 	struct rr_packet *cloned_pkt;
 	struct sk_buff *temp_skb, *cloned_skb;
 	struct sk_buff_head *pkt_fragment_q;
 
-	cloned_pkt = kzalloc(sizeof(struct rr_packet), GFP_KERNEL);
+	cloned_pkt = alloc_pkt();
 	if (!cloned_pkt) {
 		pr_err("%s: failure\n", __func__);
 		return NULL;
@@ -299,7 +324,7 @@ struct rr_packet *clone_pkt(struct rr_packet *pkt)
 	pkt_fragment_q = kmalloc(sizeof(struct sk_buff_head), GFP_KERNEL);
 	if (!pkt_fragment_q) {
 		pr_err("%s: pkt_frag_q alloc failure\n", __func__);
-		kfree(cloned_pkt);
+		mempool_free(cloned_pkt, rr_packet_pool);
 		return NULL;
 	}
 	skb_queue_head_init(pkt_fragment_q);
@@ -320,7 +345,7 @@ fail_clone:
 		kfree_skb(temp_skb);
 	}
 	kfree(pkt_fragment_q);
-	kfree(cloned_pkt);
+	mempool_free(cloned_pkt, rr_packet_pool);
 	return NULL;
 }
 
@@ -329,7 +354,7 @@ struct rr_packet *create_pkt(struct sk_buff_head *data)
 	struct rr_packet *pkt;
 	struct sk_buff *temp_skb;
 
-	pkt = kzalloc(sizeof(struct rr_packet), GFP_KERNEL);
+	pkt = alloc_pkt();
 	if (!pkt) {
 		pr_err("%s: failure\n", __func__);
 		return NULL;
@@ -349,7 +374,7 @@ void release_pkt(struct rr_packet *pkt)
 		return;
 
 	if (!pkt->pkt_fragment_q) {
-		kfree(pkt);
+		mempool_free(pkt, rr_packet_pool);
 		return;
 	}
 
@@ -358,7 +383,7 @@ void release_pkt(struct rr_packet *pkt)
 		kfree_skb(temp_skb);
 	}
 	kfree(pkt->pkt_fragment_q);
-	kfree(pkt);
+	mempool_free(pkt, rr_packet_pool);
 	return;
 }
 
@@ -428,7 +453,7 @@ void msm_ipc_router_add_local_port(struct msm_ipc_port *port_ptr)
 
 	key = (port_ptr->this_port.port_id & (LP_HASH_SIZE - 1));
 	mutex_lock(&local_ports_lock);
-	list_add_tail(&port_ptr->list, &local_ports[key]);
+	list_add_tail_rcu(&port_ptr->list, &local_ports[key]);
 	mutex_unlock(&local_ports_lock);
 }
 
@@ -463,27 +488,51 @@ struct msm_ipc_port *msm_ipc_router_create_raw_port(void *endpoint,
 	port_ptr->endpoint = endpoint;
 	port_ptr->notify = notify;
 	port_ptr->priv = priv;
+	atomic_set(&port_ptr->ref, 1);
 
 	msm_ipc_router_add_local_port(port_ptr);
 	return port_ptr;
 }
 
+/*
+ * Returns the port with a reference held, which the caller drops with
+ * msm_ipc_router_put_local_port(). A port whose last reference is
+ * already gone is treated as not found.
+ */
 static struct msm_ipc_port *msm_ipc_router_lookup_local_port(uint32_t port_id)
 {
 	int key = (port_id & (LP_HASH_SIZE - 1));
 	struct msm_ipc_port *port_ptr;
 
-	mutex_lock(&local_ports_lock);
-	list_for_each_entry(port_ptr, &local_ports[key], list) {
+	rcu_read_lock();
+	list_for_each_entry_rcu(port_ptr, &local_ports[key], list) {
 		if (port_ptr->this_port.port_id == port_id) {
-			mutex_unlock(&local_ports_lock);
+			if (!atomic_inc_not_zero(&port_ptr->ref))
+				port_ptr = NULL;
+			rcu_read_unlock();
 			return port_ptr;
 		}
 	}
-	mutex_unlock(&local_ports_lock);
+	rcu_read_unlock();
 	return NULL;
 }
 
+static void msm_ipc_router_put_local_port(struct msm_ipc_port *port_ptr)
+{
+	struct rr_packet *pkt, *temp_pkt;
+
+	if (!atomic_dec_and_test(&port_ptr->ref))
+		return;
+
+	/* Packets delivered by a lookup that raced with close_port */
+	list_for_each_entry_safe(pkt, temp_pkt, &port_ptr->port_rx_q, list) {
+		list_del(&pkt->list);
+		release_pkt(pkt);
+	}
+	wake_lock_destroy(&port_ptr->port_rx_wake_lock);
+	kfree_rcu(port_ptr, rcu);
+}
+
 static struct msm_ipc_router_remote_port *msm_ipc_router_lookup_remote_port(
 						uint32_t node_id,
 						uint32_t port_id)
@@ -492,30 +541,35 @@ static struct msm_ipc_router_remote_port *msm_ipc_router_lookup_remote_port(
 	struct msm_ipc_routing_table_entry *rt_entry;
 	int key = (port_id & (RP_HASH_SIZE - 1));
 
-	mutex_lock(&routing_table_lock);
+	rcu_read_lock();
 	rt_entry = lookup_routing_table(node_id);
 	if (!rt_entry) {
-		mutex_unlock(&routing_table_lock);
+		rcu_read_unlock();
 		pr_err("%s: Node is not up\n", __func__);
 		return NULL;
 	}
 
-	mutex_lock(&rt_entry->lock);
-	list_for_each_entry(rport_ptr,
-			    &rt_entry->remote_port_list[key], list) {
+	list_for_each_entry_rcu(rport_ptr,
+				&rt_entry->remote_port_list[key], list) {
 		if (rport_ptr->port_id == port_id) {
-			if (rport_ptr->restart_state != RESTART_NORMAL)
+			if (rport_ptr->restart_state != RESTART_NORMAL ||
+			    !atomic_inc_not_zero(&rport_ptr->ref))
 				rport_ptr = NULL;
-			mutex_unlock(&rt_entry->lock);
-			mutex_unlock(&routing_table_lock);
+			rcu_read_unlock();
 			return rport_ptr;
 		}
 	}
-	mutex_unlock(&rt_entry->lock);
-	mutex_unlock(&routing_table_lock);
+	rcu_read_unlock();
 	return NULL;
 }
 
+static void msm_ipc_router_put_remote_port(
+	struct msm_ipc_router_remote_port *rport_ptr)
+{
+	if (atomic_dec_and_test(&rport_ptr->ref))
+		kfree_rcu(rport_ptr, rcu);
+}
+
 static struct msm_ipc_router_remote_port *msm_ipc_router_create_remote_port(
 						uint32_t node_id,
 						uint32_t port_id)
@@ -547,8 +601,10 @@ static struct msm_ipc_router_remote_port *msm_ipc_router_create_remote_port(
 	rport_ptr->tx_quota_cnt = 0;
 	init_waitqueue_head(&rport_ptr->quota_wait);
 	mutex_init(&rport_ptr->quota_lock);
-	list_add_tail(&rport_ptr->list,
-		      &rt_entry->remote_port_list[key]);
+	/* One reference for the list, one for the caller */
+	atomic_set(&rport_ptr->ref, 2);
+	list_add_tail_rcu(&rport_ptr->list,
+			  &rt_entry->remote_port_list[key]);
 	mutex_unlock(&rt_entry->lock);
 	mutex_unlock(&routing_table_lock);
 	return rport_ptr;
@@ -573,8 +629,8 @@ static void msm_ipc_router_destroy_remote_port(
 	}
 
 	mutex_lock(&rt_entry->lock);
-	list_del(&rport_ptr->list);
-	kfree(rport_ptr);
+	list_del_rcu(&rport_ptr->list);
+	msm_ipc_router_put_remote_port(rport_ptr);
 	mutex_unlock(&rt_entry->lock);
 	mutex_unlock(&routing_table_lock);
 	return;
@@ -708,7 +764,7 @@ static int msm_ipc_router_send_control_msg(
 	if (xprt_info->remote_node_id == IPC_ROUTER_NID_LOCAL)
 		return 0;
 
-	pkt = kzalloc(sizeof(struct rr_packet), GFP_KERNEL);
+	pkt = alloc_pkt();
 	if (!pkt) {
 		pr_err("%s: pkt alloc failed\n", __func__);
 		return -ENOMEM;
@@ -717,7 +773,7 @@ static int msm_ipc_router_send_control_msg(
 	pkt_fragment_q = kmalloc(sizeof(struct sk_buff_head), GFP_KERNEL);
 	if (!pkt_fragment_q) {
 		pr_err("%s: pkt_fragment_q alloc failed\n", __func__);
-		kfree(pkt);
+		mempool_free(pkt, rr_packet_pool);
 		return -ENOMEM;
 	}
 	skb_queue_head_init(pkt_fragment_q);
@@ -727,7 +783,7 @@ static int msm_ipc_router_send_control_msg(
 	if (!ipc_rtr_pkt) {
 		pr_err("%s: ipc_rtr_pkt alloc failed\n", __func__);
 		kfree(pkt_fragment_q);
-		kfree(pkt);
+		mempool_free(pkt, rr_packet_pool);
 		return -ENOMEM;
 	}
 
@@ -739,7 +795,7 @@ static int msm_ipc_router_send_control_msg(
 		pr_err("%s: skb_push failed\n", __func__);
 		kfree_skb(ipc_rtr_pkt);
 		kfree(pkt_fragment_q);
-		kfree(pkt);
+		mempool_free(pkt, rr_packet_pool);
 		return -ENOMEM;
 	}
 
@@ -839,7 +895,7 @@ static int broadcast_ctl_msg_locally(union rr_control_msg *msg)
 	struct sk_buff_head *pkt_fragment_q;
 	int ret;
 
-	pkt = kzalloc(sizeof(struct rr_packet), GFP_KERNEL);
+	pkt = alloc_pkt();
 	if (!pkt) {
 		pr_err("%s: pkt alloc failed\n", __func__);
 		return -ENOMEM;
@@ -848,7 +904,7 @@ static int broadcast_ctl_msg_locally(union rr_control_msg *msg)
 	pkt_fragment_q = kmalloc(sizeof(struct sk_buff_head), GFP_KERNEL);
 	if (!pkt_fragment_q) {
 		pr_err("%s: pkt_fragment_q alloc failed\n", __func__);
-		kfree(pkt);
+		mempool_free(pkt, rr_packet_pool);
 		return -ENOMEM;
 	}
 	skb_queue_head_init(pkt_fragment_q);
@@ -858,7 +914,7 @@ static int broadcast_ctl_msg_locally(union rr_control_msg *msg)
 	if (!ipc_rtr_pkt) {
 		pr_err("%s: ipc_rtr_pkt alloc failed\n", __func__);
 		kfree(pkt_fragment_q);
-		kfree(pkt);
+		mempool_free(pkt, rr_packet_pool);
 		return -ENOMEM;
 	}
 
@@ -870,7 +926,7 @@ static int broadcast_ctl_msg_locally(union rr_control_msg *msg)
 		pr_err("%s: skb_push failed\n", __func__);
 		kfree_skb(ipc_rtr_pkt);
 		kfree(pkt_fragment_q);
-		kfree(pkt);
+		mempool_free(pkt, rr_packet_pool);
 		return -ENOMEM;
 	}
 	hdr->version = IPC_ROUTER_VERSION;
@@ -1006,6 +1062,7 @@ static void reset_remote_port_info(uint32_t node_id, uint32_t port_id)
 	rport_ptr->restart_state = RESTART_PEND;
 	wake_up(&rport_ptr->quota_wait);
 	mutex_unlock(&rport_ptr->quota_lock);
+	msm_ipc_router_put_remote_port(rport_ptr);
 	return;
 }
 
@@ -1117,8 +1174,9 @@ static void msm_ipc_cleanup_remote_port_info(uint32_t node_id)
 				list_for_each_entry_safe(rport_ptr,
 					tmp_rport_ptr,
 					&rt_entry->remote_port_list[j], list) {
-					list_del(&rport_ptr->list);
-					kfree(rport_ptr);
+					list_del_rcu(&rport_ptr->list);
+					msm_ipc_router_put_remote_port(
+								rport_ptr);
 				}
 			}
 			mutex_unlock(&rt_entry->lock);
@@ -1247,6 +1305,7 @@ static int process_control_msg(struct msm_ipc_router_xprt_info *xprt_info,
 		rport_ptr->tx_quota_cnt = 0;
 		mutex_unlock(&rport_ptr->quota_lock);
 		wake_up(&rport_ptr->quota_wait);
+		msm_ipc_router_put_remote_port(rport_ptr);
 		break;
 
 	case IPC_ROUTER_CTRL_CMD_NEW_SERVER:
@@ -1292,14 +1351,16 @@ static int process_control_msg(struct msm_ipc_router_xprt_info *xprt_info,
 				return -ENOMEM;
 			}
 
-			if (!msm_ipc_router_lookup_remote_port(
-					msg->srv.node_id, msg->srv.port_id)) {
+			rport_ptr = msm_ipc_router_lookup_remote_port(
+					msg->srv.node_id, msg->srv.port_id);
+			if (!rport_ptr)
 				rport_ptr = msm_ipc_router_create_remote_port(
 					msg->srv.node_id, msg->srv.port_id);
-				if (!rport_ptr)
-					pr_err("%s: Remote port create "
-					       "failed\n", __func__);
-			}
+			if (rport_ptr)
+				msm_ipc_router_put_remote_port(rport_ptr);
+			else
+				pr_err("%s: Remote port create failed\n",
+				       __func__);
 			wake_up(&newserver_wait);
 		}
 
@@ -1326,8 +1387,10 @@ static int process_control_msg(struct msm_ipc_router_xprt_info *xprt_info,
 		    msg->cli.node_id, msg->cli.port_id);
 		rport_ptr = msm_ipc_router_lookup_remote_port(msg->cli.node_id,
 							msg->cli.port_id);
-		if (rport_ptr)
+		if (rport_ptr) {
 			msm_ipc_router_destroy_remote_port(rport_ptr);
+			msm_ipc_router_put_remote_port(rport_ptr);
+		}
 
 		relay_msg(xprt_info, pkt);
 		post_control_ports(pkt);
@@ -1444,9 +1507,11 @@ static void do_read_data(struct work_struct *work)
 		if (!rport_ptr) {
 			pr_err("%s: Remote port %08x:%08x creation failed\n",
 				__func__, hdr->src_node_id, hdr->src_port_id);
+			msm_ipc_router_put_local_port(port_ptr);
 			goto process_done;
 		}
 	}
+	msm_ipc_router_put_remote_port(rport_ptr);
 
 	if (!port_ptr->notify) {
 		mutex_lock(&port_ptr->port_rx_q_lock);
@@ -1468,6 +1533,7 @@ static void do_read_data(struct work_struct *work)
 		src_addr = NULL;
 		release_pkt(pkt);
 	}
+	msm_ipc_router_put_local_port(port_ptr);
 
 process_done:
 	if (resume_tx) {
@@ -1590,6 +1656,7 @@ static int loopback_data(struct msm_ipc_port *src,
 	struct rr_header *hdr;
 	struct msm_ipc_port *port_ptr;
 	struct rr_packet *pkt;
+	int ret;
 
 	if (!data) {
 		pr_err("%s: Invalid pkt pointer\n", __func__);
@@ -1630,13 +1697,15 @@ static int loopback_data(struct msm_ipc_port *src,
 		return -ENODEV;
 	}
 
+	ret = pkt->length;
 	mutex_lock(&port_ptr->port_rx_q_lock);
 	wake_lock(&port_ptr->port_rx_wake_lock);
 	list_add_tail(&pkt->list, &port_ptr->port_rx_q);
 	wake_up(&port_ptr->port_rx_wait_q);
 	mutex_unlock(&port_ptr->port_rx_q_lock);
+	msm_ipc_router_put_local_port(port_ptr);
 
-	return pkt->length;
+	return ret;
 }
 
 static int msm_ipc_router_write_pkt(struct msm_ipc_port *src,
@@ -1803,11 +1872,13 @@ int msm_ipc_router_send_to(struct msm_ipc_port *src,
 	pkt = create_pkt(data);
 	if (!pkt) {
 		pr_err("%s: Pkt creation failed\n", __func__);
+		msm_ipc_router_put_remote_port(rport_ptr);
 		return -ENOMEM;
 	}
 
 	ret = msm_ipc_router_write_pkt(src, rport_ptr, pkt);
 	release_pkt(pkt);
+	msm_ipc_router_put_remote_port(rport_ptr);
 
 	return ret;
 }
@@ -1838,7 +1909,7 @@ int msm_ipc_router_read(struct msm_ipc_port *port_ptr,
 		wake_unlock(&port_ptr->port_rx_wake_lock);
 	*data = pkt->pkt_fragment_q;
 	ret = pkt->length;
-	kfree(pkt);
+	mempool_free(pkt, rr_packet_pool);
 	mutex_unlock(&port_ptr->port_rx_q_lock);
 
 	return ret;
@@ -1965,11 +2036,11 @@ int msm_ipc_router_close_port(struct msm_ipc_port *port_ptr)
 				port_ptr->this_port.node_id,
 				port_ptr->this_port.port_id);
 		mutex_lock(&local_ports_lock);
-		list_del(&port_ptr->list);
+		list_del_rcu(&port_ptr->list);
 		mutex_unlock(&local_ports_lock);
 	} else if (port_ptr->type == CLIENT_PORT) {
 		mutex_lock(&local_ports_lock);
-		list_del(&port_ptr->list);
+		list_del_rcu(&port_ptr->list);
 		mutex_unlock(&local_ports_lock);
 	} else if (port_ptr->type == CONTROL_PORT) {
 		mutex_lock(&control_ports_lock);
@@ -1977,8 +2048,7 @@ int msm_ipc_router_close_port(struct msm_ipc_port *port_ptr)
 		mutex_unlock(&control_ports_lock);
 	}
 
-	wake_lock_destroy(&port_ptr->port_rx_wake_lock);
-	kfree(port_ptr);
+	msm_ipc_router_put_local_port(port_ptr);
 	return 0;
 }
 
@@ -2007,8 +2077,10 @@ int msm_ipc_router_bind_control_port(struct msm_ipc_port *port_ptr)
 		return -EINVAL;
 
 	mutex_lock(&local_ports_lock);
-	list_del(&port_ptr->list);
+	list_del_rcu(&port_ptr->list);
 	mutex_unlock(&local_ports_lock);
+	/* lockless lookups may still be walking through this entry */
+	synchronize_rcu();
 	port_ptr->type = CONTROL_PORT;
 	mutex_lock(&control_ports_lock);
 	list_add_tail(&port_ptr->list, &control_ports);
@@ -2507,6 +2579,151 @@ static __init int msm_ipc_router_modem_restart_late_init(void)
 }
 late_initcall(msm_ipc_router_modem_restart_late_init);
 
+#ifdef CONFIG_MSM_IPC_ROUTER_SELFTEST
+#define IPC_RTR_TEST_MSGS	10000
+#define IPC_RTR_TEST_BATCH	16
+#define IPC_RTR_TEST_LEN	64
+
+static struct sk_buff_head * __init ipc_rtr_test_msg(uint32_t seq)
+{
+	struct sk_buff_head *msg_head;
+	struct sk_buff *msg;
+
+	msg_head = kmalloc(sizeof(struct sk_buff_head), GFP_KERNEL);
+	if (!msg_head)
+		return NULL;
+	skb_queue_head_init(msg_head);
+
+	msg = alloc_skb(IPC_ROUTER_HDR_SIZE + IPC_RTR_TEST_LEN, GFP_KERNEL);
+	if (!msg) {
+		kfree(msg_head);
+		return NULL;
+	}
+	skb_reserve(msg, IPC_ROUTER_HDR_SIZE);
+	memset(skb_put(msg, IPC_RTR_TEST_LEN), 0, IPC_RTR_TEST_LEN);
+	memcpy(msg->data, &seq, sizeof(seq));
+	skb_queue_tail(msg_head, msg);
+	return msg_head;
+}
+
+/* Read one message from port_ptr and check it is message seq from src */
+static int __init ipc_rtr_test_read(struct msm_ipc_port *port_ptr,
+				    struct msm_ipc_port *src, uint32_t seq)
+{
+	struct sk_buff_head *data;
+	struct rr_header *hdr;
+	struct sk_buff *msg;
+	uint32_t got;
+	int ret;
+
+	ret = msm_ipc_router_read(port_ptr, &data, 0);
+	if (ret < 0)
+		return ret;
+
+	msg = skb_peek(data);
+	hdr = (struct rr_header *)msg->data;
+	memcpy(&got, msg->data + IPC_ROUTER_HDR_SIZE, sizeof(got));
+	if (ret != IPC_ROUTER_HDR_SIZE + IPC_RTR_TEST_LEN ||
+	    hdr->size != IPC_RTR_TEST_LEN ||
+	    hdr->src_port_id != src->this_port.port_id || got != seq)
+		ret = -EBADMSG;
+	skb_queue_purge(data);
+	kfree(data);
+	return ret < 0 ? ret : 0;
+}
+
+/*
+ * Pass messages between two local ports through the loopback path,
+ * checking contents and order, and log the cost of a send plus read.
+ * Then check that a port looked up before close_port() stays valid
+ * until its reference is dropped, and that it can no longer be found.
+ */
+static int __init msm_ipc_router_selftest(void)
+{
+	struct msm_ipc_port *src, *dst, *held;
+	struct sk_buff_head *msg;
+	struct msm_ipc_addr addr;
+	uint32_t dst_port_id;
+	ktime_t start;
+	s64 ns;
+	int fail = 0;
+	int i, j;
+
+	src = msm_ipc_router_create_port(NULL, NULL);
+	dst = msm_ipc_router_create_port(NULL, NULL);
+	if (!src || !dst) {
+		pr_err("%s: self-test out of memory\n", __func__);
+		goto out;
+	}
+	dst_port_id = dst->this_port.port_id;
+	addr.addrtype = MSM_IPC_ADDR_ID;
+	addr.addr.port_addr.node_id = IPC_ROUTER_NID_LOCAL;
+	addr.addr.port_addr.port_id = dst_port_id;
+
+	start = ktime_get();
+	for (i = 0; i < IPC_RTR_TEST_MSGS; i += IPC_RTR_TEST_BATCH) {
+		for (j = i; j < i + IPC_RTR_TEST_BATCH; j++) {
+			msg = ipc_rtr_test_msg(j);
+			if (!msg || msm_ipc_router_send_to(src, msg, &addr) < 0)
+				fail++;
+		}
+		for (j = i; j < i + IPC_RTR_TEST_BATCH; j++)
+			if (ipc_rtr_test_read(dst, src, j))
+				fail++;
+	}
+	ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+	if (msm_ipc_router_get_curr_pkt_size(dst))
+		fail++;
+
+	held = msm_ipc_router_lookup_local_port(dst_port_id);
+	if (held != dst)
+		fail++;
+	if (held) {
+		msg = ipc_rtr_test_msg(0);
+		if (!msg || msm_ipc_router_send_to(src, msg, &addr) < 0)
+			fail++;
+		msm_ipc_router_close_port(dst);
+		dst = NULL;
+		if (atomic_read(&held->ref) != 1)
+			fail++;
+		if (msm_ipc_router_lookup_local_port(dst_port_id))
+			fail++;
+		msg = ipc_rtr_test_msg(0);
+		if (!msg || msm_ipc_router_send_to(src, msg, &addr) != -ENODEV)
+			fail++;
+		msm_ipc_router_put_local_port(held);
+	}
+
+	pr_info("%s: self-test %s: %d messages, ns/message %lld\n",
+		__func__, fail ? "FAILED" : "passed", IPC_RTR_TEST_MSGS,
+		div_s64(ns, IPC_RTR_TEST_MSGS));
+out:
+	if (dst)
+		msm_ipc_router_close_port(dst);
+	if (src)
+		msm_ipc_router_close_port(src);
+	return 0;
+}
+late_initcall(msm_ipc_router_selftest);
+#endif /* CONFIG_MSM_IPC_ROUTER_SELFTEST */
+
+static int __init msm_ipc_router_pkt_pool_init(void)
+{
+	rr_packet_cache = KMEM_CACHE(rr_packet, 0);
+	if (!rr_packet_cache)
+		return -ENOMEM;
+
+	rr_packet_pool = mempool_create_slab_pool(IPC_ROUTER_PKT_POOL_SIZE,
+						  rr_packet_cache);
+	if (!rr_packet_pool) {
+		kmem_cache_destroy(rr_packet_cache);
+		return -ENOMEM;
+	}
+	return 0;
+}
+/* transports may hand us packets before msm_ipc_router_init() runs */
+subsys_initcall(msm_ipc_router_pkt_pool_init);
+
 static int __init msm_ipc_router_init(void)
 {
 	int i, ret;
@@ -131,6 +131,8 @@ struct msm_ipc_port {
 	unsigned long num_tx_bytes;
 	unsigned long num_rx_bytes;
 	void *priv;
+	atomic_t ref;
+	struct rcu_head rcu;
 };
 
 struct msm_ipc_sock {
@@ -164,6 +166,7 @@ void msm_ipc_router_xprt_notify(struct msm_ipc_router_xprt *xprt,
 				void *data);
 
 
+struct rr_packet *alloc_pkt(void);
 struct rr_packet *clone_pkt(struct rr_packet *pkt);
 void release_pkt(struct rr_packet *pkt);
 
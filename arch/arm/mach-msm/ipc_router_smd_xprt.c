@@ -187,7 +187,7 @@ static void smd_xprt_read_data(struct work_struct *work)
 	while ((pkt_size = smd_cur_packet_size(smd_remote_xprt.channel)) &&
 		smd_read_avail(smd_remote_xprt.channel)) {
 		if (!is_partial_in_pkt) {
-			in_pkt = kzalloc(sizeof(struct rr_packet), GFP_KERNEL);
+			in_pkt = alloc_pkt();
 			if (!in_pkt) {
 				pr_err("%s: Couldn't alloc rr_packet\n",
 					__func__);
@@ -200,7 +200,7 @@ static void smd_xprt_read_data(struct work_struct *work)
 			if (!in_pkt->pkt_fragment_q) {
 				pr_err("%s: Couldn't alloc pkt_fragment_q\n",
 					__func__);
-				kfree(in_pkt);
+				release_pkt(in_pkt);
 				return;
 			}
 			skb_queue_head_init(in_pkt->pkt_fragment_q);
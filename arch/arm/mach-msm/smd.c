@@ -1246,8 +1246,11 @@ static int smd_is_packet(struct smd_alloc_elm *alloc_elm)
 		return 0;
 }
 
-static int smd_stream_write(smd_channel_t *ch, const void *_data, int len,
-				int user_buf)
+/* basic write interface to ch_write_{buffer,done} used by
+ * smd_*_write() and smd_write_start(); does not signal the remote side
+ */
+static int ch_write(smd_channel_t *ch, const void *_data, int len,
+			int user_buf)
 {
 	void *ptr;
 	const unsigned char *buf = _data;
@@ -1255,12 +1258,6 @@ static int smd_stream_write(smd_channel_t *ch, const void *_data, int len,
 	int orig_len = len;
 	int r = 0;
 
-	SMD_DBG("smd_stream_write() %d -> ch%d\n", len, ch->n);
-	if (len < 0)
-		return -EINVAL;
-	else if (len == 0)
-		return 0;
-
 	while ((xfer = ch_write_buffer(ch, &ptr)) != 0) {
 		if (!ch_is_open(ch))
 			break;
@@ -1284,10 +1281,25 @@ static int smd_stream_write(smd_channel_t *ch, const void *_data, int len,
 			break;
 	}
 
-	if (orig_len - len)
+	return orig_len - len;
+}
+
+static int smd_stream_write(smd_channel_t *ch, const void *_data, int len,
+				int user_buf)
+{
+	int r;
+
+	SMD_DBG("smd_stream_write() %d -> ch%d\n", len, ch->n);
+	if (len < 0)
+		return -EINVAL;
+	else if (len == 0)
+		return 0;
+
+	r = ch_write(ch, _data, len, user_buf);
+	if (r)
 		ch->notify_other_cpu();
 
-	return orig_len - len;
+	return r;
 }
 
 static int smd_packet_write(smd_channel_t *ch, const void *_data, int len,
@@ -1309,7 +1321,8 @@ static int smd_packet_write(smd_channel_t *ch, const void *_data, int len,
 	hdr[1] = hdr[2] = hdr[3] = hdr[4] = 0;
 
 
-	ret = smd_stream_write(ch, hdr, sizeof(hdr), 0);
+	/* header and payload go out behind a single remote interrupt */
+	ret = ch_write(ch, hdr, sizeof(hdr), 0);
 	if (ret < 0 || ret != sizeof(hdr)) {
 		SMD_DBG("%s failed to write pkt header: "
 			"%d returned\n", __func__, ret);
@@ -1317,7 +1330,9 @@ static int smd_packet_write(smd_channel_t *ch, const void *_data, int len,
 	}
 
 
-	ret = smd_stream_write(ch, _data, len, user_buf);
+	ret = ch_write(ch, _data, len, user_buf);
+	if (ret > 0)
+		ch->notify_other_cpu();
 	if (ret < 0 || ret != len) {
 		SMD_DBG("%s failed to write pkt data: "
 			"%d returned\n", __func__, ret);
@@ -1781,7 +1796,8 @@ int smd_write_start(smd_channel_t *ch, int len)
 	hdr[1] = hdr[2] = hdr[3] = hdr[4] = 0;
 
 
-	ret = smd_stream_write(ch, hdr, sizeof(hdr), 0);
+	/* the remote is signalled once the payload follows */
+	ret = ch_write(ch, hdr, sizeof(hdr), 0);
 	if (ret < 0 || ret != sizeof(hdr)) {
 		ch->pending_pkt_sz = 0;
 		pr_err("%s: packet header failed to write\n", __func__);
@@ -1915,6 +1931,145 @@ int smd_write_avail(smd_channel_t *ch)
 }
 EXPORT_SYMBOL(smd_write_avail);
 
+/*
+ * Zero-copy FIFO access.
+ *
+ * smd_read_buffer()/smd_write_buffer() hand out a pointer straight into
+ * the shared-memory FIFO together with the size of the contiguous span
+ * behind it; smd_read_done()/smd_write_done() then commit what was
+ * consumed or filled in.  Neither side interrupts the remote processor,
+ * so a client can move any number of packets and signal the whole batch
+ * with a single smd_kick().
+ */
+int smd_read_buffer(smd_channel_t *ch, void **ptr)
+{
+	int n;
+
+	if (!ch) {
+		pr_err("%s: Invalid channel specified\n", __func__);
+		return -ENODEV;
+	}
+
+	n = ch_read_buffer(ch, ptr);
+	if (ch->is_pkt_ch && n > ch->current_packet)
+		n = ch->current_packet;
+
+	return n;
+}
+EXPORT_SYMBOL(smd_read_buffer);
+
+int smd_read_done(smd_channel_t *ch, int len)
+{
+	unsigned long flags;
+	void *ptr;
+
+	if (!ch) {
+		pr_err("%s: Invalid channel specified\n", __func__);
+		return -ENODEV;
+	}
+	if (len < 0 || len > smd_read_buffer(ch, &ptr)) {
+		pr_err("%s: invalid length: %d\n", __func__, len);
+		return -EINVAL;
+	}
+	if (len == 0)
+		return 0;
+
+	ch_read_done(ch, len);
+
+	if (ch->is_pkt_ch) {
+		spin_lock_irqsave(&smd_lock, flags);
+		ch->current_packet -= len;
+		update_packet_state(ch);
+		spin_unlock_irqrestore(&smd_lock, flags);
+	}
+
+	return len;
+}
+EXPORT_SYMBOL(smd_read_done);
+
+int smd_read_nokick(smd_channel_t *ch, void *data, int len)
+{
+	void *src;
+	int n, done = 0;
+
+	while (done < len) {
+		n = smd_read_buffer(ch, &src);
+		if (n < 0)
+			return n;
+		if (n == 0)
+			break;
+		if (n > len - done)
+			n = len - done;
+		memcpy(data + done, src, n);
+		smd_read_done(ch, n);
+		done += n;
+	}
+	return done;
+}
+EXPORT_SYMBOL(smd_read_nokick);
+
+int smd_write_buffer(smd_channel_t *ch, void **ptr)
+{
+	int n;
+
+	if (!ch) {
+		pr_err("%s: Invalid channel specified\n", __func__);
+		return -ENODEV;
+	}
+	if (ch->is_pkt_ch && !ch->pending_pkt_sz) {
+		pr_err("%s: no transaction in progress\n", __func__);
+		return -ENOEXEC;
+	}
+	if (!ch_is_open(ch))
+		return 0;
+
+	n = ch_write_buffer(ch, ptr);
+	if (ch->is_pkt_ch && n > ch->pending_pkt_sz)
+		n = ch->pending_pkt_sz;
+
+	return n;
+}
+EXPORT_SYMBOL(smd_write_buffer);
+
+int smd_write_done(smd_channel_t *ch, int len)
+{
+	void *ptr;
+
+	if (!ch) {
+		pr_err("%s: Invalid channel specified\n", __func__);
+		return -ENODEV;
+	}
+	if (len < 0 || len > smd_write_buffer(ch, &ptr)) {
+		pr_err("%s: invalid length: %d\n", __func__, len);
+		return -EINVAL;
+	}
+	if (len == 0)
+		return 0;
+
+	ch_write_done(ch, len);
+	if (ch->is_pkt_ch)
+		ch->pending_pkt_sz -= len;
+
+	return len;
+}
+EXPORT_SYMBOL(smd_write_done);
+
+/*
+ * Signal the remote processor about everything committed through the
+ * zero-copy calls since the last interrupt.  Nothing is sent if the
+ * remote has already picked the updates up, and read-side updates are
+ * only signalled if the remote has not blocked read interrupts.
+ */
+void smd_kick(smd_channel_t *ch)
+{
+	if (!ch)
+		return;
+
+	if (ch->send->fHEAD || (ch->send->fTAIL && !read_intr_blocked(ch)))
+		ch->notify_other_cpu();
+}
+EXPORT_SYMBOL(smd_kick);
+
 void smd_enable_read_intr(smd_channel_t *ch)
 {
 	if (ch)
@@ -3142,6 +3297,138 @@ static struct platform_driver msm_smd_driver = {
 	},
 };
 
+#ifdef CONFIG_MSM_SMD_SELFTEST
+#define SMD_TEST_FIFO_SIZE	1024
+#define SMD_TEST_MAX_PKT	(SMD_TEST_FIFO_SIZE / 3)
+#define SMD_TEST_PACKETS	2000
+
+static struct smd_channel *smd_test_ch;
+static int smd_test_kicks;
+
+/* Stands in for the remote processor: count the interrupt, take updates */
+static void smd_test_notify(void)
+{
+	smd_test_kicks++;
+	smd_test_ch->send->fHEAD = 0;
+	smd_test_ch->send->fTAIL = 0;
+}
+
+static int __init smd_test_len(int pkt)
+{
+	return 1 + (pkt * 37) % SMD_TEST_MAX_PKT;
+}
+
+static int __init smd_test_write(smd_channel_t *ch, const u8 *data, int len)
+{
+	void *dst;
+	int n, done = 0;
+
+	if (smd_write_start(ch, len) < 0)
+		return -1;
+	while (done < len) {
+		n = smd_write_buffer(ch, &dst);
+		if (n <= 0)
+			break;
+		if (n > len - done)
+			n = len - done;
+		memcpy(dst, data + done, n);
+		smd_write_done(ch, n);
+		done += n;
+	}
+	return smd_write_end(ch) < 0 ? -1 : done;
+}
+
+/*
+ * Loop packets through a packet channel whose send and receive halves
+ * share one FIFO, in batches that fill it, so that headers and payloads
+ * wrap at every offset.  Each batch of writes and each batch of reads
+ * through the zero-copy calls has to cost exactly one interrupt.
+ */
+static int __init smd_selftest(void)
+{
+	struct smd_half_channel *half;
+	struct smd_channel *ch;
+	u8 *fifo, *src, *dst;
+	unsigned long flags;
+	int wr = 0, rd = 0;
+	int fail = 0;
+	int kicks, sz, i;
+	void *ptr;
+
+	ch = kzalloc(sizeof(*ch), GFP_KERNEL);
+	half = kzalloc(sizeof(*half), GFP_KERNEL);
+	fifo = kmalloc(SMD_TEST_FIFO_SIZE, GFP_KERNEL);
+	src = kmalloc(2 * SMD_TEST_MAX_PKT, GFP_KERNEL);
+	dst = kmalloc(SMD_TEST_MAX_PKT, GFP_KERNEL);
+	if (!ch || !half || !fifo || !src || !dst) {
+		pr_err("smd: self-test out of memory\n");
+		goto out;
+	}
+
+	half->state = SMD_SS_OPENED;
+	ch->send = ch->recv = half;
+	ch->send_data = ch->recv_data = fifo;
+	ch->fifo_size = SMD_TEST_FIFO_SIZE;
+	ch->fifo_mask = SMD_TEST_FIFO_SIZE - 1;
+	ch->notify_other_cpu = smd_test_notify;
+	ch->read = smd_packet_read;
+	ch->write = smd_packet_write;
+	ch->read_avail = smd_packet_read_avail;
+	ch->write_avail = smd_packet_write_avail;
+	ch->update_state = update_packet_state;
+	ch->read_from_cb = smd_packet_read_from_cb;
+	ch->is_pkt_ch = 1;
+	smd_test_ch = ch;
+
+	for (i = 0; i < 2 * SMD_TEST_MAX_PKT; i++)
+		src[i] = i * 7 + 3;
+
+	/* writes to a packet channel need a packet in progress */
+	if (smd_write_buffer(ch, &ptr) != -ENOEXEC)
+		fail++;
+
+	while (rd < SMD_TEST_PACKETS && !fail) {
+		kicks = smd_test_kicks;
+		while (smd_write_avail(ch) >= smd_test_len(wr)) {
+			if (smd_test_write(ch, src + wr % SMD_TEST_MAX_PKT,
+					   smd_test_len(wr)) != smd_test_len(wr))
+				fail++;
+			wr++;
+		}
+		smd_kick(ch);
+		if (smd_test_kicks != kicks + 1)
+			fail++;
+
+		spin_lock_irqsave(&smd_lock, flags);
+		ch->update_state(ch);
+		spin_unlock_irqrestore(&smd_lock, flags);
+
+		kicks = smd_test_kicks;
+		while ((sz = smd_cur_packet_size(ch)) > 0) {
+			if (sz != smd_test_len(rd) ||
+			    smd_read_nokick(ch, dst, sz) != sz ||
+			    memcmp(dst, src + rd % SMD_TEST_MAX_PKT, sz))
+				fail++;
+			rd++;
+		}
+		smd_kick(ch);
+		if (smd_test_kicks != kicks + 1 || rd != wr)
+			fail++;
+	}
+
+	pr_info("smd: self-test %s: %d packets, %d interrupts\n",
+		fail ? "FAILED" : "passed", rd, smd_test_kicks);
+out:
+	kfree(dst);
+	kfree(src);
+	kfree(fifo);
+	kfree(half);
+	kfree(ch);
+	return 0;
+}
+late_initcall(smd_selftest);
+#endif /* CONFIG_MSM_SMD_SELFTEST */
+
 static int __init msm_smd_init(void)
 {
 	return platform_driver_register(&msm_smd_driver);
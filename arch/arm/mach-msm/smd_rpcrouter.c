@@ -40,6 +40,8 @@
 #include <linux/platform_device.h>
 #include <linux/uaccess.h>
 #include <linux/debugfs.h>
+#include <linux/hash.h>
+#include <linux/jhash.h>
 
 #include <asm/byteorder.h>
 
@@ -140,6 +142,36 @@ static LIST_HEAD(remote_endpoints);
 
 static LIST_HEAD(server_list);
 
+/*
+ * The lists above are kept for walking every entry (restart handling,
+ * debugfs); per-packet lookups go through these hashes instead.  Both
+ * are protected by the same lock as the matching list.
+ */
+#define RR_HASH_BITS	5
+#define RR_HASH_SIZE	(1 << RR_HASH_BITS)
+
+static struct hlist_head local_endpoints_hash[RR_HASH_SIZE];
+static struct hlist_head remote_endpoints_hash[RR_HASH_SIZE];
+static struct hlist_head server_hash[RR_HASH_SIZE];
+
+static inline struct hlist_head *local_ept_bucket(uint32_t cid)
+{
+	return &local_endpoints_hash[hash_32(cid, RR_HASH_BITS)];
+}
+
+static inline struct hlist_head *remote_ept_bucket(uint32_t pid, uint32_t cid)
+{
+	return &remote_endpoints_hash[jhash_2words(pid, cid, 0) &
+				      (RR_HASH_SIZE - 1)];
+}
+
+static inline struct hlist_head *server_bucket(uint32_t prog, uint32_t vers)
+{
+	return &server_hash[jhash_2words(prog, vers, 0) & (RR_HASH_SIZE - 1)];
+}
+
+static struct kmem_cache *rr_packet_cache;
+
 static wait_queue_head_t newserver_wait;
 static wait_queue_head_t subsystem_restart_wait;
 
@@ -335,7 +367,7 @@ static void modem_reset_cleanup(struct rpcrouter_xprt_info *xprt_info)
 				kfree(frag);
 				frag = next;
 			}
-			kfree(pkt);
+			kmem_cache_free(rr_packet_cache, pkt);
 		}
 		spin_unlock(&ept->incomplete_lock);
 
@@ -350,7 +382,7 @@ static void modem_reset_cleanup(struct rpcrouter_xprt_info *xprt_info)
 				kfree(frag);
 				frag = next;
 			}
-			kfree(pkt);
+			kmem_cache_free(rr_packet_cache, pkt);
 		}
 		spin_unlock(&ept->read_q_lock);
 
@@ -460,6 +492,7 @@ static struct rr_server *rpcrouter_create_server(uint32_t pid,
 
 	spin_lock_irqsave(&server_list_lock, flags);
 	list_add_tail(&server->list, &server_list);
+	hlist_add_head(&server->hnode, server_bucket(prog, ver));
 	spin_unlock_irqrestore(&server_list_lock, flags);
 
 	rc = msm_rpcrouter_create_server_cdev(server);
@@ -470,6 +503,7 @@ static struct rr_server *rpcrouter_create_server(uint32_t pid,
 out_fail:
 	spin_lock_irqsave(&server_list_lock, flags);
 	list_del(&server->list);
+	hlist_del(&server->hnode);
 	spin_unlock_irqrestore(&server_list_lock, flags);
 	kfree(server);
 	return ERR_PTR(rc);
@@ -481,6 +515,7 @@ static void rpcrouter_destroy_server(struct rr_server *server)
 
 	spin_lock_irqsave(&server_list_lock, flags);
 	list_del(&server->list);
+	hlist_del(&server->hnode);
 	spin_unlock_irqrestore(&server_list_lock, flags);
 	device_destroy(msm_rpcrouter_class, server->device_number);
 	kfree(server);
@@ -535,10 +570,11 @@ static void rpcrouter_register_board_dev(struct rr_server *server)
 static struct rr_server *rpcrouter_lookup_server(uint32_t prog, uint32_t ver)
 {
 	struct rr_server *server;
+	struct hlist_node *n;
 	unsigned long flags;
 
 	spin_lock_irqsave(&server_list_lock, flags);
-	list_for_each_entry(server, &server_list, list) {
+	hlist_for_each_entry(server, n, server_bucket(prog, ver), hnode) {
 		if (server->prog == prog
 		 && server->vers == ver) {
 			spin_unlock_irqrestore(&server_list_lock, flags);
@@ -614,6 +650,7 @@ struct msm_rpc_endpoint *msm_rpcrouter_create_local_endpoint(dev_t dev)
 
 	spin_lock_irqsave(&local_endpoints_lock, flags);
 	list_add_tail(&ept->list, &local_endpoints);
+	hlist_add_head(&ept->hnode, local_ept_bucket(ept->cid));
 	spin_unlock_irqrestore(&local_endpoints_lock, flags);
 	return ept;
 }
@@ -631,6 +668,7 @@ int msm_rpcrouter_destroy_local_endpoint(struct msm_rpc_endpoint *ept)
 	** destroying it.*/
 	spin_lock_irqsave(&local_endpoints_lock, flags);
 	list_del(&ept->list);
+	hlist_del(&ept->hnode);
 	spin_unlock_irqrestore(&local_endpoints_lock, flags);
 	if (ept->dst_pid != 0xffffffff) {
 		msg.cmd = RPCROUTER_CTRL_CMD_REMOVE_CLIENT;
@@ -684,16 +722,19 @@ static int rpcrouter_create_remote_endpoint(uint32_t pid, uint32_t cid)
 
 	spin_lock_irqsave(&remote_endpoints_lock, flags);
 	list_add_tail(&new_c->list, &remote_endpoints);
+	hlist_add_head(&new_c->hnode, remote_ept_bucket(pid, cid));
 	new_c->quota_restart_state = RESTART_NORMAL;
 	spin_unlock_irqrestore(&remote_endpoints_lock, flags);
 	return 0;
 }
 
+/* caller must hold local_endpoints_lock */
 static struct msm_rpc_endpoint *rpcrouter_lookup_local_endpoint(uint32_t cid)
 {
 	struct msm_rpc_endpoint *ept;
+	struct hlist_node *n;
 
-	list_for_each_entry(ept, &local_endpoints, list) {
+	hlist_for_each_entry(ept, n, local_ept_bucket(cid), hnode) {
 		if (ept->cid == cid)
 			return ept;
 	}
@@ -704,10 +745,11 @@ static struct rr_remote_endpoint *rpcrouter_lookup_remote_endpoint(uint32_t pid,
 								   uint32_t cid)
 {
 	struct rr_remote_endpoint *ept;
+	struct hlist_node *n;
 	unsigned long flags;
 
 	spin_lock_irqsave(&remote_endpoints_lock, flags);
-	list_for_each_entry(ept, &remote_endpoints, list) {
+	hlist_for_each_entry(ept, n, remote_ept_bucket(pid, cid), hnode) {
 		if ((ept->pid == pid) && (ept->cid == cid)) {
 			spin_unlock_irqrestore(&remote_endpoints_lock, flags);
 			return ept;
@@ -894,6 +936,7 @@ static int process_control_msg(struct rpcrouter_xprt_info *xprt_info,
 		if (r_ept) {
 			spin_lock_irqsave(&remote_endpoints_lock, flags);
 			list_del(&r_ept->list);
+			hlist_del(&r_ept->hnode);
 			spin_unlock_irqrestore(&remote_endpoints_lock, flags);
 			kfree(r_ept);
 		}
@@ -959,6 +1002,20 @@ static void *rr_malloc(unsigned sz)
 	return ptr;
 }
 
+static struct rr_packet *rr_alloc_packet(void)
+{
+	struct rr_packet *pkt = kmem_cache_alloc(rr_packet_cache, GFP_KERNEL);
+	if (pkt)
+		return pkt;
+
+	printk(KERN_ERR "rpcrouter: packet alloc failed, retrying...\n");
+	do {
+		pkt = kmem_cache_alloc(rr_packet_cache, GFP_KERNEL);
+	} while (!pkt);
+
+	return pkt;
+}
+
 static int rr_read(struct rpcrouter_xprt_info *xprt_info,
 		   void *data, uint32_t len)
 {
@@ -1152,7 +1209,7 @@ static void do_read_data(struct work_struct *work)
 	 * the incomplete list if this fragment is not a last fragment,
 	 * otherwise put it on the read queue.
 	 */
-	pkt = rr_malloc(sizeof(struct rr_packet));
+	pkt = rr_alloc_packet();
 	pkt->first = frag;
 	pkt->last = frag;
 	memcpy(&pkt->hdr, &hdr, sizeof(hdr));
@@ -1165,7 +1222,7 @@ static void do_read_data(struct work_struct *work)
 		spin_unlock_irqrestore(&local_endpoints_lock, flags);
 		DIAG("no local ept for cid %08x\n", hdr.dst_cid);
 		kfree(frag);
-		kfree(pkt);
+		kmem_cache_free(rr_packet_cache, pkt);
 		goto done;
 	}
 	if (!PACMARK_LAST(pm)) {
@@ -1891,7 +1948,7 @@ int __msm_rpc_read(struct msm_rpc_endpoint *ept,
 		set_pend_reply(ept, reply);
 	}
 
-	kfree(pkt);
+	kmem_cache_free(rr_packet_cache, pkt);
 
 	IO("READ on ept %p (%d bytes)\n", ept, rc);
 
@@ -2498,6 +2555,100 @@ static __init int modem_restart_late_init(void)
 }
 late_initcall(modem_restart_late_init);
 
+#ifdef CONFIG_MSM_ONCRPCROUTER_SELFTEST
+#define RR_TEST_PID		0x7e57
+#define RR_TEST_EPTS		256
+#define RR_TEST_LOOKUPS		100000
+
+static inline uint32_t rr_test_cid(int i)
+{
+	return 0x10000 + 2 * i;
+}
+
+/* The lookup rpcrouter_lookup_remote_endpoint() did before the hash */
+static struct rr_remote_endpoint * __init rr_test_list_lookup(uint32_t pid,
+							       uint32_t cid)
+{
+	struct rr_remote_endpoint *ept;
+	unsigned long flags;
+
+	spin_lock_irqsave(&remote_endpoints_lock, flags);
+	list_for_each_entry(ept, &remote_endpoints, list) {
+		if ((ept->pid == pid) && (ept->cid == cid)) {
+			spin_unlock_irqrestore(&remote_endpoints_lock, flags);
+			return ept;
+		}
+	}
+	spin_unlock_irqrestore(&remote_endpoints_lock, flags);
+	return NULL;
+}
+
+/*
+ * Register RR_TEST_EPTS remote endpoints for a pid that no processor
+ * uses, check that each of them and nothing else is found through the
+ * hash, and log the cost of a lookup against the old list walk.
+ */
+static int __init rpcrouter_selftest(void)
+{
+	struct rr_remote_endpoint *ept, *tmp;
+	unsigned long flags;
+	s64 hash_ns, list_ns;
+	ktime_t start;
+	uint32_t cid;
+	int fail = 0;
+	int i;
+
+	for (i = 0; i < RR_TEST_EPTS; i++) {
+		if (rpcrouter_create_remote_endpoint(RR_TEST_PID,
+						     rr_test_cid(i))) {
+			pr_err("rpcrouter: self-test out of memory\n");
+			goto out;
+		}
+	}
+
+	for (i = 0; i < RR_TEST_EPTS; i++) {
+		cid = rr_test_cid(i);
+		ept = rpcrouter_lookup_remote_endpoint(RR_TEST_PID, cid);
+		if (!ept || ept->pid != RR_TEST_PID || ept->cid != cid)
+			fail++;
+		if (rpcrouter_lookup_remote_endpoint(RR_TEST_PID, cid + 1) ||
+		    rpcrouter_lookup_remote_endpoint(RR_TEST_PID + 1, cid))
+			fail++;
+	}
+
+	start = ktime_get();
+	for (i = 0; i < RR_TEST_LOOKUPS; i++)
+		if (!rpcrouter_lookup_remote_endpoint(RR_TEST_PID,
+				rr_test_cid(i % RR_TEST_EPTS)))
+			fail++;
+	hash_ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+
+	start = ktime_get();
+	for (i = 0; i < RR_TEST_LOOKUPS; i++)
+		if (!rr_test_list_lookup(RR_TEST_PID,
+					 rr_test_cid(i % RR_TEST_EPTS)))
+			fail++;
+	list_ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+
+	pr_info("rpcrouter: self-test %s: %d endpoints, ns/lookup hash %lld,"
+		" list %lld\n", fail ? "FAILED" : "passed", RR_TEST_EPTS,
+		div_s64(hash_ns, RR_TEST_LOOKUPS),
+		div_s64(list_ns, RR_TEST_LOOKUPS));
+out:
+	spin_lock_irqsave(&remote_endpoints_lock, flags);
+	list_for_each_entry_safe(ept, tmp, &remote_endpoints, list) {
+		if (ept->pid != RR_TEST_PID)
+			continue;
+		list_del(&ept->list);
+		hlist_del(&ept->hnode);
+		kfree(ept);
+	}
+	spin_unlock_irqrestore(&remote_endpoints_lock, flags);
+	return 0;
+}
+late_initcall(rpcrouter_selftest);
+#endif /* CONFIG_MSM_ONCRPCROUTER_SELFTEST */
+
 static int __init rpcrouter_init(void)
 {
 	int ret;
@@ -2506,6 +2657,10 @@ static int __init rpcrouter_init(void)
 	smd_rpcrouter_debug_mask |= SMEM_LOG;
 	debugfs_init();
 
+	rr_packet_cache = KMEM_CACHE(rr_packet, 0);
+	if (!rr_packet_cache)
+		return -ENOMEM;
+
 
 	/* Initialize what we need to start processing */
 	rpcrouter_workqueue =
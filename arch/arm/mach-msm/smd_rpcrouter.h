@@ -133,6 +133,7 @@ static inline uint32_t PACMARK(uint32_t len, uint32_t mid, uint32_t first,
 
 struct rr_server {
 	struct list_head list;
+	struct hlist_node hnode;	/* server_hash, keyed by prog/vers */
 
 	uint32_t pid;
 	uint32_t cid;
@@ -156,6 +157,7 @@ struct rr_remote_endpoint {
 	wait_queue_head_t quota_wait;
 
 	struct list_head list;
+	struct hlist_node hnode;	/* remote_endpoints_hash, pid/cid */
 };
 
 struct msm_rpc_reply {
@@ -169,6 +171,7 @@ struct msm_rpc_reply {
 
 struct msm_rpc_endpoint {
 	struct list_head list;
+	struct hlist_node hnode;	/* local_endpoints_hash, keyed by cid */
 
 	/* incomplete packets waiting for assembly */
 	struct list_head incomplete;
@@ -150,10 +150,11 @@ static void smd_tty_read(unsigned long param)
 				info->buf_req_timer.data = param;
 				add_timer(&info->buf_req_timer);
 			}
+			smd_kick(info->ch);
 			return;
 		}
 
-		if (smd_read(info->ch, ptr, avail) != avail) {
+		if (smd_read_nokick(info->ch, ptr, avail) != avail) {
 			/* shouldn't be possible since we're in interrupt
 			** context here and nobody else could 'steal' our
 			** characters.
@@ -165,6 +166,10 @@ static void smd_tty_read(unsigned long param)
 		tty_flip_buffer_push(tty);
 	}
 
+	/* a single interrupt covers everything drained above */
+	if (!is_in_reset(info))
+		smd_kick(info->ch);
+
 	/* XXX only when writable and necessary */
 	tty_wakeup(tty);
 }
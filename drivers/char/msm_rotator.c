@@ -29,6 +29,9 @@
 #include <linux/major.h>
 #include <linux/regulator/consumer.h>
 #include <linux/ion.h>
+#include <linux/poll.h>
+#include <linux/random.h>
+#include <linux/vmalloc.h>
 #ifdef CONFIG_MSM_BUS_SCALING
 #include <mach/msm_bus.h>
 #include <mach/msm_bus_board.h>
@@ -84,6 +87,7 @@
 #define IMEM_NO_OWNER -1;
 
 #define MAX_SESSIONS 16
+#define MAX_QUEUED_JOBS 16	/* per open file */
 #define INVALID_SESSION -1
 #define VERSION_KEY_MASK 0xFFFFFF00
 #define MAX_DOWNSCALE_RATIO 3
@@ -143,6 +147,10 @@ struct msm_rotator_dev {
 	int imem_owner;
 	wait_queue_head_t wq;
 	struct ion_client *client;
+	struct workqueue_struct *job_wq;
+	struct work_struct job_work;
+	struct list_head job_list;
+	spinlock_t job_lock;
 	#ifdef CONFIG_MSM_BUS_SCALING
 	uint32_t bus_client_handle;
 	#endif
@@ -764,23 +772,25 @@ static int msm_rotator_rgb_types(struct msm_rotator_img_info *info,
 }
 
 static int get_img(struct msmfb_data *fbd, unsigned long *start,
-	unsigned long *len, struct file **p_file, int *p_need,
-	struct ion_handle **p_ihdl)
+	unsigned long *vstart, unsigned long *len, struct file **p_file,
+	int *p_need, struct ion_handle **p_ihdl)
 {
 	int ret = 0;
 #ifdef CONFIG_FB
 	struct file *file = NULL;
-	int put_needed, fb_num;
-#endif
-#ifdef CONFIG_ANDROID_PMEM
-	unsigned long vstart;
+	int fb_num;
 #endif
 
 	*p_need = 0;
+	*vstart = 0;
 
 #ifdef CONFIG_FB
 	if (fbd->flags & MDP_MEMORY_ID_TYPE_FB) {
-		file = fget_light(fbd->memory_id, &put_needed);
+		/*
+		 * Take a real reference: queued jobs hold the file past
+		 * the ioctl that looked it up.
+		 */
+		file = fget(fbd->memory_id);
 		if (file == NULL)
 			return -EINVAL;
 
@@ -790,12 +800,12 @@ static int get_img(struct msmfb_data *fbd, unsigned long *start,
 				ret = -1;
 			else {
 				*p_file = file;
-				*p_need = put_needed;
+				*p_need = 1;
 			}
 		} else
 			ret = -1;
 		if (ret)
-			fput_light(file, put_needed);
+			fput(file);
 		return ret;
 	}
 #endif
@@ -812,7 +822,7 @@ static int get_img(struct msmfb_data *fbd, unsigned long *start,
 		return -ENOMEM;
 #endif
 #ifdef CONFIG_ANDROID_PMEM
-	if (!get_pmem_file(fbd->memory_id, start, &vstart, len, p_file))
+	if (!get_pmem_file(fbd->memory_id, start, vstart, len, p_file))
 		return 0;
 	else
 		return -ENOMEM;
@@ -831,30 +841,60 @@ static void put_img(struct file *p_file, struct ion_handle *p_ihdl)
 		ion_free(msm_rotator_dev->client, p_ihdl);
 #endif
 }
-static int msm_rotator_do_rotate(unsigned long arg)
-{
-	unsigned int status, format;
+
+/*
+ * Async submission state of one open file.  Fences are handed out in
+ * submission order and jobs run in that order on job_wq, so a single
+ * "retired" counter describes every job of the file.  All fields are
+ * protected by msm_rotator_dev->job_lock.
+ */
+struct msm_rotator_fd {
+	int pid;
+	wait_queue_head_t wq;
+	unsigned int submitted;	/* last fence handed out */
+	unsigned int retired;	/* last fence completed */
+	unsigned int acked;	/* last fence collected by WAIT */
+	unsigned int pending;	/* jobs being queued or not yet retired */
+	int error;		/* first failure since the last WAIT */
+};
+
+/* one rotation with its session and buffers resolved */
+struct msm_rotator_job {
+	struct list_head list;
+	struct msm_rotator_fd *fd;	/* NULL for synchronous ROTATE */
+	unsigned int fence;
 	struct msm_rotator_data_info info;
-	unsigned int in_paddr, out_paddr;
-	unsigned long src_len, dst_len;
-	int use_imem = 0, rc = 0, s;
-	struct file *srcp0_file = NULL, *dstp0_file = NULL;
-	struct file *srcp1_file = NULL, *dstp1_file = NULL;
-	struct ion_handle *srcp0_ihdl = NULL, *dstp0_ihdl = NULL;
-	struct ion_handle *srcp1_ihdl = NULL, *dstp1_ihdl = NULL;
-	int ps0_need, p_need;
-	unsigned int in_chroma_paddr = 0, out_chroma_paddr = 0;
-	unsigned int in_chroma2_paddr = 0;
-	struct msm_rotator_img_info *img_info;
+	struct msm_rotator_img_info img;
 	struct msm_rotator_mem_planes src_planes, dst_planes;
+	unsigned long in_paddr, out_paddr;
+	unsigned long in_chroma_paddr, out_chroma_paddr, in_chroma2_paddr;
+	/* kernel addresses for the CPU path, 0 when not mapped */
+	unsigned long in_vaddr, out_vaddr;
+	unsigned long in_chroma_vaddr, out_chroma_vaddr;
+	struct file *srcp0_file, *dstp0_file, *srcp1_file, *dstp1_file;
+	struct ion_handle *srcp0_ihdl, *dstp0_ihdl;
+	struct ion_handle *srcp1_ihdl, *dstp1_ihdl;
+	int ps0_need, pd0_need;
+};
 
-	if (copy_from_user(&info, (void __user *)arg, sizeof(info)))
-		return -EFAULT;
+/*
+ * Look up the session of job->info and pin its buffers.  Called with
+ * rotator_lock held, in the context of the submitting process since
+ * the buffers are named by that process's file descriptors.  On failure
+ * whatever was pinned is left for msm_rotator_release().
+ */
+static int msm_rotator_prepare(struct msm_rotator_job *job)
+{
+	struct msm_rotator_data_info *info = &job->info;
+	struct msm_rotator_mem_planes *src_planes = &job->src_planes;
+	struct msm_rotator_mem_planes *dst_planes = &job->dst_planes;
+	unsigned long src_len, dst_len;
+	unsigned long in_chroma_vaddr = 0, out_chroma_vaddr = 0;
+	int rc, s, p_need;
 
-	mutex_lock(&msm_rotator_dev->rotator_lock);
 	for (s = 0; s < MAX_SESSIONS; s++)
 		if ((msm_rotator_dev->img_info[s] != NULL) &&
-			(info.session_id ==
+			(info->session_id ==
 			(unsigned int)msm_rotator_dev->img_info[s]
 			))
 			break;
@@ -863,142 +903,172 @@ static int msm_rotator_do_rotate(unsigned long arg)
 		dev_dbg(msm_rotator_dev->device,
 			"%s() : Attempt to use invalid session_id %d\n",
 			__func__, s);
-		rc = -EINVAL;
-		goto do_rotate_unlock_mutex;
+		return -EINVAL;
 	}
 
 	if (msm_rotator_dev->img_info[s]->enable == 0) {
 		dev_dbg(msm_rotator_dev->device,
 			"%s() : Session_id %d not enabled \n",
 			__func__, s);
-		rc = -EINVAL;
-		goto do_rotate_unlock_mutex;
+		return -EINVAL;
 	}
 
-	img_info = msm_rotator_dev->img_info[s];
-	if (msm_rotator_get_plane_sizes(img_info->src.format,
-					img_info->src.width,
-					img_info->src.height,
-					&src_planes)) {
+	/* queued jobs must not see a later START or FINISH */
+	job->img = *msm_rotator_dev->img_info[s];
+	if (msm_rotator_get_plane_sizes(job->img.src.format,
+					job->img.src.width,
+					job->img.src.height,
+					src_planes)) {
 		pr_err("%s: invalid src format\n", __func__);
-		rc = -EINVAL;
-		goto do_rotate_unlock_mutex;
+		return -EINVAL;
 	}
-	if (msm_rotator_get_plane_sizes(img_info->dst.format,
-					img_info->dst.width,
-					img_info->dst.height,
-					&dst_planes)) {
+	if (msm_rotator_get_plane_sizes(job->img.dst.format,
+					job->img.dst.width,
+					job->img.dst.height,
+					dst_planes)) {
 		pr_err("%s: invalid dst format\n", __func__);
-		rc = -EINVAL;
-		goto do_rotate_unlock_mutex;
+		return -EINVAL;
 	}
 
-
-	rc = get_img(&info.src, (unsigned long *)&in_paddr,
-		(unsigned long *)&src_len, &srcp0_file, &ps0_need, &srcp0_ihdl);
+	rc = get_img(&info->src, &job->in_paddr, &job->in_vaddr, &src_len,
+		&job->srcp0_file, &job->ps0_need, &job->srcp0_ihdl);
 	if (rc) {
 		pr_err("%s: in get_img() failed id=0x%08x\n",
-			DRIVER_NAME, info.src.memory_id);
-		goto do_rotate_unlock_mutex;
+			DRIVER_NAME, info->src.memory_id);
+		return rc;
 	}
 
-	rc = get_img(&info.dst, (unsigned long *)&out_paddr,
-		(unsigned long *)&dst_len, &dstp0_file, &p_need, &dstp0_ihdl);
+	rc = get_img(&info->dst, &job->out_paddr, &job->out_vaddr, &dst_len,
+		&job->dstp0_file, &job->pd0_need, &job->dstp0_ihdl);
 	if (rc) {
 		pr_err("%s: out get_img() failed id=0x%08x\n",
-		       DRIVER_NAME, info.dst.memory_id);
-		goto do_rotate_unlock_mutex;
+		       DRIVER_NAME, info->dst.memory_id);
+		return rc;
 	}
 
-	format = msm_rotator_dev->img_info[s]->src.format;
-	if (((info.version_key & VERSION_KEY_MASK) == 0xA5B4C300) &&
-			((info.version_key & ~VERSION_KEY_MASK) > 0) &&
-			(src_planes.num_planes == 2)) {
-		if (checkoffset(info.src.offset,
-				src_planes.plane_size[0],
+	if (((info->version_key & VERSION_KEY_MASK) == 0xA5B4C300) &&
+			((info->version_key & ~VERSION_KEY_MASK) > 0) &&
+			(src_planes->num_planes == 2)) {
+		if (checkoffset(info->src.offset,
+				src_planes->plane_size[0],
 				src_len)) {
 			pr_err("%s: invalid src buffer (len=%lu offset=%x)\n",
-			       __func__, src_len, info.src.offset);
-			rc = -ERANGE;
-			goto do_rotate_unlock_mutex;
+			       __func__, src_len, info->src.offset);
+			return -ERANGE;
 		}
-		if (checkoffset(info.dst.offset,
-				dst_planes.plane_size[0],
+		if (checkoffset(info->dst.offset,
+				dst_planes->plane_size[0],
 				dst_len)) {
 			pr_err("%s: invalid dst buffer (len=%lu offset=%x)\n",
-			       __func__, dst_len, info.dst.offset);
-			rc = -ERANGE;
-			goto do_rotate_unlock_mutex;
+			       __func__, dst_len, info->dst.offset);
+			return -ERANGE;
 		}
 
-		rc = get_img(&info.src_chroma,
-				(unsigned long *)&in_chroma_paddr,
-				(unsigned long *)&src_len, &srcp1_file, &p_need,
-				&srcp1_ihdl);
+		rc = get_img(&info->src_chroma, &job->in_chroma_paddr,
+				&in_chroma_vaddr, &src_len, &job->srcp1_file,
+				&p_need, &job->srcp1_ihdl);
 		if (rc) {
 			pr_err("%s: in chroma get_img() failed id=0x%08x\n",
-				DRIVER_NAME, info.src_chroma.memory_id);
-			goto do_rotate_unlock_mutex;
+				DRIVER_NAME, info->src_chroma.memory_id);
+			return rc;
 		}
 
-		rc = get_img(&info.dst_chroma,
-				(unsigned long *)&out_chroma_paddr,
-				(unsigned long *)&dst_len, &dstp1_file, &p_need,
-				&dstp1_ihdl);
+		rc = get_img(&info->dst_chroma, &job->out_chroma_paddr,
+				&out_chroma_vaddr, &dst_len, &job->dstp1_file,
+				&p_need, &job->dstp1_ihdl);
 		if (rc) {
 			pr_err("%s: out chroma get_img() failed id=0x%08x\n",
-				DRIVER_NAME, info.dst_chroma.memory_id);
-			goto do_rotate_unlock_mutex;
+				DRIVER_NAME, info->dst_chroma.memory_id);
+			return rc;
 		}
 
-		if (checkoffset(info.src_chroma.offset,
-				src_planes.plane_size[1],
+		if (checkoffset(info->src_chroma.offset,
+				src_planes->plane_size[1],
 				src_len)) {
 			pr_err("%s: invalid chr src buf len=%lu offset=%x\n",
-			       __func__, src_len, info.src_chroma.offset);
-			rc = -ERANGE;
-			goto do_rotate_unlock_mutex;
+			       __func__, src_len, info->src_chroma.offset);
+			return -ERANGE;
 		}
 
-		if (checkoffset(info.dst_chroma.offset,
-				src_planes.plane_size[1],
+		if (checkoffset(info->dst_chroma.offset,
+				src_planes->plane_size[1],
 				dst_len)) {
 			pr_err("%s: invalid chr dst buf len=%lu offset=%x\n",
-			       __func__, dst_len, info.dst_chroma.offset);
-			rc = -ERANGE;
-			goto do_rotate_unlock_mutex;
+			       __func__, dst_len, info->dst_chroma.offset);
+			return -ERANGE;
 		}
 
-		in_chroma_paddr += info.src_chroma.offset;
-		out_chroma_paddr += info.dst_chroma.offset;
+		job->in_chroma_paddr += info->src_chroma.offset;
+		job->out_chroma_paddr += info->dst_chroma.offset;
+		if (in_chroma_vaddr)
+			job->in_chroma_vaddr = in_chroma_vaddr +
+				info->src_chroma.offset;
+		if (out_chroma_vaddr)
+			job->out_chroma_vaddr = out_chroma_vaddr +
+				info->dst_chroma.offset;
 	} else {
-		if (checkoffset(info.src.offset,
-				src_planes.total_size,
+		if (checkoffset(info->src.offset,
+				src_planes->total_size,
 				src_len)) {
 			pr_err("%s: invalid src buffer (len=%lu offset=%x)\n",
-			       __func__, src_len, info.src.offset);
-			rc = -ERANGE;
-			goto do_rotate_unlock_mutex;
+			       __func__, src_len, info->src.offset);
+			return -ERANGE;
 		}
-		if (checkoffset(info.dst.offset,
-				dst_planes.total_size,
+		if (checkoffset(info->dst.offset,
+				dst_planes->total_size,
 				dst_len)) {
 			pr_err("%s: invalid dst buffer (len=%lu offset=%x)\n",
-			       __func__, dst_len, info.dst.offset);
-			rc = -ERANGE;
-			goto do_rotate_unlock_mutex;
+			       __func__, dst_len, info->dst.offset);
+			return -ERANGE;
 		}
 	}
 
-	in_paddr += info.src.offset;
-	out_paddr += info.dst.offset;
+	job->in_paddr += info->src.offset;
+	job->out_paddr += info->dst.offset;
+	/* only PMEM is mapped here, ION gets its offset when mapped */
+	if (job->in_vaddr)
+		job->in_vaddr += info->src.offset;
+	if (job->out_vaddr)
+		job->out_vaddr += info->dst.offset;
+
+	if (!job->in_chroma_paddr && src_planes->num_planes >= 2)
+		job->in_chroma_paddr = job->in_paddr +
+			src_planes->plane_size[0];
+	if (!job->out_chroma_paddr && dst_planes->num_planes >= 2)
+		job->out_chroma_paddr = job->out_paddr +
+			dst_planes->plane_size[0];
+	if (src_planes->num_planes >= 3)
+		job->in_chroma2_paddr = job->in_chroma_paddr +
+			src_planes->plane_size[1];
+
+	return 0;
+}
 
-	if (!in_chroma_paddr && src_planes.num_planes >= 2)
-		in_chroma_paddr = in_paddr + src_planes.plane_size[0];
-	if (!out_chroma_paddr && dst_planes.num_planes >= 2)
-		out_chroma_paddr = out_paddr + dst_planes.plane_size[0];
-	if (src_planes.num_planes >= 3)
-		in_chroma2_paddr = in_chroma_paddr + src_planes.plane_size[1];
+static void msm_rotator_release(struct msm_rotator_job *job)
+{
+	put_img(job->dstp1_file, job->dstp1_ihdl);
+	put_img(job->srcp1_file, job->srcp1_ihdl);
+
+	if (job->info.dst.flags & MDP_MEMORY_ID_TYPE_FB) {
+		if (job->dstp0_file)
+			fput_light(job->dstp0_file, job->pd0_need);
+	} else
+		put_img(job->dstp0_file, job->dstp0_ihdl);
+
+	if (job->info.src.flags & MDP_MEMORY_ID_TYPE_FB) {
+		if (job->srcp0_file)
+			fput_light(job->srcp0_file, job->ps0_need);
+	} else
+		put_img(job->srcp0_file, job->srcp0_ihdl);
+}
+
+static int msm_rotator_hw_rotate(struct msm_rotator_job *job)
+{
+	struct msm_rotator_img_info *img = &job->img;
+	unsigned int status;
+	int use_imem = 0, rc = 0;
+	/* sessions are snapshotted per job, so always reprogram */
+	int new_session = 1;
 
 	cancel_delayed_work(&msm_rotator_dev->rot_clk_work);
 	if (msm_rotator_dev->rot_clk_state != CLK_EN) {
@@ -1020,20 +1090,17 @@ static int msm_rotator_do_rotate(unsigned long arg)
 	if (use_imem)
 		iowrite32(0x42, MSM_ROTATOR_MAX_BURST_SIZE);
 
-	iowrite32(((msm_rotator_dev->img_info[s]->src_rect.h & 0x1fff)
-				<< 16) |
-		  (msm_rotator_dev->img_info[s]->src_rect.w & 0x1fff),
+	iowrite32(((img->src_rect.h & 0x1fff) << 16) |
+		  (img->src_rect.w & 0x1fff),
 		  MSM_ROTATOR_SRC_SIZE);
-	iowrite32(((msm_rotator_dev->img_info[s]->src_rect.y & 0x1fff)
-				<< 16) |
-		  (msm_rotator_dev->img_info[s]->src_rect.x & 0x1fff),
+	iowrite32(((img->src_rect.y & 0x1fff) << 16) |
+		  (img->src_rect.x & 0x1fff),
 		  MSM_ROTATOR_SRC_XY);
-	iowrite32(((msm_rotator_dev->img_info[s]->src.height & 0x1fff)
-				<< 16) |
-		  (msm_rotator_dev->img_info[s]->src.width & 0x1fff),
+	iowrite32(((img->src.height & 0x1fff) << 16) |
+		  (img->src.width & 0x1fff),
 		  MSM_ROTATOR_SRC_IMAGE_SIZE);
 
-	switch (format) {
+	switch (img->src.format) {
 	case MDP_RGB_565:
 	case MDP_BGR_565:
 	case MDP_RGB_888:
@@ -1042,11 +1109,9 @@ static int msm_rotator_do_rotate(unsigned long arg)
 	case MDP_XRGB_8888:
 	case MDP_BGRA_8888:
 	case MDP_RGBX_8888:
-		rc = msm_rotator_rgb_types(msm_rotator_dev->img_info[s],
-					   in_paddr, out_paddr,
-					   use_imem,
-					   msm_rotator_dev->last_session_idx
-								!= s);
+		rc = msm_rotator_rgb_types(img,
+					   job->in_paddr, job->out_paddr,
+					   use_imem, new_session);
 		break;
 	case MDP_Y_CBCR_H2V2:
 	case MDP_Y_CRCB_H2V2:
@@ -1055,28 +1120,25 @@ static int msm_rotator_do_rotate(unsigned long arg)
 	case MDP_Y_CR_CB_GH2V2:
 	case MDP_Y_CRCB_H2V2_TILE:
 	case MDP_Y_CBCR_H2V2_TILE:
-		rc = msm_rotator_ycxcx_h2v2(msm_rotator_dev->img_info[s],
-					    in_paddr, out_paddr, use_imem,
-					    msm_rotator_dev->last_session_idx
-								!= s,
-					    in_chroma_paddr,
-					    out_chroma_paddr,
-					    in_chroma2_paddr);
+		rc = msm_rotator_ycxcx_h2v2(img,
+					    job->in_paddr, job->out_paddr,
+					    use_imem, new_session,
+					    job->in_chroma_paddr,
+					    job->out_chroma_paddr,
+					    job->in_chroma2_paddr);
 		break;
 	case MDP_Y_CBCR_H2V1:
 	case MDP_Y_CRCB_H2V1:
-		rc = msm_rotator_ycxcx_h2v1(msm_rotator_dev->img_info[s],
-					    in_paddr, out_paddr, use_imem,
-					    msm_rotator_dev->last_session_idx
-								!= s,
-					    in_chroma_paddr,
-					    out_chroma_paddr);
+		rc = msm_rotator_ycxcx_h2v1(img,
+					    job->in_paddr, job->out_paddr,
+					    use_imem, new_session,
+					    job->in_chroma_paddr,
+					    job->out_chroma_paddr);
 		break;
 	case MDP_YCRYCB_H2V1:
-		rc = msm_rotator_ycrycb(msm_rotator_dev->img_info[s],
-				in_paddr, out_paddr, use_imem,
-				msm_rotator_dev->last_session_idx != s,
-				out_chroma_paddr);
+		rc = msm_rotator_ycrycb(img,
+				job->in_paddr, job->out_paddr, use_imem,
+				new_session, job->out_chroma_paddr);
 		break;
 	default:
 		rc = -EINVAL;
@@ -1107,22 +1169,552 @@ do_rotate_exit:
 	msm_rotator_imem_free(ROTATOR_REQUEST);
 #endif
 	schedule_delayed_work(&msm_rotator_dev->rot_clk_work, HZ);
-do_rotate_unlock_mutex:
-	put_img(dstp1_file, dstp1_ihdl);
-	put_img(srcp1_file, srcp1_ihdl);
-	put_img(dstp0_file, dstp0_ihdl);
-
-	/* only source may use frame buffer */
-	if (info.src.flags & MDP_MEMORY_ID_TYPE_FB)
-		fput_light(srcp0_file, ps0_need);
-	else
-		put_img(srcp0_file, srcp0_ihdl);
+	return rc;
+}
+
+/*
+ * CPU rotation path.
+ *
+ * Small frames cost more in clock enable, iMem arbitration and the
+ * interrupt round trip than in the rotation itself, so frames of up to
+ * cpu_max_pixels source pixels are rotated by the CPU instead.  The
+ * output is bit-exact with the block: flips are applied in source
+ * space, then the 90 degree rotation is clockwise.  Tiled sources are
+ * left to the hardware, as are H2V1 chroma rotated by 90 degrees, which
+ * the block resamples.
+ */
+static unsigned int cpu_max_pixels = 128 * 128;
+module_param(cpu_max_pixels, uint, 0644);
+MODULE_PARM_DESC(cpu_max_pixels,
+		 "Rotate frames of up to this many pixels on the CPU (0: never)");
+
+/*
+ * One plane: w x h elements read @pitch bytes apart along a source row
+ * and written as @esz byte elements.  With @src2 set, elements are byte
+ * pairs gathered from two planes (planar or packed chroma).
+ */
+struct msm_rotator_plane {
+	const u8 *src, *src2;
+	unsigned int pitch, stride;
+	u8 *dst;
+	unsigned int dst_stride;
+	unsigned int esz, w, h;
+};
+
+/* tile edge, in elements, of the blocked kernels */
+#define MSM_ROTATOR_TILE	32
+
+/*
+ * Blocked kernels for contiguous source elements.  Source rows are
+ * read sequentially; with a 90 degree rotation the writes go down a
+ * destination column, so walk the plane in tiles small enough to keep
+ * the destination lines of a tile in the cache.
+ */
+#define MSM_ROTATOR_CPU_KERNEL(name, type)				\
+static void name(const struct msm_rotator_plane *p, u8 *base,		\
+		 long xs, long ys)					\
+{									\
+	unsigned int tx, ty, x, y, xe, ye;				\
+									\
+	for (ty = 0; ty < p->h; ty += MSM_ROTATOR_TILE) {		\
+		ye = min(ty + MSM_ROTATOR_TILE, p->h);			\
+		for (tx = 0; tx < p->w; tx += MSM_ROTATOR_TILE) {	\
+			xe = min(tx + MSM_ROTATOR_TILE, p->w);		\
+			for (y = ty; y < ye; y++) {			\
+				const type *s = (const type *)		\
+					(p->src + y * p->stride) + tx;	\
+				u8 *d = base + y * ys + tx * xs;	\
+									\
+				for (x = tx; x < xe; x++, d += xs)	\
+					*(type *)d = *s++;		\
+			}						\
+		}							\
+	}								\
+}
+
+MSM_ROTATOR_CPU_KERNEL(msm_rotator_cpu_rot8, u8)
+MSM_ROTATOR_CPU_KERNEL(msm_rotator_cpu_rot16, u16)
+MSM_ROTATOR_CPU_KERNEL(msm_rotator_cpu_rot32, u32)
+
+/* strided, gathered, unaligned and 3 byte elements */
+static void msm_rotator_cpu_rot_any(const struct msm_rotator_plane *p,
+				    u8 *base, long xs, long ys)
+{
+	unsigned int x, y;
+
+	for (y = 0; y < p->h; y++) {
+		const u8 *s = p->src + y * p->stride;
+		const u8 *s2 = p->src2 ? p->src2 + y * p->stride : NULL;
+		u8 *d = base + y * ys;
+
+		for (x = 0; x < p->w; x++, d += xs) {
+			if (s2) {
+				d[0] = s[x * p->pitch];
+				d[1] = s2[x * p->pitch];
+			} else
+				memcpy(d, s + x * p->pitch, p->esz);
+		}
+	}
+}
+
+static void msm_rotator_cpu_plane(const struct msm_rotator_plane *p,
+				  unsigned char rotations)
+{
+	long xs, ys;	/* destination step per source column, row */
+	u8 *base;
+	unsigned int y;
+
+	if (!p->w || !p->h)
+		return;
+
+	if (rotations & MDP_ROT_90) {
+		xs = (rotations & MDP_FLIP_LR) ?
+			-(long)p->dst_stride : p->dst_stride;
+		ys = (rotations & MDP_FLIP_UD) ? p->esz : -(long)p->esz;
+	} else {
+		xs = (rotations & MDP_FLIP_LR) ? -(long)p->esz : p->esz;
+		ys = (rotations & MDP_FLIP_UD) ?
+			-(long)p->dst_stride : p->dst_stride;
+	}
+	base = p->dst;
+	if (xs < 0)
+		base += (p->w - 1) * -xs;
+	if (ys < 0)
+		base += (p->h - 1) * -ys;
+
+	if (p->src2 || p->pitch != p->esz ||
+	    ((unsigned long)p->src | p->stride |
+	     (unsigned long)base | xs | ys) & (p->esz - 1)) {
+		msm_rotator_cpu_rot_any(p, base, xs, ys);
+		return;
+	}
+
+	if (xs == p->esz) {
+		for (y = 0; y < p->h; y++)
+			memcpy(base + y * ys, p->src + y * p->stride,
+			       p->w * p->esz);
+		return;
+	}
+
+	switch (p->esz) {
+	case 1:
+		msm_rotator_cpu_rot8(p, base, xs, ys);
+		break;
+	case 2:
+		msm_rotator_cpu_rot16(p, base, xs, ys);
+		break;
+	case 4:
+		msm_rotator_cpu_rot32(p, base, xs, ys);
+		break;
+	default:
+		msm_rotator_cpu_rot_any(p, base, xs, ys);
+		break;
+	}
+}
+
+static int msm_rotator_cpu_supported(const struct msm_rotator_img_info *img)
+{
+	switch (img->src.format) {
+	case MDP_RGB_565:
+	case MDP_BGR_565:
+	case MDP_RGB_888:
+	case MDP_ARGB_8888:
+	case MDP_RGBA_8888:
+	case MDP_XRGB_8888:
+	case MDP_BGRA_8888:
+	case MDP_RGBX_8888:
+	case MDP_Y_CBCR_H2V2:
+	case MDP_Y_CRCB_H2V2:
+	case MDP_Y_CB_CR_H2V2:
+	case MDP_Y_CR_CB_H2V2:
+	case MDP_Y_CR_CB_GH2V2:
+		return 1;
+	case MDP_Y_CBCR_H2V1:
+	case MDP_Y_CRCB_H2V1:
+	case MDP_YCRYCB_H2V1:
+		return !(img->rotations & MDP_ROT_90);
+	default:
+		return 0;
+	}
+}
+
+/*
+ * Rotate the frame described by @img.  @in_c2 is only used by the
+ * three plane formats; the output is always at most two planes.
+ */
+static void msm_rotator_cpu_frame(const struct msm_rotator_img_info *img,
+				  const u8 *in, const u8 *in_c,
+				  const u8 *in_c2, u8 *out, u8 *out_c)
+{
+	struct msm_rotator_plane y = { .pitch = 1, .esz = 1 };
+	struct msm_rotator_plane c = { .pitch = 2, .esz = 2 };
+	unsigned int sx = img->src_rect.x, sy = img->src_rect.y;
+	unsigned int sw = img->src.width, dw = img->dst.width;
+	unsigned int dx = img->dst_x, dy = img->dst_y;
+	unsigned int cs;
+	int bpp = get_bpp(img->src.format);
+
+	y.w = img->src_rect.w;
+	y.h = img->src_rect.h;
+	y.dst = out + dy * dw + dx;
+	y.dst_stride = dw;
+	c.w = y.w / 2;
+	c.dst_stride = dw;
+
+	switch (img->src.format) {
+	case MDP_RGB_565:
+	case MDP_BGR_565:
+	case MDP_RGB_888:
+	case MDP_ARGB_8888:
+	case MDP_RGBA_8888:
+	case MDP_XRGB_8888:
+	case MDP_BGRA_8888:
+	case MDP_RGBX_8888:
+		y.pitch = y.esz = bpp;
+		y.stride = sw * bpp;
+		y.src = in + sy * y.stride + sx * bpp;
+		y.dst_stride = dw * bpp;
+		y.dst = out + dy * y.dst_stride + dx * bpp;
+		msm_rotator_cpu_plane(&y, img->rotations);
+		return;
+	case MDP_Y_CBCR_H2V2:
+	case MDP_Y_CRCB_H2V2:
+		y.stride = sw;
+		c.stride = sw;
+		c.h = y.h / 2;
+		c.src = in_c + (sy / 2) * sw + (sx / 2) * 2;
+		c.dst = out_c + (dy / 2) * dw + (dx / 2) * 2;
+		break;
+	case MDP_Y_CB_CR_H2V2:
+	case MDP_Y_CR_CB_H2V2:
+	case MDP_Y_CR_CB_GH2V2:
+		if (img->src.format == MDP_Y_CR_CB_GH2V2) {
+			y.stride = ALIGN(sw, 16);
+			cs = ALIGN(sw / 2, 16);
+		} else {
+			y.stride = sw;
+			cs = sw / 2;
+		}
+		c.pitch = 1;
+		c.stride = cs;
+		c.h = y.h / 2;
+		c.src = in_c + (sy / 2) * cs + sx / 2;
+		c.src2 = in_c2 + (sy / 2) * cs + sx / 2;
+		c.dst = out_c + (dy / 2) * dw + (dx / 2) * 2;
+		break;
+	case MDP_Y_CBCR_H2V1:
+	case MDP_Y_CRCB_H2V1:
+		y.stride = sw;
+		c.stride = sw;
+		c.h = y.h;
+		c.src = in_c + sy * sw + (sx / 2) * 2;
+		c.dst = out_c + dy * dw + (dx / 2) * 2;
+		break;
+	case MDP_YCRYCB_H2V1:
+		/* Y0 Cr Y1 Cb to Y plus CrCb pairs */
+		y.pitch = 2;
+		y.stride = sw * 2;
+		c.pitch = 4;
+		c.stride = sw * 2;
+		c.h = y.h;
+		c.src = in + sy * c.stride + (sx / 2) * 4 + 1;
+		c.src2 = c.src + 2;
+		c.dst = out_c + dy * dw + (dx / 2) * 2;
+		break;
+	default:
+		return;
+	}
+
+	y.src = in + sy * y.stride + sx * y.pitch;
+	msm_rotator_cpu_plane(&y, img->rotations);
+	msm_rotator_cpu_plane(&c, img->rotations);
+}
+
+static int msm_rotator_use_cpu(struct msm_rotator_job *job)
+{
+	struct msm_rotator_img_info *img = &job->img;
+
+	if (img->src_rect.w * img->src_rect.h > cpu_max_pixels)
+		return 0;
+	if (img->downscale_ratio || !msm_rotator_cpu_supported(img))
+		return 0;
+	/* frame buffers have no kernel mapping here */
+	if ((job->info.src.flags | job->info.dst.flags) &
+	    MDP_MEMORY_ID_TYPE_FB)
+		return 0;
+	return 1;
+}
+
+#ifdef CONFIG_MSM_MULTIMEDIA_USE_ION
+static unsigned long msm_rotator_map_ion(struct ion_handle *ihdl,
+					 unsigned int offset)
+{
+	void *vaddr;
+
+	if (IS_ERR_OR_NULL(ihdl))
+		return 0;
+	/* the default kernel mapping is uncached: no maintenance needed */
+	vaddr = ion_map_kernel(msm_rotator_dev->client, ihdl, 0);
+	if (IS_ERR_OR_NULL(vaddr))
+		return 0;
+	return (unsigned long)vaddr + offset;
+}
+
+static void msm_rotator_unmap_ion(struct ion_handle *ihdl,
+				  unsigned long vaddr)
+{
+	if (vaddr)
+		ion_unmap_kernel(msm_rotator_dev->client, ihdl);
+}
+#endif
+
+static int msm_rotator_cpu_rotate(struct msm_rotator_job *job)
+{
+	struct msm_rotator_data_info *info = &job->info;
+	unsigned long in_c = job->in_chroma_vaddr;
+	unsigned long out_c = job->out_chroma_vaddr;
+	unsigned long in_c2 = 0;
+	int rc = 0;
+
+#ifdef CONFIG_MSM_MULTIMEDIA_USE_ION
+	if (!job->in_vaddr)
+		job->in_vaddr = msm_rotator_map_ion(job->srcp0_ihdl,
+						    info->src.offset);
+	if (!job->out_vaddr)
+		job->out_vaddr = msm_rotator_map_ion(job->dstp0_ihdl,
+						     info->dst.offset);
+	if (!in_c && job->srcp1_ihdl)
+		in_c = job->in_chroma_vaddr =
+			msm_rotator_map_ion(job->srcp1_ihdl,
+					    info->src_chroma.offset);
+	if (!out_c && job->dstp1_ihdl)
+		out_c = job->out_chroma_vaddr =
+			msm_rotator_map_ion(job->dstp1_ihdl,
+					    info->dst_chroma.offset);
+#endif
+	if (!job->in_vaddr || !job->out_vaddr ||
+	    ((job->srcp1_file || job->srcp1_ihdl) && !in_c) ||
+	    ((job->dstp1_file || job->dstp1_ihdl) && !out_c)) {
+		rc = -ENOMEM;
+		goto out;
+	}
+
+	if (!in_c && job->src_planes.num_planes >= 2)
+		in_c = job->in_vaddr + job->src_planes.plane_size[0];
+	if (!out_c && job->dst_planes.num_planes >= 2)
+		out_c = job->out_vaddr + job->dst_planes.plane_size[0];
+	if (job->src_planes.num_planes >= 3)
+		in_c2 = in_c + job->src_planes.plane_size[1];
+
+	/* the source may have been written by another master */
+	if (job->srcp0_file)
+		flush_pmem_file(job->srcp0_file, info->src.offset,
+				job->src_planes.total_size);
+	if (job->srcp1_file)
+		flush_pmem_file(job->srcp1_file, info->src_chroma.offset,
+				job->src_planes.plane_size[1]);
+
+	msm_rotator_cpu_frame(&job->img, (const u8 *)job->in_vaddr,
+			      (const u8 *)in_c, (const u8 *)in_c2,
+			      (u8 *)job->out_vaddr, (u8 *)out_c);
+
+	if (job->dstp0_file)
+		flush_pmem_file(job->dstp0_file, info->dst.offset,
+				job->dst_planes.total_size);
+	if (job->dstp1_file)
+		flush_pmem_file(job->dstp1_file, info->dst_chroma.offset,
+				job->dst_planes.plane_size[1]);
+
+out:
+#ifdef CONFIG_MSM_MULTIMEDIA_USE_ION
+	if (job->srcp0_ihdl)
+		msm_rotator_unmap_ion(job->srcp0_ihdl, job->in_vaddr);
+	if (job->dstp0_ihdl)
+		msm_rotator_unmap_ion(job->dstp0_ihdl, job->out_vaddr);
+	if (job->srcp1_ihdl)
+		msm_rotator_unmap_ion(job->srcp1_ihdl, job->in_chroma_vaddr);
+	if (job->dstp1_ihdl)
+		msm_rotator_unmap_ion(job->dstp1_ihdl, job->out_chroma_vaddr);
+#endif
+	return rc;
+}
+
+/* called with rotator_lock held */
+static int msm_rotator_run(struct msm_rotator_job *job)
+{
+	/* a buffer that cannot be mapped still goes to the hardware */
+	if (msm_rotator_use_cpu(job) && !msm_rotator_cpu_rotate(job))
+		return 0;
+	return msm_rotator_hw_rotate(job);
+}
+
+static int msm_rotator_do_rotate(unsigned long arg)
+{
+	struct msm_rotator_job job;
+	int rc;
+
+	memset(&job, 0, sizeof(job));
+	if (copy_from_user(&job.info, (void __user *)arg, sizeof(job.info)))
+		return -EFAULT;
+
+	mutex_lock(&msm_rotator_dev->rotator_lock);
+	rc = msm_rotator_prepare(&job);
+	if (!rc)
+		rc = msm_rotator_run(&job);
+	msm_rotator_release(&job);
 	mutex_unlock(&msm_rotator_dev->rotator_lock);
 	dev_dbg(msm_rotator_dev->device, "%s() returning rc = %d\n",
 		__func__, rc);
 	return rc;
 }
 
+static void msm_rotator_job_work_f(struct work_struct *work)
+{
+	struct msm_rotator_job *job;
+	struct msm_rotator_fd *fd;
+	int rc;
+
+	for (;;) {
+		spin_lock(&msm_rotator_dev->job_lock);
+		if (list_empty(&msm_rotator_dev->job_list)) {
+			spin_unlock(&msm_rotator_dev->job_lock);
+			break;
+		}
+		job = list_first_entry(&msm_rotator_dev->job_list,
+				       struct msm_rotator_job, list);
+		list_del(&job->list);
+		spin_unlock(&msm_rotator_dev->job_lock);
+
+		mutex_lock(&msm_rotator_dev->rotator_lock);
+		rc = msm_rotator_run(job);
+		msm_rotator_release(job);
+		mutex_unlock(&msm_rotator_dev->rotator_lock);
+
+		/*
+		 * Wake with job_lock held: release may free fd as soon as
+		 * it sees the fence retired, and it checks under job_lock.
+		 */
+		fd = job->fd;
+		spin_lock(&msm_rotator_dev->job_lock);
+		fd->retired = job->fence;
+		fd->pending--;
+		if (rc && !fd->error)
+			fd->error = rc;
+		wake_up_all(&fd->wq);
+		spin_unlock(&msm_rotator_dev->job_lock);
+
+		dev_dbg(msm_rotator_dev->device, "%s() fence %u rc = %d\n",
+			__func__, job->fence, rc);
+		kfree(job);
+	}
+}
+
+/*
+ * Queue a rotation and return its fence.  Buffers are resolved before
+ * returning, so the caller may close its descriptors once this
+ * succeeds; it must not touch the buffer contents until the fence has
+ * retired.
+ */
+static int msm_rotator_queue(struct msm_rotator_fd *fd, unsigned long arg)
+{
+	struct msm_rotator_queue_info __user *uqi = (void __user *)arg;
+	struct msm_rotator_job *job;
+	unsigned int fence;
+	int rc;
+
+	/* each queued job pins its buffers, so bound them per file */
+	spin_lock(&msm_rotator_dev->job_lock);
+	rc = fd->pending >= MAX_QUEUED_JOBS ? -EBUSY : 0;
+	if (!rc)
+		fd->pending++;
+	spin_unlock(&msm_rotator_dev->job_lock);
+	if (rc)
+		return rc;
+
+	job = kzalloc(sizeof(*job), GFP_KERNEL);
+	if (!job) {
+		rc = -ENOMEM;
+		goto unreserve;
+	}
+
+	if (copy_from_user(&job->info, &uqi->data, sizeof(job->info))) {
+		rc = -EFAULT;
+		goto free_job;
+	}
+	job->fd = fd;
+
+	mutex_lock(&msm_rotator_dev->rotator_lock);
+	rc = msm_rotator_prepare(job);
+	if (rc)
+		msm_rotator_release(job);
+	mutex_unlock(&msm_rotator_dev->rotator_lock);
+	if (rc)
+		goto free_job;
+
+	/* fence order must match queue order, see msm_rotator_fd */
+	spin_lock(&msm_rotator_dev->job_lock);
+	fence = job->fence = ++fd->submitted;
+	list_add_tail(&job->list, &msm_rotator_dev->job_list);
+	spin_unlock(&msm_rotator_dev->job_lock);
+	queue_work(msm_rotator_dev->job_wq, &msm_rotator_dev->job_work);
+
+	/* the job runs regardless; a bad pointer only loses the fence */
+	if (put_user(fence, &uqi->fence))
+		return -EFAULT;
+	return 0;
+
+free_job:
+	kfree(job);
+unreserve:
+	spin_lock(&msm_rotator_dev->job_lock);
+	fd->pending--;
+	spin_unlock(&msm_rotator_dev->job_lock);
+	return rc;
+}
+
+static int msm_rotator_fence_done(struct msm_rotator_fd *fd,
+				  unsigned int fence)
+{
+	int done;
+
+	spin_lock(&msm_rotator_dev->job_lock);
+	done = (int)(fd->retired - fence) >= 0;
+	spin_unlock(&msm_rotator_dev->job_lock);
+	return done;
+}
+
+/*
+ * Wait for @fence to retire.  Returns the first error of any job
+ * retired since the previous WAIT, then clears it.
+ */
+static int msm_rotator_wait(struct msm_rotator_fd *fd, unsigned long arg)
+{
+	unsigned int fence;
+	int rc;
+
+	if (copy_from_user(&fence, (void __user *)arg, sizeof(fence)))
+		return -EFAULT;
+
+	spin_lock(&msm_rotator_dev->job_lock);
+	rc = (int)(fence - fd->submitted) > 0 ? -EINVAL : 0;
+	spin_unlock(&msm_rotator_dev->job_lock);
+	if (rc)
+		return rc;
+
+	rc = wait_event_interruptible(fd->wq,
+				      msm_rotator_fence_done(fd, fence));
+	if (rc)
+		return rc;
+
+	spin_lock(&msm_rotator_dev->job_lock);
+	rc = fd->error;
+	fd->error = 0;
+	if ((int)(fence - fd->acked) > 0)
+		fd->acked = fence;
+	spin_unlock(&msm_rotator_dev->job_lock);
+	return rc;
+}
+
 static void msm_rotator_set_perf_level(u32 wh, u32 is_rgb)
 {
 	u32 perf_level;
@@ -1312,6 +1904,7 @@ static int msm_rotator_finish(unsigned long arg)
 static int
 msm_rotator_open(struct inode *inode, struct file *filp)
 {
+	struct msm_rotator_fd *fd;
 	int *id;
 	int i;
 
@@ -1329,7 +1922,12 @@ msm_rotator_open(struct inode *inode, struct file *filp)
 	if (i == MAX_SESSIONS)
 		return -EBUSY;
 
-	filp->private_data = (void *)current->pid;
+	fd = kzalloc(sizeof(*fd), GFP_KERNEL);
+	if (!fd)
+		return -ENOMEM;
+	fd->pid = current->pid;
+	init_waitqueue_head(&fd->wq);
+	filp->private_data = fd;
 
 	return 0;
 }
@@ -1337,14 +1935,16 @@ msm_rotator_open(struct inode *inode, struct file *filp)
 static int
 msm_rotator_close(struct inode *inode, struct file *filp)
 {
+	struct msm_rotator_fd *fd = filp->private_data;
 	int s;
-	int pid;
 
-	pid = (int)filp->private_data;
+	/* queued jobs point at fd */
+	wait_event(fd->wq, msm_rotator_fence_done(fd, fd->submitted));
+
 	mutex_lock(&msm_rotator_dev->rotator_lock);
 	for (s = 0; s < MAX_SESSIONS; s++) {
 		if (msm_rotator_dev->img_info[s] != NULL &&
-			msm_rotator_dev->pid_list[s] == pid) {
+			msm_rotator_dev->pid_list[s] == fd->pid) {
 			kfree(msm_rotator_dev->img_info[s]);
 			msm_rotator_dev->img_info[s] = NULL;
 			if (msm_rotator_dev->last_session_idx == s)
@@ -1353,27 +1953,47 @@ msm_rotator_close(struct inode *inode, struct file *filp)
 		}
 	}
 	mutex_unlock(&msm_rotator_dev->rotator_lock);
+	kfree(fd);
 
 	return 0;
 }
 
+static unsigned int
+msm_rotator_poll(struct file *filp, struct poll_table_struct *wait)
+{
+	struct msm_rotator_fd *fd = filp->private_data;
+	unsigned int mask = 0;
+
+	poll_wait(filp, &fd->wq, wait);
+
+	/* readable while some retired fence has not been waited for */
+	spin_lock(&msm_rotator_dev->job_lock);
+	if (fd->retired != fd->acked)
+		mask |= POLLIN | POLLRDNORM;
+	spin_unlock(&msm_rotator_dev->job_lock);
+
+	return mask;
+}
+
 static long msm_rotator_ioctl(struct file *file, unsigned cmd,
 						 unsigned long arg)
 {
-	int pid;
+	struct msm_rotator_fd *fd = file->private_data;
 
 	if (_IOC_TYPE(cmd) != MSM_ROTATOR_IOCTL_MAGIC)
 		return -ENOTTY;
 
-	pid = (int)file->private_data;
-
 	switch (cmd) {
 	case MSM_ROTATOR_IOCTL_START:
-		return msm_rotator_start(arg, pid);
+		return msm_rotator_start(arg, fd->pid);
 	case MSM_ROTATOR_IOCTL_ROTATE:
 		return msm_rotator_do_rotate(arg);
 	case MSM_ROTATOR_IOCTL_FINISH:
 		return msm_rotator_finish(arg);
+	case MSM_ROTATOR_IOCTL_QUEUE:
+		return msm_rotator_queue(fd, arg);
+	case MSM_ROTATOR_IOCTL_WAIT:
+		return msm_rotator_wait(fd, arg);
 
 	default:
 		dev_dbg(msm_rotator_dev->device,
@@ -1387,6 +2007,7 @@ static const struct file_operations msm_rotator_fops = {
 	.open = msm_rotator_open,
 	.release = msm_rotator_close,
 	.unlocked_ioctl = msm_rotator_ioctl,
+	.poll = msm_rotator_poll,
 };
 
 static int __devinit msm_rotator_probe(struct platform_device *pdev)
@@ -1417,6 +2038,9 @@ static int __devinit msm_rotator_probe(struct platform_device *pdev)
 			  msm_rotator_imem_clk_work_f);
 	msm_rotator_dev->imem_clk = NULL;
 	msm_rotator_dev->pdev = pdev;
+	INIT_LIST_HEAD(&msm_rotator_dev->job_list);
+	spin_lock_init(&msm_rotator_dev->job_lock);
+	INIT_WORK(&msm_rotator_dev->job_work, msm_rotator_job_work_f);
 
 	msm_rotator_dev->core_clk = NULL;
 	msm_rotator_dev->pclk = NULL;
@@ -1573,6 +2197,14 @@ static int __devinit msm_rotator_probe(struct platform_device *pdev)
 		goto error_class_device_create;
 	}
 
+	/* one thread: queued jobs retire in submission order */
+	msm_rotator_dev->job_wq = create_singlethread_workqueue(DRIVER_NAME);
+	if (!msm_rotator_dev->job_wq) {
+		printk(KERN_ERR "%s: create workqueue failed\n", __func__);
+		rc = -ENOMEM;
+		goto error_job_wq;
+	}
+
 	cdev_init(&msm_rotator_dev->cdev, &msm_rotator_fops);
 	rc = cdev_add(&msm_rotator_dev->cdev,
 		      MKDEV(MAJOR(msm_rotator_dev->dev_num), 0),
@@ -1588,6 +2220,8 @@ static int __devinit msm_rotator_probe(struct platform_device *pdev)
 	return rc;
 
 error_cdev_add:
+	destroy_workqueue(msm_rotator_dev->job_wq);
+error_job_wq:
 	device_destroy(msm_rotator_dev->class, msm_rotator_dev->dev_num);
 error_class_device_create:
 	class_destroy(msm_rotator_dev->class);
@@ -1621,6 +2255,7 @@ static int __devexit msm_rotator_remove(struct platform_device *plat_dev)
 	free_irq(msm_rotator_dev->irq, NULL);
 	mutex_destroy(&msm_rotator_dev->rotator_lock);
 	cdev_del(&msm_rotator_dev->cdev);
+	destroy_workqueue(msm_rotator_dev->job_wq);
 	device_destroy(msm_rotator_dev->class, msm_rotator_dev->dev_num);
 	class_destroy(msm_rotator_dev->class);
 	unregister_chrdev_region(msm_rotator_dev->dev_num, 1);
@@ -1698,8 +2333,227 @@ static struct platform_driver msm_rotator_platform_driver = {
 	}
 };
 
+#ifdef CONFIG_MSM_ROTATOR_SELFTEST
+/*
+ * Reference for the CPU path: walk the destination a byte at a time and
+ * map every sample back into the source rectangle.
+ */
+static void msm_rotator_ref_map(unsigned char rotations, unsigned int w,
+				unsigned int h, unsigned int dx,
+				unsigned int dy, unsigned int *x,
+				unsigned int *y)
+{
+	unsigned int u, v;
+
+	if (rotations & MDP_ROT_90) {
+		u = dy;
+		v = h - 1 - dx;
+	} else {
+		u = dx;
+		v = dy;
+	}
+	*x = (rotations & MDP_FLIP_LR) ? w - 1 - u : u;
+	*y = (rotations & MDP_FLIP_UD) ? h - 1 - v : v;
+}
+
+static void msm_rotator_ref_frame(const struct msm_rotator_img_info *img,
+				  const u8 *in, const u8 *in_c,
+				  const u8 *in_c2, u8 *out, u8 *out_c)
+{
+	unsigned int fmt = img->src.format, rot = img->rotations;
+	unsigned int w = img->src_rect.w, h = img->src_rect.h;
+	unsigned int x0 = img->src_rect.x, y0 = img->src_rect.y;
+	unsigned int sw = img->src.width, dw = img->dst.width;
+	unsigned int cw, ch, vs, ys, cs, dx, dy, x, y;
+	int bpp = get_bpp(fmt);
+	const u8 *p;
+	u8 *q;
+
+	switch (fmt) {
+	case MDP_RGB_565:
+	case MDP_BGR_565:
+	case MDP_RGB_888:
+	case MDP_ARGB_8888:
+	case MDP_RGBA_8888:
+	case MDP_XRGB_8888:
+	case MDP_BGRA_8888:
+	case MDP_RGBX_8888:
+		for (dy = 0; dy < ((rot & MDP_ROT_90) ? w : h); dy++)
+			for (dx = 0; dx < ((rot & MDP_ROT_90) ? h : w); dx++) {
+				msm_rotator_ref_map(rot, w, h, dx, dy, &x, &y);
+				memcpy(out + ((img->dst_y + dy) * dw +
+					      img->dst_x + dx) * bpp,
+				       in + ((y0 + y) * sw + x0 + x) * bpp,
+				       bpp);
+			}
+		return;
+	case MDP_Y_CBCR_H2V1:
+	case MDP_Y_CRCB_H2V1:
+	case MDP_YCRYCB_H2V1:
+		vs = 1;
+		break;
+	default:
+		vs = 2;
+		break;
+	}
+
+	ys = fmt == MDP_Y_CR_CB_GH2V2 ? ALIGN(sw, 16) : sw;
+	cs = fmt == MDP_Y_CR_CB_GH2V2 ? ALIGN(sw / 2, 16) : sw / 2;
+
+	for (dy = 0; dy < ((rot & MDP_ROT_90) ? w : h); dy++)
+		for (dx = 0; dx < ((rot & MDP_ROT_90) ? h : w); dx++) {
+			msm_rotator_ref_map(rot, w, h, dx, dy, &x, &y);
+			if (fmt == MDP_YCRYCB_H2V1)
+				p = in + (y0 + y) * sw * 2 + (x0 + x) * 2;
+			else
+				p = in + (y0 + y) * ys + x0 + x;
+			out[(img->dst_y + dy) * dw + img->dst_x + dx] = *p;
+		}
+
+	cw = w / 2;
+	ch = h / vs;
+	for (dy = 0; dy < ((rot & MDP_ROT_90) ? cw : ch); dy++)
+		for (dx = 0; dx < ((rot & MDP_ROT_90) ? ch : cw); dx++) {
+			msm_rotator_ref_map(rot, cw, ch, dx, dy, &x, &y);
+			q = out_c + (img->dst_y / vs + dy) * dw +
+				(img->dst_x / 2 + dx) * 2;
+			switch (fmt) {
+			case MDP_Y_CB_CR_H2V2:
+			case MDP_Y_CR_CB_H2V2:
+			case MDP_Y_CR_CB_GH2V2:
+				q[0] = in_c[(y0 / 2 + y) * cs + x0 / 2 + x];
+				q[1] = in_c2[(y0 / 2 + y) * cs + x0 / 2 + x];
+				break;
+			case MDP_YCRYCB_H2V1:
+				p = in + (y0 + y) * sw * 2 + (x0 / 2 + x) * 4;
+				q[0] = p[1];
+				q[1] = p[3];
+				break;
+			default:
+				p = in_c + (y0 / vs + y) * sw +
+					(x0 / 2 + x) * 2;
+				q[0] = p[0];
+				q[1] = p[1];
+				break;
+			}
+		}
+}
+
+#define MSM_ROTATOR_TEST_SIZE	(32 * 1024)
+
+/*
+ * Compare the CPU path against the reference for every format get_bpp()
+ * knows, all eight rotations, rectangles that span several tiles and
+ * odd sizes, with aligned and misaligned buffers.
+ */
+static void __init msm_rotator_selftest(void)
+{
+	static const struct {
+		uint32_t src, dst;
+	} formats[] __initconst = {
+		{ MDP_RGB_565, MDP_RGB_565 },
+		{ MDP_BGR_565, MDP_BGR_565 },
+		{ MDP_RGB_888, MDP_RGB_888 },
+		{ MDP_XRGB_8888, MDP_XRGB_8888 },
+		{ MDP_ARGB_8888, MDP_ARGB_8888 },
+		{ MDP_RGBA_8888, MDP_RGBA_8888 },
+		{ MDP_BGRA_8888, MDP_BGRA_8888 },
+		{ MDP_RGBX_8888, MDP_RGBX_8888 },
+		{ MDP_Y_CBCR_H2V2, MDP_Y_CBCR_H2V2 },
+		{ MDP_Y_CRCB_H2V2, MDP_Y_CRCB_H2V2 },
+		{ MDP_Y_CB_CR_H2V2, MDP_Y_CBCR_H2V2 },
+		{ MDP_Y_CR_CB_H2V2, MDP_Y_CRCB_H2V2 },
+		{ MDP_Y_CR_CB_GH2V2, MDP_Y_CRCB_H2V2 },
+		{ MDP_Y_CRCB_H2V2_TILE, MDP_Y_CRCB_H2V2 },
+		{ MDP_Y_CBCR_H2V2_TILE, MDP_Y_CBCR_H2V2 },
+		{ MDP_Y_CBCR_H2V1, MDP_Y_CBCR_H2V1 },
+		{ MDP_Y_CRCB_H2V1, MDP_Y_CRCB_H2V1 },
+		{ MDP_YCRYCB_H2V1, MDP_Y_CRCB_H2V1 },
+	};
+	static const struct mdp_rect rects[] __initconst = {
+		/* src_rect, with the source frame 10 x 6 larger */
+		{ 4, 2, 36, 28 },
+		{ 2, 4, 70, 66 },
+		{ 3, 5, 37, 21 },
+	};
+	struct msm_rotator_img_info img;
+	struct msm_rotator_mem_planes sp, dp;
+	u8 *buf, *in, *out, *ref;
+	unsigned int f, r, i, mis, pass = 0, fail = 0, skip = 0;
+
+	buf = vmalloc(3 * MSM_ROTATOR_TEST_SIZE);
+	if (!buf)
+		return;
+
+	for (f = 0; f < ARRAY_SIZE(formats); f++)
+	for (r = 0; r <= MSM_ROTATOR_MAX_ROT; r++)
+	for (i = 0; i < ARRAY_SIZE(rects); i++)
+	for (mis = 0; mis < 2; mis++) {
+		memset(&img, 0, sizeof(img));
+		img.src.format = formats[f].src;
+		img.dst.format = formats[f].dst;
+		img.src_rect = rects[i];
+		img.src.width = img.src_rect.x + img.src_rect.w + 10;
+		img.src.height = img.src_rect.y + img.src_rect.h + 6;
+		img.rotations = r;
+		img.dst_x = 2;
+		img.dst_y = 4;
+		img.dst.width = ((r & MDP_ROT_90) ? img.src_rect.h :
+				 img.src_rect.w) + 6;
+		img.dst.height = ((r & MDP_ROT_90) ? img.src_rect.w :
+				  img.src_rect.h) + 8;
+
+		if (!msm_rotator_cpu_supported(&img)) {
+			skip++;
+			continue;
+		}
+		if (msm_rotator_get_plane_sizes(img.src.format,
+				img.src.width, img.src.height, &sp) ||
+		    msm_rotator_get_plane_sizes(img.dst.format,
+				img.dst.width, img.dst.height, &dp) ||
+		    sp.total_size + 1 > MSM_ROTATOR_TEST_SIZE ||
+		    dp.total_size + 1 > MSM_ROTATOR_TEST_SIZE) {
+			fail++;
+			continue;
+		}
+
+		in = buf + mis;
+		out = buf + MSM_ROTATOR_TEST_SIZE + mis;
+		ref = buf + 2 * MSM_ROTATOR_TEST_SIZE + mis;
+		get_random_bytes(in, sp.total_size);
+		get_random_bytes(out, dp.total_size);
+		memcpy(ref, out, dp.total_size);
+
+		msm_rotator_cpu_frame(&img, in, in + sp.plane_size[0],
+				      in + sp.plane_size[0] + sp.plane_size[1],
+				      out, out + dp.plane_size[0]);
+		msm_rotator_ref_frame(&img, in, in + sp.plane_size[0],
+				      in + sp.plane_size[0] + sp.plane_size[1],
+				      ref, ref + dp.plane_size[0]);
+
+		if (memcmp(out, ref, dp.total_size)) {
+			pr_err("%s: selftest: format %u rotations %u "
+			       "rect %ux%u%s mismatch\n", DRIVER_NAME,
+			       img.src.format, r, img.src_rect.w,
+			       img.src_rect.h, mis ? " misaligned" : "");
+			fail++;
+		} else
+			pass++;
+	}
+
+	vfree(buf);
+	pr_info("%s: selftest: %u passed, %u failed, %u hardware only\n",
+		DRIVER_NAME, pass, fail, skip);
+}
+#else
+static inline void msm_rotator_selftest(void)
+{
+}
+#endif
+
 static int __init msm_rotator_init(void)
 {
+	msm_rotator_selftest();
 	return platform_driver_register(&msm_rotator_platform_driver);
 }
 
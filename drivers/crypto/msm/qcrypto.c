@@ -23,6 +23,9 @@
 #include <linux/interrupt.h>
 #include <linux/spinlock.h>
 #include <linux/debugfs.h>
+#include <linux/completion.h>
+#include <linux/ktime.h>
+#include <linux/module.h>
 
 #include <crypto/ctr.h>
 #include <crypto/des.h>
@@ -43,7 +46,27 @@
 
 #define MAX_CRYPTO_DEVICE 3
 #define DEBUG_MAX_FNAME  16
-#define DEBUG_MAX_RW_BUF 1024
+#define DEBUG_MAX_RW_BUF 4096
+
+/*
+ * Cipher and AEAD requests shorter than this many bytes are done by a
+ * software transform in the caller's context instead of the engine: for
+ * small packets the DMA setup and completion interrupt cost more than
+ * the crypto work itself.  0 sends everything to the engine.
+ */
+static unsigned int _qcrypto_sw_threshold = 512;
+module_param_named(sw_threshold, _qcrypto_sw_threshold, uint, 0644);
+MODULE_PARM_DESC(sw_threshold,
+		"Requests below this size (bytes) use the software fallback");
+
+/* request size buckets for the latency statistics: <= 64, ..., > 4096 */
+#define QCRYPTO_LAT_BUCKETS	8
+
+struct crypto_lat_stat {
+	u32 count;
+	u32 max_us;
+	u64 total_us;
+};
 
 struct crypto_stat {
 	u32 aead_sha1_aes_enc;
@@ -70,6 +93,10 @@ struct crypto_stat {
 	u32 sha256_hmac_digest;
 	u32 sha_hmac_op_success;
 	u32 sha_hmac_op_fail;
+	u32 ablk_cipher_sw;
+	u32 aead_sw;
+	struct crypto_lat_stat hw_lat[QCRYPTO_LAT_BUCKETS];
+	struct crypto_lat_stat sw_lat[QCRYPTO_LAT_BUCKETS];
 };
 static struct crypto_stat _qcrypto_stat[MAX_CRYPTO_DEVICE];
 static struct dentry *_debug_dent;
@@ -98,6 +125,9 @@ struct crypto_priv {
 	/* current active request */
 	struct crypto_async_request *req;
 	int res;
+	/* size and dispatch time of the active request, for statistics */
+	unsigned int req_len;
+	ktime_t req_start;
 
 	/* request queue */
 	struct crypto_queue queue;
@@ -214,6 +244,11 @@ struct qcrypto_cipher_ctx {
 	unsigned int auth_key_len;
 
 	struct crypto_priv *cp;
+
+	/* software transform for small requests, see _qcrypto_sw_threshold */
+	struct crypto_blkcipher *fallback_blk;
+	struct crypto_aead *fallback_aead;
+	bool fallback_ready;
 };
 
 struct qcrypto_cipher_req_ctx {
@@ -227,6 +262,8 @@ struct qcrypto_cipher_req_ctx {
 	enum qce_cipher_alg_enum alg;
 	enum qce_cipher_dir_enum dir;
 	enum qce_cipher_mode_enum mode;
+	/* working IV for the software fallback, which updates it in place */
+	u8 fallback_iv[QCRYPTO_MAX_IV_LENGTH];
 };
 
 #define SHA_MAX_BLOCK_SIZE      SHA256_BLOCK_SIZE
@@ -500,20 +537,52 @@ static int _qcrypto_ahash_hmac_cra_init(struct crypto_tfm *tfm)
 
 static int _qcrypto_cra_ablkcipher_init(struct crypto_tfm *tfm)
 {
+	struct qcrypto_cipher_ctx *ctx = crypto_tfm_ctx(tfm);
+	struct crypto_blkcipher *fallback;
+	int ret;
+
 	tfm->crt_ablkcipher.reqsize = sizeof(struct qcrypto_cipher_req_ctx);
-	return _qcrypto_cipher_cra_init(tfm);
+	ret = _qcrypto_cipher_cra_init(tfm);
+	if (ret)
+		return ret;
+
+	/* no synchronous software equivalent just means no fallback */
+	fallback = crypto_alloc_blkcipher(crypto_tfm_alg_name(tfm), 0,
+				CRYPTO_ALG_ASYNC | CRYPTO_ALG_NEED_FALLBACK);
+	if (!IS_ERR(fallback))
+		ctx->fallback_blk = fallback;
+	return 0;
 };
 
 static int _qcrypto_cra_aead_init(struct crypto_tfm *tfm)
 {
+	struct qcrypto_cipher_ctx *ctx = crypto_tfm_ctx(tfm);
+	struct crypto_aead *fallback;
+	int ret;
+
 	tfm->crt_aead.reqsize = sizeof(struct qcrypto_cipher_req_ctx);
-	return _qcrypto_cipher_cra_init(tfm);
+	ret = _qcrypto_cipher_cra_init(tfm);
+	if (ret)
+		return ret;
+
+	fallback = crypto_alloc_aead(crypto_tfm_alg_name(tfm), 0,
+				CRYPTO_ALG_ASYNC | CRYPTO_ALG_NEED_FALLBACK);
+	if (!IS_ERR(fallback)) {
+		ctx->fallback_aead = fallback;
+		/* the fallback request lives behind our own request ctx */
+		tfm->crt_aead.reqsize += crypto_tfm_ctx_alignment() +
+					sizeof(struct aead_request) +
+					crypto_aead_reqsize(fallback);
+	}
+	return 0;
 };
 
 static void _qcrypto_cra_ablkcipher_exit(struct crypto_tfm *tfm)
 {
 	struct qcrypto_cipher_ctx *ctx = crypto_tfm_ctx(tfm);
 
+	if (ctx->fallback_blk)
+		crypto_free_blkcipher(ctx->fallback_blk);
 	if (ctx->cp->platform_support.bus_scale_table != NULL)
 		qcrypto_ce_high_bw_req(ctx->cp, false);
 };
@@ -522,10 +591,36 @@ static void _qcrypto_cra_aead_exit(struct crypto_tfm *tfm)
 {
 	struct qcrypto_cipher_ctx *ctx = crypto_tfm_ctx(tfm);
 
+	if (ctx->fallback_aead)
+		crypto_free_aead(ctx->fallback_aead);
 	if (ctx->cp->platform_support.bus_scale_table != NULL)
 		qcrypto_ce_high_bw_req(ctx->cp, false);
 };
 
+static int _disp_lat_stats(char *buf, int size, const char *name,
+		struct crypto_lat_stat *lat)
+{
+	int len;
+	int i;
+
+	len = snprintf(buf, size, "   %s latency (us) by request size:\n",
+				name);
+	for (i = 0; i < QCRYPTO_LAT_BUCKETS; i++, lat++) {
+		if (!lat->count)
+			continue;
+		if (i < QCRYPTO_LAT_BUCKETS - 1)
+			len += snprintf(buf + len, size - len, "     <= %5u",
+					64U << i);
+		else
+			len += snprintf(buf + len, size - len, "      > %5u",
+					64U << (i - 1));
+		len += snprintf(buf + len, size - len,
+			" : count %u avg %u max %u\n", lat->count,
+			(u32)div_u64(lat->total_us, lat->count), lat->max_us);
+	}
+	return len;
+}
+
 static int _disp_stats(int id)
 {
 	struct crypto_stat *pstat;
@@ -616,6 +711,18 @@ static int _disp_stats(int id)
 	len += snprintf(_debug_read_buf + len, DEBUG_MAX_RW_BUF - len - 1,
 			"   SHA HMAC operation success          : %d\n",
 					pstat->sha_hmac_op_success);
+	len += snprintf(_debug_read_buf + len, DEBUG_MAX_RW_BUF - len - 1,
+			"   ABLK CIPHER software fallback : %d\n",
+					pstat->ablk_cipher_sw);
+	len += snprintf(_debug_read_buf + len, DEBUG_MAX_RW_BUF - len - 1,
+			"   AEAD software fallback        : %d\n",
+					pstat->aead_sw);
+	len += _disp_lat_stats(_debug_read_buf + len,
+				DEBUG_MAX_RW_BUF - len - 1, "Engine",
+				pstat->hw_lat);
+	len += _disp_lat_stats(_debug_read_buf + len,
+				DEBUG_MAX_RW_BUF - len - 1, "Software fallback",
+				pstat->sw_lat);
 	return len;
 }
 
@@ -649,6 +756,13 @@ static int _qcrypto_remove(struct platform_device *pdev)
 	return 0;
 };
 
+static void _qcrypto_fallback_setkey_blk(struct qcrypto_cipher_ctx *ctx,
+		const u8 *key, unsigned int len)
+{
+	ctx->fallback_ready = ctx->fallback_blk &&
+		!crypto_blkcipher_setkey(ctx->fallback_blk, key, len);
+}
+
 static int _qcrypto_setkey_aes(struct crypto_ablkcipher *cipher, const u8 *key,
 		unsigned int len)
 {
@@ -669,6 +783,7 @@ static int _qcrypto_setkey_aes(struct crypto_ablkcipher *cipher, const u8 *key,
 	};
 	ctx->enc_key_len = len;
 	memcpy(ctx->enc_key, key, len);
+	_qcrypto_fallback_setkey_blk(ctx, key, len);
 	return 0;
 };
 
@@ -692,6 +807,7 @@ static int _qcrypto_setkey_des(struct crypto_ablkcipher *cipher, const u8 *key,
 
 	ctx->enc_key_len = len;
 	memcpy(ctx->enc_key, key, len);
+	_qcrypto_fallback_setkey_blk(ctx, key, len);
 	return 0;
 };
 
@@ -707,23 +823,68 @@ static int _qcrypto_setkey_3des(struct crypto_ablkcipher *cipher, const u8 *key,
 	};
 	ctx->enc_key_len = len;
 	memcpy(ctx->enc_key, key, len);
+	_qcrypto_fallback_setkey_blk(ctx, key, len);
 	return 0;
 };
 
+static unsigned int _qcrypto_req_len(struct crypto_async_request *areq)
+{
+	switch (crypto_tfm_alg_type(areq->tfm)) {
+	case CRYPTO_ALG_TYPE_ABLKCIPHER:
+		return container_of(areq, struct ablkcipher_request,
+					base)->nbytes;
+	case CRYPTO_ALG_TYPE_AHASH:
+		return container_of(areq, struct ahash_request, base)->nbytes;
+	default: {
+		struct aead_request *req = container_of(areq,
+					struct aead_request, base);
+
+		return req->cryptlen + req->assoclen;
+		}
+	}
+}
+
+static void _qcrypto_lat_update(struct crypto_lat_stat *lat,
+		unsigned int len, ktime_t start)
+{
+	u32 us = ktime_to_us(ktime_sub(ktime_get(), start));
+	int i = 0;
+
+	/* bucket i holds requests of up to 64 << i bytes */
+	while (i < QCRYPTO_LAT_BUCKETS - 1 && len > (64U << i))
+		i++;
+	lat += i;
+	lat->count++;
+	lat->total_us += us;
+	if (us > lat->max_us)
+		lat->max_us = us;
+}
+
 static void req_done(unsigned long data)
 {
 	struct crypto_async_request *areq;
 	struct crypto_priv *cp = (struct crypto_priv *)data;
 	unsigned long flags;
+	int res;
 
 	spin_lock_irqsave(&cp->lock, flags);
 	areq = cp->req;
 	cp->req = NULL;
+	res = cp->res;
 	spin_unlock_irqrestore(&cp->lock, flags);
 
 	if (areq)
-		areq->complete(areq, cp->res);
+		_qcrypto_lat_update(_qcrypto_stat[cp->pdev->id].hw_lat,
+					cp->req_len, cp->req_start);
+
+	/*
+	 * Hand the next queued request to the engine before running the
+	 * completion, so the engine works while the caller processes the
+	 * result instead of idling through the callback.
+	 */
 	_start_qcrypto_process(cp);
+	if (areq)
+		areq->complete(areq, res);
 };
 
 static void _update_sha1_ctx(struct ahash_request  *req)
@@ -1020,6 +1181,8 @@ again:
 	if (backlog)
 		backlog->complete(backlog, -EINPROGRESS);
 	type = crypto_tfm_alg_type(async_req->tfm);
+	cp->req_len = _qcrypto_req_len(async_req);
+	cp->req_start = ktime_get();
 
 	if (type == CRYPTO_ALG_TYPE_ABLKCIPHER) {
 		struct ablkcipher_request *req;
@@ -1171,12 +1334,111 @@ done:
 	};
 };
 
+static bool _qcrypto_use_fallback(struct crypto_async_request *req)
+{
+	u32 type = crypto_tfm_alg_type(req->tfm);
+	struct qcrypto_cipher_ctx *ctx;
+
+	if (type != CRYPTO_ALG_TYPE_ABLKCIPHER && type != CRYPTO_ALG_TYPE_AEAD)
+		return false;
+	ctx = crypto_tfm_ctx(req->tfm);
+	return ctx->fallback_ready &&
+		_qcrypto_req_len(req) < _qcrypto_sw_threshold;
+}
+
+/* the fallback AEAD request lives behind our own request ctx */
+static struct aead_request *_qcrypto_fallback_subreq(
+				struct qcrypto_cipher_req_ctx *rctx)
+{
+	return (struct aead_request *)PTR_ALIGN((u8 *)(rctx + 1),
+					crypto_tfm_ctx_alignment());
+}
+
+/*
+ * Run a cipher or AEAD request synchronously on the software fallback.
+ * The request ctx has already been set up by the caller exactly as for
+ * the engine, so direction, mode and (generated) IV are taken from it.
+ */
+static int _qcrypto_fallback_req(struct crypto_priv *cp,
+				struct crypto_async_request *async_req)
+{
+	struct qcrypto_cipher_ctx *ctx = crypto_tfm_ctx(async_req->tfm);
+	struct crypto_stat *pstat = &_qcrypto_stat[cp->pdev->id];
+	struct qcrypto_cipher_req_ctx *rctx;
+	unsigned int len = _qcrypto_req_len(async_req);
+	ktime_t start = ktime_get();
+	int ret;
+
+	if (crypto_tfm_alg_type(async_req->tfm) == CRYPTO_ALG_TYPE_ABLKCIPHER) {
+		struct ablkcipher_request *req = container_of(async_req,
+					struct ablkcipher_request, base);
+		unsigned int ivsize = crypto_ablkcipher_ivsize(
+					crypto_ablkcipher_reqtfm(req));
+		struct blkcipher_desc desc;
+
+		rctx = ablkcipher_request_ctx(req);
+		memcpy(rctx->fallback_iv, req->info, ivsize);
+		desc.tfm = ctx->fallback_blk;
+		desc.info = rctx->fallback_iv;
+		desc.flags = req->base.flags;
+
+		if (rctx->dir == QCE_ENCRYPT)
+			ret = crypto_blkcipher_encrypt_iv(&desc, req->dst,
+						req->src, req->nbytes);
+		else
+			ret = crypto_blkcipher_decrypt_iv(&desc, req->dst,
+						req->src, req->nbytes);
+		/* the engine leaves its output IV in ctx->iv, do the same */
+		memcpy(ctx->iv, rctx->fallback_iv, ivsize);
+
+		pstat->ablk_cipher_sw++;
+		if (ret)
+			pstat->ablk_cipher_op_fail++;
+		else
+			pstat->ablk_cipher_op_success++;
+	} else {
+		struct aead_request *req = container_of(async_req,
+					struct aead_request, base);
+		unsigned int ivsize = crypto_aead_ivsize(
+					crypto_aead_reqtfm(req));
+		struct aead_request *subreq;
+
+		rctx = aead_request_ctx(req);
+		memcpy(rctx->fallback_iv, rctx->iv, ivsize);
+		subreq = _qcrypto_fallback_subreq(rctx);
+		aead_request_set_tfm(subreq, ctx->fallback_aead);
+		aead_request_set_callback(subreq, req->base.flags, NULL, NULL);
+		aead_request_set_crypt(subreq, req->src, req->dst,
+					req->cryptlen, rctx->fallback_iv);
+		aead_request_set_assoc(subreq, req->assoc, req->assoclen);
+
+		if (rctx->dir == QCE_ENCRYPT)
+			ret = crypto_aead_encrypt(subreq);
+		else
+			ret = crypto_aead_decrypt(subreq);
+		if (rctx->mode != QCE_MODE_CCM)
+			memcpy(ctx->iv, rctx->fallback_iv, ivsize);
+
+		pstat->aead_sw++;
+		if (ret)
+			pstat->aead_op_fail++;
+		else
+			pstat->aead_op_success++;
+	}
+	_qcrypto_lat_update(pstat->sw_lat, len, start);
+
+	return ret;
+}
+
 static int _qcrypto_queue_req(struct crypto_priv *cp,
 				struct crypto_async_request *req)
 {
 	int ret;
 	unsigned long flags;
 
+	if (_qcrypto_use_fallback(req))
+		return _qcrypto_fallback_req(cp, req);
+
 	if (cp->platform_support.ce_shared) {
 		ret = qcrypto_lock_ce(cp);
 		if (ret)
@@ -1606,6 +1868,12 @@ static int _qcrypto_aead_setauthsize(struct crypto_aead *authenc,
 {
 	struct qcrypto_cipher_ctx *ctx = crypto_aead_ctx(authenc);
 
+	if (ctx->fallback_aead) {
+		int ret = crypto_aead_setauthsize(ctx->fallback_aead, authsize);
+
+		if (ret)
+			return ret;
+	}
 	ctx->authsize = authsize;
 	return 0;
 }
@@ -1627,10 +1895,23 @@ static int _qcrypto_aead_ccm_setauthsize(struct crypto_aead *authenc,
 	default:
 		return -EINVAL;
 	}
+	if (ctx->fallback_aead) {
+		int ret = crypto_aead_setauthsize(ctx->fallback_aead, authsize);
+
+		if (ret)
+			return ret;
+	}
 	ctx->authsize = authsize;
 	return 0;
 }
 
+static void _qcrypto_fallback_setkey_aead(struct qcrypto_cipher_ctx *ctx,
+		const u8 *key, unsigned int keylen)
+{
+	ctx->fallback_ready = ctx->fallback_aead &&
+		!crypto_aead_setkey(ctx->fallback_aead, key, keylen);
+}
+
 static int _qcrypto_aead_setkey(struct crypto_aead *tfm, const u8 *key,
 			unsigned int keylen)
 {
@@ -1638,6 +1919,8 @@ static int _qcrypto_aead_setkey(struct crypto_aead *tfm, const u8 *key,
 	struct rtattr *rta = (struct rtattr *)key;
 	struct crypto_authenc_key_param *param;
 
+	_qcrypto_fallback_setkey_aead(ctx, key, keylen);
+
 	if (!RTA_OK(rta, keylen))
 		goto badkey;
 	if (rta->rta_type != CRYPTO_AUTHENC_KEYA_PARAM)
@@ -1665,6 +1948,7 @@ static int _qcrypto_aead_setkey(struct crypto_aead *tfm, const u8 *key,
 	return 0;
 badkey:
 	ctx->enc_key_len = 0;
+	ctx->fallback_ready = false;
 	crypto_aead_set_flags(tfm, CRYPTO_TFM_RES_BAD_KEY_LEN);
 	return -EINVAL;
 }
@@ -1685,6 +1969,7 @@ static int _qcrypto_aead_ccm_setkey(struct crypto_aead *aead, const u8 *key,
 			break;
 	default:
 		ctx->enc_key_len = 0;
+		ctx->fallback_ready = false;
 		crypto_aead_set_flags(aead, CRYPTO_TFM_RES_BAD_KEY_LEN);
 		return -EINVAL;
 	};
@@ -1692,6 +1977,7 @@ static int _qcrypto_aead_ccm_setkey(struct crypto_aead *aead, const u8 *key,
 	memcpy(ctx->enc_key, key, keylen);
 	ctx->auth_key_len = keylen;
 	memcpy(ctx->auth_key, key, keylen);
+	_qcrypto_fallback_setkey_aead(ctx, key, keylen);
 
 	return 0;
 }
@@ -3335,6 +3621,295 @@ err:
 	return rc;
 }
 
+#ifdef CONFIG_CRYPTO_DEV_QCRYPTO_SELFTEST
+#define QCRYPTO_TEST_LEN	64
+#define QCRYPTO_TEST_ASSOC	8
+#define QCRYPTO_TEST_AUTHSIZE	12
+#define QCRYPTO_TEST_GUARD	64
+
+/* AES-128-CBC, RFC 3602 case #2: plaintext is 0x00 .. 0x1f */
+static const u8 _qcrypto_test_key[AES_KEYSIZE_128] __initconst = {
+	0xc2, 0x86, 0x69, 0x6d, 0x88, 0x7c, 0x9a, 0xa0,
+	0x61, 0x1b, 0xbb, 0x3e, 0x20, 0x25, 0xa4, 0x5a,
+};
+static const u8 _qcrypto_test_iv[AES_BLOCK_SIZE] __initconst = {
+	0x56, 0x2e, 0x17, 0x99, 0x6d, 0x09, 0x3d, 0x28,
+	0xdd, 0xb3, 0xba, 0x69, 0x5a, 0x2e, 0x6f, 0x58,
+};
+static const u8 _qcrypto_test_ct[2 * AES_BLOCK_SIZE] __initconst = {
+	0xd2, 0x96, 0xcd, 0x94, 0xc2, 0xcc, 0xcf, 0x8a,
+	0x3a, 0x86, 0x30, 0x28, 0xb5, 0xe1, 0xdc, 0x0a,
+	0x75, 0x86, 0x60, 0x2d, 0x25, 0x3c, 0xff, 0xf9,
+	0x1b, 0x82, 0x66, 0xbe, 0xa6, 0xd6, 0x1a, 0xb1,
+};
+
+struct _qcrypto_test_result {
+	struct completion completion;
+	int err;
+};
+
+static void _qcrypto_test_done(struct crypto_async_request *req, int err)
+{
+	struct _qcrypto_test_result *res = req->data;
+
+	if (err == -EINPROGRESS)
+		return;
+	res->err = err;
+	complete(&res->completion);
+}
+
+/*
+ * Requests below the threshold must finish in the caller's context.
+ * One that went to the engine is waited for, then counted as a failure.
+ */
+static int __init _qcrypto_test_wait(int ret, struct _qcrypto_test_result *res,
+		int *fail)
+{
+	if (ret != -EINPROGRESS && ret != -EBUSY)
+		return ret;
+	wait_for_completion(&res->completion);
+	INIT_COMPLETION(res->completion);
+	(*fail)++;
+	return res->err;
+}
+
+static int __init _qcrypto_test_ablkcipher(void)
+{
+	struct crypto_ablkcipher *tfm;
+	struct ablkcipher_request *req = NULL;
+	struct qcrypto_cipher_ctx *ctx;
+	struct crypto_stat *pstat;
+	struct _qcrypto_test_result res;
+	struct scatterlist sg;
+	u8 iv[AES_BLOCK_SIZE];
+	unsigned int len = sizeof(_qcrypto_test_ct);
+	u32 nsw;
+	u8 *buf;
+	int fail = 0;
+	int i, ret;
+
+	tfm = crypto_alloc_ablkcipher("qcrypto-cbc-aes", 0, 0);
+	if (IS_ERR(tfm))
+		return 1;
+	ctx = crypto_ablkcipher_ctx(tfm);
+	pstat = &_qcrypto_stat[ctx->cp->pdev->id];
+
+	buf = kmalloc(len, GFP_KERNEL);
+	req = ablkcipher_request_alloc(tfm, GFP_KERNEL);
+	if (!buf || !req ||
+	    crypto_ablkcipher_setkey(tfm, _qcrypto_test_key,
+				     sizeof(_qcrypto_test_key)) ||
+	    !ctx->fallback_ready) {
+		fail++;
+		goto out;
+	}
+
+	init_completion(&res.completion);
+	ablkcipher_request_set_callback(req, CRYPTO_TFM_REQ_MAY_BACKLOG,
+					_qcrypto_test_done, &res);
+	sg_init_one(&sg, buf, len);
+	ablkcipher_request_set_crypt(req, &sg, &sg, len, iv);
+	for (i = 0; i < len; i++)
+		buf[i] = i;
+	memcpy(iv, _qcrypto_test_iv, sizeof(iv));
+	nsw = pstat->ablk_cipher_sw;
+
+	ret = _qcrypto_test_wait(crypto_ablkcipher_encrypt(req), &res, &fail);
+	if (ret || memcmp(buf, _qcrypto_test_ct, len) ||
+	    memcmp(ctx->iv, _qcrypto_test_ct + len - AES_BLOCK_SIZE,
+		   AES_BLOCK_SIZE) ||
+	    memcmp(iv, _qcrypto_test_iv, sizeof(iv)))
+		fail++;
+
+	ret = _qcrypto_test_wait(crypto_ablkcipher_decrypt(req), &res, &fail);
+	if (ret)
+		fail++;
+	for (i = 0; i < len; i++)
+		if (buf[i] != i)
+			fail++;
+	if (pstat->ablk_cipher_sw != nsw + 2)
+		fail++;
+out:
+	ablkcipher_request_free(req);
+	kfree(buf);
+	crypto_free_ablkcipher(tfm);
+	return fail;
+}
+
+static int __init _qcrypto_test_aead_setkey(struct crypto_aead *tfm)
+{
+	struct crypto_authenc_key_param *param;
+	struct rtattr *rta;
+	unsigned int keylen;
+	u8 *key, *p;
+	int ret;
+
+	keylen = RTA_SPACE(sizeof(*param)) + SHA1_DIGEST_SIZE +
+					sizeof(_qcrypto_test_key);
+	key = kzalloc(keylen, GFP_KERNEL);
+	if (!key)
+		return -ENOMEM;
+	rta = (struct rtattr *)key;
+	rta->rta_type = CRYPTO_AUTHENC_KEYA_PARAM;
+	rta->rta_len = RTA_LENGTH(sizeof(*param));
+	param = RTA_DATA(rta);
+	param->enckeylen = cpu_to_be32(sizeof(_qcrypto_test_key));
+	p = key + RTA_SPACE(sizeof(*param));
+	memset(p, 0x0b, SHA1_DIGEST_SIZE);
+	memcpy(p + SHA1_DIGEST_SIZE, _qcrypto_test_key,
+					sizeof(_qcrypto_test_key));
+
+	ret = crypto_aead_setkey(tfm, key, keylen);
+	if (!ret)
+		ret = crypto_aead_setauthsize(tfm, QCRYPTO_TEST_AUTHSIZE);
+	kfree(key);
+	return ret;
+}
+
+/*
+ * Check that the fallback subrequest and its own ctx fit inside the
+ * request we advertise, by running a request allocated with exactly
+ * that size plus a guard area, and compare its output against a
+ * software authenc transform.
+ */
+static int __init _qcrypto_test_aead(void)
+{
+	struct crypto_aead *tfm, *ref;
+	struct aead_request *req = NULL, *refreq = NULL, *subreq;
+	struct qcrypto_cipher_ctx *ctx;
+	struct crypto_stat *pstat;
+	struct _qcrypto_test_result res;
+	struct scatterlist sg, refsg, asg;
+	unsigned int reqsize;
+	u8 iv[AES_BLOCK_SIZE], refiv[AES_BLOCK_SIZE];
+	u8 *buf = NULL, *refbuf = NULL, *assoc = NULL, *guard;
+	unsigned int len = QCRYPTO_TEST_LEN + QCRYPTO_TEST_AUTHSIZE;
+	u32 nsw;
+	int fail = 0;
+	int i, ret;
+
+	tfm = crypto_alloc_aead("qcrypto-aead-hmac-sha1-cbc-aes", 0, 0);
+	if (IS_ERR(tfm))
+		return 1;
+	ref = crypto_alloc_aead("authenc(hmac(sha1),cbc(aes))", 0,
+				CRYPTO_ALG_ASYNC);
+	if (IS_ERR(ref)) {
+		crypto_free_aead(tfm);
+		return 1;
+	}
+	ctx = crypto_aead_ctx(tfm);
+	pstat = &_qcrypto_stat[ctx->cp->pdev->id];
+	if (!ctx->fallback_aead) {
+		fail++;
+		goto out;
+	}
+
+	reqsize = sizeof(struct aead_request) + crypto_aead_reqsize(tfm);
+	req = kzalloc(reqsize + QCRYPTO_TEST_GUARD, GFP_KERNEL);
+	refreq = aead_request_alloc(ref, GFP_KERNEL);
+	buf = kmalloc(len, GFP_KERNEL);
+	refbuf = kmalloc(len, GFP_KERNEL);
+	assoc = kmalloc(QCRYPTO_TEST_ASSOC, GFP_KERNEL);
+	if (!req || !refreq || !buf || !refbuf || !assoc ||
+	    _qcrypto_test_aead_setkey(tfm) || _qcrypto_test_aead_setkey(ref) ||
+	    !ctx->fallback_ready) {
+		fail++;
+		goto out;
+	}
+	guard = (u8 *)req + reqsize;
+	memset(guard, 0xa5, QCRYPTO_TEST_GUARD);
+
+	aead_request_set_tfm(req, tfm);
+	subreq = _qcrypto_fallback_subreq(aead_request_ctx(req));
+	if ((u8 *)(subreq + 1) + crypto_aead_reqsize(ctx->fallback_aead) >
+	    guard)
+		fail++;
+
+	init_completion(&res.completion);
+	aead_request_set_callback(req, CRYPTO_TFM_REQ_MAY_BACKLOG,
+					_qcrypto_test_done, &res);
+	aead_request_set_callback(refreq, 0, NULL, NULL);
+	for (i = 0; i < QCRYPTO_TEST_ASSOC; i++)
+		assoc[i] = 0xa0 + i;
+	for (i = 0; i < QCRYPTO_TEST_LEN; i++)
+		buf[i] = refbuf[i] = i;
+	memcpy(iv, _qcrypto_test_iv, sizeof(iv));
+	memcpy(refiv, _qcrypto_test_iv, sizeof(refiv));
+	sg_init_one(&asg, assoc, QCRYPTO_TEST_ASSOC);
+	sg_init_one(&sg, buf, len);
+	sg_init_one(&refsg, refbuf, len);
+	aead_request_set_assoc(req, &asg, QCRYPTO_TEST_ASSOC);
+	aead_request_set_assoc(refreq, &asg, QCRYPTO_TEST_ASSOC);
+	aead_request_set_crypt(req, &sg, &sg, QCRYPTO_TEST_LEN, iv);
+	aead_request_set_crypt(refreq, &refsg, &refsg, QCRYPTO_TEST_LEN,
+					refiv);
+	nsw = pstat->aead_sw;
+
+	ret = _qcrypto_test_wait(crypto_aead_encrypt(req), &res, &fail);
+	if (ret || crypto_aead_encrypt(refreq) || memcmp(buf, refbuf, len))
+		fail++;
+
+	aead_request_set_crypt(req, &sg, &sg, len, iv);
+	memcpy(iv, _qcrypto_test_iv, sizeof(iv));
+	ret = _qcrypto_test_wait(crypto_aead_decrypt(req), &res, &fail);
+	if (ret)
+		fail++;
+	for (i = 0; i < QCRYPTO_TEST_LEN; i++)
+		if (buf[i] != i)
+			fail++;
+
+	/* a corrupted tag must be rejected */
+	memcpy(buf, refbuf, len);
+	buf[len - 1] ^= 1;
+	memcpy(iv, _qcrypto_test_iv, sizeof(iv));
+	ret = _qcrypto_test_wait(crypto_aead_decrypt(req), &res, &fail);
+	if (ret != -EBADMSG)
+		fail++;
+
+	if (pstat->aead_sw != nsw + 3)
+		fail++;
+	for (i = 0; i < QCRYPTO_TEST_GUARD; i++)
+		if (guard[i] != 0xa5)
+			fail++;
+out:
+	kfree(assoc);
+	kfree(refbuf);
+	kfree(buf);
+	aead_request_free(refreq);
+	kfree(req);
+	crypto_free_aead(ref);
+	crypto_free_aead(tfm);
+	return fail;
+}
+
+/*
+ * Run small cipher and AEAD requests, which must take the software
+ * path below sw_threshold, against known answers.
+ */
+static void __init _qcrypto_selftest(void)
+{
+	unsigned int threshold = _qcrypto_sw_threshold;
+	int ablk_fail, aead_fail;
+
+	/* the largest test request is an AEAD decrypt, tag included */
+	if (threshold <= QCRYPTO_TEST_LEN + QCRYPTO_TEST_AUTHSIZE +
+			 QCRYPTO_TEST_ASSOC)
+		_qcrypto_sw_threshold = QCRYPTO_TEST_LEN +
+				QCRYPTO_TEST_AUTHSIZE + QCRYPTO_TEST_ASSOC + 1;
+	ablk_fail = _qcrypto_test_ablkcipher();
+	aead_fail = _qcrypto_test_aead();
+	_qcrypto_sw_threshold = threshold;
+
+	pr_info("qcrypto: self-test %s (ablkcipher %d, aead %d failures)\n",
+		ablk_fail || aead_fail ? "FAILED" : "passed",
+		ablk_fail, aead_fail);
+}
+#else
+static inline void _qcrypto_selftest(void)
+{
+}
+#endif /* CONFIG_CRYPTO_DEV_QCRYPTO_SELFTEST */
+
 static int __init _qcrypto_init(void)
 {
 	int rc;
@@ -3343,7 +3918,12 @@ static int __init _qcrypto_init(void)
 	if (rc)
 		return rc;
 
-	return platform_driver_register(&_qualcomm_crypto);
+	rc = platform_driver_register(&_qualcomm_crypto);
+	if (rc)
+		return rc;
+
+	_qcrypto_selftest();
+	return 0;
 }
 
 static void __exit _qcrypto_exit(void)
@@ -1006,15 +1006,14 @@ const struct kgsl_memdesc *adreno_find_region(struct kgsl_device *device,
 	list_for_each_entry(priv, &kgsl_driver.process_list, list) {
 		if (!kgsl_mmu_pt_equal(priv->pagetable, pt_base))
 			continue;
-		spin_lock(&priv->mem_lock);
 		entry = kgsl_sharedmem_find_region(priv, gpuaddr, size);
 		if (entry) {
+			/* hang dumps only peek, no reference is kept */
 			result = &entry->memdesc;
-			spin_unlock(&priv->mem_lock);
+			kgsl_mem_entry_put(entry);
 			mutex_unlock(&kgsl_driver.process_mutex);
 			return result;
 		}
-		spin_unlock(&priv->mem_lock);
 	}
 	mutex_unlock(&kgsl_driver.process_mutex);
 
@@ -1197,7 +1196,7 @@ static int adreno_waittimestamp(struct kgsl_device *device,
 			 * will not be generated and thus the timestamp
 			 * work needs to be queued.
 			 */
-			queue_work(device->work_queue, &device->ts_expired_ws);
+			kgsl_signal_events(device);
 			status = 0;
 			goto done;
 		}
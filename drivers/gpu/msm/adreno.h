@@ -35,6 +35,8 @@
 
 #ifdef CONFIG_MSM_SCM
 #define ADRENO_DEFAULT_PWRSCALE_POLICY  (&kgsl_pwrscale_policy_tz)
+#elif defined(CONFIG_MSM_KGSL_PWRSCALE_DCVS)
+#define ADRENO_DEFAULT_PWRSCALE_POLICY  (&kgsl_pwrscale_policy_dcvs)
 #else
 #define ADRENO_DEFAULT_PWRSCALE_POLICY  NULL
 #endif
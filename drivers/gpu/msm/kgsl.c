@@ -88,22 +88,24 @@ static int kgsl_add_event(struct kgsl_device *device, u32 ts,
 	event->func = cb;
 	event->owner = owner;
 
-	/* Add the event in order to the list */
+	/*
+	 * Add the event in order to the list.  New events are almost always
+	 * for the newest timestamp, so look for the spot from the tail.
+	 */
 
-	for (n = device->events.next ; n != &device->events; n = n->next) {
+	spin_lock(&device->events_lock);
+	for (n = device->events.prev; n != &device->events; n = n->prev) {
 		struct kgsl_event *e =
 			list_entry(n, struct kgsl_event, list);
 
-		if (timestamp_cmp(e->timestamp, ts) > 0) {
-			list_add(&event->list, n->prev);
+		if (timestamp_cmp(e->timestamp, ts) <= 0)
 			break;
-		}
 	}
+	list_add(&event->list, n);
+	spin_unlock(&device->events_lock);
 
-	if (n == &device->events)
-		list_add_tail(&event->list, &device->events);
-
-	queue_work(device->work_queue, &device->ts_expired_ws);
+	/* the timestamp may have retired since it was read above */
+	kgsl_signal_events(device);
 	return 0;
 }
 
@@ -119,10 +121,22 @@ static void kgsl_cancel_events(struct kgsl_device *device,
 	struct kgsl_event *event, *event_tmp;
 	unsigned int cur = device->ftbl->readtimestamp(device,
 		KGSL_TIMESTAMP_RETIRED);
+	LIST_HEAD(cancelled);
 
+	spin_lock(&device->events_lock);
 	list_for_each_entry_safe(event, event_tmp, &device->events, list) {
-		if (event->owner != owner)
-			continue;
+		if (event->owner == owner)
+			list_move_tail(&event->list, &cancelled);
+	}
+	spin_unlock(&device->events_lock);
+
+	/*
+	 * A batch of expired events for this owner may still be running
+	 * its callbacks, let it finish before the owner goes away.
+	 */
+	flush_work(&device->ts_expired_ws);
+
+	list_for_each_entry_safe(event, event_tmp, &cancelled, list) {
 		/*
 		 * "cancel" the events by calling their callback.
 		 * Currently, events are used for lock and memory
@@ -144,8 +158,10 @@ kgsl_mem_entry_create(void)
 
 	if (!entry)
 		KGSL_CORE_ERR("kzalloc(%d) failed\n", sizeof(*entry));
-	else
+	else {
 		kref_init(&entry->refcount);
+		RB_CLEAR_NODE(&entry->node);
+	}
 
 	return entry;
 }
@@ -157,7 +173,8 @@ kgsl_mem_entry_destroy(struct kref *kref)
 						    struct kgsl_mem_entry,
 						    refcount);
 
-	entry->priv->stats[entry->memtype].cur -= entry->memdesc.size;
+	kgsl_process_sub_stats(entry->priv, entry->memtype,
+			       entry->memdesc.size);
 
 	if (entry->memtype != KGSL_MEM_ENTRY_KERNEL)
 		kgsl_driver.stats.mapped -= entry->memdesc.size;
@@ -190,15 +207,103 @@ kgsl_mem_entry_destroy(struct kref *kref)
 }
 EXPORT_SYMBOL(kgsl_mem_entry_destroy);
 
+/*
+ * The per process memory entries live in an interval tree: an rbtree
+ * ordered by gpuaddr where every node also caches the highest end
+ * address found in its subtree, so that a containing region can be found
+ * without visiting subtrees that end too early.  Regions normally do not
+ * overlap, but with the MMU off the same physical buffer can be mapped
+ * twice, so equal keys are allowed.
+ */
+static void kgsl_mem_rb_augment_cb(struct rb_node *node, void *unused)
+{
+	struct kgsl_mem_entry *entry, *child;
+	unsigned int end;
+
+	if (!node)
+		return;
+
+	entry = rb_entry(node, struct kgsl_mem_entry, node);
+	end = entry->memdesc.gpuaddr + entry->memdesc.size;
+
+	if (node->rb_left) {
+		child = rb_entry(node->rb_left, struct kgsl_mem_entry, node);
+		end = max(end, child->subtree_end);
+	}
+	if (node->rb_right) {
+		child = rb_entry(node->rb_right, struct kgsl_mem_entry, node);
+		end = max(end, child->subtree_end);
+	}
+	entry->subtree_end = end;
+}
+
+/* call with process->mem_lock held */
+static void __kgsl_mem_entry_attach(struct kgsl_process_private *process,
+				    struct kgsl_mem_entry *entry)
+{
+	struct rb_node **p = &process->mem_rb.rb_node;
+	struct rb_node *parent = NULL;
+	struct kgsl_mem_entry *tmp;
+
+	while (*p) {
+		parent = *p;
+		tmp = rb_entry(parent, struct kgsl_mem_entry, node);
+		if (entry->memdesc.gpuaddr < tmp->memdesc.gpuaddr)
+			p = &parent->rb_left;
+		else
+			p = &parent->rb_right;
+	}
+
+	rb_link_node(&entry->node, parent, p);
+	rb_insert_color(&entry->node, &process->mem_rb);
+	rb_augment_insert(&entry->node, kgsl_mem_rb_augment_cb, NULL);
+}
+
+/*
+ * call with process->mem_lock held. Returns 1 if the entry was removed,
+ * 0 if somebody else got there first.
+ */
+static int __kgsl_mem_entry_detach(struct kgsl_process_private *process,
+				   struct kgsl_mem_entry *entry)
+{
+	struct rb_node *deepest;
+
+	if (RB_EMPTY_NODE(&entry->node))
+		return 0;
+
+	deepest = rb_augment_erase_begin(&entry->node);
+	rb_erase(&entry->node, &process->mem_rb);
+	rb_augment_erase_end(deepest, kgsl_mem_rb_augment_cb, NULL);
+	RB_CLEAR_NODE(&entry->node);
+	return 1;
+}
+
 static
 void kgsl_mem_entry_attach_process(struct kgsl_mem_entry *entry,
 				   struct kgsl_process_private *process)
 {
+	entry->priv = process;
+
 	spin_lock(&process->mem_lock);
-	list_add(&entry->list, &process->mem_list);
+	__kgsl_mem_entry_attach(process, entry);
 	spin_unlock(&process->mem_lock);
+}
 
-	entry->priv = process;
+/*
+ * Remove the entry from its process and drop the reference the process
+ * held.  Safe against a concurrent detach of the same entry.
+ */
+static void kgsl_mem_entry_detach_process(struct kgsl_mem_entry *entry)
+{
+	struct kgsl_process_private *process = entry->priv;
+	int detached;
+
+	spin_lock(&process->mem_lock);
+	detached = __kgsl_mem_entry_detach(process, entry);
+	spin_unlock(&process->mem_lock);
+
+	if (detached)
+		kgsl_mem_entry_put(entry);
 }
 
 /* Allocate a new context id */
@@ -262,27 +367,46 @@ static void kgsl_timestamp_expired(struct work_struct *work)
 	struct kgsl_device *device = container_of(work, struct kgsl_device,
 		ts_expired_ws);
 	struct kgsl_event *event, *event_tmp;
+	struct list_head *last = NULL;
 	uint32_t ts_processed;
+	LIST_HEAD(expired);
+	s64 latency;
 
-	mutex_lock(&device->mutex);
-
-	/* get current EOP timestamp */
+	/*
+	 * get current EOP timestamp.  The retired timestamp comes from the
+	 * memstore, so neither device->mutex nor a powered core is needed.
+	 */
 	ts_processed = device->ftbl->readtimestamp(device,
 		KGSL_TIMESTAMP_RETIRED);
 
-	/* Process expired events */
-	list_for_each_entry_safe(event, event_tmp, &device->events, list) {
+	/* Take all expired events off the list in one go */
+	spin_lock(&device->events_lock);
+	list_for_each_entry(event, &device->events, list) {
 		if (timestamp_cmp(ts_processed, event->timestamp) < 0)
 			break;
+		last = &event->list;
+	}
+	if (last)
+		list_cut_position(&expired, &device->events, last);
+	spin_unlock(&device->events_lock);
+
+	if (last == NULL)
+		return;
 
+	latency = ktime_to_ns(ktime_sub(ktime_get(), device->events_signaled));
+	device->event_stats.batches++;
+	device->event_stats.latency_total += latency;
+	if (latency > device->event_stats.latency_max)
+		device->event_stats.latency_max = latency;
+
+	/* and run the callbacks without any lock held */
+	list_for_each_entry_safe(event, event_tmp, &expired, list) {
 		if (event->func)
 			event->func(device, event->priv, ts_processed);
 
-		list_del(&event->list);
 		kfree(event);
+		device->event_stats.callbacks++;
 	}
-
-	mutex_unlock(&device->mutex);
 }
 
 static void kgsl_check_idle_locked(struct kgsl_device *device)
@@ -549,7 +673,7 @@ kgsl_get_process_private(struct kgsl_device_private *cur_dev_priv)
 	private->refcnt = 1;
 	private->pid = task_tgid_nr(current);
 
-	INIT_LIST_HEAD(&private->mem_list);
+	private->mem_rb = RB_ROOT;
 
 	if (kgsl_mmu_enabled())
 	{
@@ -577,8 +701,8 @@ static void
 kgsl_put_process_private(struct kgsl_device *device,
 			 struct kgsl_process_private *private)
 {
-	struct kgsl_mem_entry *entry = NULL;
-	struct kgsl_mem_entry *entry_tmp = NULL;
+	struct kgsl_mem_entry *entry;
+	struct rb_node *node;
 
 	if (!private)
 		return;
@@ -592,9 +716,9 @@ kgsl_put_process_private(struct kgsl_device *device,
 
 	list_del(&private->list);
 
-	list_for_each_entry_safe(entry, entry_tmp, &private->mem_list, list) {
-		list_del(&entry->list);
-		kgsl_mem_entry_put(entry);
+	while ((node = rb_first(&private->mem_rb))) {
+		entry = rb_entry(node, struct kgsl_mem_entry, node);
+		kgsl_mem_entry_detach_process(entry);
 	}
 
 	kgsl_mmu_putpagetable(private->pagetable);
@@ -725,41 +849,107 @@ err_pmruntime:
 
 /*call with private->mem_lock locked */
 static struct kgsl_mem_entry *
+__kgsl_sharedmem_find(struct kgsl_process_private *private,
+		      unsigned int gpuaddr)
+{
+	struct rb_node *node = private->mem_rb.rb_node;
+	struct kgsl_mem_entry *entry;
+
+	while (node) {
+		entry = rb_entry(node, struct kgsl_mem_entry, node);
+		if (gpuaddr < entry->memdesc.gpuaddr)
+			node = node->rb_left;
+		else if (gpuaddr > entry->memdesc.gpuaddr)
+			node = node->rb_right;
+		else
+			return entry;
+	}
+	return NULL;
+}
+
+/*
+ * Find an entry in the subtree at @node that contains [start, end).  The
+ * left subtree is only searched if something in it ends late enough and
+ * the right one only if this node does not already start past @start, so
+ * for non overlapping regions this is a single root to leaf walk.
+ */
+static struct kgsl_mem_entry *
+__kgsl_sharedmem_find_region(struct rb_node *node, unsigned int start,
+			     unsigned int end)
+{
+	struct kgsl_mem_entry *entry, *found;
+
+	while (node) {
+		entry = rb_entry(node, struct kgsl_mem_entry, node);
+		if (entry->subtree_end < end)
+			return NULL;
+
+		if (node->rb_left) {
+			found = __kgsl_sharedmem_find_region(node->rb_left,
+							     start, end);
+			if (found)
+				return found;
+		}
+
+		if (entry->memdesc.gpuaddr > start)
+			return NULL;
+		if (kgsl_gpuaddr_in_memdesc(&entry->memdesc, start,
+					    end - start))
+			return entry;
+
+		node = node->rb_right;
+	}
+	return NULL;
+}
+
+/*
+ * Look up the entry starting at gpuaddr.  On success a reference is taken
+ * which the caller must release with kgsl_mem_entry_put().
+ */
+static struct kgsl_mem_entry *
 kgsl_sharedmem_find(struct kgsl_process_private *private, unsigned int gpuaddr)
 {
-	struct kgsl_mem_entry *entry = NULL, *result = NULL;
+	struct kgsl_mem_entry *entry;
 
 	BUG_ON(private == NULL);
 
 	gpuaddr &= PAGE_MASK;
 
-	list_for_each_entry(entry, &private->mem_list, list) {
-		if (entry->memdesc.gpuaddr == gpuaddr) {
-			result = entry;
-			break;
-		}
-	}
-	return result;
+	spin_lock(&private->mem_lock);
+	entry = __kgsl_sharedmem_find(private, gpuaddr);
+	if (entry)
+		kgsl_mem_entry_get(entry);
+	spin_unlock(&private->mem_lock);
+
+	return entry;
 }
 
-/*call with private->mem_lock locked */
+/*
+ * Look up the entry containing [gpuaddr, gpuaddr + size).  On success a
+ * reference is taken which the caller must release with
+ * kgsl_mem_entry_put(), so the result stays valid without holding
+ * mem_lock or the device mutex.
+ */
 struct kgsl_mem_entry *
 kgsl_sharedmem_find_region(struct kgsl_process_private *private,
 				unsigned int gpuaddr,
 				size_t size)
 {
-	struct kgsl_mem_entry *entry = NULL, *result = NULL;
+	struct kgsl_mem_entry *entry;
 
 	BUG_ON(private == NULL);
 
-	list_for_each_entry(entry, &private->mem_list, list) {
-		if (kgsl_gpuaddr_in_memdesc(&entry->memdesc, gpuaddr, size)) {
-			result = entry;
-			break;
-		}
-	}
+	if (gpuaddr + size < gpuaddr)
+		return NULL;
 
-	return result;
+	spin_lock(&private->mem_lock);
+	entry = __kgsl_sharedmem_find_region(private->mem_rb.rb_node,
+					     gpuaddr, gpuaddr + size);
+	if (entry)
+		kgsl_mem_entry_get(entry);
+	spin_unlock(&private->mem_lock);
+
+	return entry;
 }
 EXPORT_SYMBOL(kgsl_sharedmem_find_region);
 
@@ -869,10 +1059,8 @@ static bool check_ibdesc(struct kgsl_device_private *dev_priv,
 	unsigned int i;
 	for (i = 0; i < numibs; i++) {
 		struct kgsl_mem_entry *entry;
-		spin_lock(&dev_priv->process_priv->mem_lock);
 		entry = kgsl_sharedmem_find_region(dev_priv->process_priv,
 			ibdesc[i].gpuaddr, ibdesc[i].sizedwords * sizeof(uint));
-		spin_unlock(&dev_priv->process_priv->mem_lock);
 		if (entry == NULL) {
 			KGSL_DRV_ERR(dev_priv->device,
 				"invalid cmd buffer gpuaddr %08x " \
@@ -890,8 +1078,10 @@ static bool check_ibdesc(struct kgsl_device_private *dev_priv,
 				ibdesc[i].gpuaddr,
 				ibdesc[i].sizedwords, i+1, numibs);
 			result = false;
-			break;
 		}
+		kgsl_mem_entry_put(entry);
+		if (!result)
+			break;
 	}
 	return result;
 }
@@ -1021,9 +1211,9 @@ static void kgsl_freemem_event_cb(struct kgsl_device *device,
 	void *priv, u32 timestamp)
 {
 	struct kgsl_mem_entry *entry = priv;
-	spin_lock(&entry->priv->mem_lock);
-	list_del(&entry->list);
-	spin_unlock(&entry->priv->mem_lock);
+
+	kgsl_mem_entry_detach_process(entry);
+	/* and the reference taken by the lookup in the ioctl */
 	kgsl_mem_entry_put(entry);
 }
 
@@ -1035,13 +1225,13 @@ static long kgsl_ioctl_cmdstream_freememontimestamp(struct kgsl_device_private
 	struct kgsl_cmdstream_freememontimestamp *param = data;
 	struct kgsl_mem_entry *entry = NULL;
 
-	spin_lock(&dev_priv->process_priv->mem_lock);
 	entry = kgsl_sharedmem_find(dev_priv->process_priv, param->gpuaddr);
-	spin_unlock(&dev_priv->process_priv->mem_lock);
 
 	if (entry) {
 		result = kgsl_add_event(dev_priv->device, param->timestamp,
 					kgsl_freemem_event_cb, entry, dev_priv);
+		if (result)
+			kgsl_mem_entry_put(entry);
 	} else {
 		KGSL_DRV_ERR(dev_priv->device,
 			"invalid gpuaddr %08x\n", param->gpuaddr);
@@ -1111,13 +1301,10 @@ static long kgsl_ioctl_sharedmem_free(struct kgsl_device_private *dev_priv,
 	struct kgsl_process_private *private = dev_priv->process_priv;
 	struct kgsl_mem_entry *entry = NULL;
 
-	spin_lock(&private->mem_lock);
 	entry = kgsl_sharedmem_find(private, param->gpuaddr);
-	if (entry)
-		list_del(&entry->list);
-	spin_unlock(&private->mem_lock);
 
 	if (entry) {
+		kgsl_mem_entry_detach_process(entry);
 		kgsl_mem_entry_put(entry);
 	} else {
 		KGSL_CORE_ERR("invalid gpuaddr %08x\n", param->gpuaddr);
@@ -1677,12 +1864,10 @@ kgsl_ioctl_sharedmem_flush_cache(struct kgsl_device_private *dev_priv,
 	struct kgsl_sharedmem_free *param = data;
 	struct kgsl_process_private *private = dev_priv->process_priv;
 
-	spin_lock(&private->mem_lock);
 	entry = kgsl_sharedmem_find(private, param->gpuaddr);
 	if (!entry) {
 		KGSL_CORE_ERR("invalid gpuaddr %08x\n", param->gpuaddr);
-		result = -EINVAL;
-		goto done;
+		return -EINVAL;
 	}
 	if (!entry->memdesc.hostptr) {
 		KGSL_CORE_ERR("invalid hostptr with gpuaddr %08x\n",
@@ -1692,7 +1877,7 @@ kgsl_ioctl_sharedmem_flush_cache(struct kgsl_device_private *dev_priv,
 
 	kgsl_cache_range_op(&entry->memdesc, KGSL_CACHE_OP_CLEAN);
 done:
-	spin_unlock(&private->mem_lock);
+	kgsl_mem_entry_put(entry);
 	return result;
 }
 
@@ -1732,14 +1917,13 @@ static long kgsl_ioctl_cff_syncmem(struct kgsl_device_private *dev_priv,
 	struct kgsl_process_private *private = dev_priv->process_priv;
 	struct kgsl_mem_entry *entry = NULL;
 
-	spin_lock(&private->mem_lock);
 	entry = kgsl_sharedmem_find_region(private, param->gpuaddr, param->len);
-	if (entry)
+	if (entry) {
 		kgsl_cffdump_syncmem(dev_priv, &entry->memdesc, param->gpuaddr,
 				     param->len, true);
-	else
+		kgsl_mem_entry_put(entry);
+	} else
 		result = -EINVAL;
-	spin_unlock(&private->mem_lock);
 	return result;
 }
 
@@ -1888,7 +2072,7 @@ static const struct {
 	KGSL_IOCTL_FUNC(IOCTL_KGSL_CMDSTREAM_READTIMESTAMP,
 			kgsl_ioctl_cmdstream_readtimestamp, 1),
 	KGSL_IOCTL_FUNC(IOCTL_KGSL_CMDSTREAM_FREEMEMONTIMESTAMP,
-			kgsl_ioctl_cmdstream_freememontimestamp, 1),
+			kgsl_ioctl_cmdstream_freememontimestamp, 0),
 	KGSL_IOCTL_FUNC(IOCTL_KGSL_DRAWCTXT_CREATE,
 			kgsl_ioctl_drawctxt_create, 1),
 	KGSL_IOCTL_FUNC(IOCTL_KGSL_DRAWCTXT_DESTROY,
@@ -1910,7 +2094,7 @@ static const struct {
 	KGSL_IOCTL_FUNC(IOCTL_KGSL_CFF_USER_EVENT,
 			kgsl_ioctl_cff_user_event, 0),
 	KGSL_IOCTL_FUNC(IOCTL_KGSL_TIMESTAMP_EVENT,
-			kgsl_ioctl_timestamp_event, 1),
+			kgsl_ioctl_timestamp_event, 0),
 };
 
 static long kgsl_ioctl(struct file *filep, unsigned int cmd, unsigned long arg)
@@ -2063,7 +2247,7 @@ static int kgsl_mmap(struct file *file, struct vm_area_struct *vma)
 	unsigned long vma_offset = vma->vm_pgoff << PAGE_SHIFT;
 	struct kgsl_device_private *dev_priv = file->private_data;
 	struct kgsl_process_private *private = dev_priv->process_priv;
-	struct kgsl_mem_entry *tmp, *entry = NULL;
+	struct kgsl_mem_entry *entry = NULL;
 	struct kgsl_device *device = dev_priv->device;
 
 	/* Handle leagacy behavior for memstore */
@@ -2073,23 +2257,17 @@ static int kgsl_mmap(struct file *file, struct vm_area_struct *vma)
 
 	/* Find a chunk of GPU memory */
 
-	spin_lock(&private->mem_lock);
-	list_for_each_entry(tmp, &private->mem_list, list) {
-		if (vma_offset == tmp->memdesc.gpuaddr) {
-			kgsl_mem_entry_get(tmp);
-			entry = tmp;
-			break;
-		}
-	}
-	spin_unlock(&private->mem_lock);
+	entry = kgsl_sharedmem_find(private, vma_offset);
 
 	if (entry == NULL)
 		return -EINVAL;
 
 	if (!entry->memdesc.ops ||
 		!entry->memdesc.ops->vmflags ||
-		!entry->memdesc.ops->vmfault)
+		!entry->memdesc.ops->vmfault) {
+		kgsl_mem_entry_put(entry);
 		return -EINVAL;
+	}
 
 	vma->vm_flags |= entry->memdesc.ops->vmflags(&entry->memdesc);
 
@@ -2216,6 +2394,7 @@ kgsl_register_device(struct kgsl_device *device)
 	INIT_WORK(&device->idle_check_ws, kgsl_idle_check);
 	INIT_WORK(&device->ts_expired_ws, kgsl_timestamp_expired);
 
+	spin_lock_init(&device->events_lock);
 	INIT_LIST_HEAD(&device->events);
 
 	ret = kgsl_mmu_init(device);
@@ -2389,11 +2568,138 @@ static void kgsl_core_exit(void)
 	kgsl_cffdump_destroy();
 	kgsl_core_debugfs_close();
 	kgsl_sharedmem_uninit_sysfs();
+	kgsl_page_pool_exit();
+}
+
+#ifdef CONFIG_MSM_KGSL_MEM_SELFTEST
+#define KGSL_MEM_TEST_ENTRIES	4096
+#define KGSL_MEM_TEST_STRIDE	0x10000
+
+/*
+ * Build a process memory tree of fake entries in scrambled order, check
+ * hits, misses, overlapping regions and removal, and report the cost of
+ * a lookup.  The entries have no backing memory so they are freed
+ * directly rather than through kgsl_mem_entry_put().
+ */
+static int __init kgsl_mem_selftest(void)
+{
+	struct kgsl_process_private *private;
+	struct kgsl_mem_entry **entries, *entry, *big = NULL;
+	unsigned int i, j, gpuaddr;
+	int ret = -ENOMEM;
+	ktime_t t;
+	s64 ns = 0;
+
+	private = kzalloc(sizeof(*private), GFP_KERNEL);
+	entries = vzalloc(KGSL_MEM_TEST_ENTRIES * sizeof(*entries));
+	if (!private || !entries)
+		goto out;
+	spin_lock_init(&private->mem_lock);
+	private->mem_rb = RB_ROOT;
+
+	for (i = 0; i < KGSL_MEM_TEST_ENTRIES; i++) {
+		/* 2647 is coprime to the entry count, so j visits them all */
+		j = (i * 2647) % KGSL_MEM_TEST_ENTRIES;
+		entry = kgsl_mem_entry_create();
+		if (!entry)
+			goto out_free;
+		entry->memdesc.gpuaddr = 0x10000000 + j * KGSL_MEM_TEST_STRIDE;
+		entry->memdesc.size = PAGE_SIZE << (j & 3);
+		entries[j] = entry;
+		kgsl_mem_entry_attach_process(entry, private);
+	}
+
+	ret = -EINVAL;
+	t = ktime_get();
+	for (i = 0; i < KGSL_MEM_TEST_ENTRIES; i++) {
+		gpuaddr = entries[i]->memdesc.gpuaddr +
+			entries[i]->memdesc.size / 2;
+		entry = kgsl_sharedmem_find_region(private, gpuaddr, 4);
+		if (entry != entries[i])
+			goto out_fail;
+		kgsl_mem_entry_put(entry);
+	}
+	ns = ktime_to_ns(ktime_sub(ktime_get(), t));
+
+	for (i = 0; i < KGSL_MEM_TEST_ENTRIES; i++) {
+		gpuaddr = entries[i]->memdesc.gpuaddr;
+		entry = kgsl_sharedmem_find(private, gpuaddr);
+		if (entry != entries[i])
+			goto out_fail;
+		kgsl_mem_entry_put(entry);
+		/* the gap after every region, and a range running into it */
+		if (kgsl_sharedmem_find_region(private,
+				gpuaddr + KGSL_MEM_TEST_STRIDE / 2, 4) ||
+		    kgsl_sharedmem_find_region(private, gpuaddr,
+				entries[i]->memdesc.size + 4))
+			goto out_fail;
+	}
+
+	/* an overlapping region starting at the same address */
+	big = kgsl_mem_entry_create();
+	if (!big)
+		goto out_free;
+	big->memdesc.gpuaddr = entries[0]->memdesc.gpuaddr;
+	big->memdesc.size = KGSL_MEM_TEST_STRIDE;
+	kgsl_mem_entry_attach_process(big, private);
+	entry = kgsl_sharedmem_find_region(private,
+		big->memdesc.gpuaddr + KGSL_MEM_TEST_STRIDE / 2, 4);
+	if (entry != big)
+		goto out_fail;
+	kgsl_mem_entry_put(entry);
+
+	/* remove every other entry */
+	spin_lock(&private->mem_lock);
+	for (i = 0; i < KGSL_MEM_TEST_ENTRIES; i += 2)
+		__kgsl_mem_entry_detach(private, entries[i]);
+	spin_unlock(&private->mem_lock);
+	for (i = 0; i < KGSL_MEM_TEST_ENTRIES; i++) {
+		entry = kgsl_sharedmem_find_region(private,
+			entries[i]->memdesc.gpuaddr, 4);
+		if (entry)
+			kgsl_mem_entry_put(entry);
+		if (entry != ((i & 1) ? entries[i] : (i ? NULL : big)))
+			goto out_fail;
+	}
+	ret = 0;
+
+out_fail:
+	if (ret)
+		KGSL_CORE_ERR("memory tree self-test failed at entry %u\n", i);
+	else
+		pr_info("kgsl: memory tree self-test passed, %d entries, "
+			"%lld ns per lookup\n", KGSL_MEM_TEST_ENTRIES,
+			div_s64(ns, KGSL_MEM_TEST_ENTRIES));
+out_free:
+	spin_lock(&private->mem_lock);
+	while (private->mem_rb.rb_node) {
+		entry = rb_entry(private->mem_rb.rb_node,
+				 struct kgsl_mem_entry, node);
+		__kgsl_mem_entry_detach(private, entry);
+	}
+	spin_unlock(&private->mem_lock);
+	for (i = 0; i < KGSL_MEM_TEST_ENTRIES; i++)
+		kfree(entries[i]);
+	kfree(big);
+out:
+	vfree(entries);
+	kfree(private);
+	return ret;
 }
+#else
+static inline int kgsl_mem_selftest(void)
+{
+	return 0;
+}
+#endif
 
 static int __init kgsl_core_init(void)
 {
 	int result = 0;
+
+	/* first, as every error path ends in kgsl_core_exit() */
+	kgsl_page_pool_init();
+
 	/* alloc major and minor device numbers */
 	result = alloc_chrdev_region(&kgsl_driver.major, 0, KGSL_DEVICE_MAX,
 				  KGSL_NAME);
@@ -2464,6 +2770,11 @@ static int __init kgsl_core_init(void)
 	if (result)
 		goto err;
 
+	kgsl_mem_selftest();
+	kgsl_page_pool_selftest();
+	if (KGSL_MMU_TYPE_GPU == kgsl_mmu_get_mmutype())
+		kgsl_gpummu_selftest();
+
 	return 0;
 
 err:
@@ -20,6 +20,7 @@
 #include <linux/interrupt.h>
 #include <linux/mutex.h>
 #include <linux/cdev.h>
+#include <linux/rbtree.h>
 #include <linux/regulator/consumer.h>
 
 #define KGSL_NAME "kgsl"
@@ -95,6 +96,7 @@ struct kgsl_driver {
 		unsigned int coherent_max;
 		unsigned int mapped;
 		unsigned int mapped_max;
+		unsigned int page_pool;
 		unsigned int histogram[16];
 	} stats;
 };
@@ -115,6 +117,11 @@ struct kgsl_memdesc {
 	struct scatterlist *sg;
 	unsigned int sglen;
 	struct kgsl_memdesc_ops *ops;
+	/*
+	 * Optional bitmap, one bit per page, of pages the CPU may have
+	 * written.  When present a cache clean only covers those pages.
+	 */
+	unsigned long *dirty;
 };
 
 /* List of different memory entry types */
@@ -131,7 +138,10 @@ struct kgsl_mem_entry {
 	struct kgsl_memdesc memdesc;
 	int memtype;
 	void *priv_data;
-	struct list_head list;
+	/* node in the owning process's mem_rb, keyed by gpuaddr */
+	struct rb_node node;
+	/* highest end address (gpuaddr + size) in this node's subtree */
+	unsigned int subtree_end;
 	uint32_t free_timestamp;
 	/* back pointer to private structure under whose context this
 	* allocation is made */
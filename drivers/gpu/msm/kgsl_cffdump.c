@@ -390,6 +390,7 @@ void kgsl_cffdump_syncmem(struct kgsl_device_private *dev_priv,
 	const struct kgsl_memdesc *memdesc, uint gpuaddr, uint sizebytes,
 	bool clean_cache)
 {
+	struct kgsl_mem_entry *entry = NULL;
 	const void *src;
 
 	if (!kgsl_cff_dump_enable)
@@ -398,11 +399,8 @@ void kgsl_cffdump_syncmem(struct kgsl_device_private *dev_priv,
 	total_syncmem += sizebytes;
 
 	if (memdesc == NULL) {
-		struct kgsl_mem_entry *entry;
-		spin_lock(&dev_priv->process_priv->mem_lock);
 		entry = kgsl_sharedmem_find_region(dev_priv->process_priv,
 			gpuaddr, sizebytes);
-		spin_unlock(&dev_priv->process_priv->mem_lock);
 		if (entry == NULL) {
 			KGSL_CORE_ERR("did not find mapping "
 				"for gpuaddr: 0x%08x\n", gpuaddr);
@@ -415,7 +413,7 @@ void kgsl_cffdump_syncmem(struct kgsl_device_private *dev_priv,
 		KGSL_CORE_ERR("no kernel mapping for "
 			"gpuaddr: 0x%08x, m->host: 0x%p, phys: 0x%08x\n",
 			gpuaddr, memdesc->hostptr, memdesc->physaddr);
-		return;
+		goto done;
 	}
 
 	if (clean_cache) {
@@ -438,6 +436,9 @@ void kgsl_cffdump_syncmem(struct kgsl_device_private *dev_priv,
 	if (sizebytes > 0)
 		cffdump_printline(-1, CFF_OP_WRITE_MEM, gpuaddr, *(uint *)src,
 			0, 0, 0);
+done:
+	if (entry)
+		kgsl_mem_entry_put(entry);
 }
 
 void kgsl_cffdump_setmem(uint addr, uint value, uint sizebytes)
@@ -556,6 +557,7 @@ bool kgsl_cffdump_parse_ibs(struct kgsl_device_private *dev_priv,
 	bool check_only)
 {
 	static uint level; /* recursion level */
+	struct kgsl_mem_entry *entry = NULL;
 	bool ret = true;
 	uint *hostaddr, *hoststart;
 	int dwords_left = sizedwords; /* dwords left in the current command
@@ -565,11 +567,8 @@ bool kgsl_cffdump_parse_ibs(struct kgsl_device_private *dev_priv,
 		kgsl_cffdump_addr_count = 0;
 
 	if (memdesc == NULL) {
-		struct kgsl_mem_entry *entry;
-		spin_lock(&dev_priv->process_priv->mem_lock);
 		entry = kgsl_sharedmem_find_region(dev_priv->process_priv,
 			gpuaddr, sizedwords * sizeof(uint));
-		spin_unlock(&dev_priv->process_priv->mem_lock);
 		if (entry == NULL) {
 			KGSL_CORE_ERR("did not find mapping "
 				"for gpuaddr: 0x%08x\n", gpuaddr);
@@ -581,6 +580,8 @@ bool kgsl_cffdump_parse_ibs(struct kgsl_device_private *dev_priv,
 	if (hostaddr == NULL) {
 		KGSL_CORE_ERR("no kernel mapping for "
 			"gpuaddr: 0x%08x\n", gpuaddr);
+		if (entry)
+			kgsl_mem_entry_put(entry);
 		return true;
 	}
 
@@ -678,6 +679,8 @@ bool kgsl_cffdump_parse_ibs(struct kgsl_device_private *dev_priv,
 
 	level--;
 
+	if (entry)
+		kgsl_mem_entry_put(entry);
 	return ret;
 }
 
@@ -12,6 +12,8 @@
  */
 
 #include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/math64.h>
 
 #include "kgsl.h"
 #include "kgsl_device.h"
@@ -49,6 +51,32 @@ KGSL_DEBUGFS_LOG(ctxt_log);
 KGSL_DEBUGFS_LOG(mem_log);
 KGSL_DEBUGFS_LOG(pwr_log);
 
+static int events_show(struct seq_file *s, void *unused)
+{
+	struct kgsl_device *device = s->private;
+	unsigned int batches = device->event_stats.batches;
+
+	seq_printf(s, "batches: %u\n", batches);
+	seq_printf(s, "callbacks: %u\n", device->event_stats.callbacks);
+	seq_printf(s, "latency_avg_us: %lld\n", batches ?
+		div_s64(device->event_stats.latency_total, batches * 1000) : 0);
+	seq_printf(s, "latency_max_us: %lld\n",
+		div_s64(device->event_stats.latency_max, 1000));
+	return 0;
+}
+
+static int events_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, events_show, inode->i_private);
+}
+
+static const struct file_operations events_fops = {
+	.open = events_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
 void kgsl_device_debugfs_init(struct kgsl_device *device)
 {
 	if (kgsl_debugfs_dir && !IS_ERR(kgsl_debugfs_dir))
@@ -74,6 +102,8 @@ void kgsl_device_debugfs_init(struct kgsl_device *device)
 				&mem_log_fops);
 	debugfs_create_file("log_level_pwr", 0644, device->d_debugfs, device,
 				&pwr_log_fops);
+	debugfs_create_file("events", 0444, device->d_debugfs, device,
+				&events_fops);
 }
 
 void kgsl_core_debugfs_init(void)
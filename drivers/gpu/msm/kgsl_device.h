@@ -16,6 +16,7 @@
 #include <linux/idr.h>
 #include <linux/wakelock.h>
 #include <linux/earlysuspend.h>
+#include <linux/hrtimer.h>
 
 #include "kgsl.h"
 #include "kgsl_mmu.h"
@@ -185,7 +186,15 @@ struct kgsl_device {
 	struct kgsl_pwrscale pwrscale;
 	struct kobject pwrscale_kobj;
 	struct work_struct ts_expired_ws;
+	spinlock_t events_lock;		/* protects events */
 	struct list_head events;
+	ktime_t events_signaled;	/* last time ts_expired_ws was queued */
+	struct {
+		unsigned int batches;
+		unsigned int callbacks;
+		s64 latency_total;	/* ns, signal to start of batch */
+		s64 latency_max;
+	} event_stats;
 	s64 on_time;
 };
 
@@ -208,7 +217,7 @@ struct kgsl_process_private {
 	unsigned int refcnt;
 	pid_t pid;
 	spinlock_t mem_lock;
-	struct list_head mem_list;
+	struct rb_root mem_rb;
 	struct kgsl_pagetable *pagetable;
 	struct list_head list;
 	struct kobject kobj;
@@ -231,12 +240,26 @@ struct kgsl_power_stats {
 
 struct kgsl_device *kgsl_get_device(int dev_idx);
 
+/*
+ * Entries can be freed without device->mutex (from timestamp events), so
+ * the per process statistics are protected by mem_lock instead.
+ */
 static inline void kgsl_process_add_stats(struct kgsl_process_private *priv,
 	unsigned int type, size_t size)
 {
+	spin_lock(&priv->mem_lock);
 	priv->stats[type].cur += size;
 	if (priv->stats[type].max < priv->stats[type].cur)
 		priv->stats[type].max = priv->stats[type].cur;
+	spin_unlock(&priv->mem_lock);
+}
+
+static inline void kgsl_process_sub_stats(struct kgsl_process_private *priv,
+	unsigned int type, size_t size)
+{
+	spin_lock(&priv->mem_lock);
+	priv->stats[type].cur -= size;
+	spin_unlock(&priv->mem_lock);
 }
 
 static inline void kgsl_regread(struct kgsl_device *device,
@@ -324,6 +347,17 @@ kgsl_find_context(struct kgsl_device_private *dev_priv, uint32_t id)
 
 int kgsl_check_timestamp(struct kgsl_device *device, unsigned int timestamp);
 
+/*
+ * Timestamps may have retired: run the expired events from the device
+ * workqueue.  The signal time only feeds the latency statistics, so it
+ * is not protected against a racing interrupt.
+ */
+static inline void kgsl_signal_events(struct kgsl_device *device)
+{
+	device->events_signaled = ktime_get();
+	queue_work(device->work_queue, &device->ts_expired_ws);
+}
+
 int kgsl_register_ts_notifier(struct kgsl_device *device,
 			      struct notifier_block *nb);
 
@@ -16,12 +16,20 @@
 #include <linux/genalloc.h>
 #include <linux/slab.h>
 #include <linux/sched.h>
+#include <linux/hrtimer.h>
 
 #include "kgsl.h"
 #include "kgsl_mmu.h"
 #include "kgsl_device.h"
 #include "kgsl_sharedmem.h"
 
+/*
+ * Free entries to keep around in dynamically added chunks, so a process
+ * starting right after another one exits does not have to go back to
+ * dma_alloc_coherent() for its pagetable.
+ */
+#define KGSL_PTPOOL_WARM	2
+
 static ssize_t
 sysfs_show_ptpool_entries(struct kobject *kobj,
 			  struct kobj_attribute *attr,
@@ -167,6 +175,7 @@ _kgsl_ptpool_get_entry(struct kgsl_ptpool *pool, unsigned int *physaddr)
 			continue;
 
 		set_bit(bit, chunk->bitmap);
+		pool->used++;
 		*physaddr = chunk->phys + (bit * pool->ptsize);
 
 		return chunk->data + (bit * pool->ptsize);
@@ -260,7 +269,8 @@ static inline void _kgsl_ptpool_rm_chunk(struct kgsl_ptpool_chunk *chunk)
  * @pool:  A pointer to a ptpool structure
  * @addr: A pointer to the virtual address to free
  *
- * Free a pagetable allocated from the pool
+ * Free a pagetable allocated from the pool.  The pagetable must already
+ * be all zeroes again, only the caller knows which entries it used.
  */
 
 static void kgsl_ptpool_free(struct kgsl_ptpool *pool, void *addr)
@@ -278,11 +288,16 @@ static void kgsl_ptpool_free(struct kgsl_ptpool *pool, void *addr)
 				pool->ptsize;
 
 			clear_bit(bit, chunk->bitmap);
-			memset(addr, 0, pool->ptsize);
+			pool->used--;
 
 			if (chunk->dynamic &&
-				bitmap_empty(chunk->bitmap, chunk->count))
+				bitmap_empty(chunk->bitmap, chunk->count) &&
+				pool->entries - pool->used - chunk->count >=
+				KGSL_PTPOOL_WARM) {
+				pool->entries -= chunk->count;
+				pool->chunks--;
 				_kgsl_ptpool_rm_chunk(chunk);
+			}
 
 			break;
 		}
@@ -362,6 +377,14 @@ void kgsl_gpummu_destroy_pagetable(void *mmu_specific_pt)
 {
 	struct kgsl_gpummu_pt *gpummu_pt = (struct kgsl_gpummu_pt *)
 						mmu_specific_pt;
+
+	/* only the entries that were ever written need clearing */
+	if (gpummu_pt->pte_hi > gpummu_pt->pte_lo)
+		memset(gpummu_pt->base.hostptr +
+			gpummu_pt->pte_lo * sizeof(uint32_t), 0,
+			(gpummu_pt->pte_hi - gpummu_pt->pte_lo) *
+			sizeof(uint32_t));
+
 	kgsl_ptpool_free((struct kgsl_ptpool *)kgsl_driver.ptpool,
 				gpummu_pt->base.hostptr);
 
@@ -405,9 +428,9 @@ static unsigned int kgsl_gpummu_pt_get_flags(struct kgsl_pagetable *pt,
 	gpummu_pt = pt->priv;
 
 	spin_lock(&pt->lock);
-	if (gpummu_pt->tlb_flags && (1<<id)) {
+	if (gpummu_pt->tlb_seen[id] != gpummu_pt->tlb_gen) {
 		result = KGSL_MMUFLAGS_TLBFLUSH;
-		gpummu_pt->tlb_flags &= ~(1<<id);
+		gpummu_pt->tlb_seen[id] = gpummu_pt->tlb_gen;
 	}
 	spin_unlock(&pt->lock);
 	return result;
@@ -437,8 +460,8 @@ static void *kgsl_gpummu_create_pagetable(void)
 	if (!gpummu_pt)
 		return NULL;
 
-	gpummu_pt->tlb_flags = 0;
 	gpummu_pt->last_superpte = 0;
+	gpummu_pt->pte_lo = UINT_MAX;
 
 	gpummu_pt->tlbflushfilter.size = (CONFIG_MSM_KGSL_PAGE_TABLE_SIZE /
 				(PAGE_SIZE * GSL_PT_SUPER_PTE * 8)) + 1;
@@ -511,7 +534,7 @@ static void kgsl_gpummu_setstate(struct kgsl_device *device,
 			mmu->hwpagetable = pagetable;
 			spin_lock(&mmu->hwpagetable->lock);
 			gpummu_pt = mmu->hwpagetable->priv;
-			gpummu_pt->tlb_flags &= ~(1<<device->id);
+			gpummu_pt->tlb_seen[device->id] = gpummu_pt->tlb_gen;
 			spin_unlock(&mmu->hwpagetable->lock);
 
 			/* call device specific set page table */
@@ -676,6 +699,8 @@ kgsl_gpummu_map(void *mmu_specific_pt,
 	int i;
 
 	pte = kgsl_pt_entry_get(KGSL_PAGETABLE_BASE, memdesc->gpuaddr);
+	if (pte < gpummu_pt->pte_lo)
+		gpummu_pt->pte_lo = pte;
 
 	/* Flush the TLB if the first PTE isn't at the superpte boundary */
 	if (pte & (GSL_PT_SUPER_PTE - 1))
@@ -693,6 +718,9 @@ kgsl_gpummu_map(void *mmu_specific_pt,
 		}
 	}
 
+	if (pte > gpummu_pt->pte_hi)
+		gpummu_pt->pte_hi = pte;
+
 	/* Flush the TLB if the last PTE isn't at the superpte boundary */
 	if ((pte + 1) & (GSL_PT_SUPER_PTE - 1))
 		flushtlb = 1;
@@ -700,8 +728,8 @@ kgsl_gpummu_map(void *mmu_specific_pt,
 	wmb();
 
 	if (flushtlb) {
-		/*set all devices as needing flushing*/
-		gpummu_pt->tlb_flags = UINT_MAX;
+		/* every device flushes once it sees the new generation */
+		gpummu_pt->tlb_gen++;
 		GSL_TLBFLUSH_FILTER_RESET();
 	}
 
@@ -744,6 +772,121 @@ kgsl_gpummu_get_current_ptbase(struct kgsl_device *device)
 	return ptbase;
 }
 
+#ifdef CONFIG_MSM_KGSL_MEM_SELFTEST
+static int __init kgsl_gpummu_test_map(struct kgsl_gpummu_pt *gpummu_pt,
+				       struct kgsl_memdesc *memdesc,
+				       struct page *page, unsigned int pte,
+				       unsigned int count)
+{
+	unsigned int i;
+
+	memdesc->gpuaddr = KGSL_PAGETABLE_BASE + (pte << PAGE_SHIFT);
+	memdesc->size = count << PAGE_SHIFT;
+	sg_init_table(memdesc->sg, 1);
+	memdesc->sglen = 1;
+	/* the PTEs only hold addresses, nothing behind the page is used */
+	sg_set_page(memdesc->sg, page, memdesc->size, 0);
+	kgsl_gpummu_map(gpummu_pt, memdesc, GSL_PT_PAGE_RV);
+
+	for (i = 0; i < count; i++)
+		if (kgsl_pt_map_get(gpummu_pt, pte + i) !=
+		    page_to_phys(page) + (i << PAGE_SHIFT))
+			return -EINVAL;
+	return 0;
+}
+
+/*
+ * Run a pagetable through map, unmap and free on the CPU only: check
+ * that a TLB flush is requested once per device for every mapping
+ * generation, that only the used entries are cleared on free, and that
+ * the next pagetable is the same, zeroed, pool entry.  The table never
+ * reaches the hardware.
+ */
+int __init kgsl_gpummu_selftest(void)
+{
+	struct kgsl_pagetable pt = { .lock = __SPIN_LOCK_UNLOCKED(pt.lock) };
+	struct kgsl_memdesc a = { 0 }, b = { 0 };
+	struct scatterlist sg_a, sg_b;
+	struct kgsl_gpummu_pt *gpummu_pt;
+	const char *step = "create";
+	struct page *page;
+	uint32_t *ptes;
+	void *hostptr;
+	unsigned int i;
+	int ret = -ENOMEM;
+	ktime_t t;
+	s64 ns;
+
+	page = alloc_page(GFP_KERNEL);
+	gpummu_pt = kgsl_gpummu_create_pagetable();
+	if (page == NULL || gpummu_pt == NULL)
+		goto out;
+	pt.priv = gpummu_pt;
+	a.sg = &sg_a;
+	b.sg = &sg_b;
+	ret = -EINVAL;
+
+	/*
+	 * Not superpte aligned, so this one needs a flush.  GPU addresses
+	 * are 8K aligned, unmap rounds down to that, so keep to even PTEs.
+	 */
+	step = "map";
+	if (kgsl_gpummu_test_map(gpummu_pt, &a, page, 2, 8) ||
+	    gpummu_pt->pte_lo != 2 || gpummu_pt->pte_hi != 10)
+		goto out;
+	step = "first flush";
+	if (kgsl_gpummu_pt_get_flags(&pt, KGSL_DEVICE_3D0) !=
+	    KGSL_MMUFLAGS_TLBFLUSH ||
+	    kgsl_gpummu_pt_get_flags(&pt, KGSL_DEVICE_3D0) != 0 ||
+	    kgsl_gpummu_pt_get_flags(&pt, KGSL_DEVICE_2D0) !=
+	    KGSL_MMUFLAGS_TLBFLUSH)
+		goto out;
+
+	/* a clean superpte aligned range does not */
+	step = "aligned map";
+	if (kgsl_gpummu_test_map(gpummu_pt, &b, page, 16, 7) ||
+	    kgsl_gpummu_pt_get_flags(&pt, KGSL_DEVICE_3D0) != 0)
+		goto out;
+
+	/* reusing an unmapped superpte does */
+	step = "remap";
+	kgsl_gpummu_unmap(gpummu_pt, &a);
+	if (kgsl_gpummu_test_map(gpummu_pt, &a, page, 8, 7) ||
+	    kgsl_gpummu_pt_get_flags(&pt, KGSL_DEVICE_3D0) !=
+	    KGSL_MMUFLAGS_TLBFLUSH)
+		goto out;
+
+	step = "recycle";
+	hostptr = gpummu_pt->base.hostptr;
+	t = ktime_get();
+	kgsl_gpummu_destroy_pagetable(gpummu_pt);
+	gpummu_pt = kgsl_gpummu_create_pagetable();
+	ns = ktime_to_ns(ktime_sub(ktime_get(), t));
+	if (gpummu_pt == NULL) {
+		ret = -ENOMEM;
+		goto out;
+	}
+	if (gpummu_pt->base.hostptr != hostptr)
+		goto out;
+	ptes = gpummu_pt->base.hostptr;
+	for (i = 0; i < gpummu_pt->base.size / sizeof(uint32_t); i++)
+		if (ptes[i])
+			goto out;
+
+	ret = 0;
+	pr_info("kgsl: gpummu self-test passed, %lld ns to recycle a "
+		"pagetable\n", ns);
+out:
+	if (ret)
+		KGSL_CORE_ERR("gpummu self-test failed at %s\n", step);
+	if (gpummu_pt)
+		kgsl_gpummu_destroy_pagetable(gpummu_pt);
+	if (page)
+		__free_page(page);
+	return ret;
+}
+#endif
+
 struct kgsl_mmu_ops gpummu_ops = {
 	.mmu_init = kgsl_gpummu_init,
 	.mmu_close = kgsl_gpummu_close,
@@ -47,7 +47,13 @@ struct kgsl_tlbflushfilter {
 struct kgsl_gpummu_pt {
 	struct kgsl_memdesc  base;
 	unsigned int   last_superpte;
-	unsigned int tlb_flags;
+	/* Bumped whenever a map needs the TLB flushed */
+	unsigned int tlb_gen;
+	/* tlb_gen as of the last flush by each device */
+	unsigned int tlb_seen[KGSL_DEVICE_MAX];
+	/* Range of PTEs written so far, cleared when the table is freed */
+	unsigned int pte_lo;
+	unsigned int pte_hi;
 	/* Maintain filter to manage tlb flushing */
 	struct kgsl_tlbflushfilter tlbflushfilter;
 };
@@ -70,6 +76,7 @@ struct kgsl_ptpool {
 	struct list_head list;
 	int entries;
 	int static_entries;
+	int used;
 	int chunks;
 };
 
@@ -77,6 +84,15 @@ void *kgsl_gpummu_ptpool_init(int ptsize,
 			int entries);
 void kgsl_gpummu_ptpool_destroy(void *ptpool);
 
+#ifdef CONFIG_MSM_KGSL_MEM_SELFTEST
+int kgsl_gpummu_selftest(void);
+#else
+static inline int kgsl_gpummu_selftest(void)
+{
+	return 0;
+}
+#endif
+
 static inline unsigned int kgsl_pt_get_base_addr(struct kgsl_pagetable *pt)
 {
 	struct kgsl_gpummu_pt *gpummu_pt = pt->priv;
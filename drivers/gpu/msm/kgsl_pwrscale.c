@@ -44,6 +44,9 @@ static struct kgsl_pwrscale_policy *kgsl_pwrscale_policies[] = {
 #endif
 #ifdef CONFIG_MSM_SLEEP_STATS_DEVICE
 	&kgsl_pwrscale_policy_idlestats,
+#endif
+#ifdef CONFIG_MSM_KGSL_PWRSCALE_DCVS
+	&kgsl_pwrscale_policy_dcvs,
 #endif
 	NULL
 };
@@ -0,0 +1,384 @@
+/* Copyright (C) 2026 agent <agent@local>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 and
+ * only version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+/*
+ * In-kernel GPU frequency policy driven by the busy statistics of the
+ * core.  Busy time is accumulated over a window; a busy window steps the
+ * clock up, and only a run of quiet windows steps it down.  A single
+ * stretch of busy time close to a whole frame jumps straight to the
+ * fastest level so that the next frame is not missed.
+ *
+ * The decision logic does not touch the device, so the same code can be
+ * fed a recorded trace through the "replay" file.  That reports the
+ * frames the policy would have missed and the energy it would have used
+ * relative to running at the fastest level all the time.
+ */
+
+#include <linux/kernel.h>
+#include <linux/slab.h>
+#include <linux/math64.h>
+
+#include "kgsl.h"
+#include "kgsl_pwrscale.h"
+#include "kgsl_device.h"
+
+struct dcvs_state {
+	unsigned int level;
+	s64 busy;		/* us busy in the current window */
+	s64 total;		/* us in the current window */
+	unsigned int quiet;	/* windows in a row below down_threshold */
+	unsigned int transitions;
+	unsigned int boosts;
+};
+
+struct dcvs_replay {
+	struct dcvs_state state;
+	unsigned int samples;
+	unsigned int missed;
+	u64 energy;		/* us at the power of the fastest level */
+	u64 energy_fastest;
+	u64 residency[KGSL_MAX_PWRLEVELS];
+	char partial[32];	/* a line split across two writes */
+	unsigned int partial_len;
+};
+
+struct dcvs_priv {
+	/* tunables */
+	unsigned int window_us;
+	unsigned int up_threshold;
+	unsigned int down_threshold;
+	unsigned int down_hold;
+	unsigned int frame_us;
+	unsigned int boost_percent;
+
+	struct dcvs_state state;
+
+	struct mutex replay_lock;
+	struct dcvs_replay replay;
+};
+
+/*
+ * Account one busy sample and return the level to run at.  fastest and
+ * slowest are the range of usable power levels, fastest being the lower
+ * index.
+ */
+static unsigned int dcvs_sample(struct dcvs_priv *priv,
+				struct dcvs_state *state, s64 busy, s64 total,
+				unsigned int fastest, unsigned int slowest)
+{
+	unsigned int level = clamp(state->level, fastest, slowest);
+	unsigned int percent;
+
+	/* one burst that nearly filled a frame: don't wait for the window */
+	if (priv->frame_us && busy * 100 >=
+	    (s64) priv->frame_us * priv->boost_percent) {
+		if (level != fastest)
+			state->boosts++;
+		level = fastest;
+		state->busy = 0;
+		state->total = 0;
+		state->quiet = 0;
+		goto done;
+	}
+
+	state->busy += busy;
+	state->total += total;
+	if (state->total < priv->window_us)
+		goto done;
+
+	percent = div64_u64(state->busy * 100, state->total);
+	state->busy = 0;
+	state->total = 0;
+
+	if (percent >= priv->up_threshold) {
+		state->quiet = 0;
+		if (level > fastest)
+			level--;
+	} else if (percent < priv->down_threshold) {
+		if (++state->quiet >= priv->down_hold) {
+			state->quiet = 0;
+			if (level < slowest)
+				level++;
+		}
+	} else {
+		state->quiet = 0;
+	}
+
+done:
+	if (level != state->level)
+		state->transitions++;
+	state->level = level;
+	return level;
+}
+
+static void dcvs_state_reset(struct dcvs_state *state, unsigned int level)
+{
+	memset(state, 0, sizeof(*state));
+	state->level = level;
+}
+
+static void dcvs_idle(struct kgsl_device *device,
+		      struct kgsl_pwrscale *pwrscale)
+{
+	struct kgsl_pwrctrl *pwr = &device->pwrctrl;
+	struct dcvs_priv *priv = pwrscale->priv;
+	struct kgsl_power_stats stats;
+	unsigned int level;
+
+	device->ftbl->power_stats(device, &stats);
+	if (stats.total_time == 0)
+		return;
+
+	priv->state.level = pwr->active_pwrlevel;
+	level = dcvs_sample(priv, &priv->state, stats.busy_time,
+			    stats.total_time, pwr->thermal_pwrlevel,
+			    pwr->num_pwrlevels - 2);
+	if (level != pwr->active_pwrlevel)
+		kgsl_pwrctrl_pwrlevel_change(device, level);
+}
+
+static void dcvs_busy(struct kgsl_device *device,
+		      struct kgsl_pwrscale *pwrscale)
+{
+	device->on_time = ktime_to_us(ktime_get());
+}
+
+static void dcvs_sleep(struct kgsl_device *device,
+		       struct kgsl_pwrscale *pwrscale)
+{
+	struct dcvs_priv *priv = pwrscale->priv;
+
+	/* a window should not span a sleep */
+	dcvs_state_reset(&priv->state, device->pwrctrl.active_pwrlevel);
+}
+
+/* sysfs: tunables, live statistics and the trace replay */
+
+#define DCVS_TUNABLE(_name, _min, _max)					\
+static ssize_t dcvs_##_name##_show(struct kgsl_device *device,		\
+				   struct kgsl_pwrscale *pwrscale,	\
+				   char *buf)				\
+{									\
+	struct dcvs_priv *priv = pwrscale->priv;			\
+	return snprintf(buf, PAGE_SIZE, "%u\n", priv->_name);		\
+}									\
+static ssize_t dcvs_##_name##_store(struct kgsl_device *device,	\
+				    struct kgsl_pwrscale *pwrscale,	\
+				    const char *buf, size_t count)	\
+{									\
+	struct dcvs_priv *priv = pwrscale->priv;			\
+	unsigned long val;						\
+									\
+	if (strict_strtoul(buf, 0, &val) || val < (_min) || val > (_max)) \
+		return -EINVAL;						\
+	mutex_lock(&device->mutex);					\
+	priv->_name = val;						\
+	mutex_unlock(&device->mutex);					\
+	return count;							\
+}									\
+PWRSCALE_POLICY_ATTR(_name, 0644, dcvs_##_name##_show,		\
+		     dcvs_##_name##_store)
+
+DCVS_TUNABLE(window_us, 1000, 1000000);
+DCVS_TUNABLE(up_threshold, 1, 100);
+DCVS_TUNABLE(down_threshold, 0, 100);
+DCVS_TUNABLE(down_hold, 1, 100);
+DCVS_TUNABLE(frame_us, 0, 1000000);
+DCVS_TUNABLE(boost_percent, 1, 100);
+
+static ssize_t dcvs_stats_show(struct kgsl_device *device,
+			       struct kgsl_pwrscale *pwrscale, char *buf)
+{
+	struct dcvs_priv *priv = pwrscale->priv;
+
+	return snprintf(buf, PAGE_SIZE, "transitions: %u\nboosts: %u\n",
+			priv->state.transitions, priv->state.boosts);
+}
+
+PWRSCALE_POLICY_ATTR(stats, 0444, dcvs_stats_show, NULL);
+
+/*
+ * Run one recorded frame through the policy.  The busy time is taken to
+ * be measured at the fastest level and scales with the clock; a frame
+ * whose scaled busy time does not fit its period is missed.  Energy
+ * assumes busy power goes with the square of the clock, as the voltage
+ * follows the frequency, and ignores idle power.
+ */
+static void dcvs_replay_frame(struct kgsl_device *device,
+			      struct dcvs_priv *priv, u64 busy, u64 period)
+{
+	struct kgsl_pwrctrl *pwr = &device->pwrctrl;
+	struct dcvs_replay *r = &priv->replay;
+	unsigned int fastest = pwr->thermal_pwrlevel;
+	unsigned int f0 = pwr->pwrlevels[fastest].gpu_freq / 1000;
+	unsigned int f = pwr->pwrlevels[r->state.level].gpu_freq / 1000;
+	u64 scaled;
+
+	if (f0 == 0 || f == 0 || period == 0)
+		return;
+
+	scaled = div_u64(busy * f0, f);
+	if (scaled > period)
+		r->missed++;
+
+	r->samples++;
+	r->residency[r->state.level] += period;
+	r->energy += div_u64(div_u64(scaled * f, f0) * f, f0);
+	r->energy_fastest += busy;
+
+	dcvs_sample(priv, &r->state, min(scaled, period), period,
+		    fastest, pwr->num_pwrlevels - 2);
+}
+
+static ssize_t dcvs_replay_show(struct kgsl_device *device,
+				struct kgsl_pwrscale *pwrscale, char *buf)
+{
+	struct dcvs_priv *priv = pwrscale->priv;
+	struct dcvs_replay *r = &priv->replay;
+	unsigned int i;
+	ssize_t ret;
+
+	mutex_lock(&priv->replay_lock);
+	ret = snprintf(buf, PAGE_SIZE,
+		"frames: %u\nmissed: %u\ntransitions: %u\nboosts: %u\n"
+		"energy: %llu\nenergy_percent: %llu\n",
+		r->samples, r->missed, r->state.transitions, r->state.boosts,
+		r->energy, r->energy_fastest ?
+		div64_u64(r->energy * 100, r->energy_fastest) : 0);
+	for (i = 0; i < device->pwrctrl.num_pwrlevels - 1; i++)
+		ret += snprintf(buf + ret, PAGE_SIZE - ret,
+				"residency_us[%u]: %llu\n", i,
+				r->residency[i]);
+	mutex_unlock(&priv->replay_lock);
+
+	return ret;
+}
+
+/*
+ * Writes are "<busy_us> <period_us>" lines, one per recorded frame, in
+ * as many writes as needed.  Writing "reset" starts a new replay.
+ */
+static ssize_t dcvs_replay_store(struct kgsl_device *device,
+				 struct kgsl_pwrscale *pwrscale,
+				 const char *buf, size_t count)
+{
+	struct dcvs_priv *priv = pwrscale->priv;
+	struct dcvs_replay *r = &priv->replay;
+	const char *p = buf, *end = buf + count, *eol;
+	unsigned long long busy, period;
+	char line[sizeof(r->partial)];
+	ssize_t ret = count;
+	size_t len;
+
+	mutex_lock(&priv->replay_lock);
+
+	if (!strncmp(buf, "reset", 5)) {
+		memset(r, 0, sizeof(*r));
+		dcvs_state_reset(&r->state, device->pwrctrl.thermal_pwrlevel);
+		goto done;
+	}
+
+	while (p < end) {
+		eol = memchr(p, '\n', end - p);
+		len = (eol ? eol : end) - p;
+
+		if (r->partial_len + len >= sizeof(line)) {
+			ret = -EINVAL;
+			r->partial_len = 0;
+			goto done;
+		}
+		memcpy(r->partial + r->partial_len, p, len);
+		r->partial_len += len;
+		p += len + 1;
+
+		/* keep an unterminated tail for the next write */
+		if (eol == NULL)
+			break;
+
+		memcpy(line, r->partial, r->partial_len);
+		line[r->partial_len] = '\0';
+		r->partial_len = 0;
+
+		if (sscanf(line, "%llu %llu", &busy, &period) == 2)
+			dcvs_replay_frame(device, priv, busy, period);
+	}
+
+done:
+	mutex_unlock(&priv->replay_lock);
+	return ret;
+}
+
+PWRSCALE_POLICY_ATTR(replay, 0644, dcvs_replay_show, dcvs_replay_store);
+
+static struct attribute *dcvs_attrs[] = {
+	&policy_attr_window_us.attr,
+	&policy_attr_up_threshold.attr,
+	&policy_attr_down_threshold.attr,
+	&policy_attr_down_hold.attr,
+	&policy_attr_frame_us.attr,
+	&policy_attr_boost_percent.attr,
+	&policy_attr_stats.attr,
+	&policy_attr_replay.attr,
+	NULL
+};
+
+static struct attribute_group dcvs_attr_group = {
+	.attrs = dcvs_attrs,
+};
+
+static int dcvs_init(struct kgsl_device *device,
+		     struct kgsl_pwrscale *pwrscale)
+{
+	struct dcvs_priv *priv;
+
+	if (device->ftbl->power_stats == NULL)
+		return -EINVAL;
+
+	priv = pwrscale->priv = kzalloc(sizeof(struct dcvs_priv), GFP_KERNEL);
+	if (pwrscale->priv == NULL)
+		return -ENOMEM;
+
+	priv->window_us = 50000;
+	priv->up_threshold = 80;
+	priv->down_threshold = 40;
+	priv->down_hold = 3;
+	priv->frame_us = 16667;
+	priv->boost_percent = 90;
+
+	dcvs_state_reset(&priv->state, device->pwrctrl.active_pwrlevel);
+	mutex_init(&priv->replay_lock);
+	dcvs_state_reset(&priv->replay.state,
+			 device->pwrctrl.thermal_pwrlevel);
+
+	kgsl_pwrscale_policy_add_files(device, pwrscale, &dcvs_attr_group);
+
+	return 0;
+}
+
+static void dcvs_close(struct kgsl_device *device,
+		       struct kgsl_pwrscale *pwrscale)
+{
+	kgsl_pwrscale_policy_remove_files(device, pwrscale, &dcvs_attr_group);
+	kfree(pwrscale->priv);
+	pwrscale->priv = NULL;
+}
+
+struct kgsl_pwrscale_policy kgsl_pwrscale_policy_dcvs = {
+	.name = "dcvs",
+	.init = dcvs_init,
+	.busy = dcvs_busy,
+	.idle = dcvs_idle,
+	.sleep = dcvs_sleep,
+	.close = dcvs_close
+};
+EXPORT_SYMBOL(kgsl_pwrscale_policy_dcvs);
@@ -12,6 +12,10 @@
  */
 #include <linux/vmalloc.h>
 #include <linux/memory_alloc.h>
+#include <linux/highmem.h>
+#include <linux/log2.h>
+#include <linux/hrtimer.h>
+#include <linux/math64.h>
 #include <asm/cacheflush.h>
 #include <linux/slab.h>
 #include <linux/kmemleak.h>
@@ -211,6 +215,8 @@ static int kgsl_drv_memstat_show(struct device *dev,
 		val = kgsl_driver.stats.mapped;
 	else if (!strncmp(attr->attr.name, "mapped_max", 10))
 		val = kgsl_driver.stats.mapped_max;
+	else if (!strncmp(attr->attr.name, "page_pool", 9))
+		val = kgsl_driver.stats.page_pool;
 
 	return snprintf(buf, PAGE_SIZE, "%u\n", val);
 }
@@ -236,6 +242,7 @@ DEVICE_ATTR(coherent, 0444, kgsl_drv_memstat_show, NULL);
 DEVICE_ATTR(coherent_max, 0444, kgsl_drv_memstat_show, NULL);
 DEVICE_ATTR(mapped, 0444, kgsl_drv_memstat_show, NULL);
 DEVICE_ATTR(mapped_max, 0444, kgsl_drv_memstat_show, NULL);
+DEVICE_ATTR(page_pool, 0444, kgsl_drv_memstat_show, NULL);
 DEVICE_ATTR(histogram, 0444, kgsl_drv_histogram_show, NULL);
 
 static const struct device_attribute *drv_attr_list[] = {
@@ -245,6 +252,7 @@ static const struct device_attribute *drv_attr_list[] = {
 	&dev_attr_coherent_max,
 	&dev_attr_mapped,
 	&dev_attr_mapped_max,
+	&dev_attr_page_pool,
 	&dev_attr_histogram,
 	NULL
 };
@@ -290,11 +298,282 @@ static void outer_cache_range_op_sg(struct scatterlist *sg, int sglen, int op)
 }
 
 #else
+static void _outer_cache_range_op(int op, unsigned long addr, size_t size)
+{
+}
+
 static void outer_cache_range_op_sg(struct scatterlist *sg, int sglen, int op)
 {
 }
 #endif
 
+/*
+ * Pool of free pages for the paged allocations below.  Every page in the
+ * pool is zeroed and has had its cache lines written back and
+ * invalidated, so an allocation served from the pool only has to map it.
+ * Pages are refilled in high order chunks when possible, zeroed again on
+ * the way back in, and given back to the system by the shrinker.
+ */
+#define KGSL_PAGE_POOL_MAX	1024	/* pages */
+#define KGSL_PAGE_POOL_ORDER	4	/* largest refill chunk */
+
+static struct {
+	spinlock_t lock;
+	struct list_head list;
+	unsigned int count;
+	unsigned int hits;
+	unsigned int misses;
+} kgsl_page_pool = {
+	.lock = __SPIN_LOCK_UNLOCKED(kgsl_page_pool.lock),
+	.list = LIST_HEAD_INIT(kgsl_page_pool.list),
+};
+
+/* write back and invalidate one page from the inner and outer caches */
+static void kgsl_page_flush(struct page *page)
+{
+	void *addr = kmap_atomic(page, KM_USER0);
+
+	dmac_flush_range(addr, addr + PAGE_SIZE);
+	kunmap_atomic(addr, KM_USER0);
+	_outer_cache_range_op(KGSL_CACHE_OP_FLUSH, page_to_phys(page),
+			      PAGE_SIZE);
+}
+
+/* Take up to @count pages from the pool, returns how many were taken */
+static unsigned int kgsl_page_pool_get(struct page **pages,
+				       unsigned int count)
+{
+	unsigned int i;
+
+	spin_lock(&kgsl_page_pool.lock);
+	for (i = 0; i < count && kgsl_page_pool.count; i++) {
+		pages[i] = list_first_entry(&kgsl_page_pool.list,
+					    struct page, lru);
+		list_del(&pages[i]->lru);
+		kgsl_page_pool.count--;
+	}
+	kgsl_page_pool.hits += i;
+	kgsl_page_pool.misses += count - i;
+	kgsl_driver.stats.page_pool = kgsl_page_pool.count << PAGE_SHIFT;
+	spin_unlock(&kgsl_page_pool.lock);
+
+	return i;
+}
+
+/*
+ * Fill @pages with @count zeroed, cache clean pages, from the pool first
+ * and then from the page allocator in chunks of up to
+ * 1 << KGSL_PAGE_POOL_ORDER pages.
+ */
+static int kgsl_page_pool_alloc(struct page **pages, unsigned int count)
+{
+	unsigned int i, j, order;
+	struct page *page;
+
+	i = kgsl_page_pool_get(pages, count);
+
+	while (i < count) {
+		order = min_t(unsigned int, ilog2(count - i),
+			      KGSL_PAGE_POOL_ORDER);
+		page = NULL;
+		if (order)
+			page = alloc_pages(GFP_KERNEL | __GFP_HIGHMEM |
+					   __GFP_ZERO | __GFP_NORETRY |
+					   __GFP_NOWARN, order);
+		if (page == NULL) {
+			order = 0;
+			page = alloc_page(GFP_KERNEL | __GFP_HIGHMEM |
+					  __GFP_ZERO);
+			if (page == NULL)
+				goto err;
+		}
+		if (order)
+			split_page(page, order);
+
+		for (j = 0; j < (1 << order); j++, i++) {
+			kgsl_page_flush(page + j);
+			pages[i] = page + j;
+		}
+	}
+
+	return 0;
+err:
+	while (i--)
+		__free_page(pages[i]);
+	return -ENOMEM;
+}
+
+/*
+ * Give pages back, keeping up to KGSL_PAGE_POOL_MAX of them for reuse.
+ * A page somebody else still holds a reference to (a user mapping, for
+ * instance) is only put, never pooled.
+ */
+static void kgsl_page_pool_free(struct page **pages, unsigned int count)
+{
+	unsigned int i, room;
+
+	spin_lock(&kgsl_page_pool.lock);
+	room = KGSL_PAGE_POOL_MAX - min_t(unsigned int,
+		kgsl_page_pool.count, KGSL_PAGE_POOL_MAX);
+	spin_unlock(&kgsl_page_pool.lock);
+
+	for (i = 0; i < count; i++) {
+		if (!room || page_count(pages[i]) != 1) {
+			put_page(pages[i]);
+			continue;
+		}
+		room--;
+
+		clear_highpage(pages[i]);
+		kgsl_page_flush(pages[i]);
+
+		spin_lock(&kgsl_page_pool.lock);
+		list_add_tail(&pages[i]->lru, &kgsl_page_pool.list);
+		kgsl_page_pool.count++;
+		spin_unlock(&kgsl_page_pool.lock);
+	}
+
+	spin_lock(&kgsl_page_pool.lock);
+	kgsl_driver.stats.page_pool = kgsl_page_pool.count << PAGE_SHIFT;
+	spin_unlock(&kgsl_page_pool.lock);
+}
+
+static int kgsl_page_pool_shrink(struct shrinker *shrinker,
+				 struct shrink_control *sc)
+{
+	unsigned int nr = sc->nr_to_scan;
+	struct page *page;
+	int count;
+
+	spin_lock(&kgsl_page_pool.lock);
+	while (nr-- && kgsl_page_pool.count) {
+		page = list_first_entry(&kgsl_page_pool.list,
+					struct page, lru);
+		list_del(&page->lru);
+		kgsl_page_pool.count--;
+		__free_page(page);
+	}
+	count = kgsl_page_pool.count;
+	kgsl_driver.stats.page_pool = count << PAGE_SHIFT;
+	spin_unlock(&kgsl_page_pool.lock);
+
+	return count;
+}
+
+static struct shrinker kgsl_page_pool_shrinker = {
+	.shrink = kgsl_page_pool_shrink,
+	.seeks = DEFAULT_SEEKS,
+};
+
+void kgsl_page_pool_init(void)
+{
+	register_shrinker(&kgsl_page_pool_shrinker);
+}
+
+void kgsl_page_pool_exit(void)
+{
+	struct shrink_control sc = { .nr_to_scan = KGSL_PAGE_POOL_MAX };
+
+	unregister_shrinker(&kgsl_page_pool_shrinker);
+	kgsl_page_pool_shrink(&kgsl_page_pool_shrinker, &sc);
+}
+
+#ifdef CONFIG_MSM_KGSL_MEM_SELFTEST
+#define KGSL_POOL_TEST_PAGES	37	/* not a power of two on purpose */
+
+static int __init kgsl_page_pool_check(struct page **pages, int fill)
+{
+	unsigned int i, j;
+	u32 *addr;
+	int ret = 0;
+
+	for (i = 0; i < KGSL_POOL_TEST_PAGES && !ret; i++) {
+		addr = kmap_atomic(pages[i], KM_USER0);
+		for (j = 0; j < PAGE_SIZE / sizeof(u32); j++)
+			if (addr[j]) {
+				ret = -EINVAL;
+				break;
+			}
+		if (fill)
+			memset(addr, 0xa5, PAGE_SIZE);
+		kunmap_atomic(addr, KM_USER0);
+	}
+
+	return ret;
+}
+
+/*
+ * Drain the pool, then allocate the same number of pages twice, once
+ * from the page allocator and once from the pool, checking that both
+ * come back zeroed and that the shrinker gives pages back.  Only the
+ * CPU side is exercised.
+ */
+int __init kgsl_page_pool_selftest(void)
+{
+	struct shrink_control sc = { .nr_to_scan = KGSL_PAGE_POOL_MAX };
+	struct page **pages;
+	unsigned int hits;
+	s64 miss_ns, hit_ns;
+	int ret = -ENOMEM;
+	const char *step;
+	ktime_t t;
+
+	pages = kmalloc(KGSL_POOL_TEST_PAGES * sizeof(*pages), GFP_KERNEL);
+	if (pages == NULL)
+		return -ENOMEM;
+
+	kgsl_page_pool_shrink(&kgsl_page_pool_shrinker, &sc);
+
+	step = "alloc";
+	t = ktime_get();
+	if (kgsl_page_pool_alloc(pages, KGSL_POOL_TEST_PAGES))
+		goto out;
+	miss_ns = ktime_to_ns(ktime_sub(ktime_get(), t));
+	ret = -EINVAL;
+	if (kgsl_page_pool_check(pages, 1))
+		goto out_free;
+	kgsl_page_pool_free(pages, KGSL_POOL_TEST_PAGES);
+
+	step = "refill";
+	if (kgsl_page_pool.count != KGSL_POOL_TEST_PAGES)
+		goto out;
+
+	step = "reuse";
+	hits = kgsl_page_pool.hits;
+	t = ktime_get();
+	if (kgsl_page_pool_alloc(pages, KGSL_POOL_TEST_PAGES)) {
+		ret = -ENOMEM;
+		goto out;
+	}
+	hit_ns = ktime_to_ns(ktime_sub(ktime_get(), t));
+	if (kgsl_page_pool.hits - hits != KGSL_POOL_TEST_PAGES ||
+	    kgsl_page_pool_check(pages, 0))
+		goto out_free;
+	kgsl_page_pool_free(pages, KGSL_POOL_TEST_PAGES);
+
+	step = "shrink";
+	sc.nr_to_scan = 10;
+	if (kgsl_page_pool_shrink(&kgsl_page_pool_shrinker, &sc) !=
+	    KGSL_POOL_TEST_PAGES - 10)
+		goto out;
+
+	ret = 0;
+	pr_info("kgsl: page pool self-test passed, %lld ns per page "
+		"allocated, %lld ns per page from the pool\n",
+		div_s64(miss_ns, KGSL_POOL_TEST_PAGES),
+		div_s64(hit_ns, KGSL_POOL_TEST_PAGES));
+	goto out;
+
+out_free:
+	kgsl_page_pool_free(pages, KGSL_POOL_TEST_PAGES);
+out:
+	if (ret)
+		KGSL_CORE_ERR("page pool self-test failed at %s\n", step);
+	kfree(pages);
+	return ret;
+}
+#endif
+
 static int kgsl_vmalloc_vmfault(struct kgsl_memdesc *memdesc,
 				struct vm_area_struct *vma,
 				struct vm_fault *vmf)
@@ -326,6 +605,55 @@ static void kgsl_vmalloc_free(struct kgsl_memdesc *memdesc)
 	vfree(memdesc->hostptr);
 }
 
+static int kgsl_page_alloc_vmfault(struct kgsl_memdesc *memdesc,
+				struct vm_area_struct *vma,
+				struct vm_fault *vmf)
+{
+	unsigned long pgoff;
+	struct page *page;
+
+	pgoff = ((unsigned long) vmf->virtual_address - vma->vm_start) >>
+		PAGE_SHIFT;
+	if (pgoff >= memdesc->sglen)
+		return VM_FAULT_SIGBUS;
+
+	page = sg_page(&memdesc->sg[pgoff]);
+	get_page(page);
+
+	/* userspace can write it from now on */
+	if (memdesc->dirty)
+		set_bit(pgoff, memdesc->dirty);
+
+	vmf->page = page;
+	return 0;
+}
+
+static void kgsl_page_alloc_free(struct kgsl_memdesc *memdesc)
+{
+	struct page **pages;
+	unsigned int i;
+
+	kgsl_driver.stats.vmalloc -= memdesc->size;
+	if (memdesc->hostptr)
+		vunmap(memdesc->hostptr);
+
+	if (memdesc->sg == NULL)
+		return;
+
+	/* sglen pages were allocated whenever the sg table exists */
+	pages = vmalloc(memdesc->sglen * sizeof(struct page *));
+	if (pages == NULL) {
+		for (i = 0; i < memdesc->sglen; i++)
+			__free_page(sg_page(&memdesc->sg[i]));
+		return;
+	}
+
+	for (i = 0; i < memdesc->sglen; i++)
+		pages[i] = sg_page(&memdesc->sg[i]);
+	kgsl_page_pool_free(pages, memdesc->sglen);
+	vfree(pages);
+}
+
 static int kgsl_contiguous_vmflags(struct kgsl_memdesc *memdesc)
 {
 	return VM_RESERVED | VM_IO | VM_PFNMAP | VM_DONTEXPAND;
@@ -377,6 +705,12 @@ struct kgsl_memdesc_ops kgsl_vmalloc_ops = {
 };
 EXPORT_SYMBOL(kgsl_vmalloc_ops);
 
+static struct kgsl_memdesc_ops kgsl_page_alloc_ops = {
+	.free = kgsl_page_alloc_free,
+	.vmflags = kgsl_vmalloc_vmflags,
+	.vmfault = kgsl_page_alloc_vmfault,
+};
+
 static struct kgsl_memdesc_ops kgsl_ebimem_ops = {
 	.free = kgsl_ebimem_free,
 	.vmflags = kgsl_contiguous_vmflags,
@@ -387,11 +721,35 @@ static struct kgsl_memdesc_ops kgsl_coherent_ops = {
 	.free = kgsl_coherent_free,
 };
 
+/*
+ * Clean only the pages marked in memdesc->dirty.  Untouched pages came
+ * out of the pool clean, and speculative fills never leave dirty lines,
+ * so there is nothing to write back for them.
+ */
+static void kgsl_cache_clean_dirty(struct kgsl_memdesc *memdesc)
+{
+	unsigned int i;
+	void *addr;
+
+	for_each_set_bit(i, memdesc->dirty, memdesc->sglen) {
+		addr = memdesc->hostptr + (i << PAGE_SHIFT);
+		dmac_clean_range(addr, addr + PAGE_SIZE);
+		_outer_cache_range_op(KGSL_CACHE_OP_CLEAN,
+				      kgsl_get_sg_pa(&memdesc->sg[i]),
+				      PAGE_SIZE);
+	}
+}
+
 void kgsl_cache_range_op(struct kgsl_memdesc *memdesc, int op)
 {
 	void *addr = memdesc->hostptr;
 	int size = memdesc->size;
 
+	if (op == KGSL_CACHE_OP_CLEAN && memdesc->dirty) {
+		kgsl_cache_clean_dirty(memdesc);
+		return;
+	}
+
 	switch (op) {
 	case KGSL_CACHE_OP_FLUSH:
 		dmac_flush_range(addr, addr + size);
@@ -409,41 +767,63 @@ void kgsl_cache_range_op(struct kgsl_memdesc *memdesc, int op)
 EXPORT_SYMBOL(kgsl_cache_range_op);
 
 static int
-_kgsl_sharedmem_vmalloc(struct kgsl_memdesc *memdesc,
+_kgsl_sharedmem_page_alloc(struct kgsl_memdesc *memdesc,
 			struct kgsl_pagetable *pagetable,
-			void *ptr, size_t size, unsigned int protflags)
+			size_t size, unsigned int protflags, bool track)
 {
 	int order, ret = 0;
 	int sglen = PAGE_ALIGN(size) / PAGE_SIZE;
+	struct page **pages;
 	int i;
 
 	memdesc->size = size;
 	memdesc->pagetable = pagetable;
 	memdesc->priv = KGSL_MEMFLAGS_CACHED;
-	memdesc->ops = &kgsl_vmalloc_ops;
-	memdesc->hostptr = (void *) ptr;
+	memdesc->ops = &kgsl_page_alloc_ops;
 
+	pages = vmalloc(sglen * sizeof(struct page *));
 	memdesc->sg = vmalloc(sglen * sizeof(struct scatterlist));
-	if (memdesc->sg == NULL) {
+	if (pages == NULL || memdesc->sg == NULL) {
+		vfree(memdesc->sg);
+		memdesc->sg = NULL;
 		ret = -ENOMEM;
 		goto done;
 	}
 
 	kmemleak_not_leak(memdesc->sg);
 
-	memdesc->sglen = sglen;
-	sg_init_table(memdesc->sg, sglen);
-
-	for (i = 0; i < memdesc->sglen; i++, ptr += PAGE_SIZE) {
-		struct page *page = vmalloc_to_page(ptr);
-		if (!page) {
-			ret = -EINVAL;
+	if (track) {
+		memdesc->dirty = kzalloc(BITS_TO_LONGS(sglen) *
+					 sizeof(unsigned long), GFP_KERNEL);
+		if (memdesc->dirty == NULL) {
+			vfree(memdesc->sg);
+			memdesc->sg = NULL;
+			ret = -ENOMEM;
 			goto done;
 		}
-		sg_set_page(&memdesc->sg[i], page, PAGE_SIZE, 0);
 	}
 
-	kgsl_cache_range_op(memdesc, KGSL_CACHE_OP_INV);
+	/* pool pages are zeroed and clean, no cache maintenance needed */
+	if (kgsl_page_pool_alloc(pages, sglen)) {
+		KGSL_CORE_ERR("page allocation of %d pages failed: "
+			"allocated=%d\n", sglen, kgsl_driver.stats.vmalloc);
+		vfree(memdesc->sg);
+		memdesc->sg = NULL;
+		ret = -ENOMEM;
+		goto done;
+	}
+
+	memdesc->sglen = sglen;
+	sg_init_table(memdesc->sg, sglen);
+	for (i = 0; i < sglen; i++)
+		sg_set_page(&memdesc->sg[i], pages[i], PAGE_SIZE, 0);
+
+	/* the sg table now owns the pages, the free op returns them */
+	memdesc->hostptr = vmap(pages, sglen, VM_MAP, PAGE_KERNEL);
+	if (memdesc->hostptr == NULL) {
+		ret = -ENOMEM;
+		goto done;
+	}
 
 	ret = kgsl_mmu_map(pagetable, memdesc, protflags);
 
@@ -459,6 +839,7 @@ _kgsl_sharedmem_vmalloc(struct kgsl_memdesc *memdesc,
 		kgsl_driver.stats.histogram[order]++;
 
 done:
+	vfree(pages);
 	if (ret)
 		kgsl_sharedmem_free(memdesc);
 
@@ -469,20 +850,16 @@ int
 kgsl_sharedmem_vmalloc(struct kgsl_memdesc *memdesc,
 		       struct kgsl_pagetable *pagetable, size_t size)
 {
-	void *ptr;
-
 	BUG_ON(size == 0);
 
 	size = ALIGN(size, PAGE_SIZE * 2);
-	ptr = vmalloc(size);
 
-	if (ptr  == NULL) {
-		KGSL_CORE_ERR("vmalloc(%d) failed\n", size);
-		return -ENOMEM;
-	}
-
-	return _kgsl_sharedmem_vmalloc(memdesc, pagetable, ptr, size,
-		GSL_PT_PAGE_RV | GSL_PT_PAGE_WV);
+	/*
+	 * Kernel buffers are written through hostptr all over the driver,
+	 * so they are not dirty tracked and always get full range ops.
+	 */
+	return _kgsl_sharedmem_page_alloc(memdesc, pagetable, size,
+		GSL_PT_PAGE_RV | GSL_PT_PAGE_WV, false);
 }
 EXPORT_SYMBOL(kgsl_sharedmem_vmalloc);
 
@@ -491,26 +868,16 @@ kgsl_sharedmem_vmalloc_user(struct kgsl_memdesc *memdesc,
 			    struct kgsl_pagetable *pagetable,
 			    size_t size, int flags)
 {
-	void *ptr;
 	unsigned int protflags;
 
 	BUG_ON(size == 0);
-	ptr = vmalloc_user(size);
-
-	if (ptr == NULL) {
-		KGSL_CORE_ERR("vmalloc_user(%d) failed: allocated=%d\n",
-			      size, kgsl_driver.stats.vmalloc);
-		return -ENOMEM;
-	}
-
-	kmemleak_not_leak(ptr);
 
 	protflags = GSL_PT_PAGE_RV;
 	if (!(flags & KGSL_MEMFLAGS_GPUREADONLY))
 		protflags |= GSL_PT_PAGE_WV;
 
-	return _kgsl_sharedmem_vmalloc(memdesc, pagetable, ptr, size,
-		protflags);
+	return _kgsl_sharedmem_page_alloc(memdesc, pagetable, size,
+		protflags, true);
 }
 EXPORT_SYMBOL(kgsl_sharedmem_vmalloc_user);
 
@@ -561,6 +928,7 @@ void kgsl_sharedmem_free(struct kgsl_memdesc *memdesc)
 		memdesc->ops->free(memdesc);
 
 	vfree(memdesc->sg);
+	kfree(memdesc->dirty);
 
 	memset(memdesc, 0, sizeof(*memdesc));
 }
@@ -675,6 +1043,8 @@ kgsl_sharedmem_writel(const struct kgsl_memdesc *memdesc,
 		src, sizeof(uint32_t));
 	dst = (uint32_t *)(memdesc->hostptr + offsetbytes);
 	*dst = src;
+	if (memdesc->dirty)
+		set_bit(offsetbytes >> PAGE_SHIFT, memdesc->dirty);
 	return 0;
 }
 EXPORT_SYMBOL(kgsl_sharedmem_writel);
@@ -689,6 +1059,10 @@ kgsl_sharedmem_set(const struct kgsl_memdesc *memdesc, unsigned int offsetbytes,
 	kgsl_cffdump_setmem(memdesc->gpuaddr + offsetbytes, value,
 			    sizebytes);
 	memset(memdesc->hostptr + offsetbytes, value, sizebytes);
+	if (memdesc->dirty && sizebytes)
+		bitmap_set(memdesc->dirty, offsetbytes >> PAGE_SHIFT,
+			((offsetbytes + sizebytes - 1) >> PAGE_SHIFT) -
+			(offsetbytes >> PAGE_SHIFT) + 1);
 	return 0;
 }
 EXPORT_SYMBOL(kgsl_sharedmem_set);
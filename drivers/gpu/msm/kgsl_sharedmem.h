@@ -78,6 +78,18 @@ void kgsl_process_uninit_sysfs(struct kgsl_process_private *private);
 int kgsl_sharedmem_init_sysfs(void);
 void kgsl_sharedmem_uninit_sysfs(void);
 
+void kgsl_page_pool_init(void);
+void kgsl_page_pool_exit(void);
+
+#ifdef CONFIG_MSM_KGSL_MEM_SELFTEST
+int kgsl_page_pool_selftest(void);
+#else
+static inline int kgsl_page_pool_selftest(void)
+{
+	return 0;
+}
+#endif
+
 static inline unsigned int kgsl_get_sg_pa(struct scatterlist *sg)
 {
 	/*
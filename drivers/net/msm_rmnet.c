@@ -77,6 +77,9 @@ static const char *ch_name[RMNET_DEVICE_COUNT] = {
 
 #define HEADROOM_FOR_QOS    8
 
+/* Max packets pulled from SMD per NAPI poll */
+#define RMNET_NAPI_WEIGHT 64
+
 static struct completion *port_complete[RMNET_DEVICE_COUNT];
 
 struct rmnet_private
@@ -94,6 +97,7 @@ struct rmnet_private
 	struct sk_buff *skb;
 	spinlock_t lock;
 	struct tasklet_struct tsklt;
+	struct napi_struct napi;
 	u32 operation_mode;    /* IOCTL specified mode (protocol, QoS header) */
 	struct platform_driver pdrv;
 	struct completion complete;
@@ -256,80 +260,130 @@ static __be16 rmnet_ip_type_trans(struct sk_buff *skb, struct net_device *dev)
 	return protocol;
 }
 
-static void smd_net_data_handler(unsigned long arg);
-static DECLARE_TASKLET(smd_net_data_tasklet, smd_net_data_handler, 0);
+static int smd_net_rx_pending(struct rmnet_private *p)
+{
+	int sz;
+
+	if (!p->ch)
+		return 0;
+	sz = smd_cur_packet_size(p->ch);
+	return sz && smd_read_avail(p->ch) >= sz;
+}
 
-/* Called in soft-irq context */
-static void smd_net_data_handler(unsigned long arg)
+/*
+ * NAPI poll, called in soft-irq context.
+ * Pulls up to budget packets off the SMD channel and hands them to GRO.
+ */
+static int rmnet_poll(struct napi_struct *napi, int budget)
 {
-	struct net_device *dev = (struct net_device *) arg;
-	struct rmnet_private *p = netdev_priv(dev);
+	struct rmnet_private *p = container_of(napi, struct rmnet_private,
+					       napi);
+	struct net_device *dev = napi->dev;
 	struct sk_buff *skb;
-	void *ptr = 0;
+	void *ptr;
 	int sz;
-	u32 opmode = p->operation_mode;
+	int work = 0;
+	u32 opmode;
 	unsigned long flags;
 
-	for (;;) {
+	spin_lock_irqsave(&p->lock, flags);
+	opmode = p->operation_mode;
+	spin_unlock_irqrestore(&p->lock, flags);
+
+	while (work < budget) {
+		if (!smd_net_rx_pending(p))
+			break;
 		sz = smd_cur_packet_size(p->ch);
-		if (sz == 0) break;
-		if (smd_read_avail(p->ch) < sz) break;
 
-		skb = dev_alloc_skb(sz + NET_IP_ALIGN);
+		skb = netdev_alloc_skb(dev, sz + NET_IP_ALIGN);
 		if (skb == NULL) {
 			pr_err("[%s] rmnet_recv() cannot allocate skb\n",
 			       dev->name);
-			/* out of memory, reschedule a later attempt */
-			smd_net_data_tasklet.data = (unsigned long)dev;
-			tasklet_schedule(&smd_net_data_tasklet);
-			break;
+			/* out of memory, stay on the poll list and retry */
+			smd_kick(p->ch);
+			return budget;
+		}
+		skb_reserve(skb, NET_IP_ALIGN);
+		ptr = skb_put(skb, sz);
+		wake_lock_timeout(&p->wake_lock, HZ / 2);
+		if (smd_read_nokick(p->ch, ptr, sz) != sz) {
+			pr_err("[%s] rmnet_recv() smd lied about avail?!",
+				dev->name);
+			dev_kfree_skb_any(skb);
+			continue;
+		}
+		work++;
+
+		/* Handle Rx frame format */
+		if (RMNET_IS_MODE_IP(opmode)) {
+			/* Driver in IP mode */
+			skb_reset_mac_header(skb);
+			skb->protocol = rmnet_ip_type_trans(skb, dev);
 		} else {
-			skb->dev = dev;
-			skb_reserve(skb, NET_IP_ALIGN);
-			ptr = skb_put(skb, sz);
-			wake_lock_timeout(&p->wake_lock, HZ / 2);
-			if (smd_read(p->ch, ptr, sz) != sz) {
-				pr_err("[%s] rmnet_recv() smd lied about avail?!",
-					dev->name);
-				ptr = 0;
-				dev_kfree_skb_irq(skb);
-			} else {
-				/* Handle Rx frame format */
-				spin_lock_irqsave(&p->lock, flags);
-				opmode = p->operation_mode;
-				spin_unlock_irqrestore(&p->lock, flags);
-
-				if (RMNET_IS_MODE_IP(opmode)) {
-					/* Driver in IP mode */
-					skb->protocol =
-					  rmnet_ip_type_trans(skb, dev);
-				} else {
-					/* Driver in Ethernet mode */
-					skb->protocol =
-					  eth_type_trans(skb, dev);
-				}
-				if (RMNET_IS_MODE_IP(opmode) ||
-				    count_this_packet(ptr, skb->len)) {
+			/* Driver in Ethernet mode */
+			skb->protocol = eth_type_trans(skb, dev);
+		}
+		if (RMNET_IS_MODE_IP(opmode) ||
+		    count_this_packet(ptr, skb->len)) {
 #ifdef CONFIG_MSM_RMNET_DEBUG
-					p->wakeups_rcv +=
-					rmnet_cause_wakeup(p);
+			p->wakeups_rcv += rmnet_cause_wakeup(p);
 #endif
-					p->stats.rx_packets++;
-					p->stats.rx_bytes += skb->len;
-				}
-				DBG1("[%s] Rx packet #%lu len=%d\n",
-					dev->name, p->stats.rx_packets,
-					skb->len);
-
-				/* Deliver to network stack */
-				netif_rx(skb);
-			}
-			continue;
+			p->stats.rx_packets++;
+			p->stats.rx_bytes += skb->len;
 		}
-		if (smd_read(p->ch, ptr, sz) != sz)
-			pr_err("[%s] rmnet_recv() smd lied about avail?!",
-				dev->name);
+		DBG1("[%s] Rx packet #%lu len=%d\n",
+			dev->name, p->stats.rx_packets, skb->len);
+
+		/* Deliver to network stack */
+		napi_gro_receive(napi, skb);
 	}
+
+	/* one interrupt to the modem for everything consumed above */
+	smd_kick(p->ch);
+
+	if (work < budget) {
+		napi_complete(napi);
+		/*
+		 * SMD only notifies on new data, so pick up anything that
+		 * raced in between the last read and napi_complete().
+		 */
+		if (smd_net_rx_pending(p))
+			napi_schedule(napi);
+	}
+	return work;
+}
+
+/*
+ * Copy skb straight into the SMD FIFO as one packet and signal the modem
+ * once it is complete.
+ */
+static int rmnet_smd_write(smd_channel_t *ch, struct sk_buff *skb)
+{
+	void *dst;
+	int n, ret, done = 0;
+
+	/* A packet that was started must be finished, so check room first */
+	if (smd_write_avail(ch) < skb->len)
+		return -ENOMEM;
+
+	ret = smd_write_start(ch, skb->len);
+	if (ret < 0)
+		return ret;
+
+	while (done < skb->len) {
+		n = smd_write_buffer(ch, &dst);
+		if (n <= 0)
+			break;
+		if (n > skb->len - done)
+			n = skb->len - done;
+		skb_copy_bits(skb, done, dst, n);
+		smd_write_done(ch, n);
+		done += n;
+	}
+
+	ret = smd_write_end(ch);
+	smd_kick(ch);
+	return ret < 0 ? ret : done;
 }
 
 static int _rmnet_xmit(struct sk_buff *skb, struct net_device *dev)
@@ -355,9 +409,9 @@ static int _rmnet_xmit(struct sk_buff *skb, struct net_device *dev)
 	}
 
 	dev->trans_start = jiffies;
-	smd_ret = smd_write(ch, skb->data, skb->len);
+	smd_ret = rmnet_smd_write(ch, skb);
 	if (smd_ret != skb->len) {
-		pr_err("[%s] %s: smd_write returned error %d",
+		pr_err("[%s] %s: smd write returned error %d",
 			dev->name, __func__, smd_ret);
 		p->stats.tx_errors++;
 		goto xmit_out;
@@ -447,11 +501,9 @@ static void smd_net_notify(void *_dev, unsigned event)
 
 		spin_unlock(&p->lock);
 
-		if (smd_read_avail(p->ch) &&
-			(smd_read_avail(p->ch) >= smd_cur_packet_size(p->ch))) {
-			smd_net_data_tasklet.data = (unsigned long) _dev;
-			tasklet_schedule(&smd_net_data_tasklet);
-		}
+		/* Further notifications are absorbed while polling */
+		if (smd_net_rx_pending(p))
+			napi_schedule(&p->napi);
 		break;
 
 	case SMD_EVENT_OPEN:
@@ -516,13 +568,18 @@ static int __rmnet_close(struct net_device *dev)
 
 static int rmnet_open(struct net_device *dev)
 {
+	struct rmnet_private *p = netdev_priv(dev);
 	int rc = 0;
 
 	DBG0("[%s] rmnet_open()\n", dev->name);
 
 	rc = __rmnet_open(dev);
-	if (rc == 0)
+	if (rc == 0) {
+		napi_enable(&p->napi);
 		netif_start_queue(dev);
+		/* Drain whatever queued up while we were down */
+		napi_schedule(&p->napi);
+	}
 
 	return rc;
 }
@@ -534,6 +591,7 @@ static int rmnet_stop(struct net_device *dev)
 	DBG0("[%s] rmnet_stop()\n", dev->name);
 
 	netif_stop_queue(dev);
+	napi_disable(&p->napi);
 	tasklet_kill(&p->tsklt);
 
 	/* TODO: unload modem safely,
@@ -797,6 +855,7 @@ static int __init rmnet_init(void)
 		spin_lock_init(&p->lock);
 		tasklet_init(&p->tsklt, _rmnet_resume_flow,
 				(unsigned long)dev);
+		netif_napi_add(dev, &p->napi, rmnet_poll, RMNET_NAPI_WEIGHT);
 		wake_lock_init(&p->wake_lock, WAKE_LOCK_SUSPEND, ch_name[n]);
 #ifdef CONFIG_MSM_RMNET_DEBUG
 		p->timeout_us = timeout_us;
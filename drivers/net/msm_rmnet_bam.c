@@ -68,6 +68,9 @@ module_param_named(debug_enable, msm_rmnet_bam_debug_mask,
 #define HEADROOM_FOR_QOS    8
 #define TAILROOM            8 /* for padding by mux layer */
 
+/* Max packets handed to the stack per NAPI poll */
+#define RMNET_NAPI_WEIGHT 64
+
 struct rmnet_private {
 	struct net_device_stats stats;
 	uint32_t ch_id;
@@ -80,6 +83,8 @@ struct rmnet_private {
 	struct sk_buff *waiting_for_ul_skb;
 	spinlock_t lock;
 	struct tasklet_struct tsklt;
+	struct napi_struct napi;
+	struct sk_buff_head rx_queue;  /* filled by bam_dmux, drained by NAPI */
 	u32 operation_mode; /* IOCTL specified mode (protocol, QoS header) */
 	uint8_t device_up;
 	uint8_t in_reset;
@@ -243,22 +248,35 @@ static int count_this_packet(void *_hdr, int len)
 	return 1;
 }
 
-/* Rx Callback, Called in Work Queue context */
-static void bam_recv_notify(void *dev, struct sk_buff *skb)
+/*
+ * NAPI poll, called in soft-irq context.
+ * Hands up to budget packets queued by bam_recv_notify() to GRO.
+ */
+static int rmnet_poll(struct napi_struct *napi, int budget)
 {
-	struct rmnet_private *p = netdev_priv(dev);
+	struct rmnet_private *p = container_of(napi, struct rmnet_private,
+					       napi);
+	struct net_device *dev = napi->dev;
+	struct sk_buff *skb;
 	unsigned long flags;
+	int work = 0;
 	u32 opmode;
 
-	if (skb) {
+	spin_lock_irqsave(&p->lock, flags);
+	opmode = p->operation_mode;
+	spin_unlock_irqrestore(&p->lock, flags);
+
+	while (work < budget) {
+		skb = skb_dequeue(&p->rx_queue);
+		if (!skb)
+			break;
+		work++;
+
 		skb->dev = dev;
 		/* Handle Rx frame format */
-		spin_lock_irqsave(&p->lock, flags);
-		opmode = p->operation_mode;
-		spin_unlock_irqrestore(&p->lock, flags);
-
 		if (RMNET_IS_MODE_IP(opmode)) {
 			/* Driver in IP mode */
+			skb_reset_mac_header(skb);
 			skb->protocol = rmnet_ip_type_trans(skb, dev);
 		} else {
 			/* Driver in Ethernet mode */
@@ -273,14 +291,46 @@ static void bam_recv_notify(void *dev, struct sk_buff *skb)
 			p->stats.rx_bytes += skb->len;
 		}
 		DBG1("[%s] Rx packet #%lu len=%d\n",
-			((struct net_device *)dev)->name,
-			p->stats.rx_packets, skb->len);
+			dev->name, p->stats.rx_packets, skb->len);
 
 		/* Deliver to network stack */
-		netif_rx(skb);
-	} else
+		napi_gro_receive(napi, skb);
+	}
+
+	if (work < budget) {
+		napi_complete(napi);
+		if (!skb_queue_empty(&p->rx_queue))
+			napi_schedule(napi);
+	}
+	return work;
+}
+
+/* Rx Callback, Called in Work Queue context */
+static void bam_recv_notify(void *dev, struct sk_buff *skb)
+{
+	struct rmnet_private *p = netdev_priv(dev);
+
+	if (!skb) {
 		pr_err("[%s] %s: No skb received",
 			((struct net_device *)dev)->name, __func__);
+		return;
+	}
+
+	if (skb_queue_len(&p->rx_queue) >= netdev_max_backlog) {
+		p->stats.rx_dropped++;
+		dev_kfree_skb_any(skb);
+		return;
+	}
+	skb_queue_tail(&p->rx_queue, skb);
+
+	/*
+	 * Already polling: the packet is picked up by the current run.
+	 * BHs are disabled so that the poll runs on local_bh_enable()
+	 * rather than at the next unrelated softirq.
+	 */
+	local_bh_disable();
+	napi_schedule(&p->napi);
+	local_bh_enable();
 }
 
 static int _rmnet_xmit(struct sk_buff *skb, struct net_device *dev)
@@ -403,14 +453,19 @@ static int __rmnet_open(struct net_device *dev)
 
 static int rmnet_open(struct net_device *dev)
 {
+	struct rmnet_private *p = netdev_priv(dev);
 	int rc = 0;
 
 	DBG0("[%s] rmnet_open()\n", dev->name);
 
 	rc = __rmnet_open(dev);
 
-	if (rc == 0)
+	if (rc == 0) {
+		napi_enable(&p->napi);
 		netif_start_queue(dev);
+		/* Drain whatever queued up while we were down */
+		napi_schedule(&p->napi);
+	}
 
 	return rc;
 }
@@ -433,10 +488,14 @@ static int __rmnet_close(struct net_device *dev)
 
 static int rmnet_stop(struct net_device *dev)
 {
+	struct rmnet_private *p = netdev_priv(dev);
+
 	DBG0("[%s] rmnet_stop()\n", dev->name);
 
 	__rmnet_close(dev);
 	netif_stop_queue(dev);
+	napi_disable(&p->napi);
+	skb_queue_purge(&p->rx_queue);
 
 	return 0;
 }
@@ -770,6 +829,8 @@ static int __init rmnet_init(void)
 		p->waiting_for_ul_skb = NULL;
 		p->in_reset = 0;
 		spin_lock_init(&p->lock);
+		skb_queue_head_init(&p->rx_queue);
+		netif_napi_add(dev, &p->napi, rmnet_poll, RMNET_NAPI_WEIGHT);
 #ifdef CONFIG_MSM_RMNET_DEBUG
 		p->timeout_us = timeout_us;
 		p->wakeups_xmit = p->wakeups_rcv = 0;
@@ -1771,6 +1771,10 @@ static void mdp_drv_init(void)
 		atomic_set(&mdp_block_power_cnt[i], 0);
 	}
 
+#if defined(CONFIG_FB_MSM_OVERLAY) && defined(CONFIG_FB_MSM_MDP40)
+	mdp4_overlay_sched_init();
+#endif
+
 #ifdef MSM_FB_ENABLE_DBGFS
 	{
 		struct dentry *root;
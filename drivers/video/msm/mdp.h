@@ -182,6 +182,17 @@ struct mdp_dirty_region {
 	__u32 height;		/* number of pixels in the y-axis */
 };
 
+struct mdp_dirty_statistic {
+	ulong pans;		/* regions passed to mdp_set_dma_pan_info() */
+	ulong merged;		/* pans joining a not yet sent update */
+	ulong frames;		/* DMA_P updates */
+	u64 requested;		/* pixels panned */
+	u64 pixels;		/* pixels transferred */
+	u64 full;		/* pixels full screen updates would transfer */
+};
+
+extern struct mdp_dirty_statistic mdp_dirty_stat;
+
 /*
  * MDP extended data types
  */
@@ -708,6 +719,25 @@ void mdp_set_dma_pan_info(struct fb_info *info, struct mdp_dirty_region *dirty,
 void mdp_dma_pan_update(struct fb_info *info);
 void mdp_refresh_screen(unsigned long data);
 int mdp_ppp_blit(struct fb_info *info, struct mdp_blit_req *req);
+#ifdef CONFIG_FB_MSM_MDP_PPP_SW
+int mdp_ppp_sw_blit(struct mdp_blit_req *req, void *src,
+		    unsigned long src_len, struct file *src_file,
+		    void *dst, unsigned long dst_len, struct file *dst_file);
+void mdp_ppp_sw_hw_enter(void);
+void mdp_ppp_sw_hw_exit(struct mdp_blit_req *req, ktime_t start);
+#else
+static inline int mdp_ppp_sw_blit(struct mdp_blit_req *req, void *src,
+				  unsigned long src_len,
+				  struct file *src_file, void *dst,
+				  unsigned long dst_len,
+				  struct file *dst_file)
+{
+	return -ENODEV;
+}
+static inline void mdp_ppp_sw_hw_enter(void) { }
+static inline void mdp_ppp_sw_hw_exit(struct mdp_blit_req *req,
+				      ktime_t start) { }
+#endif
 void mdp_lcd_update_workqueue_handler(struct work_struct *work);
 void mdp_vsync_resync_workqueue_handler(struct work_struct *work);
 void mdp_dma2_update(struct msm_fb_data_type *mfd);
@@ -789,6 +819,9 @@ void mdp_vsync_clk_enable(void);
 
 #ifdef CONFIG_DEBUG_FS
 int mdp_debugfs_init(void);
+#ifdef CONFIG_FB_MSM_MDP_PPP_SW
+void mdp_ppp_sw_debugfs_init(struct dentry *parent);
+#endif
 #endif
 
 void mdp_dma_s_update(struct msm_fb_data_type *mfd);
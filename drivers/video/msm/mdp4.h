@@ -26,6 +26,8 @@ extern spinlock_t mdp_spin_lock;
 extern struct mdp4_statistic mdp4_stat;
 extern uint32 mdp4_extn_disp;
 extern uint32 mdp4_mddi_high_clk;
+extern u32 mdp4_commit_sched_on;
+extern u32 mdp4_commit_margin_us;
 
 #define MDP4_OVERLAYPROC0_BASE	0x10000
 #define MDP4_OVERLAYPROC1_BASE	0x18000
@@ -379,8 +381,51 @@ struct mdp4_statistic {
 	ulong err_stage;
 	ulong err_play;
 	ulong err_underflow;
+	ulong commit_sched;	/* vsync latched mixer commits */
+	ulong commit_late;	/* latched commit landed after vsync */
 };
 
+/*
+ * frame timeline
+ *
+ * Every commit, engine kickoff, engine done and vsync is stamped into a
+ * lockless ring so the distance between a commit and the vsync it was
+ * meant for can be read back from debugfs (mdp/timeline) or ftrace.
+ */
+enum {
+	MDP4_TL_COMMIT,		/* unit = mixer */
+	MDP4_TL_SCHED,		/* vsync latched commit, unit = mixer */
+	MDP4_TL_KICKOFF,	/* unit = MDP4_TL_OV0 ... */
+	MDP4_TL_DONE,		/* unit = MDP4_TL_OV0 ... */
+	MDP4_TL_VSYNC,		/* unit = 0 primary, 1 external */
+	MDP4_TL_EVENT_MAX
+};
+
+enum {
+	MDP4_TL_OV0,
+	MDP4_TL_OV1,
+	MDP4_TL_OV2,
+	MDP4_TL_DMA_P,
+	MDP4_TL_DMA_S,
+	MDP4_TL_DMA_E,
+	MDP4_TL_UNIT_MAX
+};
+
+#define MDP4_TL_SIZE	256	/* entries, power of 2 */
+
+struct mdp4_tl_entry {
+	s64 ns;
+	u32 seq;	/* 0 while the slot is being written */
+	u32 frame;	/* vsyncs seen on the unit's interface */
+	u16 event;
+	u16 unit;
+};
+
+void mdp4_tl_record(int event, int unit);
+void mdp4_tl_reset(void);
+int mdp4_tl_read(struct mdp4_tl_entry *buf, int max);
+int mdp4_tl_next_vsync(int intf, s64 lead_ns, ktime_t *next);
+
 struct mdp4_overlay_pipe *mdp4_overlay_ndx2pipe(int ndx);
 void mdp4_sw_reset(unsigned long bits);
 void mdp4_display_intf_sel(int output, unsigned long intf);
@@ -412,6 +457,7 @@ void mdp4_dmap_csc_setup(void);
 void mdp4_vg_csc_update(struct mdp_csc *p);
 irqreturn_t mdp4_isr(int irq, void *ptr);
 void mdp4_overlay_format_to_pipe(uint32 format, struct mdp4_overlay_pipe *pipe);
+void mdp4_overlay_sched_init(void);
 uint32 mdp4_overlay_format(struct mdp4_overlay_pipe *pipe);
 uint32 mdp4_overlay_unpack_pattern(struct mdp4_overlay_pipe *pipe);
 uint32 mdp4_overlay_op_mode(struct mdp4_overlay_pipe *pipe);
@@ -33,6 +33,7 @@
 #include <linux/semaphore.h>
 #include <linux/uaccess.h>
 #include <linux/mutex.h>
+#include <linux/workqueue.h>
 #include <linux/msm_kgsl.h>
 #include "mdp.h"
 #include "msm_fb.h"
@@ -100,6 +101,36 @@ static int new_perf_level;
 /* static array with index 0 for unset status and 1 for set status */
 static bool overlay_status[MDP4_OVERLAY_TYPE_MAX];
 
+/*
+ * vsync latched commit
+ *
+ * A MDP_OV_PLAY_NOWAIT play only stages its pipe. Instead of leaving the
+ * mixer uncommitted until userspace follows up with play_wait, a timer is
+ * armed mdp4_commit_margin_us ahead of the next predicted vsync and the
+ * work it kicks commits whatever was staged last, so a burst of plays
+ * within one frame is latched by a single commit that lands before the
+ * frame scans out. Without a live vsync to predict from nothing is armed
+ * and play_wait commits as before.
+ *
+ * This breaks clients that stage several pipes with NOWAIT and rely on
+ * play_wait to commit them together, since the timer may fire between
+ * two plays and scan out a half-staged frame. It is therefore off unless
+ * enabled through debugfs "commit_sched".
+ */
+struct mdp4_commit_sched {
+	struct msm_fb_data_type *mfd;
+	int mixer;
+	int pending;
+	ktime_t vsync;		/* vsync the armed commit aims at */
+	struct hrtimer timer;
+	struct work_struct work;
+};
+
+static struct mdp4_commit_sched commit_sched[MDP4_MIXER_MAX];
+static struct workqueue_struct *commit_wq;
+u32 mdp4_commit_sched_on;
+u32 mdp4_commit_margin_us = 3000;
+
 void mdp4_overlay_status_write(enum mdp4_overlay_status type, bool val)
 {
 	overlay_status[type] = val;
@@ -1413,10 +1444,88 @@ static void mdp4_mixer_stage_commit(int mixer)
 	}
 	mdp_pipe_ctrl(MDP_CMD_BLOCK, MDP_BLOCK_POWER_OFF, FALSE);
 
+	commit_sched[mixer].pending = 0;
+	mdp4_tl_record(MDP4_TL_COMMIT, mixer);
+
 	if (data && pipe_cnt == 1)
 		mdp4_update_perf_level(OVERLAY_PERF_LEVEL4);
 }
 
+static enum hrtimer_restart mdp4_commit_sched_timer(struct hrtimer *timer)
+{
+	struct mdp4_commit_sched *cs =
+		container_of(timer, struct mdp4_commit_sched, timer);
+
+	queue_work(commit_wq, &cs->work);
+
+	return HRTIMER_NORESTART;
+}
+
+static void mdp4_commit_sched_work(struct work_struct *work)
+{
+	struct mdp4_commit_sched *cs =
+		container_of(work, struct mdp4_commit_sched, work);
+	struct msm_fb_data_type *mfd = cs->mfd;
+
+	mutex_lock(&mfd->dma->ov_mutex);
+	if (cs->pending && mfd->panel_power_on) {
+		mdp4_tl_record(MDP4_TL_SCHED, cs->mixer);
+		mdp4_mixer_stage_commit(cs->mixer);
+		mdp4_stat.commit_sched++;
+		if (ktime_to_ns(ktime_sub(ktime_get(), cs->vsync)) > 0)
+			mdp4_stat.commit_late++;
+	}
+	cs->pending = 0;
+	mutex_unlock(&mfd->dma->ov_mutex);
+}
+
+/*
+ * called with ov_mutex held after a NOWAIT play staged its pipe
+ */
+static void mdp4_overlay_sched_commit(struct msm_fb_data_type *mfd,
+				      int mixer)
+{
+	struct mdp4_commit_sched *cs;
+	s64 lead;
+
+	/* mixer2 (writeback) has no vsync to aim at */
+	if (!mdp4_commit_sched_on || !commit_wq || mixer > MDP4_MIXER1)
+		return;
+
+	cs = &commit_sched[mixer];
+	cs->mfd = mfd;
+	cs->pending = 1;
+	if (hrtimer_active(&cs->timer))
+		return;		/* already armed for this frame */
+
+	lead = (s64)mdp4_commit_margin_us * NSEC_PER_USEC;
+	if (mdp4_tl_next_vsync(mixer, lead, &cs->vsync))
+		return;
+
+	hrtimer_start(&cs->timer, ktime_sub_ns(cs->vsync, lead),
+		      HRTIMER_MODE_ABS);
+}
+
+void mdp4_overlay_sched_init(void)
+{
+	struct mdp4_commit_sched *cs;
+	int i;
+
+	commit_wq = alloc_workqueue("mdp4_commit_wq", WQ_HIGHPRI, 0);
+	if (!commit_wq) {
+		pr_err("%s: alloc_workqueue failed\n", __func__);
+		return;
+	}
+
+	for (i = MDP4_MIXER0; i < MDP4_MIXER_MAX; i++) {
+		cs = &commit_sched[i];
+		cs->mixer = i;
+		hrtimer_init(&cs->timer, CLOCK_MONOTONIC, HRTIMER_MODE_ABS);
+		cs->timer.function = mdp4_commit_sched_timer;
+		INIT_WORK(&cs->work, mdp4_commit_sched_work);
+	}
+}
+
 void mdp4_mixer_stage_up(struct mdp4_overlay_pipe *pipe)
 {
 	struct mdp4_overlay_pipe *spipe;
@@ -2683,6 +2792,9 @@ int mdp4_overlay_play(struct fb_info *info, struct msmfb_overlay_data *req)
 
 	mdp4_mixer_stage_up(pipe);
 
+	if (pipe->flags & MDP_OV_PLAY_NOWAIT)
+		mdp4_overlay_sched_commit(mfd, pipe->mixer_num);
+
 	if (pipe->mixer_num == MDP4_MIXER2) {
 		ctrl->mixer2_played++;
 #ifdef CONFIG_FB_MSM_WRITEBACK_MSM_PANEL
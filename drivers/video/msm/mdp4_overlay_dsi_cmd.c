@@ -442,6 +442,7 @@ void mdp4_dma_p_done_dsi(struct mdp_dma_data *dma)
 	/* kick off dmap */
 	outpdw(MDP_BASE + 0x000c, 0x0);
 	mdp4_stat.kickoff_dmap++;
+	mdp4_tl_record(MDP4_TL_KICKOFF, MDP4_TL_DMA_P);
 	/* trigger dsi cmd engine */
 	mipi_dsi_cmd_mdp_start();
 
@@ -503,6 +504,7 @@ void mdp4_overlay0_done_dsi_cmd(struct mdp_dma_data *dma)
 	/* kick off dmap */
 	outpdw(MDP_BASE + 0x000c, 0x0);
 	mdp4_stat.kickoff_dmap++;
+	mdp4_tl_record(MDP4_TL_KICKOFF, MDP4_TL_DMA_P);
 	/* trigger dsi cmd engine */
 	mipi_dsi_cmd_mdp_start();
 	mdp_disable_irq_nosync(MDP_OVERLAY0_TERM);
@@ -649,6 +651,7 @@ void mdp4_dsi_cmd_overlay_kickoff(struct msm_fb_data_type *mfd,
 	spin_unlock_irqrestore(&mdp_spin_lock, flag);
 	mdp_pipe_kickoff(MDP_OVERLAY0_TERM, mfd);
 	mdp4_stat.kickoff_ov0++;
+	mdp4_tl_record(MDP4_TL_KICKOFF, MDP4_TL_OV0);
 }
 
 void mdp_dsi_cmd_overlay_suspend(void)
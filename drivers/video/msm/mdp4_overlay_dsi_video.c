@@ -500,6 +500,7 @@ void mdp4_overlay_dsi_video_vsync_push(struct msm_fb_data_type *mfd,
 		spin_unlock_irqrestore(&mdp_spin_lock, flag);
 		outpdw(MDP_BASE + 0x0004, 0); /* kickoff overlay engine */
 		mdp4_stat.kickoff_ov0++;
+		mdp4_tl_record(MDP4_TL_KICKOFF, MDP4_TL_OV0);
 		mb();
 		mdp4_overlay_dsi_video_wait4event(mfd, INTR_DMA_P_DONE);
 	} else {
@@ -563,6 +564,7 @@ static void mdp4_overlay_dsi_video_prefill(struct msm_fb_data_type *mfd)
 		spin_unlock_irqrestore(&mdp_spin_lock, flag);
 		outpdw(MDP_BASE + 0x0004, 0); /* kickoff overlay engine */
 		mdp4_stat.kickoff_ov0++;
+		mdp4_tl_record(MDP4_TL_KICKOFF, MDP4_TL_OV0);
 		mb();
 	}
 }
@@ -411,6 +411,7 @@ void mdp4_overlay_lcdc_vsync_push(struct msm_fb_data_type *mfd,
 		spin_unlock_irqrestore(&mdp_spin_lock, flag);
 		outpdw(MDP_BASE + 0x0004, 0); /* kickoff overlay engine */
 		mdp4_stat.kickoff_ov0++;
+		mdp4_tl_record(MDP4_TL_KICKOFF, MDP4_TL_OV0);
 		mb();
 		mdp4_overlay_lcdc_wait4event(mfd, INTR_DMA_P_DONE);
 	} else {
@@ -477,6 +477,7 @@ void mdp4_mddi_overlay_kickoff(struct msm_fb_data_type *mfd,
 	/* start OVERLAY pipe */
 	mdp_pipe_kickoff(MDP_OVERLAY0_TERM, mfd);
 	mdp4_stat.kickoff_ov0++;
+	mdp4_tl_record(MDP4_TL_KICKOFF, MDP4_TL_OV0);
 }
 
 void mdp4_dma_s_update_lcd(struct msm_fb_data_type *mfd,
@@ -560,6 +561,7 @@ void mdp4_mddi_dma_s_kickoff(struct msm_fb_data_type *mfd,
 	/* start dma_s pipe */
 	mdp_pipe_kickoff(MDP_DMA_S_TERM, mfd);
 	mdp4_stat.kickoff_dmas++;
+	mdp4_tl_record(MDP4_TL_KICKOFF, MDP4_TL_DMA_S);
 
 	/* wait until DMA finishes the current job */
 	wait_for_completion(&mfd->dma->comp);
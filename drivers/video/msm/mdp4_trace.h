@@ -0,0 +1,66 @@
+/* Copyright (C) 2026 agent <agent@local>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 and
+ * only version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+#if !defined(_MDP4_TRACE_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _MDP4_TRACE_H
+
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM mdp4
+#undef TRACE_INCLUDE_PATH
+#define TRACE_INCLUDE_PATH .
+#undef TRACE_INCLUDE_FILE
+#define TRACE_INCLUDE_FILE mdp4_trace
+
+#include <linux/tracepoint.h>
+
+/*
+ * Tracepoint for the mdp4 frame timeline, one per ring entry
+ */
+TRACE_EVENT(mdp4_timeline,
+
+	TP_PROTO(int tl_event, int unit, unsigned int frame, unsigned int seq),
+
+	TP_ARGS(tl_event, unit, frame, seq),
+
+	TP_STRUCT__entry(
+		__field(int, tl_event)
+		__field(int, unit)
+		__field(unsigned int, frame)
+		__field(unsigned int, seq)
+	),
+
+	TP_fast_assign(
+		__entry->tl_event = tl_event;
+		__entry->unit = unit;
+		__entry->frame = frame;
+		__entry->seq = seq;
+	),
+
+	TP_printk(
+		"seq=%u frame=%u event=%s unit=%d",
+		__entry->seq,
+		__entry->frame,
+		__print_symbolic(__entry->tl_event,
+			{ MDP4_TL_COMMIT, "commit" },
+			{ MDP4_TL_SCHED, "sched" },
+			{ MDP4_TL_KICKOFF, "kickoff" },
+			{ MDP4_TL_DONE, "done" },
+			{ MDP4_TL_VSYNC, "vsync" }),
+		__entry->unit
+	)
+);
+
+#endif /* _MDP4_TRACE_H */
+
+/* This part must be outside protection */
+#include <trace/define_trace.h>
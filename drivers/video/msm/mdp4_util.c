@@ -25,6 +25,7 @@
 #include <linux/semaphore.h>
 #include <linux/uaccess.h>
 #include <linux/msm_mdp.h>
+#include <linux/math64.h>
 #include <asm/system.h>
 #include <asm/mach-types.h>
 #include <mach/hardware.h>
@@ -32,8 +33,152 @@
 #include "msm_fb.h"
 #include "mdp4.h"
 
+/* Instantiate tracepoints */
+#define CREATE_TRACE_POINTS
+#include "mdp4_trace.h"
+
 struct mdp4_statistic mdp4_stat;
 
+/*
+ * Frame timeline ring. Writers claim a slot with a single atomic increment
+ * and publish it by storing the sequence number last, so the isr and
+ * process context never contend on a lock; a reader simply drops a slot
+ * whose sequence changed underneath it. Only the per interface vsync
+ * bookkeeping, which the commit scheduler reads as a pair, takes a lock.
+ */
+#define MDP4_TL_PERIOD_MIN	(8 * NSEC_PER_MSEC)
+#define MDP4_TL_PERIOD_MAX	(50 * NSEC_PER_MSEC)
+
+static struct mdp4_tl_entry mdp4_tl_ring[MDP4_TL_SIZE];
+static atomic_t mdp4_tl_seq = ATOMIC_INIT(0);
+
+static DEFINE_SPINLOCK(mdp4_tl_lock);
+static u32 mdp4_tl_frame[2];
+static s64 mdp4_tl_vsync_ns[2];
+static s64 mdp4_tl_period_ns[2];
+
+static int mdp4_tl_intf(int event, int unit)
+{
+	switch (event) {
+	case MDP4_TL_COMMIT:
+	case MDP4_TL_SCHED:
+		return unit == MDP4_MIXER1;
+	case MDP4_TL_VSYNC:
+		return unit != 0;
+	default:
+		return (unit == MDP4_TL_OV1) || (unit == MDP4_TL_DMA_E);
+	}
+}
+
+void mdp4_tl_record(int event, int unit)
+{
+	struct mdp4_tl_entry *e;
+	unsigned long flag;
+	s64 now, delta;
+	u32 seq, frame;
+	int intf;
+
+	now = ktime_to_ns(ktime_get());
+	intf = mdp4_tl_intf(event, unit);
+
+	if (event == MDP4_TL_VSYNC) {
+		spin_lock_irqsave(&mdp4_tl_lock, flag);
+		delta = now - mdp4_tl_vsync_ns[intf];
+		if ((delta >= MDP4_TL_PERIOD_MIN) &&
+		    (delta <= MDP4_TL_PERIOD_MAX)) {
+			/* 1/8 weight filter, seeded by the first sane gap */
+			if (mdp4_tl_period_ns[intf])
+				mdp4_tl_period_ns[intf] +=
+					(delta - mdp4_tl_period_ns[intf]) >> 3;
+			else
+				mdp4_tl_period_ns[intf] = delta;
+		}
+		mdp4_tl_vsync_ns[intf] = now;
+		mdp4_tl_frame[intf]++;
+		spin_unlock_irqrestore(&mdp4_tl_lock, flag);
+	}
+	frame = ACCESS_ONCE(mdp4_tl_frame[intf]);
+
+	seq = atomic_inc_return(&mdp4_tl_seq);
+	if (seq == 0)	/* 0 marks a slot being written */
+		seq = atomic_inc_return(&mdp4_tl_seq);
+
+	e = &mdp4_tl_ring[seq & (MDP4_TL_SIZE - 1)];
+	e->seq = 0;
+	smp_wmb();
+	e->ns = now;
+	e->frame = frame;
+	e->event = event;
+	e->unit = unit;
+	smp_wmb();
+	e->seq = seq;
+
+	trace_mdp4_timeline(event, unit, frame, seq);
+}
+
+void mdp4_tl_reset(void)
+{
+	int i;
+
+	for (i = 0; i < MDP4_TL_SIZE; i++)
+		mdp4_tl_ring[i].seq = 0;
+	smp_wmb();
+}
+
+/*
+ * copy out up to max of the most recent entries, oldest first
+ */
+int mdp4_tl_read(struct mdp4_tl_entry *buf, int max)
+{
+	struct mdp4_tl_entry *e, tmp;
+	u32 seq, last;
+	int n = 0;
+
+	if (max > MDP4_TL_SIZE)
+		max = MDP4_TL_SIZE;
+
+	last = atomic_read(&mdp4_tl_seq);
+	for (seq = last - max + 1; seq != last + 1; seq++) {
+		e = &mdp4_tl_ring[seq & (MDP4_TL_SIZE - 1)];
+		if (ACCESS_ONCE(e->seq) != seq || seq == 0)
+			continue;
+		smp_rmb();
+		tmp = *e;
+		smp_rmb();
+		if (ACCESS_ONCE(e->seq) != seq)
+			continue;	/* overwritten while copying */
+		buf[n++] = tmp;
+	}
+
+	return n;
+}
+
+/*
+ * predict the first vsync of an interface that is at least lead_ns away;
+ * fails while the vsync interrupt has not been running long enough (or
+ * has stopped) to give a trustworthy period
+ */
+int mdp4_tl_next_vsync(int intf, s64 lead_ns, ktime_t *next)
+{
+	unsigned long flag;
+	s64 last, period, now;
+	u64 cnt;
+
+	spin_lock_irqsave(&mdp4_tl_lock, flag);
+	last = mdp4_tl_vsync_ns[intf];
+	period = mdp4_tl_period_ns[intf];
+	spin_unlock_irqrestore(&mdp4_tl_lock, flag);
+
+	now = ktime_to_ns(ktime_get());
+	if (period == 0 || last == 0 || now - last > 4 * period)
+		return -EAGAIN;
+
+	cnt = div64_u64(now + lead_ns - last, period) + 1;
+	*next = ns_to_ktime(last + cnt * period);
+
+	return 0;
+}
+
 unsigned is_mdp4_hw_reset(void)
 {
 	unsigned hw_reset = 0;
@@ -405,6 +550,7 @@ irqreturn_t mdp4_isr(int irq, void *ptr)
 	panel = mdp4_overlay_panel_list();
 	if (isr & INTR_PRIMARY_VSYNC) {
 		mdp4_stat.intr_vsync_p++;
+		mdp4_tl_record(MDP4_TL_VSYNC, 0);
 		dma = &dma2_data;
 		spin_lock(&mdp_spin_lock);
 		mdp_intr_mask &= ~INTR_PRIMARY_VSYNC;
@@ -421,6 +567,7 @@ irqreturn_t mdp4_isr(int irq, void *ptr)
 #ifdef CONFIG_FB_MSM_DTV
 	if (isr & INTR_EXTERNAL_VSYNC) {
 		mdp4_stat.intr_vsync_e++;
+		mdp4_tl_record(MDP4_TL_VSYNC, 1);
 		dma = &dma_e_data;
 		spin_lock(&mdp_spin_lock);
 		mdp_intr_mask &= ~INTR_EXTERNAL_VSYNC;
@@ -435,6 +582,7 @@ irqreturn_t mdp4_isr(int irq, void *ptr)
 #ifdef CONFIG_FB_MSM_OVERLAY
 	if (isr & INTR_OVERLAY0_DONE) {
 		mdp4_stat.intr_overlay0++;
+		mdp4_tl_record(MDP4_TL_DONE, MDP4_TL_OV0);
 		dma = &dma2_data;
 		if (panel & (MDP4_PANEL_LCDC | MDP4_PANEL_DSI_VIDEO)) {
 			/* disable LCDC interrupt */
@@ -462,6 +610,7 @@ irqreturn_t mdp4_isr(int irq, void *ptr)
 	}
 	if (isr & INTR_OVERLAY1_DONE) {
 		mdp4_stat.intr_overlay1++;
+		mdp4_tl_record(MDP4_TL_DONE, MDP4_TL_OV1);
 		/* disable DTV interrupt */
 		dma = &dma_e_data;
 		spin_lock(&mdp_spin_lock);
@@ -481,6 +630,7 @@ irqreturn_t mdp4_isr(int irq, void *ptr)
 #if defined(CONFIG_FB_MSM_WRITEBACK_MSM_PANEL)
 	if (isr & INTR_OVERLAY2_DONE) {
 		mdp4_stat.intr_overlay2++;
+		mdp4_tl_record(MDP4_TL_DONE, MDP4_TL_OV2);
 		/* disable DTV interrupt */
 		dma = &dma_wb_data;
 		spin_lock(&mdp_spin_lock);
@@ -496,6 +646,7 @@ irqreturn_t mdp4_isr(int irq, void *ptr)
 
 	if (isr & INTR_DMA_P_DONE) {
 		mdp4_stat.intr_dma_p++;
+		mdp4_tl_record(MDP4_TL_DONE, MDP4_TL_DMA_P);
 		dma = &dma2_data;
 		if (panel & MDP4_PANEL_LCDC) {
 			/* disable LCDC interrupt */
@@ -538,6 +689,7 @@ irqreturn_t mdp4_isr(int irq, void *ptr)
 	}
 	if (isr & INTR_DMA_S_DONE) {
 		mdp4_stat.intr_dma_s++;
+		mdp4_tl_record(MDP4_TL_DONE, MDP4_TL_DMA_S);
 #if defined(CONFIG_FB_MSM_OVERLAY) && defined(CONFIG_FB_MSM_MDDI)
 		dma = &dma2_data;
 #else
@@ -551,6 +703,7 @@ irqreturn_t mdp4_isr(int irq, void *ptr)
 	}
 	if (isr & INTR_DMA_E_DONE) {
 		mdp4_stat.intr_dma_e++;
+		mdp4_tl_record(MDP4_TL_DONE, MDP4_TL_DMA_E);
 		dma = &dma_e_data;
 		spin_lock(&mdp_spin_lock);
 		mdp_intr_mask &= ~INTR_DMA_E_DONE;
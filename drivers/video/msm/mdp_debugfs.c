@@ -23,6 +23,8 @@
 #include <linux/debugfs.h>
 #include <linux/semaphore.h>
 #include <linux/uaccess.h>
+#include <linux/math64.h>
+#include <linux/slab.h>
 #include <asm/system.h>
 #include <asm/mach-types.h>
 #include <mach/hardware.h>
@@ -231,6 +233,70 @@ static const struct file_operations mdp_reg_fops = {
 	.write = mdp_reg_write,
 };
 
+static int mdp_dirty_open(struct inode *inode, struct file *file)
+{
+	/* non-seekable */
+	file->f_mode &= ~(FMODE_LSEEK | FMODE_PREAD | FMODE_PWRITE);
+	return 0;
+}
+
+static int mdp_dirty_release(struct inode *inode, struct file *file)
+{
+	return 0;
+}
+
+static ssize_t mdp_dirty_write(
+	struct file *file,
+	const char __user *buff,
+	size_t count,
+	loff_t *ppos)
+{
+	memset(&mdp_dirty_stat, 0, sizeof(mdp_dirty_stat));	/* reset */
+	return count;
+}
+
+static ssize_t mdp_dirty_read(
+	struct file *file,
+	char __user *buff,
+	size_t count,
+	loff_t *ppos)
+{
+	struct mdp_dirty_statistic st = mdp_dirty_stat;
+	u64 per_frame = 0, pct = 0;
+	int tot;
+
+	if (*ppos)
+		return 0;	/* the end */
+
+	if (st.frames)
+		per_frame = div_u64(st.pixels, st.frames);
+	if (st.full)
+		pct = div64_u64(st.pixels * 100, st.full);
+
+	tot = snprintf(debug_buf, sizeof(debug_buf),
+		       "pans: %08lu\tmerged: %08lu\n"
+		       "frames: %08lu\n"
+		       "requested: %llu\ntransferred: %llu\n"
+		       "pixels/frame: %llu\t(%llu%% of full screen)\n",
+		       st.pans, st.merged, st.frames,
+		       st.requested, st.pixels, per_frame, pct);
+	tot++;
+
+	if (copy_to_user(buff, debug_buf, tot))
+		return -EFAULT;
+
+	*ppos += tot;	/* increase offset */
+
+	return tot;
+}
+
+static const struct file_operations mdp_dirty_fops = {
+	.open = mdp_dirty_open,
+	.release = mdp_dirty_release,
+	.read = mdp_dirty_read,
+	.write = mdp_dirty_write,
+};
+
 #ifdef CONFIG_FB_MSM_MDP40
 static int mdp_stat_open(struct inode *inode, struct file *file)
 {
@@ -525,6 +591,126 @@ static const struct file_operations mdp_stat_fops = {
 	.read = mdp_stat_read,
 	.write = mdp_stat_write,
 };
+
+#define MDP4_TL_DUMP	64	/* entries shown */
+#define MDP4_TL_BUF	(MDP4_TL_DUMP * 64)
+
+static const char *mdp4_tl_event_name[MDP4_TL_EVENT_MAX] = {
+	"commit", "sched", "kickoff", "done", "vsync",
+};
+
+static const char *mdp4_tl_unit_name[MDP4_TL_UNIT_MAX] = {
+	"ov0", "ov1", "ov2", "dmap", "dmas", "dmae",
+};
+
+static int mdp_timeline_open(struct inode *inode, struct file *file)
+{
+	/* non-seekable */
+	file->f_mode &= ~(FMODE_LSEEK | FMODE_PREAD | FMODE_PWRITE);
+	return 0;
+}
+
+static int mdp_timeline_release(struct inode *inode, struct file *file)
+{
+	return 0;
+}
+
+static ssize_t mdp_timeline_write(
+	struct file *file,
+	const char __user *buff,
+	size_t count,
+	loff_t *ppos)
+{
+	mdp4_tl_reset();
+	return count;
+}
+
+/*
+ * one line per entry, oldest first; the last column is the distance to
+ * the previous vsync of the same interface, so a commit printed close to
+ * a full frame period just made (or missed) the next one
+ */
+static ssize_t mdp_timeline_read(
+	struct file *file,
+	char __user *buff,
+	size_t count,
+	loff_t *ppos)
+{
+	struct mdp4_tl_entry *tl, *e;
+	s64 vsync[2] = { 0, 0 };
+	const char *unit;
+	char *buf, num[8];
+	int i, n, intf, len;
+	ssize_t ret;
+
+	if (*ppos)
+		return 0;	/* the end */
+
+	tl = kmalloc(MDP4_TL_DUMP * sizeof(*tl), GFP_KERNEL);
+	buf = kmalloc(MDP4_TL_BUF, GFP_KERNEL);
+	if (!tl || !buf) {
+		ret = -ENOMEM;
+		goto out;
+	}
+
+	n = mdp4_tl_read(tl, MDP4_TL_DUMP);
+
+	len = snprintf(buf, MDP4_TL_BUF,
+		       "commit_sched: %08lu\tcommit_late: %08lu\n"
+		       "%-10s %-16s %-8s %-8s %-5s %s\n",
+		       mdp4_stat.commit_sched, mdp4_stat.commit_late,
+		       "seq", "time", "frame", "event", "unit", "vsync+us");
+
+	for (i = 0; i < n && len < MDP4_TL_BUF; i++) {
+		e = &tl[i];
+		if (e->event == MDP4_TL_VSYNC) {
+			intf = e->unit != 0;
+			unit = intf ? "ext" : "pri";
+		} else if (e->event == MDP4_TL_COMMIT ||
+			   e->event == MDP4_TL_SCHED) {
+			intf = e->unit == MDP4_MIXER1;
+			snprintf(num, sizeof(num), "mix%d", e->unit);
+			unit = num;
+		} else {
+			intf = (e->unit == MDP4_TL_OV1) ||
+				(e->unit == MDP4_TL_DMA_E);
+			unit = e->unit < MDP4_TL_UNIT_MAX ?
+				mdp4_tl_unit_name[e->unit] : "?";
+		}
+
+		len += snprintf(buf + len, MDP4_TL_BUF - len,
+				"%-10u %-16lld %-8u %-8s %-5s ",
+				e->seq, e->ns, e->frame,
+				e->event < MDP4_TL_EVENT_MAX ?
+				mdp4_tl_event_name[e->event] : "?", unit);
+		if (len >= MDP4_TL_BUF)
+			break;
+
+		if (e->event == MDP4_TL_VSYNC)
+			vsync[intf] = e->ns;
+		if (vsync[intf])
+			len += snprintf(buf + len, MDP4_TL_BUF - len, "%lld\n",
+					div_s64(e->ns - vsync[intf],
+						NSEC_PER_USEC));
+		else
+			len += snprintf(buf + len, MDP4_TL_BUF - len, "-\n");
+	}
+	if (len >= MDP4_TL_BUF)
+		len = MDP4_TL_BUF - 1;
+
+	ret = simple_read_from_buffer(buff, count, ppos, buf, len);
+out:
+	kfree(buf);
+	kfree(tl);
+	return ret;
+}
+
+static const struct file_operations mdp_timeline_fops = {
+	.open = mdp_timeline_open,
+	.release = mdp_timeline_release,
+	.read = mdp_timeline_read,
+	.write = mdp_timeline_write,
+};
 #endif
 
 /*
@@ -1294,6 +1480,29 @@ int mdp_debugfs_init(void)
 			__FILE__, __LINE__);
 		return -1;
 	}
+
+	if (debugfs_create_file("timeline", 0644, dent, 0, &mdp_timeline_fops)
+			== NULL) {
+		printk(KERN_ERR "%s(%d): debugfs_create_file: timeline fail\n",
+			__FILE__, __LINE__);
+		return -1;
+	}
+#ifdef CONFIG_FB_MSM_OVERLAY
+	debugfs_create_u32("commit_sched", 0644, dent, &mdp4_commit_sched_on);
+	debugfs_create_u32("commit_margin_us", 0644, dent,
+			   &mdp4_commit_margin_us);
+#endif
+#endif
+
+	if (debugfs_create_file("dirty", 0644, dent, 0, &mdp_dirty_fops)
+			== NULL) {
+		printk(KERN_ERR "%s(%d): debugfs_create_file: dirty fail\n",
+			__FILE__, __LINE__);
+		return -1;
+	}
+
+#ifdef CONFIG_FB_MSM_MDP_PPP_SW
+	mdp_ppp_sw_debugfs_init(dent);
 #endif
 
 	dent = debugfs_create_dir("mddi", NULL);
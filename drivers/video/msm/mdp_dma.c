@@ -51,6 +51,8 @@ extern struct workqueue_struct *mdp_dma_wq;
 
 int vsync_start_y_adjust = 4;
 
+struct mdp_dirty_statistic mdp_dirty_stat;
+
 static void mdp_dma2_update_lcd(struct msm_fb_data_type *mfd)
 {
 	MDPIBUF *iBuf = &mfd->ibuf;
@@ -437,9 +439,10 @@ static void mdp_dma_schedule(struct msm_fb_data_type *mfd, uint32 term)
 	}
 }
 
-#ifdef MDDI_HOST_WINDOW_WORKAROUND
 static void mdp_dma2_update_sub(struct msm_fb_data_type *mfd);
-void mdp_dma2_update(struct msm_fb_data_type *mfd)
+
+#ifdef MDDI_HOST_WINDOW_WORKAROUND
+static void mdp_dma2_update_rect(struct msm_fb_data_type *mfd)
 {
 	MDPIBUF *iBuf;
 	uint32 upper_height;
@@ -472,11 +475,45 @@ void mdp_dma2_update(struct msm_fb_data_type *mfd)
 		mdp_dma2_update_sub(mfd);
 	}
 }
-
-static void mdp_dma2_update_sub(struct msm_fb_data_type *mfd)
 #else
-void mdp_dma2_update(struct msm_fb_data_type *mfd)
+static inline void mdp_dma2_update_rect(struct msm_fb_data_type *mfd)
+{
+	mdp_dma2_update_sub(mfd);
+}
 #endif
+
+static uint32 mdp_dirty_area(const struct mdp_dirty_region *r)
+{
+	return r->width * r->height;
+}
+
+static void mdp_dirty_bound(struct mdp_dirty_region *d,
+			    const struct mdp_dirty_region *a,
+			    const struct mdp_dirty_region *b)
+{
+	uint32 x1 = max(a->xoffset + a->width, b->xoffset + b->width);
+	uint32 y1 = max(a->yoffset + a->height, b->yoffset + b->height);
+
+	d->xoffset = min(a->xoffset, b->xoffset);
+	d->yoffset = min(a->yoffset, b->yoffset);
+	d->width = x1 - d->xoffset;
+	d->height = y1 - d->yoffset;
+}
+
+void mdp_dma2_update(struct msm_fb_data_type *mfd)
+{
+	MDPIBUF *iBuf = &mfd->ibuf;
+
+	down(&mfd->sem);
+	mdp_dirty_stat.frames++;
+	mdp_dirty_stat.pixels += iBuf->dma_w * iBuf->dma_h;
+	mdp_dirty_stat.full += mfd->fbi->var.xres * mfd->fbi->var.yres;
+	up(&mfd->sem);
+
+	mdp_dma2_update_rect(mfd);
+}
+
+static void mdp_dma2_update_sub(struct msm_fb_data_type *mfd)
 {
 	down(&mfd->dma->mutex);
 	if ((mfd) && (!mfd->dma->busy) && (mfd->panel_power_on)) {
@@ -520,6 +557,7 @@ void mdp_set_dma_pan_info(struct fb_info *info, struct mdp_dirty_region *dirty,
 	struct msm_fb_data_type *mfd = (struct msm_fb_data_type *)info->par;
 	MDPIBUF *iBuf;
 	int bpp = info->var.bits_per_pixel / 8;
+	struct mdp_dirty_region r, box;
 
 	down(&mfd->sem);
 	iBuf = &mfd->ibuf;
@@ -537,16 +575,37 @@ void mdp_set_dma_pan_info(struct fb_info *info, struct mdp_dirty_region *dirty,
 		 * ToDo: dirty region check inside var.xoffset+xres
 		 * <-> var.yoffset+yres
 		 */
-		iBuf->dma_x = dirty->xoffset % info->var.xres;
-		iBuf->dma_y = dirty->yoffset % info->var.yres;
-		iBuf->dma_w = dirty->width;
-		iBuf->dma_h = dirty->height;
+		r.xoffset = dirty->xoffset % info->var.xres;
+		r.yoffset = dirty->yoffset % info->var.yres;
+		r.width = dirty->width;
+		r.height = dirty->height;
 	} else {
-		iBuf->dma_x = 0;
-		iBuf->dma_y = 0;
-		iBuf->dma_w = info->var.xres;
-		iBuf->dma_h = info->var.yres;
+		r.xoffset = 0;
+		r.yoffset = 0;
+		r.width = info->var.xres;
+		r.height = info->var.yres;
 	}
+
+	/*
+	 * Pans that come in before the previous one was sent accumulate:
+	 * the panel still holds the frame before that one, and the new
+	 * buffer is a complete frame, so sending the union of both
+	 * regions from it is correct.
+	 */
+	mdp_dirty_stat.pans++;
+	mdp_dirty_stat.requested += mdp_dirty_area(&r);
+	if (!mfd->ibuf_flushed && iBuf->dma_w && iBuf->dma_h) {
+		box.xoffset = iBuf->dma_x;
+		box.yoffset = iBuf->dma_y;
+		box.width = iBuf->dma_w;
+		box.height = iBuf->dma_h;
+		mdp_dirty_bound(&r, &r, &box);
+		mdp_dirty_stat.merged++;
+	}
+	iBuf->dma_x = r.xoffset;
+	iBuf->dma_y = r.yoffset;
+	iBuf->dma_w = r.width;
+	iBuf->dma_h = r.height;
 	mfd->ibuf_flushed = FALSE;
 	up(&mfd->sem);
 }
@@ -567,8 +626,14 @@ void mdp_dma_pan_update(struct fb_info *info)
 		/* waiting for this update to complete */
 		mfd->pan_waiting = TRUE;
 		wait_for_completion_killable(&mfd->pan_comp);
-	} else
+	} else {
 		mfd->dma_fnc(mfd);
+
+		/* not every dma_fnc flags it: the next pan starts afresh */
+		down(&mfd->sem);
+		mfd->ibuf_flushed = TRUE;
+		up(&mfd->sem);
+	}
 }
 
 void mdp_refresh_screen(unsigned long data)
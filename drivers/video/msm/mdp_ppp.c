@@ -1199,15 +1199,19 @@ static int mdp_ppp_verify_req(struct mdp_blit_req *req)
 		return -1;
 	}
 
-	if (((req->src_rect.x + req->src_rect.w) > req->src.width) ||
-	    ((req->src_rect.y + req->src_rect.h) > req->src.height)) {
+	if ((req->src_rect.w > req->src.width) ||
+	    (req->src_rect.x > req->src.width - req->src_rect.w) ||
+	    (req->src_rect.h > req->src.height) ||
+	    (req->src_rect.y > req->src.height - req->src_rect.h)) {
 		printk(KERN_ERR "\n%s(): Error in Line %u", __func__,
 			__LINE__);
 		return -1;
 	}
 
-	if (((req->dst_rect.x + req->dst_rect.w) > req->dst.width) ||
-	    ((req->dst_rect.y + req->dst_rect.h) > req->dst.height)) {
+	if ((req->dst_rect.w > req->dst.width) ||
+	    (req->dst_rect.x > req->dst.width - req->dst_rect.w) ||
+	    (req->dst_rect.h > req->dst.height) ||
+	    (req->dst_rect.y > req->dst.height - req->dst_rect.h)) {
 		printk(KERN_ERR "\n%s(): Error in Line %u", __func__,
 			__LINE__);
 		return -1;
@@ -1277,16 +1281,14 @@ int get_gem_img(struct mdp_img *img, unsigned long *start, unsigned long *len)
 }
 
 int get_img(struct mdp_img *img, struct fb_info *info, unsigned long *start,
-	    unsigned long *len, struct file **pp_file)
+	    unsigned long *vstart, unsigned long *len, struct file **pp_file)
 {
 	int put_needed, ret = 0;
 	struct file *file;
-#ifdef CONFIG_ANDROID_PMEM
-	unsigned long vstart;
-#endif
 
+	*vstart = 0;
 #ifdef CONFIG_ANDROID_PMEM
-	if (!get_pmem_file(img->memory_id, start, &vstart, len, pp_file))
+	if (!get_pmem_file(img->memory_id, start, vstart, len, pp_file))
 		return 0;
 #endif
 	file = fget_light(img->memory_id, &put_needed);
@@ -1295,6 +1297,7 @@ int get_img(struct mdp_img *img, struct fb_info *info, unsigned long *start,
 
 	if (MAJOR(file->f_dentry->d_inode->i_rdev) == FB_MAJOR) {
 		*start = info->fix.smem_start;
+		*vstart = (unsigned long)info->screen_base;
 		*len = info->fix.smem_len;
 		*pp_file = file;
 	} else {
@@ -1317,12 +1320,14 @@ void put_img(struct file *p_src_file)
 int mdp_ppp_blit(struct fb_info *info, struct mdp_blit_req *req)
 {
 	unsigned long src_start, dst_start;
+	unsigned long src_vstart = 0, dst_vstart = 0;
 	unsigned long src_len = 0;
 	unsigned long dst_len = 0;
 	MDPIBUF iBuf;
 	u32 dst_width, dst_height;
 	struct file *p_src_file = 0 , *p_dst_file = 0;
 	struct msm_fb_data_type *mfd = (struct msm_fb_data_type *)info->par;
+	ktime_t hw_start;
 
 	if (req->dst.format == MDP_FB_FORMAT)
 		req->dst.format =  mfd->fb_imgType;
@@ -1331,7 +1336,8 @@ int mdp_ppp_blit(struct fb_info *info, struct mdp_blit_req *req)
 	if (req->flags & MDP_BLIT_SRC_GEM)
 		get_gem_img(&req->src, &src_start, &src_len);
 	else
-		get_img(&req->src, info, &src_start, &src_len, &p_src_file);
+		get_img(&req->src, info, &src_start, &src_vstart, &src_len,
+			&p_src_file);
 	if (src_len == 0) {
 		printk(KERN_ERR "mdp_ppp: could not retrieve image from "
 		       "memory\n");
@@ -1340,7 +1346,8 @@ int mdp_ppp_blit(struct fb_info *info, struct mdp_blit_req *req)
 	if (req->flags & MDP_BLIT_DST_GEM)
 		get_gem_img(&req->dst, &dst_start, &dst_len);
 	else
-		get_img(&req->dst, info, &dst_start, &dst_len, &p_dst_file);
+		get_img(&req->dst, info, &dst_start, &dst_vstart, &dst_len,
+			&p_dst_file);
 	if (dst_len == 0) {
 		put_img(p_src_file);
 		printk(KERN_ERR "mdp_ppp: could not retrieve image from "
@@ -1485,7 +1492,21 @@ int mdp_ppp_blit(struct fb_info *info, struct mdp_blit_req *req)
 #endif
 	}
 
+	/* small blits may be cheaper on the CPU than waiting for the PPP */
+	if (src_vstart && dst_vstart &&
+	    req->src.offset < src_len && req->dst.offset < dst_len &&
+	    !mdp_ppp_sw_blit(req, (void *)(src_vstart + req->src.offset),
+			     src_len - req->src.offset, p_src_file,
+			     (void *)(dst_vstart + req->dst.offset),
+			     dst_len - req->dst.offset, p_dst_file)) {
+		put_img(p_src_file);
+		put_img(p_dst_file);
+		return 0;
+	}
+
+	mdp_ppp_sw_hw_enter();
 	down(&mdp_ppp_mutex);
+	hw_start = ktime_get();
 	/* MDP cmd block enable */
 	mdp_pipe_ctrl(MDP_CMD_BLOCK, MDP_BLOCK_POWER_ON, FALSE);
 
@@ -1584,6 +1605,7 @@ int mdp_ppp_blit(struct fb_info *info, struct mdp_blit_req *req)
 	/* MDP cmd block disable */
 	mdp_pipe_ctrl(MDP_CMD_BLOCK, MDP_BLOCK_POWER_OFF, FALSE);
 	up(&mdp_ppp_mutex);
+	mdp_ppp_sw_hw_exit(req, hw_start);
 
 	put_img(p_src_file);
 	put_img(p_dst_file);
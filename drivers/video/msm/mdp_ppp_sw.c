@@ -0,0 +1,849 @@
+/* Copyright (C) 2026 agent <agent@local>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 and
+ * only version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+/*
+ * CPU blitter for small PPP requests.
+ *
+ * Every PPP blit pays for clocking the block up, programming it and an
+ * interrupt round trip, and waits for any blit already on the engine.
+ * For small RGB blits the CPU is faster than that, and it can run while
+ * the engine is busy with somebody else's request.
+ *
+ * mdp_ppp_sw_blit() handles RGB to RGB blits with nearest-neighbour
+ * scaling, flips, 90 degree rotation, constant and per-pixel alpha and
+ * a source colour key.  Anything else (YUV, dither, blur, sharpening,
+ * premultiplied blending, GEM buffers, overlapping source and
+ * destination) is left to the hardware.  A cost model built from timing
+ * both paths decides which one a request takes.
+ *
+ * The blitter works a row at a time: source pixels are fetched through
+ * precomputed offset tables into a line of 0xAARRGGBB words, blended
+ * against the destination line and packed back.  ppp_sw_ref() is a
+ * plain per-pixel implementation of the same operation; with "verify"
+ * set in debugfs every CPU blit is rerun through it into a scratch copy
+ * of the destination and the two are compared bit for bit.
+ *
+ * Pixel layouts follow the fb_var_screeninfo bitfields msm_fb reports,
+ * i.e. each format is a little-endian word of the given width.
+ */
+
+#include <linux/kernel.h>
+#include <linux/slab.h>
+#include <linux/vmalloc.h>
+#include <linux/spinlock.h>
+#include <linux/hrtimer.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/swab.h>
+#include <linux/android_pmem.h>
+#include <linux/msm_mdp.h>
+#include <asm/div64.h>
+
+#include "mdp.h"
+
+enum {
+	PPP_SW_OFF,
+	PPP_SW_AUTO,
+	PPP_SW_ALWAYS,
+};
+
+/* cost classes, each gets its own per-pixel estimate */
+enum {
+	PPP_SW_COPY,		/* same format, 1:1, opaque */
+	PPP_SW_CONVERT,		/* format conversion and flips */
+	PPP_SW_BLEND,		/* alpha blend or colour key */
+	PPP_SW_SCALE,		/* scaling or 90 degree rotation */
+	PPP_SW_CLASSES,
+};
+
+static const char * const ppp_sw_class_names[PPP_SW_CLASSES] = {
+	"copy", "convert", "blend", "scale",
+};
+
+#define PPP_SW_FLAGS	(MDP_FLIP_LR | MDP_FLIP_UD | MDP_ROT_90 | \
+			 MDP_BLIT_NON_CACHED | MDP_NO_DMA_BARRIER_START | \
+			 MDP_NO_DMA_BARRIER_END)
+
+/* hardware samples used to split the model into setup and per-pixel */
+#define PPP_SW_HW_SMALL		4096
+#define PPP_SW_HW_LARGE		65536
+
+struct ppp_sw_format {
+	u32 bpp;
+	int alpha;
+	void (*fetch)(u32 *out, const u8 *row, const u32 *off, u32 n);
+	void (*store)(u8 *row, const u32 *in, u32 n);
+};
+
+struct ppp_sw_job {
+	const struct ppp_sw_format *sf, *df;
+	u32 src_fmt, dst_fmt;
+	const u8 *src;		/* source image origin */
+	u32 src_stride;
+	struct mdp_rect src_rect;
+	u8 *dst;		/* destination rectangle origin */
+	u32 dst_stride;
+	u32 w, h;		/* destination rectangle size */
+	u32 flags;
+	u32 alpha;		/* constant alpha, 0xff when off */
+	u32 transp;		/* colour key, MDP_TRANSP_NOP when off */
+	int cls;
+};
+
+static u32 ppp_sw_mode = PPP_SW_AUTO;
+static u32 ppp_sw_max_pixels = 65536;
+static u32 ppp_sw_verify;
+
+static struct {
+	spinlock_t lock;
+	/* model, all estimates are exponentially weighted by 1/8 */
+	u32 sw_ps[PPP_SW_CLASSES];	/* picoseconds per pixel */
+	u32 hw_setup_ns;
+	u32 hw_ps;
+	u32 hw_avg_ns;
+	atomic_t hw_queued;
+	/* statistics */
+	unsigned long sw_blits[PPP_SW_CLASSES];
+	unsigned long hw_blits;
+	unsigned long unsupported;
+	unsigned long verified;
+	unsigned long mismatches;
+} ppp_sw = {
+	.lock = __SPIN_LOCK_UNLOCKED(ppp_sw.lock),
+	.sw_ps = { 1500, 5000, 9000, 12000 },
+	.hw_setup_ns = 150000,
+	.hw_ps = 3000,
+	.hw_avg_ns = 200000,
+	.hw_queued = ATOMIC_INIT(0),
+};
+
+static inline u32 ppp_sw_ewma(u32 avg, u32 sample)
+{
+	return avg - (avg >> 3) + (sample >> 3);
+}
+
+static inline u32 ppp_sw_ps(s64 ns, u32 pixels)
+{
+	return min_t(u64, div_u64((u64)ns * 1000, pixels), 0xffffffff);
+}
+
+/* fast path pixel access */
+
+static inline u32 expand_565(u32 v)
+{
+	u32 r = (v >> 11) & 0x1f, g = (v >> 5) & 0x3f, b = v & 0x1f;
+
+	r = r << 3 | r >> 2;
+	g = g << 2 | g >> 4;
+	b = b << 3 | b >> 2;
+	return 0xff000000 | r << 16 | g << 8 | b;
+}
+
+static inline u32 pack_565(u32 c)
+{
+	return ((c >> 8) & 0xf800) | ((c >> 5) & 0x07e0) | ((c >> 3) & 0x1f);
+}
+
+static inline u32 swap_rb(u32 c)
+{
+	return (c & 0xff00ff00) | ((c & 0xff) << 16) | ((c >> 16) & 0xff);
+}
+
+#define PPP_SW_FORMAT(name, type, load, save)				\
+static void fetch_##name(u32 *out, const u8 *row, const u32 *off, u32 n)\
+{									\
+	while (n--) {							\
+		u32 v = *(const type *)(row + *off++);			\
+		*out++ = (load);					\
+	}								\
+}									\
+static void store_##name(u8 *row, const u32 *in, u32 n)		\
+{									\
+	type *p = (type *)row;						\
+	while (n--) {							\
+		u32 v = *in++;						\
+		*p++ = (save);						\
+	}								\
+}
+
+PPP_SW_FORMAT(rgb565, u16, expand_565(v), pack_565(v))
+PPP_SW_FORMAT(bgr565, u16, swap_rb(expand_565(v)), pack_565(swap_rb(v)))
+PPP_SW_FORMAT(xrgb8888, u32, v | 0xff000000, v | 0xff000000)
+PPP_SW_FORMAT(argb8888, u32, v, v)
+PPP_SW_FORMAT(rgba8888, u32, (v >> 8) | (v << 24), (v << 8) | (v >> 24))
+PPP_SW_FORMAT(bgra8888, u32, swab32(v), swab32(v))
+PPP_SW_FORMAT(rgbx8888, u32, (v >> 8) | 0xff000000, (v << 8) | 0xff)
+
+static void fetch_rgb888(u32 *out, const u8 *row, const u32 *off, u32 n)
+{
+	while (n--) {
+		const u8 *p = row + *off++;
+
+		*out++ = 0xff000000 | p[2] << 16 | p[1] << 8 | p[0];
+	}
+}
+
+static void store_rgb888(u8 *row, const u32 *in, u32 n)
+{
+	while (n--) {
+		u32 v = *in++;
+
+		*row++ = v;
+		*row++ = v >> 8;
+		*row++ = v >> 16;
+	}
+}
+
+#define PPP_SW_FMT(name, bpp, alpha) \
+	{ bpp, alpha, fetch_##name, store_##name }
+
+static const struct ppp_sw_format ppp_sw_rgb565 = PPP_SW_FMT(rgb565, 2, 0);
+static const struct ppp_sw_format ppp_sw_bgr565 = PPP_SW_FMT(bgr565, 2, 0);
+static const struct ppp_sw_format ppp_sw_rgb888 = PPP_SW_FMT(rgb888, 3, 0);
+static const struct ppp_sw_format ppp_sw_xrgb8888 =
+	PPP_SW_FMT(xrgb8888, 4, 0);
+static const struct ppp_sw_format ppp_sw_argb8888 =
+	PPP_SW_FMT(argb8888, 4, 1);
+static const struct ppp_sw_format ppp_sw_rgba8888 =
+	PPP_SW_FMT(rgba8888, 4, 1);
+static const struct ppp_sw_format ppp_sw_bgra8888 =
+	PPP_SW_FMT(bgra8888, 4, 1);
+static const struct ppp_sw_format ppp_sw_rgbx8888 =
+	PPP_SW_FMT(rgbx8888, 4, 0);
+
+static const struct ppp_sw_format *ppp_sw_format(u32 format)
+{
+	switch (format) {
+	case MDP_RGB_565:
+		return &ppp_sw_rgb565;
+	case MDP_BGR_565:
+		return &ppp_sw_bgr565;
+	case MDP_RGB_888:
+		return &ppp_sw_rgb888;
+	case MDP_XRGB_8888:
+		return &ppp_sw_xrgb8888;
+	case MDP_ARGB_8888:
+		return &ppp_sw_argb8888;
+	case MDP_RGBA_8888:
+		return &ppp_sw_rgba8888;
+	case MDP_BGRA_8888:
+		return &ppp_sw_bgra8888;
+	case MDP_RGBX_8888:
+		return &ppp_sw_rgbx8888;
+	default:
+		return NULL;
+	}
+}
+
+/* x / 255 rounded to nearest, exact for x <= 255 * 255 */
+static inline u32 div255(u32 x)
+{
+	x += 128;
+	return (x + (x >> 8)) >> 8;
+}
+
+static void ppp_sw_blend(u32 *d, const u32 *s, u32 n, u32 alpha,
+			 int pixel_alpha, u32 key, int keyed)
+{
+	while (n--) {
+		u32 c = *s++, o = *d, a, ia;
+
+		if (keyed && !((c ^ key) & 0xffffff)) {
+			d++;
+			continue;
+		}
+
+		a = pixel_alpha ? c >> 24 : 0xff;
+		if (alpha != 0xff)
+			a = div255(a * alpha);
+
+		if (a == 0xff) {
+			*d++ = c | 0xff000000;
+			continue;
+		}
+		if (a == 0) {
+			d++;
+			continue;
+		}
+
+		ia = 0xff - a;
+		*d++ = div255(0xff * a + (o >> 24) * ia) << 24 |
+			div255(((c >> 16) & 0xff) * a +
+			       ((o >> 16) & 0xff) * ia) << 16 |
+			div255(((c >> 8) & 0xff) * a +
+			       ((o >> 8) & 0xff) * ia) << 8 |
+			div255((c & 0xff) * a + (o & 0xff) * ia);
+	}
+}
+
+/*
+ * tab[i] = (base + floor(i * src_n / n)) * mul, stepped without a
+ * division per entry; flip fills the table back to front.
+ */
+static void ppp_sw_steps(u32 *tab, u32 n, u32 src_n, u32 base, u32 mul,
+			 int flip)
+{
+	u32 q = src_n / n, r = src_n % n;
+	u32 pos = base, err = 0, i;
+
+	for (i = 0; i < n; i++) {
+		tab[flip ? n - 1 - i : i] = pos * mul;
+		pos += q;
+		err += r;
+		if (err >= n) {
+			err -= n;
+			pos++;
+		}
+	}
+}
+
+static int ppp_sw_fast(const struct ppp_sw_job *job)
+{
+	const struct ppp_sw_format *sf = job->sf, *df = job->df;
+	u32 w = job->w, h = job->h, y, i;
+	int rot = job->flags & MDP_ROT_90;
+	int lr = !!(job->flags & MDP_FLIP_LR);
+	int ud = !!(job->flags & MDP_FLIP_UD);
+	int keyed = job->transp != MDP_TRANSP_NOP;
+	int blend = keyed || sf->alpha || job->alpha != 0xff;
+	u32 *off, *row_off, *doff, *sline, *dline;
+	u32 key = 0;
+
+	if (job->cls == PPP_SW_COPY) {
+		for (y = 0; y < h; y++)
+			memcpy(job->dst + y * job->dst_stride,
+			       job->src + (job->src_rect.y + y) *
+			       job->src_stride + job->src_rect.x * sf->bpp,
+			       w * df->bpp);
+		return 0;
+	}
+
+	off = kmalloc((4 * w + h) * sizeof(u32), GFP_KERNEL);
+	if (!off)
+		return -ENOMEM;
+	doff = off + w;
+	sline = doff + w;
+	dline = sline + w;
+	row_off = dline + w;
+
+	/*
+	 * Rotation turns the source row walk into a column walk: the
+	 * destination row selects the source column and the destination
+	 * column walks the source rows bottom to top.
+	 */
+	if (rot) {
+		ppp_sw_steps(row_off, h, job->src_rect.w, job->src_rect.x,
+			     sf->bpp, lr);
+		ppp_sw_steps(off, w, job->src_rect.h, job->src_rect.y,
+			     job->src_stride, !ud);
+	} else {
+		ppp_sw_steps(off, w, job->src_rect.w, job->src_rect.x,
+			     sf->bpp, lr);
+		ppp_sw_steps(row_off, h, job->src_rect.h, job->src_rect.y,
+			     job->src_stride, ud);
+	}
+	for (i = 0; i < w; i++)
+		doff[i] = i * df->bpp;
+
+	if (keyed) {
+		u32 raw = cpu_to_le32(job->transp), zero = 0;
+
+		sf->fetch(&key, (const u8 *)&raw, &zero, 1);
+	}
+
+	for (y = 0; y < h; y++) {
+		u8 *drow = job->dst + y * job->dst_stride;
+
+		sf->fetch(sline, job->src + row_off[y], off, w);
+		if (blend) {
+			df->fetch(dline, drow, doff, w);
+			ppp_sw_blend(dline, sline, w, job->alpha, sf->alpha,
+				     key, keyed);
+			df->store(drow, dline, w);
+		} else {
+			df->store(drow, sline, w);
+		}
+	}
+
+	kfree(off);
+	return 0;
+}
+
+/* reference implementation, one pixel at a time */
+
+static u32 ref_load(const u8 *p, u32 bpp)
+{
+	u32 v = 0;
+
+	while (bpp--)
+		v = v << 8 | p[bpp];
+	return v;
+}
+
+static void ref_save(u8 *p, u32 bpp, u32 v)
+{
+	while (bpp--) {
+		*p++ = v & 0xff;
+		v >>= 8;
+	}
+}
+
+static void ref_get(u32 format, u32 v, u32 *a, u32 *r, u32 *g, u32 *b)
+{
+	*a = 255;
+	switch (format) {
+	case MDP_RGB_565:
+	case MDP_BGR_565:
+		*r = (v >> 11) & 31;
+		*g = (v >> 5) & 63;
+		*b = v & 31;
+		*r = *r * 8 + *r / 4;
+		*g = *g * 4 + *g / 16;
+		*b = *b * 8 + *b / 4;
+		if (format == MDP_BGR_565)
+			swap(*r, *b);
+		break;
+	case MDP_RGB_888:
+	case MDP_XRGB_8888:
+	case MDP_ARGB_8888:
+		*r = (v >> 16) & 255;
+		*g = (v >> 8) & 255;
+		*b = v & 255;
+		if (format == MDP_ARGB_8888)
+			*a = v >> 24;
+		break;
+	case MDP_RGBA_8888:
+	case MDP_RGBX_8888:
+		*r = v >> 24;
+		*g = (v >> 16) & 255;
+		*b = (v >> 8) & 255;
+		if (format == MDP_RGBA_8888)
+			*a = v & 255;
+		break;
+	case MDP_BGRA_8888:
+		*b = v >> 24;
+		*g = (v >> 16) & 255;
+		*r = (v >> 8) & 255;
+		*a = v & 255;
+		break;
+	}
+}
+
+static u32 ref_put(u32 format, u32 a, u32 r, u32 g, u32 b)
+{
+	switch (format) {
+	case MDP_RGB_565:
+		return (r / 8) << 11 | (g / 4) << 5 | b / 8;
+	case MDP_BGR_565:
+		return (b / 8) << 11 | (g / 4) << 5 | r / 8;
+	case MDP_RGB_888:
+		return r << 16 | g << 8 | b;
+	case MDP_XRGB_8888:
+		return 0xff000000 | r << 16 | g << 8 | b;
+	case MDP_ARGB_8888:
+		return a << 24 | r << 16 | g << 8 | b;
+	case MDP_RGBA_8888:
+		return r << 24 | g << 16 | b << 8 | a;
+	case MDP_RGBX_8888:
+		return r << 24 | g << 16 | b << 8 | 255;
+	case MDP_BGRA_8888:
+		return b << 24 | g << 16 | r << 8 | a;
+	}
+	return 0;
+}
+
+static u32 ref_mix(u32 s, u32 d, u32 a)
+{
+	return (s * a + d * (255 - a) + 127) / 255;
+}
+
+static void ppp_sw_ref(const struct ppp_sw_job *job)
+{
+	u32 sbpp = job->sf->bpp, dbpp = job->df->bpp;
+	int rot = job->flags & MDP_ROT_90;
+	u32 ow = rot ? job->h : job->w;
+	u32 oh = rot ? job->w : job->h;
+	u32 ka = 0, kr = 0, kg = 0, kb = 0;
+	u32 dx, dy;
+
+	if (job->transp != MDP_TRANSP_NOP)
+		ref_get(job->src_fmt, job->transp, &ka, &kr, &kg, &kb);
+
+	for (dy = 0; dy < job->h; dy++) {
+		for (dx = 0; dx < job->w; dx++) {
+			u8 *dp = job->dst + dy * job->dst_stride + dx * dbpp;
+			u32 u = rot ? dy : dx;
+			u32 v = rot ? oh - 1 - dx : dy;
+			u32 sx, sy, sa, sr, sg, sb, da, dr, dg, db, a;
+
+			if (job->flags & MDP_FLIP_LR)
+				u = ow - 1 - u;
+			if (job->flags & MDP_FLIP_UD)
+				v = oh - 1 - v;
+			sx = job->src_rect.x + u * job->src_rect.w / ow;
+			sy = job->src_rect.y + v * job->src_rect.h / oh;
+
+			ref_get(job->src_fmt,
+				ref_load(job->src + sy * job->src_stride +
+					 sx * sbpp, sbpp),
+				&sa, &sr, &sg, &sb);
+			ref_get(job->dst_fmt, ref_load(dp, dbpp),
+				&da, &dr, &dg, &db);
+
+			a = job->sf->alpha ? sa : 255;
+			a = (a * job->alpha + 127) / 255;
+			if (job->transp != MDP_TRANSP_NOP &&
+			    sr == kr && sg == kg && sb == kb)
+				a = 0;
+			ref_save(dp, dbpp, ref_put(job->dst_fmt,
+						   ref_mix(255, da, a),
+						   ref_mix(sr, dr, a),
+						   ref_mix(sg, dg, a),
+						   ref_mix(sb, db, a)));
+		}
+	}
+}
+
+static void ppp_sw_check(const struct ppp_sw_job *job, const u8 *before)
+{
+	u32 row = job->w * job->df->bpp;
+	struct ppp_sw_job ref = *job;
+	unsigned long flags;
+	u32 y;
+	u8 *scratch;
+
+	scratch = vmalloc(row * job->h);
+	if (!scratch)
+		return;
+
+	memcpy(scratch, before, row * job->h);
+	ref.dst = scratch;
+	ref.dst_stride = row;
+	ppp_sw_ref(&ref);
+
+	for (y = 0; y < job->h; y++) {
+		const u8 *a = job->dst + y * job->dst_stride;
+		const u8 *b = scratch + y * row;
+		u32 x;
+
+		if (!memcmp(a, b, row))
+			continue;
+
+		for (x = 0; x < row && a[x] == b[x]; x++)
+			;
+		if (printk_ratelimit())
+			printk(KERN_ERR "mdp_ppp_sw: %u->%u flags 0x%x alpha "
+			       "0x%x mismatch at (%u,%u): %02x != %02x\n",
+			       job->src_fmt, job->dst_fmt, job->flags,
+			       job->alpha, x / job->df->bpp, y, a[x], b[x]);
+		spin_lock_irqsave(&ppp_sw.lock, flags);
+		ppp_sw.mismatches++;
+		spin_unlock_irqrestore(&ppp_sw.lock, flags);
+		break;
+	}
+
+	spin_lock_irqsave(&ppp_sw.lock, flags);
+	ppp_sw.verified++;
+	spin_unlock_irqrestore(&ppp_sw.lock, flags);
+	vfree(scratch);
+}
+
+/* the rectangle lies inside @img and its last byte inside the mapping */
+static int ppp_sw_rect_ok(const struct mdp_img *img,
+			  const struct mdp_rect *r, u32 bpp, unsigned long len)
+{
+	u64 stride = (u64)img->width * bpp;
+
+	if (!r->w || !r->h || stride > UINT_MAX ||
+	    r->w > img->width || r->x > img->width - r->w ||
+	    r->h > img->height || r->y > img->height - r->h)
+		return 0;
+
+	return ((u64)r->y + r->h - 1) * stride + ((u64)r->x + r->w) * bpp <=
+		len;
+}
+
+static int ppp_sw_setup(struct ppp_sw_job *job, struct mdp_blit_req *req,
+			u8 *src, unsigned long src_len,
+			u8 *dst, unsigned long dst_len)
+{
+	u32 sw, sh, scaled;
+	unsigned long s0, s1, d0, d1;
+
+	if (req->flags & ~PPP_SW_FLAGS)
+		return -EINVAL;
+
+	job->sf = ppp_sw_format(req->src.format);
+	job->df = ppp_sw_format(req->dst.format);
+	if (!job->sf || !job->df)
+		return -EINVAL;
+
+	/* word accesses in the fast path need natural alignment */
+	if (((unsigned long)src | (job->sf->bpp * req->src.width)) %
+	    (job->sf->bpp == 3 ? 1 : job->sf->bpp) ||
+	    ((unsigned long)dst | (job->df->bpp * req->dst.width)) %
+	    (job->df->bpp == 3 ? 1 : job->df->bpp))
+		return -EINVAL;
+
+	/* image sizes are not checked against the mapping elsewhere */
+	if (!ppp_sw_rect_ok(&req->src, &req->src_rect, job->sf->bpp,
+			    src_len) ||
+	    !ppp_sw_rect_ok(&req->dst, &req->dst_rect, job->df->bpp,
+			    dst_len))
+		return -EINVAL;
+
+	job->src_fmt = req->src.format;
+	job->dst_fmt = req->dst.format;
+	job->src = src;
+	job->src_stride = req->src.width * job->sf->bpp;
+	job->src_rect = req->src_rect;
+	job->dst_stride = req->dst.width * job->df->bpp;
+	job->dst = dst + req->dst_rect.y * job->dst_stride +
+		req->dst_rect.x * job->df->bpp;
+	job->w = req->dst_rect.w;
+	job->h = req->dst_rect.h;
+	job->flags = req->flags;
+	job->alpha = req->alpha & 0xff;
+	job->transp = req->transp_mask;
+
+	/* the rows are processed in place, so no overlap */
+	s0 = (unsigned long)src + req->src_rect.y * job->src_stride;
+	s1 = s0 + req->src_rect.h * job->src_stride;
+	d0 = (unsigned long)job->dst;
+	d1 = d0 + job->h * job->dst_stride;
+	if (s0 < d1 && d0 < s1)
+		return -EINVAL;
+
+	if (job->flags & MDP_ROT_90) {
+		sw = job->h;
+		sh = job->w;
+	} else {
+		sw = job->w;
+		sh = job->h;
+	}
+	scaled = sw != req->src_rect.w || sh != req->src_rect.h;
+
+	if (scaled || (job->flags & MDP_ROT_90))
+		job->cls = PPP_SW_SCALE;
+	else if (job->transp != MDP_TRANSP_NOP || job->sf->alpha ||
+		 job->alpha != 0xff)
+		job->cls = PPP_SW_BLEND;
+	else if (job->src_fmt != job->dst_fmt || job->sf->bpp == 4 ||
+		 (job->flags & (MDP_FLIP_LR | MDP_FLIP_UD)))
+		/* opaque 32bpp formats have a pad byte to rewrite */
+		job->cls = PPP_SW_CONVERT;
+	else
+		job->cls = PPP_SW_COPY;
+
+	return 0;
+}
+
+/*
+ * The kernel mapping of a cached pmem region is cached too, whatever
+ * MDP_BLIT_NON_CACHED says about the user's mapping.
+ */
+static void ppp_sw_flush(struct file *file, const struct mdp_img *img,
+			 const struct mdp_rect *r, u32 stride)
+{
+#ifdef CONFIG_ANDROID_PMEM
+	if (file)
+		flush_pmem_file(file, img->offset + r->y * stride,
+				r->h * stride);
+#endif
+}
+
+/* returns non-zero when the CPU is expected to finish first */
+static int ppp_sw_select(const struct ppp_sw_job *job)
+{
+	u32 pixels = job->w * job->h;
+	u64 sw_ns, hw_ns;
+
+	if (ppp_sw_mode == PPP_SW_ALWAYS)
+		return 1;
+	if (ppp_sw_mode != PPP_SW_AUTO || pixels > ppp_sw_max_pixels)
+		return 0;
+
+	sw_ns = div_u64((u64)pixels * ppp_sw.sw_ps[job->cls], 1000);
+	hw_ns = ppp_sw.hw_setup_ns +
+		div_u64((u64)pixels * ppp_sw.hw_ps, 1000) +
+		(u64)atomic_read(&ppp_sw.hw_queued) * ppp_sw.hw_avg_ns;
+
+	return sw_ns < hw_ns;
+}
+
+/**
+ * mdp_ppp_sw_blit() - run a blit on the CPU if that is the cheaper path
+ * @req: validated blit request
+ * @src: kernel mapping of the source image (req->src.offset applied)
+ * @src_len: bytes mapped at @src
+ * @src_file: pmem file backing @src, or NULL
+ * @dst: kernel mapping of the destination image (req->dst.offset applied)
+ * @dst_len: bytes mapped at @dst
+ * @dst_file: pmem file backing @dst, or NULL
+ *
+ * Returns 0 when the blit has been done, non-zero when the caller should
+ * send it to the PPP.  Both images are flushed before the CPU reads them
+ * and the destination again once it has been written.
+ */
+int mdp_ppp_sw_blit(struct mdp_blit_req *req, void *src,
+		    unsigned long src_len, struct file *src_file,
+		    void *dst, unsigned long dst_len, struct file *dst_file)
+{
+	struct ppp_sw_job job;
+	unsigned long flags;
+	ktime_t start;
+	u8 *before = NULL;
+	u32 pixels;
+	s64 ns;
+	int ret;
+
+	if (ppp_sw_mode == PPP_SW_OFF || !src || !dst)
+		return -EINVAL;
+
+	if (ppp_sw_setup(&job, req, src, src_len, dst, dst_len)) {
+		spin_lock_irqsave(&ppp_sw.lock, flags);
+		ppp_sw.unsupported++;
+		spin_unlock_irqrestore(&ppp_sw.lock, flags);
+		return -EINVAL;
+	}
+
+	if (!ppp_sw_select(&job))
+		return -EAGAIN;
+
+	/* either image may come from another master; blending reads dst */
+	ppp_sw_flush(src_file, &req->src, &req->src_rect, job.src_stride);
+	ppp_sw_flush(dst_file, &req->dst, &req->dst_rect, job.dst_stride);
+
+	pixels = job.w * job.h;
+	if (ppp_sw_verify) {
+		u32 row = job.w * job.df->bpp, y;
+
+		before = vmalloc(row * job.h);
+		for (y = 0; before && y < job.h; y++)
+			memcpy(before + y * row,
+			       job.dst + y * job.dst_stride, row);
+	}
+
+	start = ktime_get();
+	ret = ppp_sw_fast(&job);
+	ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+
+	if (!ret && before)
+		ppp_sw_check(&job, before);
+	vfree(before);
+	if (ret)
+		return ret;
+
+	ppp_sw_flush(dst_file, &req->dst, &req->dst_rect, job.dst_stride);
+	wmb();
+
+	spin_lock_irqsave(&ppp_sw.lock, flags);
+	ppp_sw.sw_blits[job.cls]++;
+	ppp_sw.sw_ps[job.cls] = ppp_sw_ewma(ppp_sw.sw_ps[job.cls],
+				ppp_sw_ps(ns, pixels));
+	spin_unlock_irqrestore(&ppp_sw.lock, flags);
+
+	return 0;
+}
+
+/**
+ * mdp_ppp_sw_hw_enter() - a blit is about to queue on the PPP
+ */
+void mdp_ppp_sw_hw_enter(void)
+{
+	atomic_inc(&ppp_sw.hw_queued);
+}
+
+/**
+ * mdp_ppp_sw_hw_exit() - a PPP blit has completed
+ * @req: the request
+ * @start: when the PPP was acquired for it
+ *
+ * Feeds the hardware side of the cost model.  Small blits are dominated
+ * by setup and interrupt latency and give the fixed cost, large ones
+ * give the per-pixel throughput.
+ */
+void mdp_ppp_sw_hw_exit(struct mdp_blit_req *req, ktime_t start)
+{
+	s64 ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+	u32 pixels = req->dst_rect.w * req->dst_rect.h;
+	unsigned long flags;
+
+	atomic_dec(&ppp_sw.hw_queued);
+	if (ns <= 0 || ns > NSEC_PER_SEC)
+		return;
+
+	spin_lock_irqsave(&ppp_sw.lock, flags);
+	ppp_sw.hw_blits++;
+	ppp_sw.hw_avg_ns = ppp_sw_ewma(ppp_sw.hw_avg_ns, ns);
+	if (pixels <= PPP_SW_HW_SMALL)
+		ppp_sw.hw_setup_ns = ppp_sw_ewma(ppp_sw.hw_setup_ns, ns);
+	else if (pixels >= PPP_SW_HW_LARGE && ns > ppp_sw.hw_setup_ns)
+		ppp_sw.hw_ps = ppp_sw_ewma(ppp_sw.hw_ps,
+				ppp_sw_ps(ns - ppp_sw.hw_setup_ns, pixels));
+	spin_unlock_irqrestore(&ppp_sw.lock, flags);
+}
+
+#ifdef CONFIG_DEBUG_FS
+static int ppp_sw_stats_show(struct seq_file *s, void *unused)
+{
+	unsigned long flags;
+	int i;
+
+	spin_lock_irqsave(&ppp_sw.lock, flags);
+	for (i = 0; i < PPP_SW_CLASSES; i++)
+		seq_printf(s, "sw_%s: %lu blits, %u ps/pixel\n",
+			   ppp_sw_class_names[i], ppp_sw.sw_blits[i],
+			   ppp_sw.sw_ps[i]);
+	seq_printf(s, "hw: %lu blits, %u ns setup, %u ps/pixel, "
+		   "%u ns average, %d queued\n", ppp_sw.hw_blits,
+		   ppp_sw.hw_setup_ns, ppp_sw.hw_ps, ppp_sw.hw_avg_ns,
+		   atomic_read(&ppp_sw.hw_queued));
+	seq_printf(s, "unsupported: %lu\n", ppp_sw.unsupported);
+	seq_printf(s, "verified: %lu\nmismatches: %lu\n", ppp_sw.verified,
+		   ppp_sw.mismatches);
+	spin_unlock_irqrestore(&ppp_sw.lock, flags);
+
+	return 0;
+}
+
+static int ppp_sw_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, ppp_sw_stats_show, NULL);
+}
+
+static const struct file_operations ppp_sw_stats_fops = {
+	.open = ppp_sw_stats_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+/*
+ * mdp/ppp_sw/mode: 0 off, 1 cost model, 2 every supported blit
+ * mdp/ppp_sw/max_pixels: largest blit the cost model sends to the CPU
+ * mdp/ppp_sw/verify: compare every CPU blit with the reference code
+ */
+void mdp_ppp_sw_debugfs_init(struct dentry *parent)
+{
+	struct dentry *dent = debugfs_create_dir("ppp_sw", parent);
+
+	if (IS_ERR_OR_NULL(dent))
+		return;
+
+	debugfs_create_u32("mode", 0644, dent, &ppp_sw_mode);
+	debugfs_create_u32("max_pixels", 0644, dent, &ppp_sw_max_pixels);
+	debugfs_create_u32("verify", 0644, dent, &ppp_sw_verify);
+	debugfs_create_file("stats", 0444, dent, NULL, &ppp_sw_stats_fops);
+}
+#endif
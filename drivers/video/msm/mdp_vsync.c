@@ -174,6 +174,10 @@ static void mdp_vsync_handler(void *data)
 		return;
 	}
 
+#ifdef CONFIG_FB_MSM_MDP40
+	mdp4_tl_record(MDP4_TL_VSYNC, 0);
+#endif
+
 	if (mfd->use_mdp_vsync) {
 #ifdef MDP_HW_VSYNC
 		if (mfd->panel_power_on) {
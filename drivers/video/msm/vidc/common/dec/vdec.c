@@ -123,6 +123,89 @@ static void vid_dec_notify_client(struct video_client_ctx *client_ctx)
 		complete(&client_ctx->event);
 }
 
+static struct vid_dec_msg_ring *vid_dec_get_msg_ring(
+	struct video_client_ctx *client_ctx)
+{
+	return vid_dec_device_p->msg_ring[client_ctx -
+					  vid_dec_device_p->vdec_clients];
+}
+
+static void vid_dec_queue_msg(struct video_client_ctx *client_ctx,
+			      struct vid_dec_msg_ring *ring,
+			      struct vdec_msginfo *vdec_msg_info)
+{
+	struct vid_dec_msg *vdec_msg;
+
+	mutex_lock(&client_ctx->msg_queue_lock);
+	if (ring && list_empty(&client_ctx->msg_queue) &&
+	    (ring->head - ring->tail < VID_DEC_MSG_RING_SIZE)) {
+		ring->msg[ring->head % VID_DEC_MSG_RING_SIZE] = *vdec_msg_info;
+		ring->head++;
+	} else {
+		vdec_msg = kzalloc(sizeof(struct vid_dec_msg), GFP_KERNEL);
+		if (!vdec_msg) {
+			mutex_unlock(&client_ctx->msg_queue_lock);
+			ERR("%s(): cannot allocate vid_dec_msg buffer\n",
+			    __func__);
+			return;
+		}
+		vdec_msg->vdec_msg_info = *vdec_msg_info;
+		list_add_tail(&vdec_msg->list, &client_ctx->msg_queue);
+	}
+	mutex_unlock(&client_ctx->msg_queue_lock);
+	wake_up(&client_ctx->msg_wait);
+}
+
+/*
+ * Take up to max pending messages, oldest first. Messages only go to the
+ * list while it is non-empty or the ring is full, so draining the ring
+ * before the list preserves their order.
+ */
+static u32 vid_dec_dequeue_msgs(struct video_client_ctx *client_ctx,
+				struct vid_dec_msg_ring *ring,
+				struct vdec_msginfo *vdec_msg_info, u32 max)
+{
+	struct vid_dec_msg *vdec_msg;
+	u32 count = 0;
+
+	mutex_lock(&client_ctx->msg_queue_lock);
+	while (ring && count < max && ring->tail != ring->head) {
+		vdec_msg_info[count++] =
+			ring->msg[ring->tail % VID_DEC_MSG_RING_SIZE];
+		ring->tail++;
+	}
+	while (count < max && !list_empty(&client_ctx->msg_queue)) {
+		vdec_msg = list_first_entry(&client_ctx->msg_queue,
+					    struct vid_dec_msg, list);
+		list_del(&vdec_msg->list);
+		vdec_msg_info[count++] = vdec_msg->vdec_msg_info;
+		kfree(vdec_msg);
+	}
+	mutex_unlock(&client_ctx->msg_queue_lock);
+
+	return count;
+}
+
+static u32 vid_dec_msgs_queued(struct video_client_ctx *client_ctx,
+			       struct vid_dec_msg_ring *ring)
+{
+	u32 queued;
+
+	mutex_lock(&client_ctx->msg_queue_lock);
+	queued = !list_empty(&client_ctx->msg_queue) ||
+		(ring && ring->tail != ring->head);
+	mutex_unlock(&client_ctx->msg_queue_lock);
+
+	return queued;
+}
+
+static void vid_dec_post_msg(struct video_client_ctx *client_ctx,
+			     struct vdec_msginfo *vdec_msg_info)
+{
+	vid_dec_queue_msg(client_ctx, vid_dec_get_msg_ring(client_ctx),
+			  vdec_msg_info);
+}
+
 void vid_dec_vcd_open_done(struct video_client_ctx *client_ctx,
 			   struct vcd_handle_container *handle_container)
 {
@@ -143,44 +226,36 @@ void vid_dec_vcd_open_done(struct video_client_ctx *client_ctx,
 static void vid_dec_handle_field_drop(struct video_client_ctx *client_ctx,
 	u32 event, u32 status, int64_t time_stamp)
 {
-	struct vid_dec_msg *vdec_msg;
+	struct vdec_msginfo vdec_msg_info;
 
 	if (!client_ctx) {
 		ERR("%s() NULL pointer\n", __func__);
 		return;
 	}
 
-	vdec_msg = kzalloc(sizeof(struct vid_dec_msg), GFP_KERNEL);
-	if (!vdec_msg) {
-		ERR("%s(): cannot allocate vid_dec_msg "
-			" buffer\n", __func__);
-		return;
-	}
-	vdec_msg->vdec_msg_info.status_code = vid_dec_get_status(status);
+	memset(&vdec_msg_info, 0, sizeof(vdec_msg_info));
+	vdec_msg_info.status_code = vid_dec_get_status(status);
 	if (event == VCD_EVT_IND_INFO_FIELD_DROPPED) {
-		vdec_msg->vdec_msg_info.msgcode =
+		vdec_msg_info.msgcode =
 			VDEC_MSG_EVT_INFO_FIELD_DROPPED;
-		vdec_msg->vdec_msg_info.msgdata.output_frame.time_stamp
+		vdec_msg_info.msgdata.output_frame.time_stamp
 		= time_stamp;
 		DBG("Send FIELD_DROPPED message to client = %p\n", client_ctx);
 	} else {
 		ERR("vid_dec_input_frame_done(): invalid event type: "
 			"%d\n", event);
-		vdec_msg->vdec_msg_info.msgcode = VDEC_MSG_INVALID;
+		vdec_msg_info.msgcode = VDEC_MSG_INVALID;
 	}
-	vdec_msg->vdec_msg_info.msgdatasize =
+	vdec_msg_info.msgdatasize =
 		sizeof(struct vdec_output_frameinfo);
-	mutex_lock(&client_ctx->msg_queue_lock);
-	list_add_tail(&vdec_msg->list, &client_ctx->msg_queue);
-	mutex_unlock(&client_ctx->msg_queue_lock);
-	wake_up(&client_ctx->msg_wait);
+	vid_dec_post_msg(client_ctx, &vdec_msg_info);
 }
 
 static void vid_dec_input_frame_done(struct video_client_ctx *client_ctx,
 				     u32 event, u32 status,
 				     struct vcd_frame_data *vcd_frame_data)
 {
-	struct vid_dec_msg *vdec_msg;
+	struct vdec_msginfo vdec_msg_info;
 
 	if (!client_ctx || !vcd_frame_data) {
 		ERR("vid_dec_input_frame_done() NULL pointer\n");
@@ -191,44 +266,36 @@ static void vid_dec_input_frame_done(struct video_client_ctx *client_ctx,
 	vcd_frame_data->desc_buf = NULL;
 	vcd_frame_data->desc_size = 0;
 
-	vdec_msg = kzalloc(sizeof(struct vid_dec_msg), GFP_KERNEL);
-	if (!vdec_msg) {
-		ERR("vid_dec_input_frame_done(): cannot allocate vid_dec_msg "
-		    " buffer\n");
-		return;
-	}
+	memset(&vdec_msg_info, 0, sizeof(vdec_msg_info));
 
-	vdec_msg->vdec_msg_info.status_code = vid_dec_get_status(status);
+	vdec_msg_info.status_code = vid_dec_get_status(status);
 
 	if (event == VCD_EVT_RESP_INPUT_DONE) {
-		vdec_msg->vdec_msg_info.msgcode =
+		vdec_msg_info.msgcode =
 		    VDEC_MSG_RESP_INPUT_BUFFER_DONE;
 		DBG("Send INPUT_DON message to client = %p\n", client_ctx);
 
 	} else if (event == VCD_EVT_RESP_INPUT_FLUSHED) {
-		vdec_msg->vdec_msg_info.msgcode = VDEC_MSG_RESP_INPUT_FLUSHED;
+		vdec_msg_info.msgcode = VDEC_MSG_RESP_INPUT_FLUSHED;
 		DBG("Send INPUT_FLUSHED message to client = %p\n", client_ctx);
 	} else {
 		ERR("vid_dec_input_frame_done(): invalid event type: "
 			"%d\n", event);
-		vdec_msg->vdec_msg_info.msgcode = VDEC_MSG_INVALID;
+		vdec_msg_info.msgcode = VDEC_MSG_INVALID;
 	}
 
-	vdec_msg->vdec_msg_info.msgdata.input_frame_clientdata =
+	vdec_msg_info.msgdata.input_frame_clientdata =
 	    (void *)vcd_frame_data->frm_clnt_data;
-	vdec_msg->vdec_msg_info.msgdatasize = sizeof(void *);
+	vdec_msg_info.msgdatasize = sizeof(void *);
 
-	mutex_lock(&client_ctx->msg_queue_lock);
-	list_add_tail(&vdec_msg->list, &client_ctx->msg_queue);
-	mutex_unlock(&client_ctx->msg_queue_lock);
-	wake_up(&client_ctx->msg_wait);
+	vid_dec_post_msg(client_ctx, &vdec_msg_info);
 }
 
 static void vid_dec_output_frame_done(struct video_client_ctx *client_ctx,
 			u32 event, u32 status,
 			struct vcd_frame_data *vcd_frame_data)
 {
-	struct vid_dec_msg *vdec_msg;
+	struct vdec_msginfo vdec_msg_info;
 
 	unsigned long kernel_vaddr = 0, phy_addr = 0, user_vaddr = 0;
 	int pmem_fd;
@@ -241,24 +308,19 @@ static void vid_dec_output_frame_done(struct video_client_ctx *client_ctx,
 		return;
 	}
 
-	vdec_msg = kzalloc(sizeof(struct vid_dec_msg), GFP_KERNEL);
-	if (!vdec_msg) {
-		ERR("vid_dec_input_frame_done(): cannot allocate vid_dec_msg "
-		    " buffer\n");
-		return;
-	}
+	memset(&vdec_msg_info, 0, sizeof(vdec_msg_info));
 
-	vdec_msg->vdec_msg_info.status_code = vid_dec_get_status(status);
+	vdec_msg_info.status_code = vid_dec_get_status(status);
 
 	if (event == VCD_EVT_RESP_OUTPUT_DONE)
-		vdec_msg->vdec_msg_info.msgcode =
+		vdec_msg_info.msgcode =
 		    VDEC_MSG_RESP_OUTPUT_BUFFER_DONE;
 	else if (event == VCD_EVT_RESP_OUTPUT_FLUSHED)
-		vdec_msg->vdec_msg_info.msgcode = VDEC_MSG_RESP_OUTPUT_FLUSHED;
+		vdec_msg_info.msgcode = VDEC_MSG_RESP_OUTPUT_FLUSHED;
 	else {
 		ERR("QVD: vid_dec_output_frame_done invalid cmd type: "
 			"%d\n", event);
-		vdec_msg->vdec_msg_info.msgcode = VDEC_MSG_INVALID;
+		vdec_msg_info.msgcode = VDEC_MSG_INVALID;
 	}
 
 	kernel_vaddr = (unsigned long)vcd_frame_data->virtual;
@@ -270,39 +332,39 @@ static void vid_dec_output_frame_done(struct video_client_ctx *client_ctx,
 		(vcd_frame_data->flags & VCD_FRAME_FLAG_EOS)) {
 
 		/* Buffer address in user space */
-		vdec_msg->vdec_msg_info.msgdata.output_frame.bufferaddr =
+		vdec_msg_info.msgdata.output_frame.bufferaddr =
 		    (u8 *) user_vaddr;
 		/* Data length */
-		vdec_msg->vdec_msg_info.msgdata.output_frame.len =
+		vdec_msg_info.msgdata.output_frame.len =
 		    vcd_frame_data->data_len;
-		vdec_msg->vdec_msg_info.msgdata.output_frame.flags =
+		vdec_msg_info.msgdata.output_frame.flags =
 		    vcd_frame_data->flags;
 		/* Timestamp pass-through from input frame */
-		vdec_msg->vdec_msg_info.msgdata.output_frame.time_stamp =
+		vdec_msg_info.msgdata.output_frame.time_stamp =
 		    vcd_frame_data->time_stamp;
 		/* Output frame client data */
-		vdec_msg->vdec_msg_info.msgdata.output_frame.client_data =
+		vdec_msg_info.msgdata.output_frame.client_data =
 		    (void *)vcd_frame_data->frm_clnt_data;
 		/* Associated input frame client data */
-		vdec_msg->vdec_msg_info.msgdata.output_frame.
+		vdec_msg_info.msgdata.output_frame.
 		    input_frame_clientdata =
 		    (void *)vcd_frame_data->ip_frm_tag;
 		/* Decoded picture width and height */
-		vdec_msg->vdec_msg_info.msgdata.output_frame.framesize.
+		vdec_msg_info.msgdata.output_frame.framesize.
 		bottom =
 		    vcd_frame_data->dec_op_prop.disp_frm.bottom;
-		vdec_msg->vdec_msg_info.msgdata.output_frame.framesize.left =
+		vdec_msg_info.msgdata.output_frame.framesize.left =
 		    vcd_frame_data->dec_op_prop.disp_frm.left;
-		vdec_msg->vdec_msg_info.msgdata.output_frame.framesize.right =
+		vdec_msg_info.msgdata.output_frame.framesize.right =
 			vcd_frame_data->dec_op_prop.disp_frm.right;
-		vdec_msg->vdec_msg_info.msgdata.output_frame.framesize.top =
+		vdec_msg_info.msgdata.output_frame.framesize.top =
 			vcd_frame_data->dec_op_prop.disp_frm.top;
 		if (vcd_frame_data->interlaced) {
-			vdec_msg->vdec_msg_info.msgdata.
+			vdec_msg_info.msgdata.
 				output_frame.interlaced_format =
 				VDEC_InterlaceInterleaveFrameTopFieldFirst;
 		} else {
-			vdec_msg->vdec_msg_info.msgdata.
+			vdec_msg_info.msgdata.
 				output_frame.interlaced_format =
 				VDEC_InterlaceFrameProgressive;
 		}
@@ -326,86 +388,79 @@ static void vid_dec_output_frame_done(struct video_client_ctx *client_ctx,
 		default:
 			pic_type = PICTURE_TYPE_UNKNOWN;
 		}
-		vdec_msg->vdec_msg_info.msgdata.output_frame.pic_type =
+		vdec_msg_info.msgdata.output_frame.pic_type =
 			pic_type;
-		vdec_msg->vdec_msg_info.msgdatasize =
+		vdec_msg_info.msgdatasize =
 		    sizeof(struct vdec_output_frameinfo);
 	} else {
 		ERR("vid_dec_output_frame_done UVA can not be found\n");
-		vdec_msg->vdec_msg_info.status_code = VDEC_S_EFATAL;
+		vdec_msg_info.status_code = VDEC_S_EFATAL;
 	}
 
-	mutex_lock(&client_ctx->msg_queue_lock);
-	list_add_tail(&vdec_msg->list, &client_ctx->msg_queue);
-	mutex_unlock(&client_ctx->msg_queue_lock);
-	wake_up(&client_ctx->msg_wait);
+	vid_dec_post_msg(client_ctx, &vdec_msg_info);
 }
 
 static void vid_dec_lean_event(struct video_client_ctx *client_ctx,
 			       u32 event, u32 status)
 {
-	struct vid_dec_msg *vdec_msg;
+	struct vdec_msginfo vdec_msg_info;
 
 	if (!client_ctx) {
 		ERR("%s(): !client_ctx pointer\n", __func__);
 		return;
 	}
 
-	vdec_msg = kzalloc(sizeof(struct vid_dec_msg), GFP_KERNEL);
-	if (!vdec_msg) {
-		ERR("%s(): cannot allocate vid_dec_msg buffer\n", __func__);
-		return;
-	}
+	memset(&vdec_msg_info, 0, sizeof(vdec_msg_info));
 
-	vdec_msg->vdec_msg_info.status_code = vid_dec_get_status(status);
+	vdec_msg_info.status_code = vid_dec_get_status(status);
 
 	switch (event) {
 	case VCD_EVT_IND_OUTPUT_RECONFIG:
 		DBG("msm_vidc_dec: Sending VDEC_MSG_EVT_CONFIG_CHANGED"
 			 " to client");
-		vdec_msg->vdec_msg_info.msgcode = VDEC_MSG_EVT_CONFIG_CHANGED;
+		vdec_msg_info.msgcode = VDEC_MSG_EVT_CONFIG_CHANGED;
 		break;
 	case VCD_EVT_IND_RESOURCES_LOST:
 		DBG("msm_vidc_dec: Sending VDEC_EVT_RESOURCES_LOST"
 			 " to client");
-		vdec_msg->vdec_msg_info.msgcode = VDEC_EVT_RESOURCES_LOST;
+		vdec_msg_info.msgcode = VDEC_EVT_RESOURCES_LOST;
 		break;
 	case VCD_EVT_RESP_FLUSH_INPUT_DONE:
 		DBG("msm_vidc_dec: Sending VDEC_MSG_RESP_FLUSH_INPUT_DONE"
 			 " to client");
-		vdec_msg->vdec_msg_info.msgcode =
+		vdec_msg_info.msgcode =
 		    VDEC_MSG_RESP_FLUSH_INPUT_DONE;
 		break;
 	case VCD_EVT_RESP_FLUSH_OUTPUT_DONE:
 		DBG("msm_vidc_dec: Sending VDEC_MSG_RESP_FLUSH_OUTPUT_DONE"
 			 " to client");
-		vdec_msg->vdec_msg_info.msgcode =
+		vdec_msg_info.msgcode =
 		    VDEC_MSG_RESP_FLUSH_OUTPUT_DONE;
 		break;
 	case VCD_EVT_IND_HWERRFATAL:
 		DBG("msm_vidc_dec: Sending VDEC_MSG_EVT_HW_ERROR"
 			 " to client");
-		vdec_msg->vdec_msg_info.msgcode = VDEC_MSG_EVT_HW_ERROR;
+		vdec_msg_info.msgcode = VDEC_MSG_EVT_HW_ERROR;
 		break;
 	case VCD_EVT_RESP_START:
 		DBG("msm_vidc_dec: Sending VDEC_MSG_RESP_START_DONE"
 			 " to client");
-		vdec_msg->vdec_msg_info.msgcode = VDEC_MSG_RESP_START_DONE;
+		vdec_msg_info.msgcode = VDEC_MSG_RESP_START_DONE;
 		break;
 	case VCD_EVT_RESP_STOP:
 		DBG("msm_vidc_dec: Sending VDEC_MSG_RESP_STOP_DONE"
 			 " to client");
-		vdec_msg->vdec_msg_info.msgcode = VDEC_MSG_RESP_STOP_DONE;
+		vdec_msg_info.msgcode = VDEC_MSG_RESP_STOP_DONE;
 		break;
 	case VCD_EVT_RESP_PAUSE:
 		DBG("msm_vidc_dec: Sending VDEC_MSG_RESP_PAUSE_DONE"
 			 " to client");
-		vdec_msg->vdec_msg_info.msgcode = VDEC_MSG_RESP_PAUSE_DONE;
+		vdec_msg_info.msgcode = VDEC_MSG_RESP_PAUSE_DONE;
 		break;
 	case VCD_EVT_IND_INFO_OUTPUT_RECONFIG:
 		DBG("msm_vidc_dec: Sending VDEC_MSG_EVT_INFO_CONFIG_CHANGED"
 			 " to client");
-		vdec_msg->vdec_msg_info.msgcode =
+		vdec_msg_info.msgcode =
 			 VDEC_MSG_EVT_INFO_CONFIG_CHANGED;
 		break;
 	default:
@@ -413,18 +468,14 @@ static void vid_dec_lean_event(struct video_client_ctx *client_ctx,
 		break;
 	}
 
-	vdec_msg->vdec_msg_info.msgdatasize = 0;
+	vdec_msg_info.msgdatasize = 0;
 	if (client_ctx->stop_sync_cb &&
 	   (event == VCD_EVT_RESP_STOP || event == VCD_EVT_IND_HWERRFATAL)) {
 		client_ctx->stop_sync_cb = false;
 		complete(&client_ctx->event);
-		kfree(vdec_msg);
 		return;
 	}
-	mutex_lock(&client_ctx->msg_queue_lock);
-	list_add_tail(&vdec_msg->list, &client_ctx->msg_queue);
-	mutex_unlock(&client_ctx->msg_queue_lock);
-	wake_up(&client_ctx->msg_wait);
+	vid_dec_post_msg(client_ctx, &vdec_msg_info);
 }
 
 
@@ -1107,7 +1158,7 @@ static u32 vid_dec_pause_resume(struct video_client_ctx *client_ctx, u32 pause)
 
 static u32 vid_dec_start_stop(struct video_client_ctx *client_ctx, u32 start)
 {
-	struct vid_dec_msg *vdec_msg = NULL;
+	struct vdec_msginfo vdec_msg_info;
 	u32 vcd_status;
 
 	DBG("msm_vidc_dec: Inside %s()", __func__);
@@ -1120,21 +1171,11 @@ static u32 vid_dec_start_stop(struct video_client_ctx *client_ctx, u32 start)
 		if (client_ctx->seq_header_set) {
 			DBG("%s(): Seq Hdr set: Send START_DONE to client",
 				 __func__);
-			vdec_msg = kzalloc(sizeof(*vdec_msg), GFP_KERNEL);
-			if (!vdec_msg) {
-				ERR("vid_dec_start_stop: cannot allocate"
-				    "buffer\n");
-				return false;
-			}
-			vdec_msg->vdec_msg_info.msgcode =
-			    VDEC_MSG_RESP_START_DONE;
-			vdec_msg->vdec_msg_info.status_code = VDEC_S_SUCCESS;
-			vdec_msg->vdec_msg_info.msgdatasize = 0;
-			mutex_lock(&client_ctx->msg_queue_lock);
-			list_add_tail(&vdec_msg->list, &client_ctx->msg_queue);
-			mutex_unlock(&client_ctx->msg_queue_lock);
-
-			wake_up(&client_ctx->msg_wait);
+			memset(&vdec_msg_info, 0, sizeof(vdec_msg_info));
+			vdec_msg_info.msgcode = VDEC_MSG_RESP_START_DONE;
+			vdec_msg_info.status_code = VDEC_S_SUCCESS;
+			vdec_msg_info.msgdatasize = 0;
+			vid_dec_post_msg(client_ctx, &vdec_msg_info);
 
 			DBG("Send START_DONE message to client = %p\n",
 			    client_ctx);
@@ -1266,6 +1307,60 @@ static u32 vid_dec_fill_output_buffer(struct video_client_ctx *client_ctx,
 	}
 }
 
+static int vid_dec_decode_user_frame(struct video_client_ctx *client_ctx,
+				     void *frame)
+{
+	struct vdec_input_frameinfo *input_frame_info = frame;
+	u8 *desc_buf = NULL;
+	u32 desc_size = 0;
+
+	if (client_ctx->dmx_disable) {
+		if (!input_frame_info->desc_addr)
+			return -EINVAL;
+		desc_size = input_frame_info->desc_size;
+		desc_buf = kzalloc(desc_size, GFP_KERNEL);
+		if (desc_buf && copy_from_user(desc_buf,
+				input_frame_info->desc_addr, desc_size)) {
+			kfree(desc_buf);
+			return -EFAULT;
+		}
+	}
+	if (!vid_dec_decode_frame(client_ctx, input_frame_info,
+				  desc_buf, desc_size)) {
+		kfree(desc_buf);
+		return -EIO;
+	}
+	return 0;
+}
+
+static int vid_dec_fill_user_buffer(struct video_client_ctx *client_ctx,
+				    void *cmd)
+{
+	if (!vid_dec_fill_output_buffer(client_ctx, cmd))
+		return -EIO;
+	return 0;
+}
+
+/*
+ * Hand count entries of size bytes each to submit in order, stopping at
+ * the first failure; *queued tells the caller how many made it so it can
+ * resubmit the rest.
+ */
+static int vid_dec_submit_batch(struct video_client_ctx *client_ctx,
+	void *entries, u32 count, size_t size,
+	int (*submit)(struct video_client_ctx *, void *), u32 *queued)
+{
+	int rc = 0;
+	u32 i;
+
+	for (i = 0; i < count; i++) {
+		rc = submit(client_ctx, (u8 *)entries + i * size);
+		if (rc)
+			break;
+	}
+	*queued = i;
+	return rc;
+}
 
 static u32 vid_dec_flush(struct video_client_ctx *client_ctx,
 			 enum vdec_bufferflush flush_dir)
@@ -1309,9 +1404,9 @@ static u32 vid_dec_flush(struct video_client_ctx *client_ctx,
 static u32 vid_dec_msg_pending(struct video_client_ctx *client_ctx)
 {
 	u32 islist_empty = 0;
-	mutex_lock(&client_ctx->msg_queue_lock);
-	islist_empty = list_empty(&client_ctx->msg_queue);
-	mutex_unlock(&client_ctx->msg_queue_lock);
+
+	islist_empty = !vid_dec_msgs_queued(client_ctx,
+					    vid_dec_get_msg_ring(client_ctx));
 
 	if (islist_empty) {
 		DBG("%s(): vid_dec msg queue empty\n", __func__);
@@ -1326,11 +1421,10 @@ static u32 vid_dec_msg_pending(struct video_client_ctx *client_ctx)
 	return !islist_empty;
 }
 
-static int vid_dec_get_next_msg(struct video_client_ctx *client_ctx,
-				struct vdec_msginfo *vdec_msg_info)
+static int vid_dec_get_next_msgs(struct video_client_ctx *client_ctx,
+				 struct vdec_msginfo *vdec_msg_info, u32 *count)
 {
 	int rc;
-	struct vid_dec_msg *vid_dec_msg = NULL;
 
 	if (!client_ctx)
 		return false;
@@ -1345,17 +1439,10 @@ static int vid_dec_get_next_msg(struct video_client_ctx *client_ctx,
 		return -EIO;
 	}
 
-	mutex_lock(&client_ctx->msg_queue_lock);
-	if (!list_empty(&client_ctx->msg_queue)) {
-		DBG("%s(): After Wait\n", __func__);
-		vid_dec_msg = list_first_entry(&client_ctx->msg_queue,
-					       struct vid_dec_msg, list);
-		list_del(&vid_dec_msg->list);
-		memcpy(vdec_msg_info, &vid_dec_msg->vdec_msg_info,
-		       sizeof(struct vdec_msginfo));
-		kfree(vid_dec_msg);
-	}
-	mutex_unlock(&client_ctx->msg_queue_lock);
+	DBG("%s(): After Wait\n", __func__);
+	*count = vid_dec_dequeue_msgs(client_ctx,
+				      vid_dec_get_msg_ring(client_ctx),
+				      vdec_msg_info, *count);
 	return 0;
 }
 
@@ -1572,38 +1659,48 @@ static long vid_dec_ioctl(struct file *file,
 	case VDEC_IOCTL_DECODE_FRAME:
 	{
 		struct vdec_input_frameinfo input_frame_info;
-		u8 *desc_buf = NULL;
-		u32 desc_size = 0;
 		DBG("VDEC_IOCTL_DECODE_FRAME\n");
 		if (copy_from_user(&vdec_msg, arg, sizeof(vdec_msg)))
 			return -EFAULT;
 		if (copy_from_user(&input_frame_info, vdec_msg.in,
 				   sizeof(input_frame_info)))
 			return -EFAULT;
-		if (client_ctx->dmx_disable) {
-			if (input_frame_info.desc_addr) {
-				desc_size = input_frame_info.desc_size;
-				desc_buf = kzalloc(desc_size, GFP_KERNEL);
-				if (desc_buf) {
-					if (copy_from_user(desc_buf,
-						input_frame_info.desc_addr,
-							desc_size)) {
-						kfree(desc_buf);
-						desc_buf = NULL;
-						return -EFAULT;
-					}
-				}
-			} else
-				return -EINVAL;
-		}
-		result = vid_dec_decode_frame(client_ctx, &input_frame_info,
-					desc_buf, desc_size);
-
-		if (!result) {
-			kfree(desc_buf);
-			desc_buf = NULL;
-			return -EIO;
+		rc = vid_dec_decode_user_frame(client_ctx, &input_frame_info);
+		if (rc)
+			return rc;
+		break;
+	}
+	case VDEC_IOCTL_DECODE_FRAMES:
+	{
+		struct vdec_input_batch input_batch;
+		struct vdec_input_frameinfo *frames;
+		u32 queued;
+		DBG("VDEC_IOCTL_DECODE_FRAMES\n");
+		if (copy_from_user(&vdec_msg, arg, sizeof(vdec_msg)))
+			return -EFAULT;
+		if (copy_from_user(&input_batch, vdec_msg.in,
+				   sizeof(input_batch)))
+			return -EFAULT;
+		if (!input_batch.count || input_batch.count > VDEC_MAX_BATCH)
+			return -EINVAL;
+		frames = kmalloc(input_batch.count * sizeof(*frames),
+				 GFP_KERNEL);
+		if (!frames)
+			return -ENOMEM;
+		if (copy_from_user(frames, input_batch.frames,
+				   input_batch.count * sizeof(*frames))) {
+			kfree(frames);
+			return -EFAULT;
 		}
+		rc = vid_dec_submit_batch(client_ctx, frames,
+					  input_batch.count, sizeof(*frames),
+					  vid_dec_decode_user_frame, &queued);
+		kfree(frames);
+		if (rc && !queued)
+			return rc;
+		if (copy_to_user(vdec_msg.out, &queued, sizeof(queued)))
+			return -EFAULT;
+		rc = 0;
 		break;
 	}
 	case VDEC_IOCTL_FILL_OUTPUT_BUFFER:
@@ -1621,6 +1718,38 @@ static long vid_dec_ioctl(struct file *file,
 			return -EIO;
 		break;
 	}
+	case VDEC_IOCTL_FILL_OUTPUT_BUFFERS:
+	{
+		struct vdec_fillbuffer_batch fill_batch;
+		struct vdec_fillbuffer_cmd *cmds;
+		u32 queued;
+		DBG("VDEC_IOCTL_FILL_OUTPUT_BUFFERS\n");
+		if (copy_from_user(&vdec_msg, arg, sizeof(vdec_msg)))
+			return -EFAULT;
+		if (copy_from_user(&fill_batch, vdec_msg.in,
+				   sizeof(fill_batch)))
+			return -EFAULT;
+		if (!fill_batch.count || fill_batch.count > VDEC_MAX_BATCH)
+			return -EINVAL;
+		cmds = kmalloc(fill_batch.count * sizeof(*cmds), GFP_KERNEL);
+		if (!cmds)
+			return -ENOMEM;
+		if (copy_from_user(cmds, fill_batch.cmds,
+				   fill_batch.count * sizeof(*cmds))) {
+			kfree(cmds);
+			return -EFAULT;
+		}
+		rc = vid_dec_submit_batch(client_ctx, cmds, fill_batch.count,
+					  sizeof(*cmds),
+					  vid_dec_fill_user_buffer, &queued);
+		kfree(cmds);
+		if (rc && !queued)
+			return rc;
+		if (copy_to_user(vdec_msg.out, &queued, sizeof(queued)))
+			return -EFAULT;
+		rc = 0;
+		break;
+	}
 	case VDEC_IOCTL_CMD_FLUSH:
 	{
 		enum vdec_bufferflush flush_dir;
@@ -1638,10 +1767,12 @@ static long vid_dec_ioctl(struct file *file,
 	case VDEC_IOCTL_GET_NEXT_MSG:
 	{
 		struct vdec_msginfo vdec_msg_info;
+		u32 count = 1;
 		DBG("VDEC_IOCTL_GET_NEXT_MSG\n");
 		if (copy_from_user(&vdec_msg, arg, sizeof(vdec_msg)))
 			return -EFAULT;
-		result = vid_dec_get_next_msg(client_ctx, &vdec_msg_info);
+		result = vid_dec_get_next_msgs(client_ctx, &vdec_msg_info,
+					       &count);
 		if (result)
 			return result;
 		if (copy_to_user(vdec_msg.out, &vdec_msg_info,
@@ -1649,6 +1780,33 @@ static long vid_dec_ioctl(struct file *file,
 			return -EFAULT;
 		break;
 	}
+	case VDEC_IOCTL_GET_NEXT_MSGS:
+	{
+		struct vdec_msg_batch msg_batch;
+		struct vdec_msginfo *msgs;
+		u32 count;
+		DBG("VDEC_IOCTL_GET_NEXT_MSGS\n");
+		if (copy_from_user(&vdec_msg, arg, sizeof(vdec_msg)))
+			return -EFAULT;
+		if (copy_from_user(&msg_batch, vdec_msg.in, sizeof(msg_batch)))
+			return -EFAULT;
+		if (!msg_batch.count)
+			return -EINVAL;
+		count = min_t(u32, msg_batch.count, VDEC_MAX_BATCH);
+		msgs = kmalloc(count * sizeof(*msgs), GFP_KERNEL);
+		if (!msgs)
+			return -ENOMEM;
+		rc = vid_dec_get_next_msgs(client_ctx, msgs, &count);
+		if (!rc && copy_to_user(msg_batch.msgs, msgs,
+					count * sizeof(*msgs)))
+			rc = -EFAULT;
+		kfree(msgs);
+		if (rc)
+			return rc;
+		if (copy_to_user(vdec_msg.out, &count, sizeof(count)))
+			return -EFAULT;
+		break;
+	}
 	case VDEC_IOCTL_STOP_NEXT_MSG:
 	{
 		DBG("VDEC_IOCTL_STOP_NEXT_MSG\n");
@@ -1938,6 +2096,7 @@ static long vid_dec_ioctl(struct file *file,
 
 static u32 vid_dec_close_client(struct video_client_ctx *client_ctx)
 {
+	struct vid_dec_msg_ring *ring;
 	struct vid_dec_msg *vdec_msg;
 	u32 vcd_status;
 
@@ -1958,6 +2117,9 @@ static u32 vid_dec_close_client(struct video_client_ctx *client_ctx)
 		DBG("\n Came out of wait event");
 	}
 	mutex_lock(&client_ctx->msg_queue_lock);
+	ring = vid_dec_get_msg_ring(client_ctx);
+	if (ring)
+		ring->tail = ring->head;
 	while (!list_empty(&client_ctx->msg_queue)) {
 		DBG("%s(): Delete remaining entries\n", __func__);
 		vdec_msg = list_first_entry(&client_ctx->msg_queue,
@@ -1986,6 +2148,7 @@ int vid_dec_open_client(struct video_client_ctx **vid_clnt_ctx, int flags)
 	int rc = 0;
 	s32 client_index;
 	struct video_client_ctx *client_ctx = NULL;
+	struct vid_dec_msg_ring *ring;
 	u8 client_count;
 
 	if (!vid_clnt_ctx) {
@@ -2017,11 +2180,21 @@ int vid_dec_open_client(struct video_client_ctx **vid_clnt_ctx, int flags)
 	}
 	client_ctx = &vid_dec_device_p->vdec_clients[client_index];
 	vid_dec_device_p->num_clients++;
+	/* kept for the next client in this slot; list only if it fails */
+	if (!vid_dec_device_p->msg_ring[client_index])
+		vid_dec_device_p->msg_ring[client_index] = kzalloc(
+			sizeof(struct vid_dec_msg_ring), GFP_KERNEL);
 	init_completion(&client_ctx->event);
 	mutex_init(&client_ctx->msg_queue_lock);
 	mutex_init(&client_ctx->enrty_queue_lock);
 	INIT_LIST_HEAD(&client_ctx->msg_queue);
 	init_waitqueue_head(&client_ctx->msg_wait);
+	/* the ring outlives the previous client of this slot */
+	mutex_lock(&client_ctx->msg_queue_lock);
+	ring = vid_dec_get_msg_ring(client_ctx);
+	if (ring)
+		ring->head = ring->tail = 0;
+	mutex_unlock(&client_ctx->msg_queue_lock);
 	client_ctx->stop_msg = 0;
 	client_ctx->stop_called = false;
 	client_ctx->stop_sync_cb = false;
@@ -2210,6 +2383,207 @@ static int vid_dec_vcd_init(void)
 	return 0;
 }
 
+#ifdef CONFIG_MSM_VIDC_VDEC_SELFTEST
+/*
+ * Software stand-in for the video core: every frame the test submits
+ * through vid_dec_submit_batch() is answered from a work item, the way
+ * vid_dec_vcd_cb() answers the core, with an INPUT_BUFFER_DONE and then
+ * an OUTPUT_BUFFER_DONE carrying the frame's timestamp. The test drains
+ * the messages in small batches while the stand-in is still producing,
+ * after letting it overrun the ring, and checks none is lost or
+ * reordered.
+ */
+#define VID_DEC_SELFTEST_FRAMES	(4 * VID_DEC_MSG_RING_SIZE + 5)
+#define VID_DEC_SELFTEST_DRAIN	7
+#define VID_DEC_SELFTEST_TS	33333
+
+struct vid_dec_selftest {
+	struct video_client_ctx client_ctx;
+	struct vid_dec_msg_ring ring;
+	struct work_struct fw_work;
+	spinlock_t fw_lock;
+	u32 submitted;
+	u32 answered;
+	u32 reject_at;
+	u32 seen;
+	u32 drains;
+	u32 errors;
+};
+
+static int vid_dec_selftest_submit(struct video_client_ctx *client_ctx,
+				   void *frame)
+{
+	struct vid_dec_selftest *st = container_of(client_ctx,
+					struct vid_dec_selftest, client_ctx);
+	struct vdec_input_frameinfo *input_frame_info = frame;
+
+	if ((unsigned long)input_frame_info->client_data == st->reject_at)
+		return -EIO;
+
+	spin_lock(&st->fw_lock);
+	st->submitted++;
+	spin_unlock(&st->fw_lock);
+	schedule_work(&st->fw_work);
+	return 0;
+}
+
+static void vid_dec_selftest_fw(struct work_struct *work)
+{
+	struct vid_dec_selftest *st = container_of(work,
+					struct vid_dec_selftest, fw_work);
+	struct vdec_msginfo vdec_msg_info;
+	u32 frame;
+
+	for (;;) {
+		spin_lock(&st->fw_lock);
+		if (st->answered == st->submitted) {
+			spin_unlock(&st->fw_lock);
+			break;
+		}
+		frame = st->answered++;
+		spin_unlock(&st->fw_lock);
+
+		memset(&vdec_msg_info, 0, sizeof(vdec_msg_info));
+		vdec_msg_info.msgcode = VDEC_MSG_RESP_INPUT_BUFFER_DONE;
+		vdec_msg_info.msgdata.input_frame_clientdata =
+			(void *)(unsigned long)frame;
+		vdec_msg_info.msgdatasize = sizeof(void *);
+		vid_dec_queue_msg(&st->client_ctx, &st->ring, &vdec_msg_info);
+
+		memset(&vdec_msg_info, 0, sizeof(vdec_msg_info));
+		vdec_msg_info.msgcode = VDEC_MSG_RESP_OUTPUT_BUFFER_DONE;
+		vdec_msg_info.msgdata.output_frame.client_data =
+			(void *)(unsigned long)frame;
+		vdec_msg_info.msgdata.output_frame.time_stamp =
+			(int64_t)frame * VID_DEC_SELFTEST_TS;
+		vdec_msg_info.msgdatasize =
+			sizeof(struct vdec_output_frameinfo);
+		vid_dec_queue_msg(&st->client_ctx, &st->ring, &vdec_msg_info);
+	}
+}
+
+static int vid_dec_selftest_drain(struct vid_dec_selftest *st, u32 want)
+{
+	struct vdec_msginfo msgs[VID_DEC_SELFTEST_DRAIN];
+	struct vdec_msginfo *m;
+	u32 count, frame, i;
+
+	while (st->seen < want) {
+		if (!wait_event_timeout(st->client_ctx.msg_wait,
+				vid_dec_msgs_queued(&st->client_ctx,
+						    &st->ring), HZ))
+			return -ETIMEDOUT;
+
+		count = vid_dec_dequeue_msgs(&st->client_ctx, &st->ring,
+					     msgs, ARRAY_SIZE(msgs));
+		st->drains++;
+		for (i = 0; i < count; i++, st->seen++) {
+			m = &msgs[i];
+			frame = st->seen / 2;
+			if (st->seen & 1) {
+				if (m->msgcode !=
+					VDEC_MSG_RESP_OUTPUT_BUFFER_DONE ||
+				    m->msgdata.output_frame.client_data !=
+					(void *)(unsigned long)frame ||
+				    m->msgdata.output_frame.time_stamp !=
+					(int64_t)frame * VID_DEC_SELFTEST_TS)
+					st->errors++;
+			} else {
+				if (m->msgcode !=
+					VDEC_MSG_RESP_INPUT_BUFFER_DONE ||
+				    m->msgdata.input_frame_clientdata !=
+					(void *)(unsigned long)frame)
+					st->errors++;
+			}
+		}
+	}
+	return 0;
+}
+
+static u32 vid_dec_selftest_batch(struct vid_dec_selftest *st,
+				  struct vdec_input_frameinfo *frames,
+				  u32 first, u32 count, int *rc)
+{
+	u32 i, queued;
+
+	for (i = 0; i < count; i++) {
+		memset(&frames[i], 0, sizeof(frames[i]));
+		frames[i].client_data = (void *)(unsigned long)(first + i);
+		frames[i].timestamp = (int64_t)(first + i) *
+			VID_DEC_SELFTEST_TS;
+	}
+	*rc = vid_dec_submit_batch(&st->client_ctx, frames, count,
+				   sizeof(*frames), vid_dec_selftest_submit,
+				   &queued);
+	return queued;
+}
+
+static void vid_dec_selftest(void)
+{
+	struct vid_dec_selftest *st;
+	struct vdec_input_frameinfo *frames;
+	u32 sent = 0, count, queued, spilled;
+	int rc;
+
+	st = kzalloc(sizeof(*st), GFP_KERNEL);
+	frames = kmalloc(VDEC_MAX_BATCH * sizeof(*frames), GFP_KERNEL);
+	if (!st || !frames) {
+		ERR("%s: no memory\n", __func__);
+		goto out;
+	}
+	mutex_init(&st->client_ctx.msg_queue_lock);
+	INIT_LIST_HEAD(&st->client_ctx.msg_queue);
+	init_waitqueue_head(&st->client_ctx.msg_wait);
+	spin_lock_init(&st->fw_lock);
+	INIT_WORK(&st->fw_work, vid_dec_selftest_fw);
+	st->reject_at = VID_DEC_SELFTEST_FRAMES + 3;
+
+	/* overrun the ring before draining anything */
+	while (sent < 2 * VDEC_MAX_BATCH) {
+		sent += vid_dec_selftest_batch(st, frames, sent,
+					       VDEC_MAX_BATCH, &rc);
+		if (rc)
+			st->errors++;
+	}
+	flush_work(&st->fw_work);
+	spilled = !list_empty(&st->client_ctx.msg_queue);
+
+	/* then drain, lagging behind, while the stand-in keeps answering */
+	while (sent < VID_DEC_SELFTEST_FRAMES) {
+		count = min_t(u32, VDEC_MAX_BATCH,
+			      VID_DEC_SELFTEST_FRAMES - sent);
+		sent += vid_dec_selftest_batch(st, frames, sent, count, &rc);
+		if (rc)
+			st->errors++;
+		if (vid_dec_selftest_drain(st, sent))
+			st->errors++;
+	}
+
+	/* a rejected entry stops the batch and reports what got in */
+	queued = vid_dec_selftest_batch(st, frames, sent, 8, &rc);
+	if (rc != -EIO || queued != 3)
+		st->errors++;
+	sent += queued;
+	if (vid_dec_selftest_drain(st, 2 * sent))
+		st->errors++;
+	flush_work(&st->fw_work);
+
+	if (!spilled || vid_dec_msgs_queued(&st->client_ctx, &st->ring) ||
+	    st->seen != 2 * sent)
+		st->errors++;
+
+	if (st->errors)
+		ERR("%s: FAILED, %u errors, %u of %u messages\n", __func__,
+		    st->errors, st->seen, 2 * sent);
+	else
+		INFO("%s: %u frames, %u messages in %u drains: passed\n",
+		     __func__, sent, st->seen, st->drains);
+out:
+	kfree(frames);
+	kfree(st);
+}
+#endif
+
 static int __init vid_dec_init(void)
 {
 	int rc = 0, i = 0, j = 0;
@@ -2268,6 +2642,9 @@ static int __init vid_dec_init(void)
 		}
 	}
 	vid_dec_vcd_init();
+#ifdef CONFIG_MSM_VIDC_VDEC_SELFTEST
+	vid_dec_selftest();
+#endif
 	return 0;
 
 error_vid_dec_cdev_add:
@@ -2292,6 +2669,8 @@ static void __exit vid_dec_exit(void)
 	device_destroy(vid_dec_class, vid_dec_dev_num);
 	class_destroy(vid_dec_class);
 	unregister_chrdev_region(vid_dec_dev_num, NUM_OF_DRIVER_NODES);
+	for (i = 0; i < VIDC_MAX_NUM_CLIENTS; i++)
+		kfree(vid_dec_device_p->msg_ring[i]);
 	kfree(vid_dec_device_p);
 	DBG("msm_vidc_dec: Return from %s()", __func__);
 }
@@ -25,6 +25,20 @@ struct vid_dec_msg {
 	struct vdec_msginfo vdec_msg_info;
 };
 
+/*
+ * Completion messages land in a fixed per client ring first and only
+ * spill to msg_queue (one allocation each) while the ring is full; the
+ * ring is always drained before the list so the client sees them in
+ * the order the core produced them. Both are under msg_queue_lock.
+ */
+#define VID_DEC_MSG_RING_SIZE 32
+
+struct vid_dec_msg_ring {
+	struct vdec_msginfo msg[VID_DEC_MSG_RING_SIZE];
+	u32 head;
+	u32 tail;
+};
+
 struct vid_dec_dev {
 	struct cdev cdev[NUM_OF_DRIVER_NODES];
 	struct device *device[NUM_OF_DRIVER_NODES];
@@ -38,6 +52,7 @@ struct vid_dec_dev {
 	struct mutex lock;
 	s32 device_handle;
 	struct video_client_ctx vdec_clients[VIDC_MAX_NUM_CLIENTS];
+	struct vid_dec_msg_ring *msg_ring[VIDC_MAX_NUM_CLIENTS];
 	u32 num_clients;
 	void(*timer_handler)(void *);
 };
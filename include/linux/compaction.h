@@ -27,6 +27,13 @@ extern unsigned long compaction_suitable(struct zone *zone, int order);
 extern unsigned long compact_zone_order(struct zone *zone, int order,
 					gfp_t gfp_mask, bool sync);
 
+extern int sysctl_kcompactd_order;
+extern int sysctl_kcompactd_min_free_blocks;
+extern int sysctl_kcompactd_interval_ms;
+extern int sysctl_kcompactd_handler(struct ctl_table *table, int write,
+			void __user *buffer, size_t *length, loff_t *ppos);
+extern void wakeup_kcompactd(pg_data_t *pgdat, int order);
+
 /* Do not skip compaction more than 64 times */
 #define COMPACT_MAX_DEFER_SHIFT 6
 
@@ -75,6 +82,10 @@ static inline unsigned long compact_zone_order(struct zone *zone, int order,
 	return COMPACT_CONTINUE;
 }
 
+static inline void wakeup_kcompactd(pg_data_t *pgdat, int order)
+{
+}
+
 static inline void defer_compaction(struct zone *zone)
 {
 }
@@ -283,6 +283,9 @@ struct mm_struct {
 	/* How many tasks sharing this mm are OOM_DISABLE */
 	atomic_t oom_disable_count;
 
+	/* oom_score_adj of the owning process, used as a reclaim hint */
+	int oom_score_adj;
+
 	unsigned long flags; /* Must use atomic bitops to access the bits */
 
 	struct core_state *core_state; /* coredumping support */
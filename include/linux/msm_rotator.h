@@ -12,6 +12,10 @@
 		_IOW(MSM_ROTATOR_IOCTL_MAGIC, 2, struct msm_rotator_data_info)
 #define MSM_ROTATOR_IOCTL_FINISH   \
 		_IOW(MSM_ROTATOR_IOCTL_MAGIC, 3, int)
+#define MSM_ROTATOR_IOCTL_QUEUE   \
+		_IOWR(MSM_ROTATOR_IOCTL_MAGIC, 4, struct msm_rotator_queue_info)
+#define MSM_ROTATOR_IOCTL_WAIT   \
+		_IOW(MSM_ROTATOR_IOCTL_MAGIC, 5, unsigned int)
 
 #define ROTATOR_VERSION_01	0xA5B4C301
 
@@ -42,6 +46,20 @@ struct msm_rotator_data_info {
 	struct msmfb_data dst_chroma;
 };
 
+/*
+ * MSM_ROTATOR_IOCTL_QUEUE takes the same request as ROTATE but returns
+ * once the buffers are resolved, with a per-file fence that increases
+ * with every queued job.  MSM_ROTATOR_IOCTL_WAIT blocks until a fence
+ * has retired and returns the first error of the jobs retired since the
+ * previous WAIT.  poll() reports POLLIN while a retired fence has not
+ * been waited for.  A synchronous ROTATE does not wait for queued jobs.
+ * QUEUE fails with -EBUSY while 16 jobs of the file have not retired.
+ */
+struct msm_rotator_queue_info {
+	struct msm_rotator_data_info data;
+	unsigned int fence;
+};
+
 struct msm_rot_clocks {
 	const char *clk_name;
 	enum rotator_clk_type clk_type;
@@ -207,6 +207,30 @@ struct vdec_ioctl_msg {
 #define VDEC_IOCTL_GET_DISABLE_DMX_SUPPORT \
 	_IOR(VDEC_IOCTL_MAGIC, 37, struct vdec_ioctl_msg)
 
+/* ========================================================
+ * Batched variants of DECODE_FRAME, FILL_OUTPUT_BUFFER and
+ * GET_NEXT_MSG, at most VDEC_MAX_BATCH entries per call
+ * ========================================================*/
+
+/*CMD params: InputParam - struct vdec_input_batch,
+  OutputParam - uint32_t (frames queued before the first failure)*/
+#define VDEC_IOCTL_DECODE_FRAMES \
+	_IOWR(VDEC_IOCTL_MAGIC, 38, struct vdec_ioctl_msg)
+
+/*CMD params: InputParam - struct vdec_fillbuffer_batch,
+  OutputParam - uint32_t (buffers queued before the first failure)*/
+#define VDEC_IOCTL_FILL_OUTPUT_BUFFERS \
+	_IOWR(VDEC_IOCTL_MAGIC, 39, struct vdec_ioctl_msg)
+
+/*IOCTL params: InputParam - struct vdec_msg_batch,
+  OutputParam - uint32_t (messages returned). Blocks like GET_NEXT_MSG
+  until at least one message is pending, then returns all pending
+  messages that fit.*/
+#define VDEC_IOCTL_GET_NEXT_MSGS \
+	_IOWR(VDEC_IOCTL_MAGIC, 40, struct vdec_ioctl_msg)
+
+#define VDEC_MAX_BATCH 32
+
 enum vdec_picture {
 	PICTURE_TYPE_I,
 	PICTURE_TYPE_P,
@@ -539,6 +563,21 @@ struct vdec_msginfo {
 	size_t msgdatasize;
 };
 
+struct vdec_input_batch {
+	uint32_t count;
+	struct vdec_input_frameinfo __user *frames;
+};
+
+struct vdec_fillbuffer_batch {
+	uint32_t count;
+	struct vdec_fillbuffer_cmd __user *cmds;
+};
+
+struct vdec_msg_batch {
+	uint32_t count;
+	struct vdec_msginfo __user *msgs;
+};
+
 struct vdec_framerate {
 	unsigned long fps_denominator;
 	unsigned long fps_numerator;
@@ -517,6 +517,7 @@ static struct mm_struct * mm_init(struct mm_struct * mm, struct task_struct *p)
 	mm_init_aio(mm);
 	mm_init_owner(mm, p);
 	atomic_set(&mm->oom_disable_count, 0);
+	mm->oom_score_adj = current->signal->oom_score_adj;
 
 	if (likely(!mm_alloc_pgd(mm))) {
 		mm->def_flags = 0;
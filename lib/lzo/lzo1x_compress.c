@@ -93,9 +93,10 @@ match:
 				}
 				*op++ = tt;
 			}
-			do {
+			for (; t >= 4; t -= 4, op += 4, ii += 4)
+				COPY4(op, ii);
+			while (t--)
 				*op++ = *ii++;
-			} while (--t > 0);
 		}
 
 		ip += 3;
@@ -125,10 +126,28 @@ match:
 			end = in_end;
 			m = m_pos + M2_MAX_LEN + 1;
 
+			/* a word at a time, then locate the mismatching byte */
+			while (end - ip >= 4) {
+				u32 diff = lzo_get32(m) ^ lzo_get32(ip);
+
+				if (diff) {
+#ifdef __LITTLE_ENDIAN
+					diff = __ffs(diff) >> 3;
+#else
+					diff = (31 - __fls(diff)) >> 3;
+#endif
+					m += diff;
+					ip += diff;
+					goto match_end;
+				}
+				m += 4;
+				ip += 4;
+			}
 			while (ip < end && *m == *ip) {
 				m++;
 				ip++;
 			}
+match_end:
 			m_len = ip - ii;
 
 			if (m_off <= M3_MAX_OFFSET) {
@@ -207,9 +226,10 @@ int lzo1x_1_compress(const unsigned char *in, size_t in_len, unsigned char *out,
 
 			*op++ = tt;
 		}
-		do {
+		for (; t >= 4; t -= 4, op += 4, ii += 4)
+			COPY4(op, ii);
+		while (t--)
 			*op++ = *ii++;
-		} while (--t > 0);
 	}
 
 	*op++ = M4_MARKER | 1;
@@ -0,0 +1,111 @@
+/*
+ *  LZO1X self-test and throughput report
+ *
+ *  Round-trips page sized buffers of varying compressibility through
+ *  lzo1x_1_compress() and lzo1x_decompress_safe() at boot, then logs
+ *  MB/s for each direction.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2 as
+ *  published by the Free Software Foundation.
+ */
+
+#include <linux/init.h>
+#include <linux/kernel.h>
+#include <linux/slab.h>
+#include <linux/vmalloc.h>
+#include <linux/string.h>
+#include <linux/hrtimer.h>
+#include <linux/random.h>
+#include <linux/lzo.h>
+
+#define LZO_TEST_LOOPS	256
+
+static const char * const lzo_test_names[] = {
+	"zero", "text", "sparse", "random",
+};
+
+/* fill @buf with PAGE_SIZE bytes of the given kind */
+static void __init lzo_test_fill(unsigned char *buf, int kind)
+{
+	static const char text[] = "the quick brown fox jumps over the lazy dog ";
+	unsigned int i;
+
+	switch (kind) {
+	case 0:
+		memset(buf, 0, PAGE_SIZE);
+		break;
+	case 1:
+		for (i = 0; i < PAGE_SIZE; i++)
+			buf[i] = text[(i * 7 + (i >> 5)) % (sizeof(text) - 1)];
+		break;
+	case 2:
+		memset(buf, 0, PAGE_SIZE);
+		for (i = 0; i < PAGE_SIZE; i += 61)
+			buf[i] = i >> 3;
+		break;
+	default:
+		get_random_bytes(buf, PAGE_SIZE);
+		break;
+	}
+}
+
+static unsigned long __init lzo_test_mbps(s64 ns)
+{
+	return ns ? div64_u64((u64)LZO_TEST_LOOPS * PAGE_SIZE * 1000, ns) : 0;
+}
+
+static int __init lzo_test(void)
+{
+	unsigned char *src, *dst, *out;
+	void *wrkmem;
+	size_t clen, dlen;
+	s64 cns, dns;
+	ktime_t t;
+	int kind, i, ret = -ENOMEM;
+
+	src = kmalloc(PAGE_SIZE, GFP_KERNEL);
+	out = kmalloc(PAGE_SIZE, GFP_KERNEL);
+	dst = kmalloc(lzo1x_worst_compress(PAGE_SIZE), GFP_KERNEL);
+	wrkmem = vmalloc(LZO1X_MEM_COMPRESS);
+	if (!src || !out || !dst || !wrkmem)
+		goto out;
+
+	for (kind = 0; kind < ARRAY_SIZE(lzo_test_names); kind++) {
+		lzo_test_fill(src, kind);
+
+		t = ktime_get();
+		for (i = 0; i < LZO_TEST_LOOPS; i++)
+			lzo1x_1_compress(src, PAGE_SIZE, dst, &clen, wrkmem);
+		cns = ktime_to_ns(ktime_sub(ktime_get(), t));
+
+		t = ktime_get();
+		for (i = 0; i < LZO_TEST_LOOPS; i++) {
+			dlen = PAGE_SIZE;
+			ret = lzo1x_decompress_safe(dst, clen, out, &dlen);
+		}
+		dns = ktime_to_ns(ktime_sub(ktime_get(), t));
+
+		if (ret != LZO_E_OK || dlen != PAGE_SIZE ||
+		    memcmp(src, out, PAGE_SIZE)) {
+			pr_err("lzo1x: self-test failed for %s page (%d)\n",
+			       lzo_test_names[kind], ret);
+			ret = -EINVAL;
+			goto out;
+		}
+
+		pr_info("lzo1x: %-6s page -> %4zu bytes: compress %lu MB/s, "
+			"decompress %lu MB/s\n", lzo_test_names[kind], clen,
+			lzo_test_mbps(cns), lzo_test_mbps(dns));
+	}
+	ret = 0;
+
+out:
+	vfree(wrkmem);
+	kfree(dst);
+	kfree(out);
+	kfree(src);
+	return ret;
+}
+
+late_initcall(lzo_test);
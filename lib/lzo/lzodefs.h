@@ -41,3 +41,31 @@
 #define DX2(p, s1, s2)	(((((size_t)((p)[2]) << (s2)) ^ (p)[1]) \
 							<< (s1)) ^ (p)[0])
 #define DX3(p, s1, s2, s3)	((DX2((p)+1, s2, s3) << (s1)) ^ (p)[0])
+
+/*
+ * Unaligned 32-bit access for the copy and compare loops.  ARMv6 and later
+ * run with the alignment trap off, so a plain ldr/str may be unaligned;
+ * the accesses are kept in asm so that gcc cannot merge neighbouring ones
+ * into ldm/ldrd, which still require alignment.  The pre-boot decompressor
+ * (STATIC) may run with the MMU off, where unaligned accesses fault, so it
+ * keeps the byte-wise helpers.
+ */
+#if defined(CONFIG_ARM) && __LINUX_ARM_ARCH__ >= 6 && !defined(STATIC)
+static inline u32 lzo_get32(const void *p)
+{
+	u32 v;
+
+	asm("ldr	%0, %1" : "=r" (v) : "m" (*(const u32 *)p));
+	return v;
+}
+
+static inline void lzo_put32(void *p, u32 v)
+{
+	asm("str	%1, %0" : "=m" (*(u32 *)p) : "r" (v));
+}
+#else
+# define lzo_get32(p)		get_unaligned((const u32 *)(p))
+# define lzo_put32(p, v)	put_unaligned((v), (u32 *)(p))
+#endif
+
+#define COPY4(dst, src)		lzo_put32((dst), lzo_get32(src))
@@ -14,6 +14,10 @@
 #include <linux/backing-dev.h>
 #include <linux/sysctl.h>
 #include <linux/sysfs.h>
+#include <linux/kthread.h>
+#include <linux/freezer.h>
+#include <linux/shmem_fs.h>
+#include <linux/file.h>
 #include "internal.h"
 
 #define CREATE_TRACE_POINTS
@@ -41,6 +45,7 @@ struct compact_control {
 
 	unsigned int order;		/* order a direct compactor needs */
 	int migratetype;		/* MOVABLE, RECLAIMABLE etc */
+	unsigned long min_free_blocks;	/* kcompactd: free blocks of order */
 	struct zone *zone;
 };
 
@@ -429,6 +434,22 @@ static void update_nr_listpages(struct compact_control *cc)
 	cc->nr_freepages = nr_freepages;
 }
 
+/*
+ * Number of free blocks of the given order the zone could hand out
+ * without splitting further, counting larger free pages as several
+ * blocks.  Racy without zone->lock, which is fine for a heuristic.
+ */
+static unsigned long zone_free_blocks(struct zone *zone, unsigned int order)
+{
+	unsigned long nr_blocks = 0;
+	unsigned int o;
+
+	for (o = order; o < MAX_ORDER; o++)
+		nr_blocks += zone->free_area[o].nr_free << (o - order);
+
+	return nr_blocks;
+}
+
 static int compact_finished(struct zone *zone,
 			    struct compact_control *cc)
 {
@@ -449,6 +470,11 @@ static int compact_finished(struct zone *zone,
 	if (cc->order == -1)
 		return COMPACT_CONTINUE;
 
+	/* Background compaction: stop once the free block target is met */
+	if (cc->min_free_blocks)
+		return zone_free_blocks(zone, cc->order) >= cc->min_free_blocks ?
+			COMPACT_PARTIAL : COMPACT_CONTINUE;
+
 	/* Compaction run is not finished if the watermark is not met */
 	watermark = low_wmark_pages(zone);
 	watermark += (1 << cc->order);
@@ -520,11 +546,50 @@ unsigned long compaction_suitable(struct zone *zone, int order)
 	return COMPACT_CONTINUE;
 }
 
+/*
+ * kcompactd_suitable: like compaction_suitable(), for a background
+ * compactor that wants min_free_blocks free blocks of order rather than
+ * just one.  A zone that already has one such block is not done yet.
+ */
+static unsigned long kcompactd_suitable(struct zone *zone, int order,
+					unsigned long min_free_blocks)
+{
+	int fragindex;
+	unsigned long watermark;
+
+	if (zone_free_blocks(zone, order) >= min_free_blocks)
+		return COMPACT_PARTIAL;
+
+	/*
+	 * The target blocks have to come out of free memory above the low
+	 * watermark, plus the migration footprint compaction_suitable()
+	 * asks for.
+	 */
+	watermark = low_wmark_pages(zone) + (min_free_blocks << order) +
+			(2UL << order);
+	if (!zone_watermark_ok(zone, 0, watermark, 0, 0))
+		return COMPACT_SKIPPED;
+
+	/*
+	 * With no free block of order left, only compact if that is due to
+	 * fragmentation rather than lack of memory.  With some left the
+	 * index is -1000 and says nothing about the shortfall.
+	 */
+	fragindex = fragmentation_index(zone, order);
+	if (fragindex >= 0 && fragindex <= sysctl_extfrag_threshold)
+		return COMPACT_SKIPPED;
+
+	return COMPACT_CONTINUE;
+}
+
 static int compact_zone(struct zone *zone, struct compact_control *cc)
 {
 	int ret;
 
-	ret = compaction_suitable(zone, cc->order);
+	if (cc->min_free_blocks)
+		ret = kcompactd_suitable(zone, cc->order, cc->min_free_blocks);
+	else
+		ret = compaction_suitable(zone, cc->order);
 	switch (ret) {
 	case COMPACT_PARTIAL:
 	case COMPACT_SKIPPED:
@@ -576,6 +641,13 @@ static int compact_zone(struct zone *zone, struct compact_control *cc)
 			cc->nr_migratepages = 0;
 		}
 
+		/*
+		 * Migrated-from pages sit on this cpu's pcp lists where they
+		 * cannot merge; give them to the buddy allocator so that
+		 * compact_finished() sees the blocks they complete.
+		 */
+		if (cc->min_free_blocks)
+			drain_local_pages(NULL);
 	}
 
 out:
@@ -724,6 +796,279 @@ int sysctl_extfrag_handler(struct ctl_table *table, int write,
 	return 0;
 }
 
+/*
+ * kcompactd keeps sysctl_kcompactd_min_free_blocks free blocks of
+ * sysctl_kcompactd_order in every zone of its node, so that drivers
+ * allocating order-2..order-4 buffers find them without entering direct
+ * compaction.  A target order of 0 disables it.  It runs asynchronous
+ * migration only, at most once per sysctl_kcompactd_interval_ms, and
+ * backs off with the direct compaction deferral logic when a zone does
+ * not get any better.
+ */
+int sysctl_kcompactd_order;
+int sysctl_kcompactd_min_free_blocks = 8;
+int sysctl_kcompactd_interval_ms = 500;
+
+static bool kcompactd_zone_needs_work(struct zone *zone, int order)
+{
+	if (!populated_zone(zone))
+		return false;
+
+	return zone_free_blocks(zone, order) <
+			sysctl_kcompactd_min_free_blocks;
+}
+
+static bool kcompactd_node_needs_work(pg_data_t *pgdat)
+{
+	int order = sysctl_kcompactd_order;
+	int zoneid;
+
+	if (!order)
+		return false;
+
+	for (zoneid = 0; zoneid < MAX_NR_ZONES; zoneid++)
+		if (kcompactd_zone_needs_work(&pgdat->node_zones[zoneid],
+					      order))
+			return true;
+
+	return false;
+}
+
+/*
+ * Compact zone until it has min_free_blocks free blocks of order or the
+ * scanners meet.  Returns true if the target was reached.
+ */
+static bool kcompactd_compact_zone(struct zone *zone, int order,
+				   unsigned long min_free_blocks)
+{
+	struct compact_control cc = {
+		.nr_freepages = 0,
+		.nr_migratepages = 0,
+		.order = order,
+		.migratetype = MIGRATE_MOVABLE,
+		.min_free_blocks = min_free_blocks,
+		.zone = zone,
+		.sync = false,
+	};
+
+	INIT_LIST_HEAD(&cc.freepages);
+	INIT_LIST_HEAD(&cc.migratepages);
+
+	compact_zone(zone, &cc);
+
+	VM_BUG_ON(!list_empty(&cc.freepages));
+	VM_BUG_ON(!list_empty(&cc.migratepages));
+
+	/* Pages freed on other cpus while we migrated count too */
+	drain_all_pages();
+
+	return zone_free_blocks(zone, order) >= min_free_blocks;
+}
+
+static void kcompactd_do_work(pg_data_t *pgdat)
+{
+	int order = sysctl_kcompactd_order;
+	unsigned long min_free_blocks = sysctl_kcompactd_min_free_blocks;
+	int zoneid;
+
+	for (zoneid = 0; zoneid < MAX_NR_ZONES; zoneid++) {
+		struct zone *zone = &pgdat->node_zones[zoneid];
+
+		if (kthread_should_stop())
+			return;
+
+		if (!kcompactd_zone_needs_work(zone, order))
+			continue;
+
+		if (compaction_deferred(zone))
+			continue;
+
+		if (kcompactd_suitable(zone, order, min_free_blocks) !=
+		    COMPACT_CONTINUE)
+			continue;
+
+		if (kcompactd_compact_zone(zone, order, min_free_blocks)) {
+			count_vm_event(KCOMPACTD_SUCCESS);
+			zone->compact_considered = 0;
+			zone->compact_defer_shift = 0;
+		} else {
+			count_vm_event(KCOMPACTD_FAIL);
+			defer_compaction(zone);
+		}
+	}
+}
+
+/*
+ * Called from the page allocator slow path when a high-order allocation
+ * had to wake kswapd.  Wakeups within the rate limit interval of the
+ * previous run are dropped; the periodic check picks them up.
+ */
+void wakeup_kcompactd(pg_data_t *pgdat, int order)
+{
+	if (!pgdat->kcompactd || !sysctl_kcompactd_order)
+		return;
+
+	if (order > sysctl_kcompactd_order)
+		return;
+
+	if (time_before(jiffies, pgdat->kcompactd_last_run +
+			msecs_to_jiffies(sysctl_kcompactd_interval_ms)))
+		return;
+
+	if (!waitqueue_active(&pgdat->kcompactd_wait))
+		return;
+
+	pgdat->kcompactd_wake = true;
+	wake_up_interruptible(&pgdat->kcompactd_wait);
+}
+
+/* Kick the daemons so a changed target order takes effect immediately */
+int sysctl_kcompactd_handler(struct ctl_table *table, int write,
+			void __user *buffer, size_t *length, loff_t *ppos)
+{
+	int nid;
+	int ret;
+
+	ret = proc_dointvec_minmax(table, write, buffer, length, ppos);
+	if (ret || !write)
+		return ret;
+
+	for_each_online_node(nid) {
+		pg_data_t *pgdat = NODE_DATA(nid);
+
+		if (!pgdat->kcompactd)
+			continue;
+		pgdat->kcompactd_wake = true;
+		wake_up_interruptible(&pgdat->kcompactd_wait);
+	}
+
+	return 0;
+}
+
+static int kcompactd(void *p)
+{
+	pg_data_t *pgdat = p;
+	const struct cpumask *cpumask = cpumask_of_node(pgdat->node_id);
+
+	if (!cpumask_empty(cpumask))
+		set_cpus_allowed_ptr(current, cpumask);
+
+	set_freezable();
+
+	while (!kthread_should_stop()) {
+		long timeout = MAX_SCHEDULE_TIMEOUT;
+
+		if (sysctl_kcompactd_order)
+			timeout = msecs_to_jiffies(sysctl_kcompactd_interval_ms);
+
+		wait_event_freezable_timeout(pgdat->kcompactd_wait,
+				pgdat->kcompactd_wake || kthread_should_stop(),
+				timeout);
+		if (kthread_should_stop())
+			break;
+
+		if (pgdat->kcompactd_wake) {
+			pgdat->kcompactd_wake = false;
+			count_vm_event(KCOMPACTD_WAKE);
+		}
+
+		if (!kcompactd_node_needs_work(pgdat))
+			continue;
+
+		kcompactd_do_work(pgdat);
+		pgdat->kcompactd_last_run = jiffies;
+	}
+
+	return 0;
+}
+
+static int __init kcompactd_init(void)
+{
+	int nid;
+
+	for_each_node_state(nid, N_HIGH_MEMORY) {
+		pg_data_t *pgdat = NODE_DATA(nid);
+		struct task_struct *tsk;
+
+		tsk = kthread_run(kcompactd, pgdat, "kcompactd%d", nid);
+		if (IS_ERR(tsk)) {
+			printk(KERN_ERR "Failed to start kcompactd on node %d\n",
+			       nid);
+			continue;
+		}
+		pgdat->kcompactd = tsk;
+	}
+
+	return 0;
+}
+module_init(kcompactd_init)
+
+#ifdef CONFIG_KCOMPACTD_SELFTEST
+#define KCOMPACTD_TEST_ORDER	3
+#define KCOMPACTD_TEST_BLOCKS	64
+
+/*
+ * Fragment KCOMPACTD_TEST_BLOCKS blocks worth of shmem pages by punching
+ * out every other page, then ask kcompactd for more free blocks than the
+ * zone has left.  Half the punched blocks are recoverable, a quarter is
+ * asked for.
+ */
+static int __init kcompactd_selftest(void)
+{
+	int order = KCOMPACTD_TEST_ORDER;
+	unsigned long nr_pages = KCOMPACTD_TEST_BLOCKS << order;
+	unsigned long before, after, target, i;
+	struct address_space *mapping;
+	struct zone *zone = NULL;
+	struct file *file;
+	struct page *page;
+	bool reached;
+
+	file = shmem_file_setup("kcompactd_test", nr_pages << PAGE_SHIFT, 0);
+	if (IS_ERR(file)) {
+		pr_err("kcompactd: self-test setup failed\n");
+		return 0;
+	}
+	mapping = file->f_mapping;
+
+	for (i = 0; i < nr_pages; i++) {
+		page = shmem_read_mapping_page(mapping, i);
+		if (IS_ERR(page)) {
+			pr_err("kcompactd: self-test out of memory\n");
+			goto out;
+		}
+		if (!zone)
+			zone = page_zone(page);
+		page_cache_release(page);
+	}
+	lru_add_drain_all();
+
+	for (i = 0; i < nr_pages; i += 2)
+		shmem_truncate_range(mapping->host, i << PAGE_SHIFT,
+				     ((i + 1) << PAGE_SHIFT) - 1);
+	drain_all_pages();
+
+	before = zone_free_blocks(zone, order);
+	target = before + KCOMPACTD_TEST_BLOCKS / 4;
+	if (kcompactd_suitable(zone, order, target) != COMPACT_CONTINUE) {
+		pr_info("kcompactd: self-test skipped, %s zone not suitable\n",
+			zone->name);
+		goto out;
+	}
+
+	reached = kcompactd_compact_zone(zone, order, target);
+	after = zone_free_blocks(zone, order);
+
+	pr_info("kcompactd: self-test %s: %s order-%d free blocks %lu -> %lu,"
+		" target %lu\n", reached ? "passed" : "FAILED", zone->name,
+		order, before, after, target);
+out:
+	fput(file);
+	return 0;
+}
+late_initcall(kcompactd_selftest);
+#endif /* CONFIG_KCOMPACTD_SELFTEST */
+
 #if defined(CONFIG_SYSFS) && defined(CONFIG_NUMA)
 ssize_t sysfs_compact_node(struct sys_device *dev,
 			struct sysdev_attribute *attr,
@@ -189,6 +189,22 @@ static unsigned int ksm_thread_pages_to_scan = 100;
 /* Milliseconds ksmd should sleep between batches */
 static unsigned int ksm_thread_sleep_millisecs = 20;
 
+/* Let ksmd stretch its sleep when full scans stop finding merges */
+static unsigned int ksm_auto_tune;
+
+/* Upper bound for the stretched sleep */
+static unsigned int ksm_thread_max_sleep_millisecs = 2000;
+
+/* Sleep currently used by ksmd when auto_tune is set */
+static unsigned int ksm_tuned_sleep_millisecs = 20;
+
+/* The number of page slots merged since boot, and at the last full scan */
+static unsigned long ksm_pages_merged;
+static unsigned long ksm_pages_merged_last_scan;
+
+/* CPU time ksmd has spent scanning, in nanoseconds */
+static u64 ksm_scan_cpu_ns;
+
 #define KSM_RUN_STOP	0
 #define KSM_RUN_MERGE	1
 #define KSM_RUN_UNMERGE	2
@@ -669,11 +685,26 @@ error:
 }
 #endif /* CONFIG_SYSFS */
 
+/*
+ * The checksum only serves to keep pages that are still changing out of
+ * the unstable tree: pages are always compared in full before they are
+ * merged.  So hash a sample of CHECKSUM_WORDS words out of every
+ * CHECKSUM_STRIDE bytes, spread over the whole page, instead of all of
+ * it; that catches practically all pages being written to at a fraction
+ * of the memory traffic of a full jhash.
+ */
+#define CHECKSUM_STRIDE		128
+#define CHECKSUM_WORDS		4
+
 static u32 calc_checksum(struct page *page)
 {
-	u32 checksum;
-	void *addr = kmap_atomic(page, KM_USER0);
-	checksum = jhash2(addr, PAGE_SIZE / 4, 17);
+	u32 checksum = 17;
+	char *addr = kmap_atomic(page, KM_USER0);
+	unsigned int offset;
+
+	for (offset = 0; offset < PAGE_SIZE; offset += CHECKSUM_STRIDE)
+		checksum = jhash2((u32 *)(addr + offset), CHECKSUM_WORDS,
+				  checksum);
 	kunmap_atomic(addr, KM_USER0);
 	return checksum;
 }
@@ -1153,9 +1184,10 @@ static void stable_tree_append(struct rmap_item *rmap_item,
 	rmap_item->address |= STABLE_FLAG;
 	hlist_add_head(&rmap_item->hlist, &stable_node->hlist);
 
-	if (rmap_item->hlist.next)
+	if (rmap_item->hlist.next) {
 		ksm_pages_sharing++;
-	else
+		ksm_pages_merged++;
+	} else
 		ksm_pages_shared++;
 }
 
@@ -1428,6 +1460,33 @@ static int ksmd_should_run(void)
 	return (ksm_run & KSM_RUN_MERGE) && !list_empty(&ksm_mm_head.mm_list);
 }
 
+/*
+ * Called after each full scan when auto_tune is set: back off while full
+ * scans merge nothing, and return towards sleep_millisecs once they merge
+ * at least one page out of every hundred scanned again.
+ */
+static void ksm_tune_sleep(void)
+{
+	unsigned long merged = ksm_pages_merged - ksm_pages_merged_last_scan;
+	unsigned int sleep = ksm_tuned_sleep_millisecs;
+
+	ksm_pages_merged_last_scan = ksm_pages_merged;
+
+	if (!merged)
+		sleep = min(max(sleep * 2, 1U), ksm_thread_max_sleep_millisecs);
+	else if (merged * 100 >= ksm_rmap_items)
+		sleep /= 2;
+
+	ksm_tuned_sleep_millisecs = max(sleep, ksm_thread_sleep_millisecs);
+}
+
+static unsigned int ksmd_sleep_millisecs(void)
+{
+	if (ksm_auto_tune)
+		return ksm_tuned_sleep_millisecs;
+	return ksm_thread_sleep_millisecs;
+}
+
 static int ksm_scan_thread(void *nothing)
 {
 	set_freezable();
@@ -1435,15 +1494,22 @@ static int ksm_scan_thread(void *nothing)
 
 	while (!kthread_should_stop()) {
 		mutex_lock(&ksm_thread_mutex);
-		if (ksmd_should_run())
+		if (ksmd_should_run()) {
+			unsigned long seqnr = ksm_scan.seqnr;
+			u64 start = task_sched_runtime(current);
+
 			ksm_do_scan(ksm_thread_pages_to_scan);
+			ksm_scan_cpu_ns += task_sched_runtime(current) - start;
+			if (ksm_auto_tune && seqnr != ksm_scan.seqnr)
+				ksm_tune_sleep();
+		}
 		mutex_unlock(&ksm_thread_mutex);
 
 		try_to_freeze();
 
 		if (ksmd_should_run()) {
 			schedule_timeout_interruptible(
-				msecs_to_jiffies(ksm_thread_sleep_millisecs));
+				msecs_to_jiffies(ksmd_sleep_millisecs()));
 		} else {
 			wait_event_freezable(ksm_thread_wait,
 				ksmd_should_run() || kthread_should_stop());
@@ -1844,11 +1910,62 @@ static ssize_t sleep_millisecs_store(struct kobject *kobj,
 		return -EINVAL;
 
 	ksm_thread_sleep_millisecs = msecs;
+	ksm_tuned_sleep_millisecs = msecs;
 
 	return count;
 }
 KSM_ATTR(sleep_millisecs);
 
+static ssize_t max_sleep_millisecs_show(struct kobject *kobj,
+					struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%u\n", ksm_thread_max_sleep_millisecs);
+}
+
+static ssize_t max_sleep_millisecs_store(struct kobject *kobj,
+					 struct kobj_attribute *attr,
+					 const char *buf, size_t count)
+{
+	unsigned long msecs;
+	int err;
+
+	err = strict_strtoul(buf, 10, &msecs);
+	if (err || msecs > UINT_MAX)
+		return -EINVAL;
+
+	ksm_thread_max_sleep_millisecs = msecs;
+
+	return count;
+}
+KSM_ATTR(max_sleep_millisecs);
+
+static ssize_t auto_tune_show(struct kobject *kobj,
+			      struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%u\n", ksm_auto_tune);
+}
+
+static ssize_t auto_tune_store(struct kobject *kobj,
+			       struct kobj_attribute *attr,
+			       const char *buf, size_t count)
+{
+	unsigned long enable;
+	int err;
+
+	err = strict_strtoul(buf, 10, &enable);
+	if (err || enable > 1)
+		return -EINVAL;
+
+	mutex_lock(&ksm_thread_mutex);
+	ksm_auto_tune = enable;
+	ksm_tuned_sleep_millisecs = ksm_thread_sleep_millisecs;
+	ksm_pages_merged_last_scan = ksm_pages_merged;
+	mutex_unlock(&ksm_thread_mutex);
+
+	return count;
+}
+KSM_ATTR(auto_tune);
+
 static ssize_t pages_to_scan_show(struct kobject *kobj,
 				  struct kobj_attribute *attr, char *buf)
 {
@@ -1966,8 +2083,36 @@ static ssize_t full_scans_show(struct kobject *kobj,
 }
 KSM_ATTR_RO(full_scans);
 
+static ssize_t pages_merged_show(struct kobject *kobj,
+				 struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%lu\n", ksm_pages_merged);
+}
+KSM_ATTR_RO(pages_merged);
+
+static ssize_t scan_cpu_usecs_show(struct kobject *kobj,
+				   struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%llu\n",
+		       (unsigned long long)div_u64(ksm_scan_cpu_ns, 1000));
+}
+KSM_ATTR_RO(scan_cpu_usecs);
+
+static ssize_t merge_cost_usecs_show(struct kobject *kobj,
+				     struct kobj_attribute *attr, char *buf)
+{
+	u64 cost = 0;
+
+	if (ksm_pages_merged)
+		cost = div64_u64(ksm_scan_cpu_ns, (u64)ksm_pages_merged * 1000);
+	return sprintf(buf, "%llu\n", (unsigned long long)cost);
+}
+KSM_ATTR_RO(merge_cost_usecs);
+
 static struct attribute *ksm_attrs[] = {
 	&sleep_millisecs_attr.attr,
+	&max_sleep_millisecs_attr.attr,
+	&auto_tune_attr.attr,
 	&pages_to_scan_attr.attr,
 	&run_attr.attr,
 	&pages_shared_attr.attr,
@@ -1975,6 +2120,9 @@ static struct attribute *ksm_attrs[] = {
 	&pages_unshared_attr.attr,
 	&pages_volatile_attr.attr,
 	&full_scans_attr.attr,
+	&pages_merged_attr.attr,
+	&scan_cpu_usecs_attr.attr,
+	&merge_cost_usecs_attr.attr,
 	NULL,
 };
 
@@ -714,6 +714,17 @@ int page_referenced_one(struct page *page, struct vm_area_struct *vma,
 		pte_unmap_unlock(pte, ptl);
 	}
 
+	/*
+	 * References from processes the userspace policy has pushed into
+	 * the background do not earn the page another trip around the
+	 * LRU, so that reclaim eats into background apps before the
+	 * working set of the foreground ones.
+	 */
+	if (referenced && mm->oom_score_adj >= vm_reclaim_bg_score_adj) {
+		count_vm_event(PGREF_BG_IGNORED);
+		referenced = 0;
+	}
+
 	/* Pretend the page is referenced if the task has the
 	   swap token and is in the middle of a page fault. */
 	if (mm != current->mm && has_swap_token(mm) &&
@@ -2298,6 +2298,55 @@ int swapcache_prepare(swp_entry_t entry)
 	return __swap_duplicate(entry, SWAP_HAS_CACHE);
 }
 
+/*
+ * A page brought in by swap readahead has been found in the swap cache.
+ */
+void swap_readahead_hit(swp_entry_t entry)
+{
+	struct swap_info_struct *si = swap_info[swp_type(entry)];
+
+	atomic_inc(&si->ra_hits);
+}
+
+/*
+ * Pick the readahead cluster order for a fault at @offset on a swap area
+ * with cheap seeks.  Every readahead page costs a full read (or, with
+ * zram, a decompression) there, so read ahead only as far as recent
+ * readahead hits or a sequential fault pattern justify, never beyond
+ * @max_cluster, and shrink the window gradually so that a single miss
+ * does not throw away a working stream.
+ */
+static int swap_readahead_cluster(struct swap_info_struct *si,
+				  unsigned long offset, int max_cluster)
+{
+	unsigned int hits, pages, last_pages;
+	unsigned long prev_offset;
+
+	hits = atomic_xchg(&si->ra_hits, 0);
+	prev_offset = si->ra_prev_offset;
+	si->ra_prev_offset = offset;
+
+	pages = hits + 2;
+	if (pages == 2) {
+		/*
+		 * No hits to judge by, but don't get stuck doing no
+		 * readahead for a process faulting in sequentially.
+		 */
+		if (offset != prev_offset + 1 && offset != prev_offset - 1)
+			pages = 1;
+	} else {
+		pages = roundup_pow_of_two(max(pages, 4U));
+	}
+	pages = min(pages, 1U << max_cluster);
+
+	last_pages = atomic_read(&si->ra_win) / 2;
+	if (pages < last_pages)
+		pages = last_pages;
+	atomic_set(&si->ra_win, pages);
+
+	return ilog2(pages);
+}
+
 /*
  * swap_lock prevents swap_map being freed. Don't grab an extra
  * reference on the swaphandle, it doesn't matter if it becomes unused.
@@ -2315,6 +2364,13 @@ int valid_swaphandles(swp_entry_t entry, unsigned long *offset)
 
 	si = swap_info[swp_type(entry)];
 	target = swp_offset(entry);
+
+	if (si->flags & SWP_SOLIDSTATE) {
+		our_page_cluster = swap_readahead_cluster(si, target,
+							  our_page_cluster);
+		if (!our_page_cluster)
+			return 0;
+	}
 	base = (target >> our_page_cluster) << our_page_cluster;
 	end = base + (1 << our_page_cluster);
 	if (!base)		/* first page is swap header */
@@ -105,6 +105,9 @@ struct scan_control {
 	 */
 	reclaim_mode_t reclaim_mode;
 
+	/* Reclaim pages even if they were recently referenced */
+	int ignore_references;
+
 	/* Which cgroup do we reclaim from */
 	struct mem_cgroup *mem_cgroup;
 
@@ -149,6 +152,13 @@ struct scan_control {
  * From 0 .. 100.  Higher means more swappy.
  */
 int vm_swappiness = 60;
+
+/*
+ * Page references made by processes whose oom_score_adj is at or above
+ * this value are ignored by reclaim.  The default is out of range, which
+ * treats all processes alike.
+ */
+int vm_reclaim_bg_score_adj = OOM_SCORE_ADJ_MAX + 1;
 long vm_total_pages;	/* The total number of pages which the VM controls */
 
 static LIST_HEAD(shrinker_list);
@@ -780,7 +790,10 @@ static unsigned long shrink_page_list(struct list_head *page_list,
 			}
 		}
 
-		references = page_check_references(page, sc);
+		if (sc->ignore_references)
+			references = PAGEREF_RECLAIM;
+		else
+			references = page_check_references(page, sc);
 		switch (references) {
 		case PAGEREF_ACTIVATE:
 			goto activate_locked;
@@ -962,6 +975,62 @@ keep_lumpy:
 	return nr_reclaimed;
 }
 
+#ifdef CONFIG_PROCESS_RECLAIM
+/*
+ * Reclaim a list of pages isolated by the caller, regardless of how
+ * recently they were referenced.  The pages may belong to any zone and
+ * must have been counted in NR_ISOLATED_ANON/NR_ISOLATED_FILE when they
+ * were isolated.  The list is reclaimed one zone at a time; pages that
+ * could not be reclaimed are put back on the LRU.
+ *
+ * Returns the number of reclaimed pages.
+ */
+unsigned long reclaim_pages_from_list(struct list_head *page_list)
+{
+	struct scan_control sc = {
+		.gfp_mask = GFP_KERNEL,
+		.may_writepage = 1,
+		.may_unmap = 1,
+		.may_swap = 1,
+		.ignore_references = 1,
+		.reclaim_mode = RECLAIM_MODE_SINGLE | RECLAIM_MODE_ASYNC,
+	};
+	unsigned long nr_reclaimed = 0;
+	struct page *page, *next;
+
+	while (!list_empty(page_list)) {
+		LIST_HEAD(zone_list);
+		unsigned long nr_anon = 0, nr_file = 0;
+		struct zone *zone;
+
+		zone = page_zone(lru_to_page(page_list));
+		list_for_each_entry_safe(page, next, page_list, lru) {
+			if (page_zone(page) != zone)
+				continue;
+			ClearPageActive(page);
+			if (page_is_file_cache(page))
+				nr_file++;
+			else
+				nr_anon++;
+			list_move(&page->lru, &zone_list);
+		}
+
+		nr_reclaimed += shrink_page_list(&zone_list, zone, &sc);
+
+		while (!list_empty(&zone_list)) {
+			page = lru_to_page(&zone_list);
+			list_del(&page->lru);
+			putback_lru_page(page);
+		}
+
+		mod_zone_page_state(zone, NR_ISOLATED_ANON, -nr_anon);
+		mod_zone_page_state(zone, NR_ISOLATED_FILE, -nr_file);
+	}
+
+	return nr_reclaimed;
+}
+#endif /* CONFIG_PROCESS_RECLAIM */
+
 /*
  * Attempt to remove the specified page from its LRU.  Only take this page
  * if it is of the appropriate PageActive status.  Pages which are being
@@ -2821,6 +2890,8 @@ void wakeup_kswapd(struct zone *zone, int order, enum zone_type classzone_idx)
 		return;
 	if (zone_watermark_ok_safe(zone, order, low_wmark_pages(zone), 0, 0))
 		return;
+	if (order)
+		wakeup_kcompactd(pgdat, order);
 
 	trace_mm_vmscan_wakeup_kswapd(pgdat->node_id, zone_idx(zone), order);
 	wake_up_interruptible(&pgdat->kswapd_wait);
@@ -178,15 +178,16 @@ static struct proc_dir_entry *iface_stat_all_procfile;
  * qtaguid_mt()
  *   account_for_uid()
  *     if_tag_stat_update()
+ *       rcu_read_lock_bh()
+ *         (iface_stat_list)
+ *         (qtaguid_match_cache)
+ *         tag_stat_update()
+ *       On a qtaguid_match_cache miss only:
  *       get_sock_stat()
  *         sock_tag_list_lock
+ *       get_active_counter_set()
+ *         tag_counter_set_list_lock
  *       struct iface_stat->tag_stat_list_lock
- *         tag_stat_update()
- *           get_active_counter_set()
- *             tag_counter_set_list_lock
- *         tag_stat_update()
- *           get_active_counter_set()
- *             tag_counter_set_list_lock
  *
  *
  * qtaguid_ctrl_parse()
@@ -227,6 +228,74 @@ static struct rb_root proc_qtu_data_tree = RB_ROOT;
 /* No proc_qtu_data_tree_lock; use uid_tag_data_tree_lock */
 
 static struct qtaguid_event_counts qtu_events;
+
+/*
+ * Bumped whenever a change to the sock tags, counter sets or tag_stats
+ * could alter what a cached {iface, sock, uid} lookup resolves to.
+ */
+static atomic_t qtaguid_cache_gen;
+static DEFINE_PER_CPU(struct qtaguid_match_cache, qtaguid_match_cache);
+
+static inline void qtaguid_cache_invalidate(void)
+{
+	atomic_inc(&qtaguid_cache_gen);
+}
+
+/*
+ * tag_stats are created from the packet path, where alloc_percpu() may
+ * not be called. Keep per-cpu counter blocks allocated ahead of time in
+ * a small pool that a work item tops up from process context.
+ */
+#define TAG_STAT_CPU_POOL_SIZE 32
+static struct tag_stat_cpu __percpu *ts_cpu_pool[TAG_STAT_CPU_POOL_SIZE];
+static int tag_stat_cpu_pool_count;
+static DEFINE_SPINLOCK(tag_stat_cpu_pool_lock);
+
+static void tag_stat_cpu_pool_fill(struct work_struct *work)
+{
+	struct tag_stat_cpu __percpu *tsc;
+	bool full;
+
+	for (;;) {
+		spin_lock_bh(&tag_stat_cpu_pool_lock);
+		full = tag_stat_cpu_pool_count == TAG_STAT_CPU_POOL_SIZE;
+		spin_unlock_bh(&tag_stat_cpu_pool_lock);
+		if (full)
+			return;
+
+		tsc = alloc_percpu(struct tag_stat_cpu);
+		if (!tsc) {
+			pr_err("qtaguid: tag stat counters alloc failed\n");
+			return;
+		}
+
+		spin_lock_bh(&tag_stat_cpu_pool_lock);
+		if (tag_stat_cpu_pool_count < TAG_STAT_CPU_POOL_SIZE) {
+			ts_cpu_pool[tag_stat_cpu_pool_count++] = tsc;
+			tsc = NULL;
+		}
+		spin_unlock_bh(&tag_stat_cpu_pool_lock);
+		if (tsc) {
+			free_percpu(tsc);
+			return;
+		}
+	}
+}
+static DECLARE_WORK(tag_stat_cpu_pool_work, tag_stat_cpu_pool_fill);
+
+/* Returns zeroed per-cpu counters, or NULL if the pool ran dry. */
+static struct tag_stat_cpu __percpu *tag_stat_cpu_pool_get(void)
+{
+	struct tag_stat_cpu __percpu *tsc = NULL;
+
+	spin_lock_bh(&tag_stat_cpu_pool_lock);
+	if (tag_stat_cpu_pool_count)
+		tsc = ts_cpu_pool[--tag_stat_cpu_pool_count];
+	if (tag_stat_cpu_pool_count < TAG_STAT_CPU_POOL_SIZE / 2)
+		schedule_work(&tag_stat_cpu_pool_work);
+	spin_unlock_bh(&tag_stat_cpu_pool_lock);
+	return tsc;
+}
 /*----------------------------------------------*/
 static bool can_manipulate_uids(void)
 {
@@ -755,7 +824,8 @@ static int get_active_counter_set(tag_t tag)
 
 /*
  * Find the entry for tracking the specified interface.
- * Caller must hold iface_stat_list_lock
+ * Caller must hold iface_stat_list_lock or rcu_read_lock_bh.
+ * iface_stat entries are never freed once on the list.
  */
 static struct iface_stat *get_iface_entry(const char *ifname)
 {
@@ -768,7 +838,7 @@ static struct iface_stat *get_iface_entry(const char *ifname)
 	}
 
 	/* Iterate over interfaces */
-	list_for_each_entry(iface_entry, &iface_stat_list, list) {
+	list_for_each_entry_rcu(iface_entry, &iface_stat_list, list) {
 		if (!strcmp(ifname, iface_entry->ifname))
 			goto done;
 	}
@@ -941,7 +1011,7 @@ static struct iface_stat *iface_alloc(struct net_device *net_dev)
 	isw->iface_entry = new_iface;
 	INIT_WORK(&isw->iface_work, iface_create_proc_worker);
 	schedule_work(&isw->iface_work);
-	list_add(&new_iface->list, &iface_stat_list);
+	list_add_rcu(&new_iface->list, &iface_stat_list);
 	return new_iface;
 }
 
@@ -1216,20 +1286,33 @@ static void iface_stat_update(struct net_device *net_dev, bool stash_only)
 	spin_unlock_bh(&iface_stat_list_lock);
 }
 
-static void tag_stat_update(struct tag_stat *tag_entry,
+static void tag_stat_cpu_update(struct tag_stat *tag_entry, int active_set,
+				enum ifs_tx_rx direction, int proto, int bytes)
+{
+	struct tag_stat_cpu *tsc;
+
+	tsc = this_cpu_ptr(tag_entry->cpu_counters);
+	u64_stats_update_begin(&tsc->syncp);
+	data_counters_update(&tsc->counters, active_set, direction,
+			     proto, bytes);
+	u64_stats_update_end(&tsc->syncp);
+}
+
+/*
+ * Bill this cpu's counters of tag_entry and its parent.
+ * Caller must hold rcu_read_lock_bh.
+ */
+static void tag_stat_update(struct tag_stat *tag_entry, int active_set,
 			enum ifs_tx_rx direction, int proto, int bytes)
 {
-	int active_set;
-	active_set = get_active_counter_set(tag_entry->tn.tag);
 	MT_DEBUG("qtaguid: tag_stat_update(tag=0x%llx (uid=%u) set=%d "
 		 "dir=%d proto=%d bytes=%d)\n",
 		 tag_entry->tn.tag, get_uid_from_tag(tag_entry->tn.tag),
 		 active_set, direction, proto, bytes);
-	data_counters_update(&tag_entry->counters, active_set, direction,
-			     proto, bytes);
-	if (tag_entry->parent_counters)
-		data_counters_update(tag_entry->parent_counters, active_set,
-				     direction, proto, bytes);
+	tag_stat_cpu_update(tag_entry, active_set, direction, proto, bytes);
+	if (tag_entry->parent)
+		tag_stat_cpu_update(tag_entry->parent, active_set, direction,
+				    proto, bytes);
 }
 
 /*
@@ -1249,39 +1332,70 @@ static struct tag_stat *create_if_tag_stat(struct iface_stat *iface_entry,
 		pr_err("qtaguid: iface_stat: tag stat alloc failed\n");
 		goto done;
 	}
+	new_tag_stat_entry->cpu_counters = tag_stat_cpu_pool_get();
+	if (!new_tag_stat_entry->cpu_counters) {
+		pr_err("qtaguid: iface_stat: tag stat counters alloc failed\n");
+		kfree(new_tag_stat_entry);
+		new_tag_stat_entry = NULL;
+		goto done;
+	}
 	new_tag_stat_entry->tn.tag = tag;
 	tag_stat_tree_insert(new_tag_stat_entry, &iface_entry->tag_stat_tree);
 done:
 	return new_tag_stat_entry;
 }
 
+static void free_tag_stat_rcu(struct rcu_head *head)
+{
+	struct tag_stat *ts_entry = container_of(head, struct tag_stat, rcu);
+
+	free_percpu(ts_entry->cpu_counters);
+	kfree(ts_entry);
+}
+
 static void if_tag_stat_update(const char *ifname, uid_t uid,
 			       const struct sock *sk, enum ifs_tx_rx direction,
 			       int proto, int bytes)
 {
+	struct qtaguid_match_cache *cache;
 	struct tag_stat *tag_stat_entry;
+	struct tag_stat *uid_tag_stat;
 	tag_t tag, acct_tag;
 	tag_t uid_tag;
-	struct data_counters *uid_tag_counters;
 	struct sock_tag *sock_tag_entry;
 	struct iface_stat *iface_entry;
-	struct tag_stat *new_tag_stat;
+	unsigned int gen;
+	int active_set;
 	MT_DEBUG("qtaguid: if_tag_stat_update(ifname=%s "
 		"uid=%u sk=%p dir=%d proto=%d bytes=%d)\n",
 		 ifname, uid, sk, direction, proto, bytes);
 
-
+	rcu_read_lock_bh();
 	iface_entry = get_iface_entry(ifname);
 	if (!iface_entry) {
 		pr_err("qtaguid: iface_stat: stat_update() %s not found\n",
 		       ifname);
-		return;
+		goto unlock;
 	}
 	/* It is ok to process data when an iface_entry is inactive */
 
 	MT_DEBUG("qtaguid: iface_stat: stat_update() dev=%s entry=%p\n",
 		 ifname, iface_entry);
 
+	/*
+	 * Same socket, uid and iface as the last packet on this cpu, and
+	 * nothing changed since: bill the same tag_stat without any lookups.
+	 */
+	cache = &__get_cpu_var(qtaguid_match_cache);
+	gen = atomic_read(&qtaguid_cache_gen);
+	if (cache->gen == gen && cache->ts_entry &&
+	    cache->iface_entry == iface_entry &&
+	    cache->sk == sk && cache->uid == uid) {
+		tag_stat_update(cache->ts_entry, cache->active_set,
+				direction, proto, bytes);
+		goto unlock;
+	}
+
 	/*
 	 * Look for a tagged sock.
 	 * It will have an acct_uid.
@@ -1296,45 +1410,63 @@ static void if_tag_stat_update(const char *ifname, uid_t uid,
 		tag = combine_atag_with_uid(acct_tag, uid);
 		uid_tag = make_tag_from_uid(uid);
 	}
+	active_set = get_active_counter_set(tag);
 	MT_DEBUG("qtaguid: iface_stat: stat_update(): "
 		 " looking for tag=0x%llx (uid=%u) in ife=%p\n",
 		 tag, get_uid_from_tag(tag), iface_entry);
 	/* Loop over tag list under this interface for {acct_tag,uid_tag} */
-	spin_lock_bh(&iface_entry->tag_stat_list_lock);
+	spin_lock(&iface_entry->tag_stat_list_lock);
 
+	/*
+	 * Updating the {acct_tag, uid_tag} entry handles both stats:
+	 * {0, uid_tag} will also get updated.
+	 */
 	tag_stat_entry = tag_stat_tree_search(&iface_entry->tag_stat_tree,
 					      tag);
-	if (tag_stat_entry) {
-		/*
-		 * Updating the {acct_tag, uid_tag} entry handles both stats:
-		 * {0, uid_tag} will also get updated.
-		 */
-		tag_stat_update(tag_stat_entry, direction, proto, bytes);
-		spin_unlock_bh(&iface_entry->tag_stat_list_lock);
-		return;
-	}
-
-	/* Loop over tag list under this interface for {0,uid_tag} */
-	tag_stat_entry = tag_stat_tree_search(&iface_entry->tag_stat_tree,
-					      uid_tag);
 	if (!tag_stat_entry) {
-		/* Here: the base uid_tag did not exist */
-		/*
-		 * No parent counters. So
-		 *  - No {0, uid_tag} stats and no {acc_tag, uid_tag} stats.
-		 */
-		new_tag_stat = create_if_tag_stat(iface_entry, uid_tag);
-		uid_tag_counters = &new_tag_stat->counters;
-	} else {
-		uid_tag_counters = &tag_stat_entry->counters;
+		/* Loop over tag list under this interface for {0,uid_tag} */
+		uid_tag_stat = tag_stat_tree_search(
+			&iface_entry->tag_stat_tree, uid_tag);
+		if (!uid_tag_stat) {
+			/* Here: the base uid_tag did not exist */
+			/*
+			 * No parent counters. So
+			 *  - No {0, uid_tag} stats and no {acc_tag, uid_tag}
+			 *    stats.
+			 */
+			uid_tag_stat = create_if_tag_stat(iface_entry,
+							  uid_tag);
+			if (!uid_tag_stat)
+				goto unlock_tag_stat;
+		}
+		tag_stat_entry = uid_tag_stat;
+		if (acct_tag) {
+			tag_stat_entry = create_if_tag_stat(iface_entry, tag);
+			if (!tag_stat_entry)
+				goto unlock_tag_stat;
+			tag_stat_entry->parent = uid_tag_stat;
+		}
 	}
+	spin_unlock(&iface_entry->tag_stat_list_lock);
 
-	if (acct_tag) {
-		new_tag_stat = create_if_tag_stat(iface_entry, tag);
-		new_tag_stat->parent_counters = uid_tag_counters;
-	}
-	tag_stat_update(new_tag_stat, direction, proto, bytes);
-	spin_unlock_bh(&iface_entry->tag_stat_list_lock);
+	tag_stat_update(tag_stat_entry, active_set, direction, proto, bytes);
+
+	/*
+	 * gen was sampled before the lookups, so any concurrent change
+	 * already makes this entry stale.
+	 */
+	cache->iface_entry = iface_entry;
+	cache->sk = sk;
+	cache->uid = uid;
+	cache->ts_entry = tag_stat_entry;
+	cache->active_set = active_set;
+	cache->gen = gen;
+	goto unlock;
+
+unlock_tag_stat:
+	spin_unlock(&iface_entry->tag_stat_list_lock);
+unlock:
+	rcu_read_unlock_bh();
 }
 
 static int iface_netdev_event_handler(struct notifier_block *nb,
@@ -1930,6 +2062,7 @@ static int ctrl_cmd_delete(const char *input)
 				list_del(&st_entry->list);
 		}
 	}
+	qtaguid_cache_invalidate();
 	spin_unlock_bh(&sock_tag_list_lock);
 
 	sock_tag_tree_erase(&st_to_free_tree);
@@ -1947,6 +2080,7 @@ static int ctrl_cmd_delete(const char *input)
 			 tcs_entry->active_set);
 		rb_erase(&tcs_entry->tn.node, &tag_counter_set_tree);
 		kfree(tcs_entry);
+		qtaguid_cache_invalidate();
 	}
 	spin_unlock_bh(&tag_counter_set_list_lock);
 
@@ -1957,6 +2091,11 @@ static int ctrl_cmd_delete(const char *input)
 	spin_lock_bh(&iface_stat_list_lock);
 	list_for_each_entry(iface_entry, &iface_stat_list, list) {
 		spin_lock_bh(&iface_entry->tag_stat_list_lock);
+		/*
+		 * Unpublish cached pointers before the grace periods below
+		 * start, so no reader picks one up after call_rcu_bh().
+		 */
+		qtaguid_cache_invalidate();
 		node = rb_first(&iface_entry->tag_stat_tree);
 		while (node) {
 			ts_entry = rb_entry(node, struct tag_stat, tn.node);
@@ -1977,7 +2116,7 @@ static int ctrl_cmd_delete(const char *input)
 					 entry_uid);
 				rb_erase(&ts_entry->tn.node,
 					 &iface_entry->tag_stat_tree);
-				kfree(ts_entry);
+				call_rcu_bh(&ts_entry->rcu, free_tag_stat_rcu);
 			}
 		}
 		spin_unlock_bh(&iface_entry->tag_stat_list_lock);
@@ -2065,6 +2204,7 @@ static int ctrl_cmd_counter_set(const char *input)
 			 input, tag, get_uid_from_tag(tag), counter_set);
 	}
 	tcs->active_set = counter_set;
+	qtaguid_cache_invalidate();
 	spin_unlock_bh(&tag_counter_set_list_lock);
 	atomic64_inc(&qtu_events.counter_set_changes);
 	res = 0;
@@ -2200,6 +2340,7 @@ static int ctrl_cmd_tag(const char *input)
 		sock_tag_tree_insert(sock_tag_entry, &sock_tag_tree);
 		atomic64_inc(&qtu_events.sockets_tagged);
 	}
+	qtaguid_cache_invalidate();
 	spin_unlock_bh(&sock_tag_list_lock);
 	/* We keep the ref to the socket (file) until it is untagged */
 	CT_DEBUG("qtaguid: ctrl_tag(%s): done st@%p ...->f_count=%ld\n",
@@ -2287,6 +2428,7 @@ static int ctrl_cmd_untag(const char *input)
 	 * only during a cmd_delete().
 	 */
 	tag_ref_entry->num_sock_tags--;
+	qtaguid_cache_invalidate();
 	spin_unlock_bh(&sock_tag_list_lock);
 	/*
 	 * Release the sock_fd that was grabbed at tag time,
@@ -2382,7 +2524,8 @@ struct proc_print_info {
 static int pp_stats_line(struct proc_print_info *ppi, int cnt_set)
 {
 	int len;
-	struct data_counters *cnts;
+	struct data_counters cnts_sum;
+	struct data_counters *cnts = &cnts_sum;
 
 	if (!ppi->item_index) {
 		if (ppi->item_index++ < ppi->items_to_skip)
@@ -2412,7 +2555,7 @@ static int pp_stats_line(struct proc_print_info *ppi, int cnt_set)
 		}
 		if (ppi->item_index++ < ppi->items_to_skip)
 			return 0;
-		cnts = &ppi->ts_entry->counters;
+		tag_stat_fold_counters(ppi->ts_entry, cnts);
 		len = snprintf(
 			ppi->outp, ppi->char_count,
 			"%d %s 0x%llx %u %u "
@@ -2675,6 +2818,7 @@ static int qtudev_release(struct inode *inode, struct file *file)
 	put_utd_entry(pqd_entry->parent_tag_data);
 	kfree(pqd_entry);
 	file->private_data = NULL;
+	qtaguid_cache_invalidate();
 
 	spin_unlock_bh(&uid_tag_data_tree_lock);
 	spin_unlock_bh(&sock_tag_list_lock);
@@ -2759,13 +2903,131 @@ static struct xt_match qtaguid_mt_reg __read_mostly = {
 	.me         = THIS_MODULE,
 };
 
+#ifdef CONFIG_NETFILTER_XT_MATCH_QTAGUID_SELFTEST
+#define QTAGUID_TEST_PACKETS	100000
+#define QTAGUID_TEST_UID1	99990
+#define QTAGUID_TEST_UID2	99991
+#define QTAGUID_TEST_ATAG	0x7e57
+
+static uint64_t __init qtaguid_test_packets(struct iface_stat *iface_entry,
+					    tag_t tag)
+{
+	struct data_counters dc;
+	struct tag_stat *ts_entry;
+
+	spin_lock_bh(&iface_entry->tag_stat_list_lock);
+	ts_entry = tag_stat_tree_search(&iface_entry->tag_stat_tree, tag);
+	if (ts_entry)
+		tag_stat_fold_counters(ts_entry, &dc);
+	spin_unlock_bh(&iface_entry->tag_stat_list_lock);
+	return ts_entry ? dc_sum_packets(&dc, 0, IFS_RX) : 0;
+}
+
+/*
+ * Bill packets to a private iface through if_tag_stat_update(): the
+ * same uid over and over (match cache hits), two alternating uids
+ * (misses) and a tagged socket (child and parent tag_stat). Check the
+ * folded per-cpu counters and log the cost per packet of each.
+ */
+static void __init qtaguid_selftest(void)
+{
+	static const char ifname[] = "qtaguid_test";
+	struct sock_tag st = {
+		.tag = combine_atag_with_uid(
+			make_atag_from_value(QTAGUID_TEST_ATAG),
+			QTAGUID_TEST_UID1),
+	};
+	tag_t utag1 = make_tag_from_uid(QTAGUID_TEST_UID1);
+	tag_t utag2 = make_tag_from_uid(QTAGUID_TEST_UID2);
+	struct iface_stat *iface_entry;
+	struct tag_stat *ts_entry;
+	struct rb_node *node;
+	s64 hit_ns, miss_ns, tagged_ns;
+	ktime_t start;
+	bool ok;
+	int i;
+
+	iface_entry = kzalloc(sizeof(*iface_entry), GFP_KERNEL);
+	if (!iface_entry)
+		return;
+	iface_entry->ifname = (char *)ifname;
+	iface_entry->tag_stat_tree = RB_ROOT;
+	spin_lock_init(&iface_entry->tag_stat_list_lock);
+	spin_lock_bh(&iface_stat_list_lock);
+	list_add_rcu(&iface_entry->list, &iface_stat_list);
+	spin_unlock_bh(&iface_stat_list_lock);
+
+	/* Never dereferenced, only used as a key */
+	st.sk = (struct sock *)&st;
+	spin_lock_bh(&sock_tag_list_lock);
+	sock_tag_tree_insert(&st, &sock_tag_tree);
+	qtaguid_cache_invalidate();
+	spin_unlock_bh(&sock_tag_list_lock);
+
+	start = ktime_get();
+	for (i = 0; i < QTAGUID_TEST_PACKETS; i++)
+		if_tag_stat_update(ifname, QTAGUID_TEST_UID1, NULL, IFS_RX,
+				   IPPROTO_TCP, 100);
+	hit_ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+
+	start = ktime_get();
+	for (i = 0; i < QTAGUID_TEST_PACKETS; i++)
+		if_tag_stat_update(ifname, i & 1 ? QTAGUID_TEST_UID2 :
+				   QTAGUID_TEST_UID1, NULL, IFS_RX,
+				   IPPROTO_TCP, 100);
+	miss_ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+
+	start = ktime_get();
+	for (i = 0; i < QTAGUID_TEST_PACKETS; i++)
+		if_tag_stat_update(ifname, QTAGUID_TEST_UID1, st.sk, IFS_RX,
+				   IPPROTO_TCP, 100);
+	tagged_ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+
+	ok = qtaguid_test_packets(iface_entry, utag1) ==
+		QTAGUID_TEST_PACKETS * 5 / 2 &&
+	     qtaguid_test_packets(iface_entry, utag2) ==
+		QTAGUID_TEST_PACKETS / 2 &&
+	     qtaguid_test_packets(iface_entry, st.tag) ==
+		QTAGUID_TEST_PACKETS;
+
+	spin_lock_bh(&sock_tag_list_lock);
+	rb_erase(&st.sock_node, &sock_tag_tree);
+	spin_unlock_bh(&sock_tag_list_lock);
+	spin_lock_bh(&iface_stat_list_lock);
+	list_del_rcu(&iface_entry->list);
+	qtaguid_cache_invalidate();
+	spin_unlock_bh(&iface_stat_list_lock);
+	synchronize_rcu_bh();
+
+	while ((node = rb_first(&iface_entry->tag_stat_tree))) {
+		ts_entry = rb_entry(node, struct tag_stat, tn.node);
+		rb_erase(node, &iface_entry->tag_stat_tree);
+		free_percpu(ts_entry->cpu_counters);
+		kfree(ts_entry);
+	}
+	kfree(iface_entry);
+
+	pr_info("qtaguid: self-test %s: ns/packet cached %lld, uncached %lld,"
+		" tagged %lld\n", ok ? "passed" : "FAILED",
+		div_s64(hit_ns, QTAGUID_TEST_PACKETS),
+		div_s64(miss_ns, QTAGUID_TEST_PACKETS),
+		div_s64(tagged_ns, QTAGUID_TEST_PACKETS));
+}
+#else
+static inline void qtaguid_selftest(void)
+{
+}
+#endif /* CONFIG_NETFILTER_XT_MATCH_QTAGUID_SELFTEST */
+
 static int __init qtaguid_mt_init(void)
 {
+	tag_stat_cpu_pool_fill(NULL);
 	if (qtaguid_proc_register(&xt_qtaguid_procdir)
 	    || iface_stat_init(xt_qtaguid_procdir)
 	    || xt_register_match(&qtaguid_mt_reg)
 	    || misc_register(&qtu_device))
 		return -1;
+	qtaguid_selftest();
 	return 0;
 }
 
@@ -11,8 +11,12 @@
 #define __XT_QTAGUID_INTERNAL_H__
 
 #include <linux/types.h>
+#include <linux/cpumask.h>
 #include <linux/rbtree.h>
+#include <linux/rcupdate.h>
 #include <linux/spinlock_types.h>
+#include <linux/string.h>
+#include <linux/u64_stats_sync.h>
 #include <linux/workqueue.h>
 
 /* Iface handling */
@@ -185,18 +189,68 @@ struct tag_node {
 	tag_t tag;
 };
 
+/*
+ * Each cpu bills into its own copy of the counters, so the match path
+ * never has to serialize on the tag_stat. Readers fold them together.
+ */
+struct tag_stat_cpu {
+	struct data_counters counters;
+	struct u64_stats_sync syncp;
+};
+
 struct tag_stat {
 	struct tag_node tn;
-	struct data_counters counters;
+	struct tag_stat_cpu __percpu *cpu_counters;
 	/*
 	 * If this tag is acct_tag based, we need to count against the
 	 * matching parent uid_tag.
 	 */
-	struct data_counters *parent_counters;
+	struct tag_stat *parent;
+	/* Freed after a grace period, the match path uses it locklessly */
+	struct rcu_head rcu;
+};
+
+/* Sum the per-cpu counters of a tag_stat into dc. */
+static inline void tag_stat_fold_counters(const struct tag_stat *ts,
+					  struct data_counters *dc)
+{
+	struct data_counters snap;
+	uint64_t *dst, *src;
+	unsigned int start;
+	int cpu, i;
+
+	memset(dc, 0, sizeof(*dc));
+	for_each_possible_cpu(cpu) {
+		const struct tag_stat_cpu *tsc = per_cpu_ptr(ts->cpu_counters,
+							     cpu);
+
+		do {
+			start = u64_stats_fetch_begin_bh(&tsc->syncp);
+			snap = tsc->counters;
+		} while (u64_stats_fetch_retry_bh(&tsc->syncp, start));
+
+		dst = (uint64_t *)dc;
+		src = (uint64_t *)&snap;
+		for (i = 0; i < sizeof(*dc) / sizeof(uint64_t); i++)
+			dst[i] += src[i];
+	}
+}
+
+/*
+ * Per-cpu memory of the last {iface, sock, uid} that got billed and
+ * where it went. Only valid while gen matches qtaguid_cache_gen.
+ */
+struct qtaguid_match_cache {
+	unsigned int gen;
+	const struct iface_stat *iface_entry;
+	const struct sock *sk;
+	uid_t uid;
+	struct tag_stat *ts_entry;
+	int active_set;
 };
 
 struct iface_stat {
-	struct list_head list;  /* in iface_stat_list */
+	struct list_head list;  /* in iface_stat_list, RCU for readers */
 	char *ifname;
 	bool active;
 	/* net_dev is only valid for active iface_stat */